@@ -49,6 +49,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include "flash.h"
 #include "image.h"
 #include "nvcom.h"
+#include "isotp.h"
 #include "firmware_manager.h"
 #include "device_monitoring.h"
 #include "device_monitoring_cmd.h"
@@ -117,6 +118,7 @@ static struct module_t module;
 static void ConsoleWrite(const char *str);
 static size_t ConsoleRead(char *str);
 static void RegisterConsoleCommands(void);
+static void ShareCANBitRate(void);
 static void ConfigureSignalHandler(void);
 static void HandleRPM1Signal(struct signal_t *signal_p);
 static void HandleCurrent1Signal(struct signal_t *signal_p);
@@ -150,11 +152,13 @@ void Application_Init(void)
     NVCom_Init();
     ADC_Init();
     SystemMonitor_Init();
-    CANInterface_Init();
-    DeviceMonitoring_Init();
     Flash_Init();
     NVS_Init(Board_GetNVSAddress(), Board_GetNumberOfPagesInNVS());
     Config_Init();
+    CANInterface_Init(Config_GetCANBitRate());
+    ShareCANBitRate();
+    ISOTP_Init();
+    DeviceMonitoring_Init();
     MotorController_Init();
     ADC_Start();
     SignalHandler_Init();
@@ -181,11 +185,14 @@ void Application_Init(void)
 void Application_Run(void)
 {
     DeviceMonitoring_StartTimer(DEV_MON_METRIC_MAIN_TASK_TIME);
+    CANInterface_Process();
     SignalHandler_Process();
     MotorController_Update();
     Console_Process();
     SystemMonitor_Update();
-    FirmwareManager_Update();
+    ISOTP_Proccess();
+    FirmwareManager_Process();
+    NVS_Process();
     HandleStateChanges();
     DeviceMonitoring_Update();
 
@@ -224,17 +231,29 @@ static void RegisterConsoleCommands(void)
     Console_RegisterCommand("level", LoggingCmd_SetLevel);
     Console_RegisterCommand("store", NVSCmd_Store);
     Console_RegisterCommand("remove", NVSCmd_Remove);
+    Console_RegisterCommand("nvsstat", NVSCmd_PrintStatistics);
     Console_RegisterCommand("update", ApplicationCmd_UpdateFirmware);
     Console_RegisterCommand("dump", DeviceMonitoringCmd_DumpData);
+    Console_RegisterCommand("bitrate", ApplicationCmd_SetCANBitRate);
+    Console_RegisterCommand("canstat", DeviceMonitoringCmd_PrintCANStatistics);
+    Console_RegisterCommand("isotpstat", DeviceMonitoringCmd_PrintISOTPStatistics);
+    Console_RegisterCommand("latency", DeviceMonitoringCmd_PrintLatency);
+}
+
+static void ShareCANBitRate(void)
+{
+    /* The bootloader uses this rate, NVS is only read when NVCom was cleared. */
+    struct nvcom_data_t *data_p = NVCom_GetData();
+    data_p->can_bit_rate = CANInterface_GetBitRate();
+    NVCom_SetData(data_p);
 }
 
 static void ConfigureSignalHandler(void)
 {
     const uint32_t motor_control_frame_id = 0x09;
-    const uint32_t id_mask = 0xffff;
+    const uint32_t id_mask = CANINTERFACE_STANDARD_ID_MASK;
 
-    CANInterface_RegisterListener(SignalHandler_Listener, NULL);
-    CANInterface_AddFilter(motor_control_frame_id, id_mask);
+    CANInterface_RegisterListener(motor_control_frame_id, id_mask, CANINTERFACE_PRIORITY_CONTROL, SignalHandler_Listener, NULL);
     if (Config_GetNumberOfMotors() > 0)
     {
         SignalHandler_RegisterHandler(SIGNAL_CONTROL_RPM1, HandleRPM1Signal);
@@ -253,12 +272,14 @@ static void HandleRPM1Signal(struct signal_t *signal_p)
 {
     Signal_Log(signal_p, module.logger);
     MotorController_SetRPM(BOARD_M1_INDEX, *(int16_t *)signal_p->data_p);
+    MotorController_SetSetpointTime(BOARD_M1_INDEX, signal_p->timestamp);
 }
 
 static void HandleCurrent1Signal(struct signal_t *signal_p)
 {
     Signal_Log(signal_p, module.logger);
     MotorController_SetCurrent(BOARD_M1_INDEX, *(int16_t *)signal_p->data_p);
+    MotorController_SetSetpointTime(BOARD_M1_INDEX, signal_p->timestamp);
 }
 
 static void HandleMode1Signal(struct signal_t *signal_p)
@@ -270,12 +291,14 @@ static void HandleRPM2Signal(struct signal_t *signal_p)
 {
     Signal_Log(signal_p, module.logger);
     MotorController_SetRPM(BOARD_M2_INDEX, *(int16_t *)signal_p->data_p);
+    MotorController_SetSetpointTime(BOARD_M2_INDEX, signal_p->timestamp);
 }
 
 static void HandleCurrent2Signal(struct signal_t *signal_p)
 {
     Signal_Log(signal_p, module.logger);
     MotorController_SetCurrent(BOARD_M2_INDEX, *(int16_t *)signal_p->data_p);
+    MotorController_SetSetpointTime(BOARD_M2_INDEX, signal_p->timestamp);
 }
 
 static void HandleMode2Signal(struct signal_t *signal_p)
@@ -384,7 +407,7 @@ static inline void PrintSoftwareInformation(void)
 
 static inline void PrintConfig(void)
 {
-    Logging_Info(module.logger, "config: {valid: %s, number_of_motors: %u, counts_per_rev: %u, no_load_rpm: %u, no_load_current: %u, stall_current: %u, kp: %u, ki: %u, kd: %u, imax: %i, imin: %i}",
+    Logging_Info(module.logger, "config: {valid: %s, number_of_motors: %u, counts_per_rev: %u, no_load_rpm: %u, no_load_current: %u, stall_current: %u, kp: %u, ki: %u, kd: %u, imax: %i, imin: %i, can_bitrate: %u}",
                  Config_IsValid() ? "true" : "false",
                  Config_GetNumberOfMotors(),
                  Config_GetCountsPerRev(),
@@ -395,7 +418,8 @@ static inline void PrintConfig(void)
                  Config_GetValue("ki"),
                  Config_GetValue("kd"),
                  Config_GetValue("imax"),
-                 Config_GetValue("imin")
+                 Config_GetValue("imin"),
+                 CANInterface_GetBitRate()
                 );
 }
 
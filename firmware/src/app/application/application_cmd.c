@@ -26,6 +26,9 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////
 
 #include "board.h"
+#include "console.h"
+#include "config.h"
+#include "can_interface.h"
 #include "nvcom.h"
 #include "device_monitoring.h"
 #include "application_cmd.h"
@@ -70,6 +73,24 @@ bool ApplicationCmd_Reset(void)
     return true;
 }
 
+bool ApplicationCmd_SetCANBitRate(void)
+{
+    bool status = false;
+
+    /*
+     * The new rate is not applied directly since that would cut off every
+     * other node on the bus, including the one issuing the command.
+     */
+    uint32_t bit_rate;
+    struct caninterface_bit_timing_t timing;
+    if (Console_GetArgument(&bit_rate) && CANInterface_CalculateBitTiming(bit_rate, &timing))
+    {
+        status = Config_SetCANBitRate(bit_rate);
+    }
+
+    return status;
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
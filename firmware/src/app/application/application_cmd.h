@@ -60,4 +60,11 @@ bool ApplicationCmd_UpdateFirmware(void);
  */
 bool ApplicationCmd_Reset(void);
 
+/**
+ * Store a new CAN bus bit rate, applied after the next reset.
+ *
+ * @return True if the bit rate is supported and was stored, otherwise false.
+ */
+bool ApplicationCmd_SetCANBitRate(void);
+
 #endif
@@ -78,6 +78,7 @@ static struct signal_handler_t signal_handlers[MAX_NUMBER_OF_HANDLERS];
 static size_t number_of_handlers;
 static firmware_manager_allowed_t reset_allowed_func;
 static firmware_manager_allowed_t update_allowed_func;
+static struct nvcom_data_t nvcom_data;
 vector_table_t vector_table;
 const struct note_section_t note_build_id;
 
@@ -123,17 +124,22 @@ static int Setup(void **state)
     expect_function_call(NVCom_Init);
     expect_function_call(ADC_Init);
     expect_function_call(SystemMonitor_Init);
-    expect_function_call(CANInterface_Init);
-    will_return(Board_GetNVSAddress, 0x801F800);
-    will_return(Board_GetNumberOfPagesInNVS, 2);
+    will_return(Board_GetNVSAddress, 0x801E000);
+    will_return(Board_GetNumberOfPagesInNVS, 8);
     expect_function_call(NVS_Init);
     expect_function_call(Config_Init);
+    will_return(Config_GetCANBitRate, 1000000);
+    expect_function_call(CANInterface_Init);
+    expect_uint_value(CANInterface_Init, bit_rate, 1000000);
+    will_return_ptr(NVCom_GetData, &nvcom_data);
+    will_return_uint_always(CANInterface_GetBitRate, 1000000);
     expect_function_call(MotorController_Init);
     expect_function_call(SignalHandler_Init);
     will_return(Logging_GetLogger, dummy_logger);
     expect_function_call(CANInterface_RegisterListener);
-    expect_any(CANInterface_AddFilter, id);
-    expect_any(CANInterface_AddFilter, mask);
+    expect_any(CANInterface_RegisterListener, id);
+    expect_any(CANInterface_RegisterListener, mask);
+    expect_uint_value(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_CONTROL);
     will_return_uint_always(Config_GetNumberOfMotors, number_of_motors);
     expect_any_always(SignalHandler_RegisterHandler, id);
     will_return_uint_maybe(SystemMonitor_GetResetFlags, 0);
@@ -182,17 +188,22 @@ static void test_Application_Init_NoMotors(void **state)
     expect_function_call(NVCom_Init);
     expect_function_call(ADC_Init);
     expect_function_call(SystemMonitor_Init);
-    expect_function_call(CANInterface_Init);
-    will_return(Board_GetNVSAddress, 0x801F800);
-    will_return(Board_GetNumberOfPagesInNVS, 2);
+    will_return(Board_GetNVSAddress, 0x801E000);
+    will_return(Board_GetNumberOfPagesInNVS, 8);
     expect_function_call(NVS_Init);
     expect_function_call(Config_Init);
+    will_return(Config_GetCANBitRate, 1000000);
+    expect_function_call(CANInterface_Init);
+    expect_uint_value(CANInterface_Init, bit_rate, 1000000);
+    will_return_ptr(NVCom_GetData, &nvcom_data);
+    will_return_uint_always(CANInterface_GetBitRate, 1000000);
     expect_function_call(MotorController_Init);
     expect_function_call(SignalHandler_Init);
     will_return(Logging_GetLogger, dummy_logger);
     expect_function_call(CANInterface_RegisterListener);
-    expect_any(CANInterface_AddFilter, id);
-    expect_any(CANInterface_AddFilter, mask);
+    expect_any(CANInterface_RegisterListener, id);
+    expect_any(CANInterface_RegisterListener, mask);
+    expect_uint_value(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_CONTROL);
     will_return_uint_always(Config_GetNumberOfMotors, number_of_motors);
     will_return_uint_maybe(SystemMonitor_GetResetFlags, 0);
     will_return_uint_maybe(Board_GetHardwareRevision, 1);
@@ -219,17 +230,22 @@ static void test_Application_Init(void **state)
     expect_function_call(NVCom_Init);
     expect_function_call(ADC_Init);
     expect_function_call(SystemMonitor_Init);
-    expect_function_call(CANInterface_Init);
-    will_return(Board_GetNVSAddress, 0x801F800);
-    will_return(Board_GetNumberOfPagesInNVS, 2);
+    will_return(Board_GetNVSAddress, 0x801E000);
+    will_return(Board_GetNumberOfPagesInNVS, 8);
     expect_function_call(NVS_Init);
     expect_function_call(Config_Init);
+    will_return(Config_GetCANBitRate, 1000000);
+    expect_function_call(CANInterface_Init);
+    expect_uint_value(CANInterface_Init, bit_rate, 1000000);
+    will_return_ptr(NVCom_GetData, &nvcom_data);
+    will_return_uint_always(CANInterface_GetBitRate, 1000000);
     expect_function_call(MotorController_Init);
     expect_function_call(SignalHandler_Init);
     will_return(Logging_GetLogger, dummy_logger);
     expect_function_call(CANInterface_RegisterListener);
-    expect_any(CANInterface_AddFilter, id);
-    expect_any(CANInterface_AddFilter, mask);
+    expect_any(CANInterface_RegisterListener, id);
+    expect_any(CANInterface_RegisterListener, mask);
+    expect_uint_value(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_CONTROL);
     will_return_uint_always(Config_GetNumberOfMotors, number_of_motors);
     expect_any_always(SignalHandler_RegisterHandler, id);
     will_return_uint_maybe(SystemMonitor_GetResetFlags, 0);
@@ -244,6 +260,8 @@ static void test_Application_Init(void **state)
     will_return_uint_maybe(Config_GetValue, 0);
 
     Application_Init();
+
+    assert_int_equal(nvcom_data.can_bit_rate, 1000000);
 }
 
 static void test_Application_Run(void **state)
@@ -251,18 +269,24 @@ static void test_Application_Run(void **state)
     const uint32_t motor_status_period_ms = 200;
     const size_t number_of_motors = 1;
 
+    expect_function_call(CANInterface_Process);
     expect_function_call(SignalHandler_Process);
     expect_function_call(MotorController_Update);
     expect_function_call(Console_Process);
     expect_function_call(SystemMonitor_Update);
+    expect_function_call(ISOTP_Proccess);
+    expect_function_call(NVS_Process);
     will_return(SystemMonitor_GetState, SYSTEM_MONITOR_UNKNOWN);
     will_return(SysTime_GetDifference, motor_status_period_ms - 1);
     Application_Run();
 
+    expect_function_call(CANInterface_Process);
     expect_function_call(SignalHandler_Process);
     expect_function_call(MotorController_Update);
     expect_function_call(Console_Process);
     expect_function_call(SystemMonitor_Update);
+    expect_function_call(ISOTP_Proccess);
+    expect_function_call(NVS_Process);
     will_return(SystemMonitor_GetState, SYSTEM_MONITOR_UNKNOWN);
     will_return(SysTime_GetDifference, motor_status_period_ms);
     expect_function_call(Board_ToggleStatusLED);
@@ -301,19 +325,25 @@ static void test_Application_Run_StateChanges(void **state)
     will_return_uint_always(Config_GetNumberOfMotors, number_of_motors);
 
     /* Active */
+    expect_function_call(CANInterface_Process);
     expect_function_call(SignalHandler_Process);
     expect_function_call(MotorController_Update);
     expect_function_call(Console_Process);
     expect_function_call(SystemMonitor_Update);
+    expect_function_call(ISOTP_Proccess);
+    expect_function_call(NVS_Process);
     will_return(SystemMonitor_GetState, SYSTEM_MONITOR_ACTIVE);
     will_return(SysTime_GetDifference, 0);
     Application_Run();
 
     /* Fail */
+    expect_function_call(CANInterface_Process);
     expect_function_call(SignalHandler_Process);
     expect_function_call(MotorController_Update);
     expect_function_call(Console_Process);
     expect_function_call(SystemMonitor_Update);
+    expect_function_call(ISOTP_Proccess);
+    expect_function_call(NVS_Process);
     will_return(SystemMonitor_GetState, SYSTEM_MONITOR_FAIL);
     for (size_t i = 0; i < number_of_motors; ++i)
     {
@@ -323,10 +353,13 @@ static void test_Application_Run_StateChanges(void **state)
     Application_Run();
 
     /* Inactive */
+    expect_function_call(CANInterface_Process);
     expect_function_call(SignalHandler_Process);
     expect_function_call(MotorController_Update);
     expect_function_call(Console_Process);
     expect_function_call(SystemMonitor_Update);
+    expect_function_call(ISOTP_Proccess);
+    expect_function_call(NVS_Process);
     will_return(SystemMonitor_GetState, SYSTEM_MONITOR_INACTIVE);
     for (size_t i = 0; i < number_of_motors; ++i)
     {
@@ -336,10 +369,13 @@ static void test_Application_Run_StateChanges(void **state)
     Application_Run();
 
     /* Emergency */
+    expect_function_call(CANInterface_Process);
     expect_function_call(SignalHandler_Process);
     expect_function_call(MotorController_Update);
     expect_function_call(Console_Process);
     expect_function_call(SystemMonitor_Update);
+    expect_function_call(ISOTP_Proccess);
+    expect_function_call(NVS_Process);
     will_return(SystemMonitor_GetState, SYSTEM_MONITOR_EMERGENCY);
     expect_uint_value(DeviceMonitoring_Count, id, DEV_MON_METRIC_EMERGENCY_STOP);
     expect_int_value(DeviceMonitoring_Count, amount, 1);
@@ -351,10 +387,13 @@ static void test_Application_Run_StateChanges(void **state)
     Application_Run();
 
     /* Unknown */
+    expect_function_call(CANInterface_Process);
     expect_function_call(SignalHandler_Process);
     expect_function_call(MotorController_Update);
     expect_function_call(Console_Process);
     expect_function_call(SystemMonitor_Update);
+    expect_function_call(ISOTP_Proccess);
+    expect_function_call(NVS_Process);
     will_return(SystemMonitor_GetState, SYSTEM_MONITOR_UNKNOWN);
     will_return(SysTime_GetDifference, 0);
     Application_Run();
@@ -0,0 +1,839 @@
+/**
+ * @file   isotp_benchmark.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  ISO-TP throughput and latency benchmark.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Two ISO-TP channels are connected back to back through a model of the CAN
+ * interface and bus, running on a simulated clock. A sender transfers a
+ * series of messages to a receiver that drains its RX buffer once per main
+ * loop, for each combination of the swept parameters:
+ *
+ *   - Payload size.
+ *   - RX buffer size, which bounds the block size granted by the receiver.
+ *   - Separation time (STmin) requested by the receiver.
+ *   - Depth of the CAN TX queue and the paced TX queue.
+ *   - Main loop period, i.e. how often 'ISOTP_Proccess' is called.
+ *
+ * Frames are put on the bus by the TX "interrupt" as soon as the bus is free,
+ * while received frames are dispatched from the main loop, as on target.
+ * Results only depend on the simulated clock so they are the same between
+ * runs and machines, and can be compared against a stored baseline.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "utility.h"
+#include "logging.h"
+#include "systime.h"
+#include "can_interface.h"
+#include "isotp.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define BIT_RATE 500000
+
+#define DATA_ID 0x701 /* Sender to receiver. */
+#define FLOW_CONTROL_ID 0x702 /* Receiver to sender. */
+
+#define MAX_NUMBER_OF_LISTENERS 4
+#define MAX_QUEUE_DEPTH 16
+#define RX_QUEUE_SIZE 32 /* Same as the RX batch in the CAN interface. */
+
+#define MAX_PAYLOAD_SIZE 8192
+#define MAX_RX_BUFFER_SIZE 4096
+#define SENDER_RX_BUFFER_SIZE 8
+#define RECEIVER_TX_BUFFER_SIZE 8
+
+#define NUMBER_OF_MESSAGES 32
+#define MESSAGE_TIMEOUT_US 10000000
+
+#define MAX_BASELINE_ENTRIES 256
+#define REGRESSION_TOLERANCE_PERCENT 5
+
+#define DIVIDE_ROUND_UP(a, b) (((a) + (b) - 1) / (b))
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct config_t
+{
+    uint32_t payload_size;
+    uint32_t rx_buffer_size;
+    uint32_t separation_time; /* STmin code, see ISO 15765-2. */
+    uint32_t queue_depth;
+    uint32_t process_period_us;
+};
+
+struct result_t
+{
+    uint32_t bytes_per_second;
+    double frames_per_process;
+    double block_size;
+    uint32_t latency_p50_us;
+    uint32_t latency_p90_us;
+    uint32_t latency_p99_us;
+    uint32_t dropped_frames;
+    bool failed;
+};
+
+struct baseline_entry_t
+{
+    struct config_t config;
+    uint32_t bytes_per_second;
+    uint32_t latency_p99_us;
+};
+
+struct bus_frame_t
+{
+    struct can_frame_t frame;
+    uint32_t separation_time_us;
+};
+
+struct frame_queue_t
+{
+    struct bus_frame_t frames[RX_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t depth;
+};
+
+struct listener_t
+{
+    uint32_t id;
+    uint32_t mask;
+    caninterface_listener_cb_t listener_cb;
+    void *arg_p;
+};
+
+/**
+ * Frames queued with 'CANInterface_Transmit' and 'CANInterface_TransmitPaced'
+ * are sent one at a time, paced frames first. A paced frame holds back the
+ * next paced frame until its separation time has passed after it was sent.
+ */
+struct bus_t
+{
+    struct frame_queue_t tx_queue;
+    struct frame_queue_t paced_queue;
+    struct frame_queue_t rx_queue;
+    struct bus_frame_t frame;
+    bool busy;
+    bool paced;
+    uint32_t done_time;
+    uint32_t idle_time;
+    uint32_t paced_ready_time;
+    uint32_t paced_id;
+    struct listener_t listeners[MAX_NUMBER_OF_LISTENERS];
+    size_t number_of_listeners;
+    uint32_t number_of_dropped_frames;
+    uint32_t number_of_flow_control_frames;
+    uint32_t block_size_sum;
+};
+
+struct module_t
+{
+    uint32_t time_us;
+    struct bus_t bus;
+    struct isotp_ctx_t sender;
+    struct isotp_ctx_t receiver;
+    uint8_t sender_rx_buffer[SENDER_RX_BUFFER_SIZE];
+    uint8_t sender_tx_buffer[MAX_PAYLOAD_SIZE];
+    uint8_t receiver_rx_buffer[MAX_RX_BUFFER_SIZE];
+    uint8_t receiver_tx_buffer[RECEIVER_TX_BUFFER_SIZE];
+    uint8_t payload[MAX_PAYLOAD_SIZE];
+    size_t payload_size;
+    size_t received_bytes;
+    bool sending;
+    bool corrupted;
+    uint32_t number_of_process_calls;
+    uint32_t number_of_frames;
+    uint32_t latencies_us[NUMBER_OF_MESSAGES];
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static const uint32_t payload_sizes[] = {7, 64, 512, 4095, 8192};
+static const uint32_t rx_buffer_sizes[] = {32, 128, 1152, 4096};
+static const uint32_t separation_times[] = {0, 0xF5, 1};
+static const uint32_t queue_depths[] = {2, 16};
+static const uint32_t process_periods_us[] = {100, 1000};
+
+static struct module_t module;
+
+static struct baseline_entry_t baseline[MAX_BASELINE_ENTRIES];
+static size_t number_of_baseline_entries;
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static void PrintUsage(const char *name);
+static bool LoadBaseline(const char *path);
+static const struct baseline_entry_t *GetBaselineEntry(const struct config_t *config_p);
+static bool IsRegression(const struct config_t *config_p, const struct result_t *result_p);
+static void RunBenchmark(const struct config_t *config_p, struct result_t *result_p);
+static bool TransferMessage(const struct config_t *config_p, size_t index);
+static void RunMainLoop(const struct config_t *config_p);
+static void DrainReceiver(void);
+static void SenderStatusCallback(enum isotp_status_t status);
+static void ReceiverStatusCallback(enum isotp_status_t status);
+static void RunBus(uint32_t end_time);
+static bool StartFrame(uint32_t end_time);
+static void CompleteFrame(void);
+static void DispatchFrames(void);
+static uint32_t GetFrameTime(size_t size);
+static struct bus_frame_t *Enqueue(struct frame_queue_t *queue_p, uint32_t id, const void *data_p, size_t size, uint32_t separation_time_us);
+static struct bus_frame_t *Peek(struct frame_queue_t *queue_p);
+static size_t GetQueueLength(const struct frame_queue_t *queue_p);
+static uint32_t GetPercentile(uint32_t *values_p, size_t number_of_values, uint32_t percentile);
+static int CompareValues(const void *a_p, const void *b_p);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+    const char *baseline_path = NULL;
+    const char *output_path = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "b:w:h")) != -1)
+    {
+        switch (option)
+        {
+            case 'b':
+                baseline_path = optarg;
+                break;
+
+            case 'w':
+                output_path = optarg;
+                break;
+
+            case 'h':
+                PrintUsage(argv[0]);
+                return EXIT_SUCCESS;
+
+            default:
+                PrintUsage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if ((baseline_path != NULL) && !LoadBaseline(baseline_path))
+    {
+        return EXIT_FAILURE;
+    }
+
+    FILE *output_p = NULL;
+    if (output_path != NULL)
+    {
+        output_p = fopen(output_path, "w");
+        if (output_p == NULL)
+        {
+            perror(output_path);
+            return EXIT_FAILURE;
+        }
+        fprintf(output_p, "payload,rx_buffer,st,depth,period_us,bytes_per_second,p99_us\n");
+    }
+
+    printf("ISO-TP benchmark: %u kbit/s, frame pool %u, %u messages per run\n",
+           BIT_RATE / 1000, ISOTP_FRAME_POOL_SIZE, NUMBER_OF_MESSAGES);
+    printf("%7s %9s %4s %5s %9s %9s %8s %6s %9s %9s %9s %7s  %s\n",
+           "payload", "rx_buffer", "st", "depth", "period_us", "bytes/s", "frames/p", "bs",
+           "p50_us", "p90_us", "p99_us", "dropped", "status");
+
+    size_t number_of_failures = 0;
+    size_t number_of_regressions = 0;
+
+    for (size_t a = 0; a < ElementsIn(payload_sizes); ++a)
+    {
+        for (size_t b = 0; b < ElementsIn(rx_buffer_sizes); ++b)
+        {
+            for (size_t c = 0; c < ElementsIn(separation_times); ++c)
+            {
+                for (size_t d = 0; d < ElementsIn(queue_depths); ++d)
+                {
+                    for (size_t e = 0; e < ElementsIn(process_periods_us); ++e)
+                    {
+                        const struct config_t config =
+                        {
+                            .payload_size = payload_sizes[a],
+                            .rx_buffer_size = rx_buffer_sizes[b],
+                            .separation_time = separation_times[c],
+                            .queue_depth = queue_depths[d],
+                            .process_period_us = process_periods_us[e]
+                        };
+
+                        struct result_t result;
+                        RunBenchmark(&config, &result);
+
+                        const char *status_p = "ok";
+                        if (result.failed)
+                        {
+                            status_p = "FAILED";
+                            ++number_of_failures;
+                        }
+                        else if (IsRegression(&config, &result))
+                        {
+                            status_p = "REGRESSION";
+                            ++number_of_regressions;
+                        }
+
+                        printf("%7u %9u 0x%02x %5u %9u %9u %8.2f %6.2f %9u %9u %9u %7u  %s\n",
+                               config.payload_size, config.rx_buffer_size, config.separation_time,
+                               config.queue_depth, config.process_period_us, result.bytes_per_second,
+                               result.frames_per_process, result.block_size, result.latency_p50_us,
+                               result.latency_p90_us, result.latency_p99_us, result.dropped_frames, status_p);
+
+                        if (output_p != NULL)
+                        {
+                            fprintf(output_p, "%u,%u,%u,%u,%u,%u,%u\n",
+                                    config.payload_size, config.rx_buffer_size, config.separation_time,
+                                    config.queue_depth, config.process_period_us,
+                                    result.bytes_per_second, result.latency_p99_us);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (output_p != NULL)
+    {
+        fclose(output_p);
+    }
+
+    printf("%zu failed, %zu regressed\n", number_of_failures, number_of_regressions);
+
+    return ((number_of_failures + number_of_regressions) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//STUBS
+//////////////////////////////////////////////////////////////////////////
+
+logging_logger_t *Logging_GetLogger(const char *name_p)
+{
+    (void)name_p;
+    return NULL;
+}
+
+void Logging_SetLevel(logging_logger_t *logger_p, enum logging_level_t level)
+{
+    (void)logger_p;
+    (void)level;
+}
+
+void Logging_Log(const logging_logger_t *logger_p, enum logging_level_t level, const char *file_p, uint32_t line, const char *message_p, ...)
+{
+    (void)logger_p;
+    (void)level;
+    (void)file_p;
+    (void)line;
+    (void)message_p;
+}
+
+uint32_t SysTime_GetSystemTime(void)
+{
+    return module.time_us / 1000;
+}
+
+uint32_t SysTime_GetDifference(uint32_t system_time)
+{
+    return SysTime_GetSystemTime() - system_time;
+}
+
+void CANInterface_RegisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
+{
+    (void)priority;
+    assert(module.bus.number_of_listeners < ElementsIn(module.bus.listeners));
+
+    module.bus.listeners[module.bus.number_of_listeners] = (struct listener_t)
+    {
+        .id = id,
+        .mask = mask,
+        .listener_cb = listener_cb,
+        .arg_p = arg_p
+    };
+    ++module.bus.number_of_listeners;
+}
+
+void CANInterface_UnregisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
+{
+    (void)priority;
+    struct bus_t *bus_p = &module.bus;
+
+    for (size_t i = 0; i < bus_p->number_of_listeners; ++i)
+    {
+        const struct listener_t *listener_p = &bus_p->listeners[i];
+        if ((listener_p->id == id) && (listener_p->mask == mask) &&
+            (listener_p->listener_cb == listener_cb) && (listener_p->arg_p == arg_p))
+        {
+            --bus_p->number_of_listeners;
+            bus_p->listeners[i] = bus_p->listeners[bus_p->number_of_listeners];
+            return;
+        }
+    }
+}
+
+bool CANInterface_Transmit(uint32_t id, void *data_p, size_t size)
+{
+    const bool status = Enqueue(&module.bus.tx_queue, id, data_p, size, 0) != NULL;
+    if (status)
+    {
+        ++module.number_of_frames;
+    }
+    else
+    {
+        ++module.bus.number_of_dropped_frames;
+    }
+
+    return status;
+}
+
+size_t CANInterface_GetTransmitQueueSpace(void)
+{
+    return module.bus.tx_queue.depth - GetQueueLength(&module.bus.tx_queue);
+}
+
+bool CANInterface_TransmitPaced(uint32_t id, void *data_p, size_t size, uint32_t separation_time_us)
+{
+    const bool status = Enqueue(&module.bus.paced_queue, id, data_p, size, separation_time_us) != NULL;
+    if (status)
+    {
+        ++module.number_of_frames;
+    }
+    else
+    {
+        ++module.bus.number_of_dropped_frames;
+    }
+
+    return status;
+}
+
+size_t CANInterface_GetPacedTransmitQueueSpace(void)
+{
+    return module.bus.paced_queue.depth - GetQueueLength(&module.bus.paced_queue);
+}
+
+bool CANInterface_IsPacedTransmitPending(uint32_t id)
+{
+    const struct bus_t *bus_p = &module.bus;
+    const struct frame_queue_t *queue_p = &bus_p->paced_queue;
+
+    for (uint32_t i = queue_p->tail; i != queue_p->head; ++i)
+    {
+        if (queue_p->frames[i % ElementsIn(queue_p->frames)].frame.id == id)
+        {
+            return true;
+        }
+    }
+
+    return (bus_p->busy && bus_p->paced && (bus_p->frame.frame.id == id)) ||
+           ((bus_p->paced_ready_time > module.time_us) && (bus_p->paced_id == id));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static void PrintUsage(const char *name)
+{
+    printf("Usage: %s [-b baseline] [-w output]\n", name);
+    printf("  -b baseline  Compare against a baseline, regressions fail the run\n");
+    printf("  -w output    Write the results as a new baseline\n");
+}
+
+static bool LoadBaseline(const char *path)
+{
+    FILE *file_p = fopen(path, "r");
+    if (file_p == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    char line[128];
+    while ((fgets(line, sizeof(line), file_p) != NULL) && (number_of_baseline_entries < ElementsIn(baseline)))
+    {
+        struct baseline_entry_t *entry_p = &baseline[number_of_baseline_entries];
+        const int number_of_fields = sscanf(line, "%u,%u,%u,%u,%u,%u,%u",
+                                            &entry_p->config.payload_size, &entry_p->config.rx_buffer_size,
+                                            &entry_p->config.separation_time, &entry_p->config.queue_depth,
+                                            &entry_p->config.process_period_us, &entry_p->bytes_per_second,
+                                            &entry_p->latency_p99_us);
+
+        /* The header and malformed lines are skipped. */
+        if (number_of_fields == 7)
+        {
+            ++number_of_baseline_entries;
+        }
+    }
+
+    fclose(file_p);
+    return true;
+}
+
+static const struct baseline_entry_t *GetBaselineEntry(const struct config_t *config_p)
+{
+    const struct baseline_entry_t *entry_p = NULL;
+    for (size_t i = 0; (entry_p == NULL) && (i < number_of_baseline_entries); ++i)
+    {
+        if (memcmp(&baseline[i].config, config_p, sizeof(*config_p)) == 0)
+        {
+            entry_p = &baseline[i];
+        }
+    }
+
+    return entry_p;
+}
+
+/**
+ * A regression is lower throughput or higher worst case latency than the
+ * baseline, outside the tolerance. Runs without a baseline entry pass.
+ */
+static bool IsRegression(const struct config_t *config_p, const struct result_t *result_p)
+{
+    const struct baseline_entry_t *entry_p = GetBaselineEntry(config_p);
+
+    bool regression = false;
+    if (entry_p != NULL)
+    {
+        const uint64_t min_bytes_per_second = (uint64_t)entry_p->bytes_per_second * (100 - REGRESSION_TOLERANCE_PERCENT) / 100;
+        const uint64_t max_latency_us = (uint64_t)entry_p->latency_p99_us * (100 + REGRESSION_TOLERANCE_PERCENT) / 100;
+
+        regression = (result_p->bytes_per_second < min_bytes_per_second) ||
+                     (result_p->latency_p99_us > max_latency_us);
+    }
+
+    return regression;
+}
+
+static void RunBenchmark(const struct config_t *config_p, struct result_t *result_p)
+{
+    assert(config_p->payload_size <= MAX_PAYLOAD_SIZE);
+    assert(config_p->rx_buffer_size <= MAX_RX_BUFFER_SIZE);
+    assert(config_p->queue_depth <= MAX_QUEUE_DEPTH);
+
+    module = (__typeof__(module)) {0};
+    module.bus.tx_queue.depth = config_p->queue_depth;
+    module.bus.paced_queue.depth = config_p->queue_depth;
+    module.bus.rx_queue.depth = RX_QUEUE_SIZE;
+    module.payload_size = config_p->payload_size;
+    for (size_t i = 0; i < module.payload_size; ++i)
+    {
+        module.payload[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    ISOTP_Init();
+    ISOTP_Bind(&module.sender,
+               module.sender_rx_buffer, sizeof(module.sender_rx_buffer),
+               module.sender_tx_buffer, sizeof(module.sender_tx_buffer),
+               FLOW_CONTROL_ID, DATA_ID,
+               ReceiverStatusCallback, SenderStatusCallback);
+    ISOTP_Bind(&module.receiver,
+               module.receiver_rx_buffer, config_p->rx_buffer_size,
+               module.receiver_tx_buffer, sizeof(module.receiver_tx_buffer),
+               DATA_ID, FLOW_CONTROL_ID,
+               ReceiverStatusCallback, SenderStatusCallback);
+    ISOTP_SetSeparationTime(&module.receiver, (uint8_t)config_p->separation_time);
+
+    *result_p = (__typeof__(*result_p)) {0};
+
+    const uint32_t start_time = module.time_us;
+    for (size_t i = 0; !result_p->failed && (i < NUMBER_OF_MESSAGES); ++i)
+    {
+        result_p->failed = !TransferMessage(config_p, i);
+    }
+    const uint32_t elapsed_time = module.time_us - start_time;
+
+    if (!result_p->failed)
+    {
+        const uint64_t total_bytes = (uint64_t)module.payload_size * NUMBER_OF_MESSAGES;
+        result_p->bytes_per_second = (uint32_t)(total_bytes * 1000000 / elapsed_time);
+        result_p->frames_per_process = (double)module.number_of_frames / module.number_of_process_calls;
+        if (module.bus.number_of_flow_control_frames > 0)
+        {
+            result_p->block_size = (double)module.bus.block_size_sum / module.bus.number_of_flow_control_frames;
+        }
+        result_p->latency_p50_us = GetPercentile(module.latencies_us, NUMBER_OF_MESSAGES, 50);
+        result_p->latency_p90_us = GetPercentile(module.latencies_us, NUMBER_OF_MESSAGES, 90);
+        result_p->latency_p99_us = GetPercentile(module.latencies_us, NUMBER_OF_MESSAGES, 99);
+    }
+    result_p->dropped_frames = module.bus.number_of_dropped_frames;
+}
+
+/**
+ * The latency is measured from the call to 'ISOTP_Send' until the receiver
+ * has drained the last byte. A transfer fails if it times out or if the
+ * received data differs from the sent data.
+ */
+static bool TransferMessage(const struct config_t *config_p, size_t index)
+{
+    const uint32_t start_time = module.time_us;
+    module.received_bytes = 0;
+    module.sending = true;
+
+    bool status = ISOTP_Send(&module.sender, module.payload, module.payload_size);
+    if (module.payload_size <= 7)
+    {
+        /* Single frames are sent without a TX status callback. */
+        module.sending = false;
+    }
+
+    while (status && (module.sending || (module.received_bytes < module.payload_size)))
+    {
+        RunMainLoop(config_p);
+        status = !module.corrupted && ((module.time_us - start_time) < MESSAGE_TIMEOUT_US);
+    }
+
+    module.latencies_us[index] = module.time_us - start_time;
+    return status;
+}
+
+static void RunMainLoop(const struct config_t *config_p)
+{
+    const uint32_t end_time = module.time_us + config_p->process_period_us;
+    RunBus(end_time);
+    module.time_us = end_time;
+
+    DispatchFrames();
+    ISOTP_Proccess();
+    DrainReceiver();
+
+    ++module.number_of_process_calls;
+}
+
+static void DrainReceiver(void)
+{
+    const void *data_p;
+    size_t length = ISOTP_Peek(&module.receiver, &data_p);
+    while (length > 0)
+    {
+        const bool fits = (module.received_bytes + length) <= module.payload_size;
+        if (!fits || (memcmp(data_p, &module.payload[module.received_bytes], length) != 0))
+        {
+            module.corrupted = true;
+        }
+        module.received_bytes += length;
+
+        ISOTP_Consume(&module.receiver, length);
+        length = ISOTP_Peek(&module.receiver, &data_p);
+    }
+}
+
+static void SenderStatusCallback(enum isotp_status_t status)
+{
+    if (status != ISOTP_STATUS_WAITING)
+    {
+        module.corrupted = module.corrupted || (status != ISOTP_STATUS_DONE);
+        module.sending = false;
+    }
+}
+
+static void ReceiverStatusCallback(enum isotp_status_t status)
+{
+    if ((status != ISOTP_STATUS_DONE) && (status != ISOTP_STATUS_WAITING))
+    {
+        module.corrupted = true;
+    }
+}
+
+/**
+ * Send frames on the bus until the end time, a frame still on the bus at the
+ * end time is completed in the next call.
+ */
+static void RunBus(uint32_t end_time)
+{
+    struct bus_t *bus_p = &module.bus;
+
+    while ((bus_p->busy || StartFrame(end_time)) && (bus_p->done_time <= end_time))
+    {
+        CompleteFrame();
+    }
+}
+
+static bool StartFrame(uint32_t end_time)
+{
+    struct bus_t *bus_p = &module.bus;
+    uint32_t start_time = bus_p->idle_time > module.time_us ? bus_p->idle_time : module.time_us;
+
+    struct frame_queue_t *queue_p = NULL;
+    if ((GetQueueLength(&bus_p->paced_queue) > 0) && (bus_p->paced_ready_time <= start_time))
+    {
+        queue_p = &bus_p->paced_queue;
+    }
+    else if (GetQueueLength(&bus_p->tx_queue) > 0)
+    {
+        queue_p = &bus_p->tx_queue;
+    }
+    else if ((GetQueueLength(&bus_p->paced_queue) > 0) && (bus_p->paced_ready_time < end_time))
+    {
+        /* The bus is idle until the separation time has passed. */
+        start_time = bus_p->paced_ready_time;
+        queue_p = &bus_p->paced_queue;
+    }
+    else
+    {
+        /* Nothing to send before the end time. */
+    }
+
+    if (queue_p != NULL)
+    {
+        bus_p->frame = *Peek(queue_p);
+        ++queue_p->tail;
+
+        bus_p->busy = true;
+        bus_p->paced = queue_p == &bus_p->paced_queue;
+        bus_p->done_time = start_time + GetFrameTime(bus_p->frame.frame.size);
+    }
+
+    return queue_p != NULL;
+}
+
+static void CompleteFrame(void)
+{
+    struct bus_t *bus_p = &module.bus;
+    const struct can_frame_t *frame_p = &bus_p->frame.frame;
+
+    bus_p->busy = false;
+    bus_p->idle_time = bus_p->done_time;
+    if (bus_p->paced)
+    {
+        bus_p->paced_ready_time = bus_p->done_time + bus_p->frame.separation_time_us;
+        bus_p->paced_id = frame_p->id;
+    }
+
+    /* Track the block sizes granted in flow control frames. */
+    if ((frame_p->size >= 2) && ((frame_p->data[0] & 0xF0) == 0x30))
+    {
+        ++bus_p->number_of_flow_control_frames;
+        bus_p->block_size_sum += frame_p->data[1];
+    }
+
+    struct bus_frame_t *received_frame_p = Enqueue(&bus_p->rx_queue, frame_p->id, frame_p->data, frame_p->size, 0);
+    if (received_frame_p != NULL)
+    {
+        received_frame_p->frame.timestamp = bus_p->done_time;
+    }
+    else
+    {
+        ++bus_p->number_of_dropped_frames;
+    }
+}
+
+static void DispatchFrames(void)
+{
+    struct bus_t *bus_p = &module.bus;
+
+    while (GetQueueLength(&bus_p->rx_queue) > 0)
+    {
+        const struct can_frame_t frame = Peek(&bus_p->rx_queue)->frame;
+        ++bus_p->rx_queue.tail;
+
+        for (size_t i = 0; i < bus_p->number_of_listeners; ++i)
+        {
+            const struct listener_t *listener_p = &bus_p->listeners[i];
+            if ((frame.id & listener_p->mask) == (listener_p->id & listener_p->mask))
+            {
+                listener_p->listener_cb(&frame, listener_p->arg_p);
+                ++module.number_of_frames;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Worst case length of a standard data frame including stuff bits, see
+ * "Controller Area Network (CAN) schedulability analysis" by Davis et al.
+ */
+static uint32_t GetFrameTime(size_t size)
+{
+    const uint32_t number_of_bits = 47 + 8 * (uint32_t)size + (34 + 8 * (uint32_t)size - 1) / 4;
+    return DIVIDE_ROUND_UP(number_of_bits * 1000000, BIT_RATE);
+}
+
+static struct bus_frame_t *Enqueue(struct frame_queue_t *queue_p, uint32_t id, const void *data_p, size_t size, uint32_t separation_time_us)
+{
+    assert(size <= 8);
+
+    struct bus_frame_t *bus_frame_p = NULL;
+    if (GetQueueLength(queue_p) < queue_p->depth)
+    {
+        bus_frame_p = &queue_p->frames[queue_p->head % ElementsIn(queue_p->frames)];
+        bus_frame_p->frame = (__typeof__(bus_frame_p->frame)) {0};
+        bus_frame_p->frame.id = id;
+        bus_frame_p->frame.size = (uint8_t)size;
+        memcpy(bus_frame_p->frame.data, data_p, size);
+        bus_frame_p->separation_time_us = separation_time_us;
+        ++queue_p->head;
+    }
+
+    return bus_frame_p;
+}
+
+static struct bus_frame_t *Peek(struct frame_queue_t *queue_p)
+{
+    return &queue_p->frames[queue_p->tail % ElementsIn(queue_p->frames)];
+}
+
+static size_t GetQueueLength(const struct frame_queue_t *queue_p)
+{
+    return queue_p->head - queue_p->tail;
+}
+
+/**
+ * Nearest-rank percentile, the values are sorted in place.
+ */
+static uint32_t GetPercentile(uint32_t *values_p, size_t number_of_values, uint32_t percentile)
+{
+    qsort(values_p, number_of_values, sizeof(values_p[0]), CompareValues);
+
+    size_t rank = DIVIDE_ROUND_UP(percentile * number_of_values, 100);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    return values_p[rank - 1];
+}
+
+static int CompareValues(const void *a_p, const void *b_p)
+{
+    const uint32_t a = *(const uint32_t *)a_p;
+    const uint32_t b = *(const uint32_t *)b_p;
+
+    return (a > b) - (a < b);
+}
@@ -0,0 +1,217 @@
+/**
+ * @file   stream_benchmark.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Stream copy microbenchmark.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Measures the cost per byte of writing and reading a stream in chunks, for
+ * the stream module and for a reference copy of the byte per byte
+ * implementation it replaced. Chunk sizes match a consecutive frame, a
+ * firmware chunk and a larger block, and the capacities match a power of two
+ * and the firmware manager RX buffer.
+ *
+ * Cycles are read from the time stamp counter on x86 hosts and are
+ * nanoseconds elsewhere. Host numbers only show the relative cost, the
+ * reference implementation also divides per byte on target.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "utility.h"
+#include "stream.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define MAX_CAPACITY 1152
+#define MAX_CHUNK_SIZE 256
+#define BYTES_PER_RUN (64UL * 1024 * 1024)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CYCLE_UNIT "cycles"
+#else
+#define CYCLE_UNIT "ns"
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+/* The stream before block copies, see 'ReferenceWrite' and 'ReferenceRead'. */
+struct reference_stream_t
+{
+    uint8_t *data_p;
+    size_t head;
+    size_t tail;
+    size_t size;
+    size_t number_of_bytes;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static const size_t capacities[] = {1024, 1152};
+static const size_t chunk_sizes[] = {7, 64, 256};
+
+static uint8_t buffer[MAX_CAPACITY];
+static uint8_t source[MAX_CHUNK_SIZE];
+static uint8_t destination[MAX_CHUNK_SIZE];
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static double MeasureStream(size_t capacity, size_t chunk_size);
+static double MeasureReference(size_t capacity, size_t chunk_size);
+static size_t ReferenceWrite(struct reference_stream_t *self_p, const void *source_p, size_t length);
+static size_t ReferenceRead(struct reference_stream_t *self_p, void *destination_p, size_t length);
+static uint64_t GetCycles(void);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(source); ++i)
+    {
+        source[i] = (uint8_t)i;
+    }
+
+    printf("Stream write and read, " CYCLE_UNIT " per byte\n");
+    printf("%8s %6s %10s %10s %8s\n", "capacity", "chunk", "reference", "stream", "speedup");
+
+    for (size_t i = 0; i < ElementsIn(capacities); ++i)
+    {
+        for (size_t j = 0; j < ElementsIn(chunk_sizes); ++j)
+        {
+            const double reference_cost = MeasureReference(capacities[i], chunk_sizes[j]);
+            const double stream_cost = MeasureStream(capacities[i], chunk_sizes[j]);
+
+            printf("%8zu %6zu %10.3f %10.3f %7.1fx\n",
+                   capacities[i], chunk_sizes[j], reference_cost, stream_cost, reference_cost / stream_cost);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+/**
+ * The stream is kept half full so that chunks wrap around the end of the
+ * buffer as they pass through it.
+ */
+static double MeasureStream(size_t capacity, size_t chunk_size)
+{
+    struct stream_t stream;
+    Stream_Init(&stream, buffer, capacity);
+    while (Stream_GetAvailableSpace(&stream) > capacity / 2)
+    {
+        Stream_Write(&stream, source, 1);
+    }
+
+    const size_t number_of_chunks = BYTES_PER_RUN / chunk_size;
+    const uint64_t start = GetCycles();
+    for (size_t i = 0; i < number_of_chunks; ++i)
+    {
+        Stream_Write(&stream, source, chunk_size);
+        Stream_Read(&stream, destination, chunk_size);
+    }
+    const uint64_t cycles = GetCycles() - start;
+
+    return (double)cycles / (double)(number_of_chunks * chunk_size);
+}
+
+static double MeasureReference(size_t capacity, size_t chunk_size)
+{
+    struct reference_stream_t stream = {.data_p = buffer, .size = capacity};
+    while ((stream.size - stream.number_of_bytes) > capacity / 2)
+    {
+        ReferenceWrite(&stream, source, 1);
+    }
+
+    const size_t number_of_chunks = BYTES_PER_RUN / chunk_size;
+    const uint64_t start = GetCycles();
+    for (size_t i = 0; i < number_of_chunks; ++i)
+    {
+        ReferenceWrite(&stream, source, chunk_size);
+        ReferenceRead(&stream, destination, chunk_size);
+    }
+    const uint64_t cycles = GetCycles() - start;
+
+    return (double)cycles / (double)(number_of_chunks * chunk_size);
+}
+
+__attribute__((noinline)) static size_t ReferenceWrite(struct reference_stream_t *self_p, const void *source_p, size_t length)
+{
+    const size_t available_space = self_p->size - self_p->number_of_bytes;
+    const size_t number_of_bytes = available_space >= length ? length : available_space;
+
+    for (size_t i = 0; i < number_of_bytes; ++i)
+    {
+        self_p->data_p[self_p->head % self_p->size] = ((const uint8_t *)source_p)[i];
+        ++self_p->head;
+    }
+
+    self_p->number_of_bytes += number_of_bytes;
+
+    return number_of_bytes;
+}
+
+__attribute__((noinline)) static size_t ReferenceRead(struct reference_stream_t *self_p, void *destination_p, size_t length)
+{
+    const size_t number_of_bytes = self_p->number_of_bytes >= length ? length : self_p->number_of_bytes;
+
+    for (size_t i = 0; i < number_of_bytes; ++i)
+    {
+        ((uint8_t *)destination_p)[i] = self_p->data_p[self_p->tail % self_p->size];
+        ++self_p->tail;
+    }
+
+    self_p->number_of_bytes -= number_of_bytes;
+
+    return number_of_bytes;
+}
+
+static uint64_t GetCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#endif
+}
@@ -39,6 +39,9 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include "image.h"
 #include "can_interface.h"
 #include "flash.h"
+#include "nvs.h"
+#include "config.h"
+#include "isotp.h"
 #include "firmware_manager.h"
 #include "nvcom.h"
 #include "bootloader.h"
@@ -81,6 +84,7 @@ static inline void StartApplication(const uintptr_t *start_p);
 static inline void PrepareForApplication(const struct image_header_t *header_p);
 static void JumpToApplication(void *pc, void *sp) __attribute__((naked, noreturn));
 static inline void UpdateFirmware(void);
+static uint32_t GetCANBitRate(void);
 static bool IsUpdateRequested(void);
 static void ClearUpdateRequest(void);
 static inline bool IsWatchdogRestart(void);
@@ -183,24 +187,45 @@ static inline void PrepareForApplication(const struct image_header_t *header_p)
 
 static void JumpToApplication(__attribute__((unused)) void *pc, __attribute__((unused)) void *sp)
 {
+#ifndef UNIT_TEST
     __asm("MSR MSP,r1");
     __asm("BX r0");
+#endif
 }
 
 static inline void UpdateFirmware()
 {
-    CANInterface_Init();
     Flash_Init();
+    NVS_Init(Board_GetNVSAddress(), Board_GetNumberOfPagesInNVS());
+    CANInterface_Init(GetCANBitRate());
+    ISOTP_Init();
     FirmwareManager_Init(Reset);
 
     Logging_Info(module.logger, "Wait for new firmware...");
     while (FirmwareManager_Active())
     {
-        FirmwareManager_Update();
+        CANInterface_Process();
+        ISOTP_Proccess();
+        FirmwareManager_Process();
         UpdateStatusLED();
     }
 }
 
+static uint32_t GetCANBitRate(void)
+{
+    const struct nvcom_data_t *data_p = NVCom_GetData();
+    uint32_t bit_rate = data_p->can_bit_rate;
+
+    /* NVCom is cleared by a power loss, the configured rate is still in NVS. */
+    if (bit_rate == 0 && !NVS_Retrieve(CONFIG_CAN_BIT_RATE_KEY, &bit_rate))
+    {
+        /* Zero selects the default bit rate. */
+        bit_rate = 0;
+    }
+
+    return bit_rate;
+}
+
 static bool IsUpdateRequested(void)
 {
     const struct nvcom_data_t *data_p = NVCom_GetData();
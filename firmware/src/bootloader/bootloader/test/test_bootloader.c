@@ -0,0 +1,165 @@
+/**
+ * @file   test_bootloader.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Test suite for the bootloader module.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nvcom.h"
+#include "nvs.h"
+#include "config.h"
+#include "bootloader.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct logging_logger_t *dummy_logger;
+static struct nvcom_data_t nvcom_data;
+uintptr_t __approm_start__;
+
+//////////////////////////////////////////////////////////////////////////
+//MOCKS
+//////////////////////////////////////////////////////////////////////////
+
+bool NVS_Retrieve(const char *key_p, uint32_t *value_p)
+{
+    check_expected_ptr(key_p);
+    assert_non_null(value_p);
+
+    *value_p = mock_type(uint32_t);
+    return mock_type(bool);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static int Setup(void **state)
+{
+    nvcom_data = (__typeof__(nvcom_data)) {0};
+
+    expect_function_call(Board_Init);
+    expect_function_call(SysTime_Init);
+    expect_any(Serial_Init, baud_rate);
+    expect_function_call(Logging_Init);
+    expect_function_call(NVCom_Init);
+    will_return(Logging_GetLogger, dummy_logger);
+    Bootloader_Init();
+    return 0;
+}
+
+static void ExpectUpdateFirmware(uint32_t bit_rate)
+{
+    will_return_ptr_always(NVCom_GetData, &nvcom_data);
+    will_return_uint_always(Board_GetResetFlags, 0);
+    will_return(Board_GetNVSAddress, 0x801E000);
+    will_return(Board_GetNumberOfPagesInNVS, 8);
+    expect_function_call(NVS_Init);
+    expect_function_call(CANInterface_Init);
+    expect_uint_value(CANInterface_Init, bit_rate, bit_rate);
+    will_return(FirmwareManager_Active, false);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//TESTS
+//////////////////////////////////////////////////////////////////////////
+
+static void test_Bootloader_Start_NVComBitRate(void **state)
+{
+    nvcom_data.request_firmware_update = true;
+    nvcom_data.can_bit_rate = 250000;
+
+    ExpectUpdateFirmware(250000);
+    Bootloader_Start();
+}
+
+static void test_Bootloader_Start_NVSBitRate(void **state)
+{
+    nvcom_data.request_firmware_update = true;
+
+    expect_string(NVS_Retrieve, key_p, CONFIG_CAN_BIT_RATE_KEY);
+    will_return(NVS_Retrieve, 1000000);
+    will_return(NVS_Retrieve, true);
+    ExpectUpdateFirmware(1000000);
+    Bootloader_Start();
+}
+
+static void test_Bootloader_Start_DefaultBitRate(void **state)
+{
+    nvcom_data.request_firmware_update = true;
+
+    expect_string(NVS_Retrieve, key_p, CONFIG_CAN_BIT_RATE_KEY);
+    will_return(NVS_Retrieve, 1000000);
+    will_return(NVS_Retrieve, false);
+    ExpectUpdateFirmware(0);
+    Bootloader_Start();
+}
+
+static void test_Bootloader_Start_InvalidApplication(void **state)
+{
+    will_return(Image_GetHeader, NULL);
+    expect_string(NVS_Retrieve, key_p, CONFIG_CAN_BIT_RATE_KEY);
+    will_return(NVS_Retrieve, 1000000);
+    will_return(NVS_Retrieve, true);
+    ExpectUpdateFirmware(1000000);
+    Bootloader_Start();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+    const struct CMUnitTest test_bootloader[] =
+    {
+        cmocka_unit_test_setup(test_Bootloader_Start_NVComBitRate, Setup),
+        cmocka_unit_test_setup(test_Bootloader_Start_NVSBitRate, Setup),
+        cmocka_unit_test_setup(test_Bootloader_Start_DefaultBitRate, Setup),
+        cmocka_unit_test_setup(test_Bootloader_Start_InvalidApplication, Setup),
+    };
+
+    if (argc >= 2)
+    {
+        cmocka_set_test_filter(argv[1]);
+    }
+
+    return cmocka_run_group_tests(test_bootloader, NULL, NULL);
+}
@@ -112,7 +112,7 @@ static void test_Board_GetNVSAddress(void **state)
 static void test_Board_GetNumberOfPagesInNVS(void **state)
 {
     skip();
-    assert_int_equal(Board_GetNumberOfPagesInNVS(), 2);
+    assert_int_equal(Board_GetNumberOfPagesInNVS(), 8);
 }
 
 static void test_Board_GetMaxCurrent(void **state)
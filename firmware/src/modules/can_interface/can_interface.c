@@ -26,11 +26,14 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////
 
 #include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
 #include <assert.h>
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/stm32/can.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
 #include "utility.h"
 #include "logging.h"
 #include "systime.h"
@@ -45,15 +48,92 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #define CANIF_LOGGER_DEBUG_LEVEL LOGGING_INFO
 #endif
 
-#define MAX_NUMBER_OF_LISTENERS 5
+/**
+ * Number of frames that can be buffered between the RX interrupt and
+ * 'CANInterface_Process'. Must be a power of two.
+ */
+#define RX_RING_SIZE 16
+_Static_assert((RX_RING_SIZE & (RX_RING_SIZE - 1)) == 0, "RX_RING_SIZE must be a power of two");
+
+/**
+ * Number of frames that can be queued for transmission while all mailboxes
+ * are busy. Must be a power of two.
+ */
+#define TX_QUEUE_SIZE 16
+_Static_assert((TX_QUEUE_SIZE & (TX_QUEUE_SIZE - 1)) == 0, "TX_QUEUE_SIZE must be a power of two");
+
+/**
+ * Number of frames that can be queued for paced transmission. Must be a
+ * power of two.
+ */
+#define PACED_QUEUE_SIZE 16
+_Static_assert((PACED_QUEUE_SIZE & (PACED_QUEUE_SIZE - 1)) == 0, "PACED_QUEUE_SIZE must be a power of two");
 
 /**
- * Since 16-bit filter scale is used, the max number of filters are twice the
- * number of filter banks.
+ * The pacing timer counts microseconds in one-pulse mode, longer separation
+ * times are split into several periods. The counter is blocked while the
+ * auto-reload value is zero, so a period is at least two microseconds.
+ */
+#define PACING_TIMER TIM1
+#define PACING_TIMER_FREQUENCY 1000000
+#define PACING_TIMER_MIN_PERIOD_US 2
+#define PACING_TIMER_MAX_PERIOD_US UINT16_MAX
+#define NO_MAILBOX -1
+
+/**
+ * Standard ID filters use 16-bit scale banks: exact IDs are packed four to a
+ * bank in list mode and ID/mask filters two to a bank in mask mode. Extended
+ * ID filters use 32-bit scale banks, which hold half as many filters.
  */
 #define NUMBER_OF_FILTER_BANKS 14
-#define MAX_NUMBER_OF_FILTERS (NUMBER_OF_FILTER_BANKS * 2)
-_Static_assert((MAX_NUMBER_OF_FILTERS % 2) == 0, "MAX_NUMBER_OF_FILTERS must be an even number");
+#define IDS_PER_LIST_BANK 4
+#define FILTERS_PER_MASK_BANK 2
+#define IDS_PER_EXTENDED_LIST_BANK 2
+#define FILTERS_PER_EXTENDED_MASK_BANK 1
+#define MAX_NUMBER_OF_FILTERS (NUMBER_OF_FILTER_BANKS * IDS_PER_LIST_BANK)
+#define MAX_NUMBER_OF_LISTENERS MAX_NUMBER_OF_FILTERS
+
+/**
+ * 16-bit filter register layout: STID[10:0] RTR IDE EXID[17:15]. The RTR and
+ * IDE bits are always compared so only standard data frames are accepted.
+ */
+#define FILTER_ID_SHIFT 5
+#define FILTER_RTR_IDE_MASK 0x18
+
+/**
+ * 32-bit filter register layout: STID[10:0] EXID[17:0] IDE RTR 0, i.e. the
+ * 29-bit ID followed by IDE and RTR. IDE is set and both bits are compared so
+ * only extended data frames are accepted.
+ */
+#define EXTENDED_FILTER_ID_SHIFT 3
+#define EXTENDED_FILTER_IDE 0x4
+#define EXTENDED_FILTER_RTR_IDE_MASK 0x6
+
+#define NUMBER_OF_RX_FIFOS 2
+
+/**
+ * Only the four most significant priority bits are implemented, a lower
+ * value means a higher priority.
+ */
+#define CONTROL_IRQ_PRIORITY (1 << 4)
+#define BULK_IRQ_PRIORITY (2 << 4)
+
+#define FRAME_RATE_PERIOD_MS 1000
+
+#define TRANSMIT_ERROR_COUNTER(esr) (((esr) >> 16) & 0xFF)
+#define RECEIVE_ERROR_COUNTER(esr) (((esr) >> 24) & 0xFF)
+
+/**
+ * A bit time consists of one sync quantum followed by the two time segments.
+ * The sample point is expressed in per mille of the bit time.
+ */
+#define MIN_TIME_QUANTA_PER_BIT 8
+#define MAX_TIME_QUANTA_PER_BIT 25
+#define MAX_PRESCALER 1024
+#define MAX_TIME_SEGMENT1 16
+#define MAX_TIME_SEGMENT2 8
+#define MAX_SYNC_JUMP_WIDTH 4
+#define SAMPLE_POINT_TARGET 875
 
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
@@ -65,19 +145,134 @@ struct listener_t
     void *arg_p;
 };
 
+/**
+ * An exact ID filter has all ID bits set in the mask, eleven for a standard
+ * and 29 for an extended filter.
+ */
 struct filter_t
 {
-    uint16_t id;
-    uint16_t mask;
+    uint32_t id;
+    uint32_t mask;
+    uint8_t fifo;
+    bool extended;
+    const struct listener_t *listener_p;
+};
+
+/**
+ * A filter bank is assigned to one RX FIFO, filters with different priorities
+ * can therefore not share a bank. Extended filters use 32-bit scale banks.
+ */
+struct filter_bank_t
+{
+    const struct filter_t *filters[IDS_PER_LIST_BANK];
+    size_t number_of_filters;
+    uint8_t fifo;
+    bool list_mode;
+    bool extended;
+};
+
+/**
+ * Single producer (RX ISR), single consumer (main loop) ring buffer. The
+ * indices are free running and only written by their respective owner.
+ *
+ * The listener is looked up when the frame is received since the filter
+ * match indices change when the filter banks are reprogrammed.
+ */
+struct rx_entry_t
+{
+    struct can_frame_t frame;
+    const struct listener_t *listener_p;
+    uint8_t fmi;
+};
+
+struct rx_ring_t
+{
+    struct rx_entry_t entries[RX_RING_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t number_of_frames;
+    volatile uint32_t number_of_dropped_frames;
+    uint32_t number_of_reported_dropped_frames;
+    volatile uint32_t number_of_overruns;
+};
+
+/**
+ * Frames waiting for a free mailbox. Written by the main loop, emptied by
+ * the TX ISR or by the main loop with the TX interrupt disabled.
+ */
+struct tx_queue_t
+{
+    struct can_frame_t frames[TX_QUEUE_SIZE];
+    uint32_t enqueue_times[TX_QUEUE_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t max_depth;
+    uint32_t number_of_dropped_frames;
+    volatile uint32_t number_of_frames;
+    volatile uint32_t max_wait_time;
+};
+
+/**
+ * Frames sent with a minimum separation. Written by the main loop, emptied
+ * by the TX and pacing timer ISRs or by the main loop with both interrupts
+ * disabled. One paced frame is handed to the peripheral at a time and the
+ * separation is timed from when its transmission has completed.
+ */
+struct paced_queue_t
+{
+    struct can_frame_t frames[PACED_QUEUE_SIZE];
+    uint32_t separation_times[PACED_QUEUE_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile int32_t mailbox; /* Mailbox of the frame being transmitted, or NO_MAILBOX. */
+    volatile uint32_t id; /* Of the frame being transmitted or separated from the next. */
+    volatile uint32_t separation_time; /* Of the frame being transmitted. */
+    volatile uint32_t remaining_time; /* Separation time left after the running timer period. */
+    volatile bool waiting; /* The pacing timer is running. */
+};
+
+struct frame_rate_t
+{
+    uint32_t period_start;
+    uint32_t last_number_of_frames;
+    uint32_t frames_per_second;
+    uint32_t max_frames_per_second;
+};
+
+/**
+ * Bus error state, updated by the status change ISR and sampled from the
+ * main loop since leaving error passive or bus-off raises no interrupt.
+ */
+struct error_state_t
+{
+    uint32_t flags;
+    uint32_t number_of_error_passive;
+    uint32_t number_of_bus_off;
+    uint32_t transmit_error_counter;
+    uint32_t receive_error_counter;
+    uint32_t max_transmit_error_counter;
+    uint32_t max_receive_error_counter;
 };
 
 struct module_t
 {
     logging_logger_t *logger;
+    struct rx_ring_t rx_rings[NUMBER_OF_RX_FIFOS];
+    struct tx_queue_t tx_queue;
+    struct paced_queue_t paced_queue;
+    struct frame_rate_t rx_rate;
+    struct frame_rate_t tx_rate;
+    struct error_state_t error_state;
+    uint32_t number_of_unhandled_frames;
     struct listener_t listeners[MAX_NUMBER_OF_LISTENERS];
     size_t number_of_listeners;
+    /* Listeners indexed by RX FIFO and filter match index. */
+    const struct listener_t *listener_table[NUMBER_OF_RX_FIFOS][MAX_NUMBER_OF_FILTERS];
     struct filter_t filters[MAX_NUMBER_OF_FILTERS];
     size_t number_of_filters;
+    struct filter_bank_t filter_banks[NUMBER_OF_FILTER_BANKS];
+    size_t number_of_filter_banks;
+    uint32_t bit_rate;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -90,23 +285,131 @@ static struct module_t module;
 //LOCAL FUNCTION PROTOTYPES
 //////////////////////////////////////////////////////////////////////////
 
-static void InitCANPeripheral(void);
-static void NotifyListeners(const struct can_frame_t *frame_p);
-static void InitFilterArray(void);
+static void InitCANPeripheral(const struct caninterface_bit_timing_t *timing_p);
+static void InitPacingTimer(void);
+static void StartPacingTimer(uint32_t time_us);
+static inline void DisableTransmitInterrupts(void);
+static inline void EnableTransmitInterrupts(void);
+static void NotifyListener(uint8_t fifo, const struct rx_entry_t *entry_p);
+static const struct listener_t *FindListener(caninterface_listener_cb_t listener_cb, void *arg_p);
+static const struct listener_t *GetListener(caninterface_listener_cb_t listener_cb, void *arg_p);
+static void AddFilter(uint32_t id, uint32_t mask, uint8_t fifo, bool extended, const struct listener_t *listener_p);
+static inline bool IsFilterCoveredBy(const struct filter_t *filter_p, const struct filter_t *other_p);
+static inline bool IsExactFilter(const struct filter_t *filter_p);
+static void RemoveFilter(size_t index);
+static void PlanFilterBanks(void);
+static void PlanStandardFilterBanks(uint8_t fifo);
+static void PlanExtendedFilterBanks(uint8_t fifo);
+static void AddToFilterBank(const struct filter_t *filter_p, bool list_mode);
+static inline size_t GetNumberOfSlots(const struct filter_bank_t *bank_p);
+static void ApplyFilterBanks(void);
+static void DispatchFrames(uint8_t fifo);
+static void ReceiveFrames(uint8_t fifo);
+static void FillMailboxes(void);
+static void SendPacedFrame(void);
+static void CheckPacedFrameCompleted(uint32_t transmit_status);
+static void UpdateFrameRate(struct frame_rate_t *rate_p, uint32_t number_of_frames, uint32_t time);
+static void UpdateErrorState(uint32_t error_status);
+static inline uint32_t GetReceiveFifoStatus(uint8_t fifo);
+static inline void ClearReceiveFifoOverrun(uint8_t fifo);
+static inline uint32_t GetTransmitStatus(void);
+static inline void ClearRequestCompletedFlags(uint32_t transmit_status);
+static inline uint32_t GetErrorStatus(void);
+static inline void ClearErrorInterrupt(void);
+static inline void BeginFilterUpdate(void);
+static inline void WriteFilterBank(size_t bank_index, const struct filter_bank_t *bank_p);
+static inline void EndFilterUpdate(uint32_t active_banks);
 
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
 
-void CANInterface_Init(void)
+void CANInterface_Init(uint32_t bit_rate)
 {
     module = (__typeof__(module)) {0};
     module.logger = Logging_GetLogger(CANIF_LOGGER_NAME);
     Logging_SetLevel(module.logger, CANIF_LOGGER_DEBUG_LEVEL);
 
-    InitCANPeripheral();
-    InitFilterArray();
-    Logging_Info(module.logger, "CAN initialized");
+    struct caninterface_bit_timing_t timing;
+    if ((bit_rate == 0) || !CANInterface_CalculateBitTiming(bit_rate, &timing))
+    {
+        if (bit_rate != 0)
+        {
+            Logging_Warning(module.logger, "Unsupported bit rate, using default: {bit_rate: %u}", bit_rate);
+        }
+
+        bit_rate = CANINTERFACE_DEFAULT_BIT_RATE;
+        if (!CANInterface_CalculateBitTiming(bit_rate, &timing))
+        {
+            Logging_Critical(module.logger, "No bit timing for default bit rate");
+            assert(false);
+        }
+    }
+    module.bit_rate = bit_rate;
+    module.paced_queue.mailbox = NO_MAILBOX;
+
+    InitCANPeripheral(&timing);
+    InitPacingTimer();
+    Logging_Info(module.logger, "CAN initialized: {bit_rate: %u, prescaler: %u, ts1: %u, ts2: %u, sample_point: %u}",
+                 bit_rate, timing.prescaler, timing.time_segment1, timing.time_segment2, timing.sample_point);
+}
+
+uint32_t CANInterface_GetBitRate(void)
+{
+    return module.bit_rate;
+}
+
+bool CANInterface_CalculateBitTiming(uint32_t bit_rate, struct caninterface_bit_timing_t *timing_p)
+{
+    assert(timing_p != NULL);
+
+    if ((bit_rate == 0) || (bit_rate > CANINTERFACE_MAX_BIT_RATE))
+    {
+        return false;
+    }
+
+    bool status = false;
+    uint32_t best_error = UINT32_MAX;
+
+    /* Prefer more time quanta per bit, i.e. finer resynchronization, when equal. */
+    for (uint32_t time_quanta = MAX_TIME_QUANTA_PER_BIT; time_quanta >= MIN_TIME_QUANTA_PER_BIT; --time_quanta)
+    {
+        const uint32_t quanta_frequency = bit_rate * time_quanta;
+        const uint32_t prescaler = rcc_apb1_frequency / quanta_frequency;
+        if ((prescaler == 0) || (prescaler > MAX_PRESCALER) || ((prescaler * quanta_frequency) != rcc_apb1_frequency))
+        {
+            continue;
+        }
+
+        uint32_t time_segment1 = ((time_quanta * SAMPLE_POINT_TARGET) / 1000) - 1;
+        if (time_segment1 > MAX_TIME_SEGMENT1)
+        {
+            time_segment1 = MAX_TIME_SEGMENT1;
+        }
+
+        const uint32_t time_segment2 = time_quanta - 1 - time_segment1;
+        if (time_segment2 > MAX_TIME_SEGMENT2)
+        {
+            continue;
+        }
+
+        const uint32_t sample_point = ((1 + time_segment1) * 1000) / time_quanta;
+        const uint32_t error = SAMPLE_POINT_TARGET - sample_point;
+        if (error < best_error)
+        {
+            best_error = error;
+            *timing_p = (__typeof__(*timing_p)) {
+                .prescaler = (uint16_t)prescaler,
+                .time_segment1 = (uint8_t)time_segment1,
+                .time_segment2 = (uint8_t)time_segment2,
+                .sync_jump_width = (uint8_t)((time_segment2 < MAX_SYNC_JUMP_WIDTH) ? time_segment2 : MAX_SYNC_JUMP_WIDTH),
+                .sample_point = (uint16_t)sample_point
+            };
+            status = true;
+        }
+    }
+
+    return status;
 }
 
 bool CANInterface_Transmit(uint32_t id, void *data_p, size_t size)
@@ -116,67 +419,224 @@ bool CANInterface_Transmit(uint32_t id, void *data_p, size_t size)
 
     Logging_Debug(module.logger, "CANTX{id=0x%x}", id);
 
-    const uint32_t start_time_ms = SysTime_GetSystemTime();
-    const uint32_t timeout_ms = 2;
-    while(!can_available_mailbox(CAN1))
+    struct tx_queue_t *queue_p = &module.tx_queue;
+
+    const uint32_t head = queue_p->head;
+    const uint32_t depth = head - queue_p->tail;
+    if (depth >= TX_QUEUE_SIZE)
     {
-        if (SysTime_GetDifference(start_time_ms) >= timeout_ms)
-        {
-            Logging_Debug(module.logger, "Timeout while waiting for mailbox");
-            break;
-        }
+        ++queue_p->number_of_dropped_frames;
+        Logging_Debug(module.logger, "TX queue full, frame dropped");
+        return false;
+    }
+
+    struct can_frame_t *frame_p = &queue_p->frames[head & (TX_QUEUE_SIZE - 1)];
+    frame_p->id = id;
+    frame_p->size = (uint8_t)size;
+    memcpy(frame_p->data, data_p, size);
+    queue_p->enqueue_times[head & (TX_QUEUE_SIZE - 1)] = SysTime_GetSystemTimeUs();
+
+    atomic_signal_fence(memory_order_release);
+    queue_p->head = head + 1;
+
+    if ((depth + 1) > queue_p->max_depth)
+    {
+        queue_p->max_depth = depth + 1;
+    }
+
+    DisableTransmitInterrupts();
+    FillMailboxes();
+    EnableTransmitInterrupts();
+
+    return true;
+}
+
+size_t CANInterface_GetTransmitQueueSpace(void)
+{
+    const struct tx_queue_t *queue_p = &module.tx_queue;
+
+    /* The ISR only moves the tail forward, so the space can only grow meanwhile. */
+    return TX_QUEUE_SIZE - (queue_p->head - queue_p->tail);
+}
+
+bool CANInterface_TransmitPaced(uint32_t id, void *data_p, size_t size, uint32_t separation_time_us)
+{
+    assert(data_p != NULL);
+    assert(size <= 8);
+
+    Logging_Debug(module.logger, "CANTX{id=0x%x, separation_time=%u}", id, separation_time_us);
+
+    struct paced_queue_t *queue_p = &module.paced_queue;
+
+    const uint32_t head = queue_p->head;
+    if ((head - queue_p->tail) >= PACED_QUEUE_SIZE)
+    {
+        ++module.tx_queue.number_of_dropped_frames;
+        Logging_Debug(module.logger, "Paced TX queue full, frame dropped");
+        return false;
+    }
+
+    const uint32_t index = head & (PACED_QUEUE_SIZE - 1);
+    struct can_frame_t *frame_p = &queue_p->frames[index];
+    frame_p->id = id;
+    frame_p->size = (uint8_t)size;
+    memcpy(frame_p->data, data_p, size);
+    queue_p->separation_times[index] = separation_time_us;
+
+    atomic_signal_fence(memory_order_release);
+    queue_p->head = head + 1;
+
+    DisableTransmitInterrupts();
+    FillMailboxes();
+    EnableTransmitInterrupts();
+
+    return true;
+}
+
+size_t CANInterface_GetPacedTransmitQueueSpace(void)
+{
+    const struct paced_queue_t *queue_p = &module.paced_queue;
+
+    /* The ISRs only move the tail forward, so the space can only grow meanwhile. */
+    return PACED_QUEUE_SIZE - (queue_p->head - queue_p->tail);
+}
+
+bool CANInterface_IsPacedTransmitPending(uint32_t id)
+{
+    const struct paced_queue_t *queue_p = &module.paced_queue;
+
+    DisableTransmitInterrupts();
+    bool pending = ((queue_p->mailbox != NO_MAILBOX) || queue_p->waiting) && (queue_p->id == id);
+    for (uint32_t i = queue_p->tail; !pending && (i != queue_p->head); ++i)
+    {
+        pending = queue_p->frames[i & (PACED_QUEUE_SIZE - 1)].id == id;
     }
+    EnableTransmitInterrupts();
+
+    return pending;
+}
 
-    bool extended_id = false;
-    bool request_transmit = false;
-    return can_transmit(CAN1,
-                        id,
-                        extended_id,
-                        request_transmit,
-                        (uint8_t)size,
-                        data_p) != -1;
+void CANInterface_GetStatistics(struct caninterface_statistics_t *statistics_p)
+{
+    assert(statistics_p != NULL);
+
+    const struct rx_ring_t *control_ring_p = &module.rx_rings[0];
+    const struct rx_ring_t *bulk_ring_p = &module.rx_rings[1];
+    const struct error_state_t *error_state_p = &module.error_state;
+
+    *statistics_p = (__typeof__(*statistics_p)) {
+        .rx_frames = control_ring_p->number_of_frames + bulk_ring_p->number_of_frames,
+        .rx_control_frames = control_ring_p->number_of_frames,
+        .rx_bulk_frames = bulk_ring_p->number_of_frames,
+        .rx_unhandled_frames = module.number_of_unhandled_frames,
+        .rx_dropped_frames = control_ring_p->number_of_dropped_frames + bulk_ring_p->number_of_dropped_frames,
+        .rx_fifo0_overruns = control_ring_p->number_of_overruns,
+        .rx_fifo1_overruns = bulk_ring_p->number_of_overruns,
+        .rx_frames_per_second = module.rx_rate.frames_per_second,
+        .rx_max_frames_per_second = module.rx_rate.max_frames_per_second,
+        .tx_frames = module.tx_queue.number_of_frames,
+        .tx_frames_per_second = module.tx_rate.frames_per_second,
+        .tx_max_frames_per_second = module.tx_rate.max_frames_per_second,
+        .tx_queue_depth = module.tx_queue.head - module.tx_queue.tail,
+        .tx_queue_max_depth = module.tx_queue.max_depth,
+        .tx_dropped_frames = module.tx_queue.number_of_dropped_frames,
+        .tx_max_wait_time_us = module.tx_queue.max_wait_time,
+        .transmit_error_counter = error_state_p->transmit_error_counter,
+        .receive_error_counter = error_state_p->receive_error_counter,
+        .max_transmit_error_counter = error_state_p->max_transmit_error_counter,
+        .max_receive_error_counter = error_state_p->max_receive_error_counter,
+        .error_passive_count = error_state_p->number_of_error_passive,
+        .bus_off_count = error_state_p->number_of_bus_off
+    };
 }
 
-void CANInterface_RegisterListener(caninterface_listener_cb_t listener_cb, void *arg_p)
+void CANInterface_ClearPeakStatistics(void)
+{
+    module.rx_rate.max_frames_per_second = 0;
+    module.tx_rate.max_frames_per_second = 0;
+    module.tx_queue.max_depth = 0;
+
+    DisableTransmitInterrupts();
+    module.tx_queue.max_wait_time = 0;
+    EnableTransmitInterrupts();
+
+    nvic_disable_irq(NVIC_CAN_SCE_IRQ);
+    module.error_state.max_transmit_error_counter = module.error_state.transmit_error_counter;
+    module.error_state.max_receive_error_counter = module.error_state.receive_error_counter;
+    nvic_enable_irq(NVIC_CAN_SCE_IRQ);
+}
+
+void CANInterface_Process(void)
+{
+    /* Control frames are dispatched before bulk frames. */
+    for (uint8_t fifo = 0; fifo < NUMBER_OF_RX_FIFOS; ++fifo)
+    {
+        DispatchFrames(fifo);
+    }
+
+    const uint32_t time = SysTime_GetSystemTime();
+    UpdateFrameRate(&module.rx_rate, module.rx_rings[0].number_of_frames + module.rx_rings[1].number_of_frames, time);
+    UpdateFrameRate(&module.tx_rate, module.tx_queue.number_of_frames, time);
+
+    nvic_disable_irq(NVIC_CAN_SCE_IRQ);
+    UpdateErrorState(GetErrorStatus());
+    nvic_enable_irq(NVIC_CAN_SCE_IRQ);
+}
+
+void CANInterface_RegisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
 {
     assert(listener_cb != NULL);
-    assert(module.number_of_listeners < ElementsIn(module.listeners));
+    assert((priority == CANINTERFACE_PRIORITY_CONTROL) || (priority == CANINTERFACE_PRIORITY_BULK));
 
-    module.listeners[module.number_of_listeners].callback = listener_cb;
-    module.listeners[module.number_of_listeners].arg_p = arg_p;
-    ++module.number_of_listeners;
+    /* Control frames are received on FIFO 0 and bulk frames on FIFO 1. */
+    const uint8_t fifo = (priority == CANINTERFACE_PRIORITY_CONTROL) ? 0 : 1;
+    const bool extended = CANInterface_IsExtendedID(id);
+    const uint32_t filter_mask = mask & (extended ? CANINTERFACE_EXTENDED_ID_MASK : CANINTERFACE_STANDARD_ID_MASK);
+
+    AddFilter(id & filter_mask, filter_mask, fifo, extended, GetListener(listener_cb, arg_p));
+    PlanFilterBanks();
+    ApplyFilterBanks();
 
-    Logging_Info(module.logger, "New listener registered: {cb: 0x%x, arg: 0x%x}", (uintptr_t)listener_cb, (uintptr_t)arg_p);
+    Logging_Info(module.logger, "New listener registered: {id=0x%x, mask=0x%x, fifo=%u, cb: 0x%x, arg: 0x%x} (filters: %u, banks: %u/%u)",
+                 id, mask, fifo, (uintptr_t)listener_cb, (uintptr_t)arg_p,
+                 module.number_of_filters, module.number_of_filter_banks, NUMBER_OF_FILTER_BANKS);
 }
 
-void CANInterface_AddFilter(uint16_t id, uint16_t mask)
+void CANInterface_UnregisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
 {
-    assert(module.number_of_filters < MAX_NUMBER_OF_FILTERS);
+    assert(listener_cb != NULL);
+    assert((priority == CANINTERFACE_PRIORITY_CONTROL) || (priority == CANINTERFACE_PRIORITY_BULK));
 
-    /* Left shift since IDs are 11-bits. */
-    module.filters[module.number_of_filters].id = (uint16_t)(id << 5);
-    module.filters[module.number_of_filters].mask = (uint16_t)(mask << 5);
+    const uint8_t fifo = (priority == CANINTERFACE_PRIORITY_CONTROL) ? 0 : 1;
+    const bool extended = CANInterface_IsExtendedID(id);
+    const uint32_t filter_mask = mask & (extended ? CANINTERFACE_EXTENDED_ID_MASK : CANINTERFACE_STANDARD_ID_MASK);
+    const struct listener_t *listener_p = FindListener(listener_cb, arg_p);
 
-    const uint32_t filter_id = module.number_of_filters / 2;
-    const uint32_t fifo = 0;
-    const bool enable = true;
-    const uint16_t id1 =  module.filters[filter_id * 2].id;
-    const uint16_t mask1 =  module.filters[filter_id * 2].mask;
-    const uint16_t id2 =  module.filters[(filter_id * 2) + 1].id;
-    const uint16_t mask2 =  module.filters[(filter_id * 2) + 1].mask;
-    can_filter_id_mask_16bit_init(filter_id, id1, mask1, id2, mask2, fifo, enable);
+    for (size_t i = 0; i < module.number_of_filters; ++i)
+    {
+        const struct filter_t *filter_p = &module.filters[i];
+        if ((filter_p->listener_p == listener_p) && (filter_p->fifo == fifo) && (filter_p->extended == extended) &&
+                (filter_p->id == (id & filter_mask)) && (filter_p->mask == filter_mask))
+        {
+            RemoveFilter(i);
+            PlanFilterBanks();
+            ApplyFilterBanks();
 
-    ++module.number_of_filters;
+            Logging_Info(module.logger, "Listener unregistered: {id=0x%x, mask=0x%x, fifo=%u, cb: 0x%x, arg: 0x%x} (filters: %u, banks: %u/%u)",
+                         id, mask, fifo, (uintptr_t)listener_cb, (uintptr_t)arg_p,
+                         module.number_of_filters, module.number_of_filter_banks, NUMBER_OF_FILTER_BANKS);
+            return;
+        }
+    }
 
-    Logging_Info(module.logger, "New filter added: {id=0x%x,mask=0x%x} (%u/%u)", id, mask, module.number_of_filters, MAX_NUMBER_OF_FILTERS);
-    Logging_Debug(module.logger, "{filter_id=%u, id1=0x%x, mask1=0x%x, id2=0x%x, mask2=0x%x}", filter_id, id1, mask1, id2, mask2);
+    Logging_Debug(module.logger, "No filter to unregister: {id=0x%x, mask=0x%x, fifo=%u}", id, mask, fifo);
 }
 
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
 
-static void InitCANPeripheral(void)
+static void InitCANPeripheral(const struct caninterface_bit_timing_t *timing_p)
 {
     Logging_Debug(module.logger, "%s()", __func__);
 
@@ -190,7 +650,13 @@ static void InitCANPeripheral(void)
     gpio_set_mode(GPIO_BANK_CAN1_TX, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_ALTFN_PUSHPULL, GPIO_CAN1_TX);
 
     nvic_enable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
-    nvic_set_priority(NVIC_USB_LP_CAN_RX0_IRQ, 1);
+    nvic_set_priority(NVIC_USB_LP_CAN_RX0_IRQ, CONTROL_IRQ_PRIORITY);
+    nvic_enable_irq(NVIC_CAN_RX1_IRQ);
+    nvic_set_priority(NVIC_CAN_RX1_IRQ, BULK_IRQ_PRIORITY);
+    nvic_enable_irq(NVIC_USB_HP_CAN_TX_IRQ);
+    nvic_set_priority(NVIC_USB_HP_CAN_TX_IRQ, BULK_IRQ_PRIORITY);
+    nvic_enable_irq(NVIC_CAN_SCE_IRQ);
+    nvic_set_priority(NVIC_CAN_SCE_IRQ, BULK_IRQ_PRIORITY);
 
     can_reset(CAN1);
 
@@ -210,10 +676,10 @@ static void InitCANPeripheral(void)
                  no_automatic_retransmission,
                  receive_fifo_locked_mode,
                  transmit_fifo_priority,
-                 CAN_BTR_SJW_1TQ,
-                 CAN_BTR_TS1_3TQ,
-                 CAN_BTR_TS2_5TQ,
-                 8,
+                 (uint32_t)(timing_p->sync_jump_width - 1) << CAN_BTR_SJW_SHIFT,
+                 (uint32_t)(timing_p->time_segment1 - 1) << CAN_BTR_TS1_SHIFT,
+                 (uint32_t)(timing_p->time_segment2 - 1) << CAN_BTR_TS2_SHIFT,
+                 timing_p->prescaler,
                  loopback,
                  silent) != 0)
     {
@@ -221,40 +687,784 @@ static void InitCANPeripheral(void)
         assert(false);
     }
 
-    /* Enable CAN RX interrupt. */
-    can_enable_irq(CAN1, CAN_IER_FMPIE0);
+    /*
+     * Enable CAN RX (both FIFOs), transmit mailbox empty and error passive/
+     * bus-off status change interrupts.
+     */
+    can_enable_irq(CAN1, CAN_IER_FMPIE0 | CAN_IER_FMPIE1 | CAN_IER_TMEIE |
+                   CAN_IER_EPVIE | CAN_IER_BOFIE | CAN_IER_ERRIE);
+}
+
+/**
+ * The pacing timer has the same priority as the TX ISR, the two never
+ * interrupt each other.
+ */
+static void InitPacingTimer(void)
+{
+    rcc_periph_clock_enable(RCC_TIM1);
+    rcc_periph_reset_pulse(RST_TIM1);
+
+    timer_set_prescaler(PACING_TIMER, (rcc_apb2_frequency / PACING_TIMER_FREQUENCY) - 1);
+    timer_one_shot_mode(PACING_TIMER);
+    timer_update_on_overflow(PACING_TIMER);
+    timer_enable_irq(PACING_TIMER, TIM_DIER_UIE);
+
+    nvic_enable_irq(NVIC_TIM1_UP_IRQ);
+    nvic_set_priority(NVIC_TIM1_UP_IRQ, BULK_IRQ_PRIORITY);
+}
+
+/**
+ * NOTE: Must not be interrupted by the TX ISR.
+ */
+static void StartPacingTimer(uint32_t time_us)
+{
+    struct paced_queue_t *queue_p = &module.paced_queue;
+
+    uint32_t period = time_us;
+    if (period > PACING_TIMER_MAX_PERIOD_US)
+    {
+        /* Don't leave a remainder that is too short for the timer. */
+        const bool short_remainder = (time_us - PACING_TIMER_MAX_PERIOD_US) < PACING_TIMER_MIN_PERIOD_US;
+        period = short_remainder ? (time_us - PACING_TIMER_MIN_PERIOD_US) : PACING_TIMER_MAX_PERIOD_US;
+    }
+    else if (period < PACING_TIMER_MIN_PERIOD_US)
+    {
+        period = PACING_TIMER_MIN_PERIOD_US;
+    }
+    queue_p->remaining_time = (time_us > period) ? (time_us - period) : 0;
+    queue_p->waiting = true;
+
+    /* The update event restarts the counter and loads the prescaler without raising an interrupt. */
+    timer_set_period(PACING_TIMER, period - 1);
+    timer_generate_event(PACING_TIMER, TIM_EGR_UG);
+    timer_enable_counter(PACING_TIMER);
+}
+
+static inline void DisableTransmitInterrupts(void)
+{
+    nvic_disable_irq(NVIC_USB_HP_CAN_TX_IRQ);
+    nvic_disable_irq(NVIC_TIM1_UP_IRQ);
+}
+
+static inline void EnableTransmitInterrupts(void)
+{
+    nvic_enable_irq(NVIC_TIM1_UP_IRQ);
+    nvic_enable_irq(NVIC_USB_HP_CAN_TX_IRQ);
+}
+
+static void NotifyListener(uint8_t fifo, const struct rx_entry_t *entry_p)
+{
+    const struct listener_t *listener_p = entry_p->listener_p;
+    if (listener_p != NULL)
+    {
+        listener_p->callback(&entry_p->frame, listener_p->arg_p);
+    }
+    else
+    {
+        ++module.number_of_unhandled_frames;
+        Logging_Debug(module.logger, "No listener: {id=0x%x, fifo=%u, fmi=%u}", entry_p->frame.id, fifo, entry_p->fmi);
+    }
 }
 
-static void NotifyListeners(const struct can_frame_t *frame_p)
+static const struct listener_t *FindListener(caninterface_listener_cb_t listener_cb, void *arg_p)
 {
     for (size_t i = 0; i < module.number_of_listeners; ++i)
     {
-        module.listeners[i].callback(frame_p, module.listeners[i].arg_p);
+        const struct listener_t *listener_p = &module.listeners[i];
+        if ((listener_p->callback == listener_cb) && (listener_p->arg_p == arg_p))
+        {
+            return listener_p;
+        }
+    }
+
+    return NULL;
+}
+
+static const struct listener_t *GetListener(caninterface_listener_cb_t listener_cb, void *arg_p)
+{
+    const struct listener_t *existing_listener_p = FindListener(listener_cb, arg_p);
+    if (existing_listener_p != NULL)
+    {
+        return existing_listener_p;
+    }
+
+    assert(module.number_of_listeners < ElementsIn(module.listeners));
+
+    struct listener_t *listener_p = &module.listeners[module.number_of_listeners];
+    listener_p->callback = listener_cb;
+    listener_p->arg_p = arg_p;
+    ++module.number_of_listeners;
+
+    return listener_p;
+}
+
+/**
+ * Add a filter to the filter list. ID/mask filters for the same listener that
+ * only differ in one ID bit are merged into one filter, since together they
+ * accept exactly the same frames. Exact IDs are not merged as four of them
+ * fit in the space of two ID/mask filters. Filters for the same listener that
+ * are covered by the new filter are removed.
+ */
+static void AddFilter(uint32_t id, uint32_t mask, uint8_t fifo, bool extended, const struct listener_t *listener_p)
+{
+    struct filter_t filter = {.id = id, .mask = mask, .fifo = fifo, .extended = extended, .listener_p = listener_p};
+
+    size_t i = 0;
+    while (i < module.number_of_filters)
+    {
+        const struct filter_t *other_p = &module.filters[i];
+        if ((other_p->fifo != filter.fifo) || (other_p->extended != filter.extended) ||
+                (other_p->listener_p != filter.listener_p))
+        {
+            ++i;
+            continue;
+        }
+
+        if (IsFilterCoveredBy(&filter, other_p))
+        {
+            Logging_Debug(module.logger, "Filter already covered: {id=0x%x, mask=0x%x}", id, mask);
+            return;
+        }
+
+        if (IsFilterCoveredBy(other_p, &filter))
+        {
+            Logging_Debug(module.logger, "Covered filter removed: {id=0x%x, mask=0x%x}", other_p->id, other_p->mask);
+            RemoveFilter(i);
+            continue;
+        }
+
+        const uint32_t difference = filter.id ^ other_p->id;
+        const bool single_bit = (difference & (difference - 1)) == 0;
+        if (!IsExactFilter(&filter) && (filter.mask == other_p->mask) && single_bit)
+        {
+            filter.id &= ~difference;
+            filter.mask &= ~difference;
+            RemoveFilter(i);
+
+            /* The merged filter might be mergeable with an earlier filter. */
+            i = 0;
+            continue;
+        }
+
+        ++i;
     }
+
+    assert(module.number_of_filters < ElementsIn(module.filters));
+    module.filters[module.number_of_filters] = filter;
+    ++module.number_of_filters;
+
+    Logging_Debug(module.logger, "New filter added: {id=0x%x, mask=0x%x, fifo=%u, ext=%u} (%u/%u)",
+                  filter.id, filter.mask, fifo, extended, module.number_of_filters, MAX_NUMBER_OF_FILTERS);
+}
+
+static inline bool IsFilterCoveredBy(const struct filter_t *filter_p, const struct filter_t *other_p)
+{
+    return ((filter_p->mask & other_p->mask) == other_p->mask) && ((filter_p->id & other_p->mask) == other_p->id);
 }
 
-static void InitFilterArray(void)
+static inline bool IsExactFilter(const struct filter_t *filter_p)
 {
-    for(size_t i = 0; i < ElementsIn(module.filters); ++i)
+    return filter_p->mask == (filter_p->extended ? CANINTERFACE_EXTENDED_ID_MASK : CANINTERFACE_STANDARD_ID_MASK);
+}
+
+static void RemoveFilter(size_t index)
+{
+    --module.number_of_filters;
+    module.filters[index] = module.filters[module.number_of_filters];
+}
+
+/**
+ * Distribute the filters on the filter banks. For each FIFO the standard
+ * filters are placed first, followed by the extended filters.
+ */
+static void PlanFilterBanks(void)
+{
+    module.number_of_filter_banks = 0;
+
+    for (uint8_t fifo = 0; fifo < NUMBER_OF_RX_FIFOS; ++fifo)
     {
-        module.filters[i] = (__typeof__(module.filters[i])) {.id = 0xFFFF, .mask = 0xFFFF};
+        PlanStandardFilterBanks(fifo);
+        PlanExtendedFilterBanks(fifo);
     }
 }
 
+/**
+ * The exact IDs are placed in list mode banks, followed by the ID/mask
+ * filters in mask mode banks. A single exact ID that would need a list bank
+ * of its own is placed in the free slot of a mask bank instead.
+ */
+static void PlanStandardFilterBanks(uint8_t fifo)
+{
+    size_t number_of_ids = 0;
+    size_t number_of_masks = 0;
+    for (size_t i = 0; i < module.number_of_filters; ++i)
+    {
+        const struct filter_t *filter_p = &module.filters[i];
+        if ((filter_p->fifo == fifo) && !filter_p->extended)
+        {
+            if (IsExactFilter(filter_p))
+            {
+                ++number_of_ids;
+            }
+            else
+            {
+                ++number_of_masks;
+            }
+        }
+    }
+
+    size_t number_of_listed_ids = number_of_ids;
+    if (((number_of_ids % IDS_PER_LIST_BANK) == 1) && ((number_of_masks % FILTERS_PER_MASK_BANK) == 1))
+    {
+        --number_of_listed_ids;
+    }
+
+    size_t number_of_ids_added = 0;
+    for (size_t i = 0; i < module.number_of_filters; ++i)
+    {
+        const struct filter_t *filter_p = &module.filters[i];
+        if ((filter_p->fifo == fifo) && !filter_p->extended && IsExactFilter(filter_p) &&
+                (number_of_ids_added < number_of_listed_ids))
+        {
+            AddToFilterBank(filter_p, true);
+            ++number_of_ids_added;
+        }
+    }
+
+    number_of_ids_added = 0;
+    for (size_t i = 0; i < module.number_of_filters; ++i)
+    {
+        const struct filter_t *filter_p = &module.filters[i];
+        if ((filter_p->fifo != fifo) || filter_p->extended)
+        {
+            continue;
+        }
+
+        if (IsExactFilter(filter_p))
+        {
+            ++number_of_ids_added;
+            if (number_of_ids_added <= number_of_listed_ids)
+            {
+                continue;
+            }
+        }
+
+        AddToFilterBank(filter_p, false);
+    }
+}
+
+/**
+ * An extended mask bank holds a single filter, so the exact IDs are always
+ * placed in list mode banks.
+ */
+static void PlanExtendedFilterBanks(uint8_t fifo)
+{
+    for (size_t pass = 0; pass < 2; ++pass)
+    {
+        const bool list_mode = (pass == 0);
+        for (size_t i = 0; i < module.number_of_filters; ++i)
+        {
+            const struct filter_t *filter_p = &module.filters[i];
+            if ((filter_p->fifo == fifo) && filter_p->extended && (IsExactFilter(filter_p) == list_mode))
+            {
+                AddToFilterBank(filter_p, list_mode);
+            }
+        }
+    }
+}
+
+static void AddToFilterBank(const struct filter_t *filter_p, bool list_mode)
+{
+    struct filter_bank_t *bank_p = NULL;
+
+    if (module.number_of_filter_banks > 0)
+    {
+        bank_p = &module.filter_banks[module.number_of_filter_banks - 1];
+
+        if ((bank_p->list_mode != list_mode) || (bank_p->extended != filter_p->extended) ||
+                (bank_p->fifo != filter_p->fifo) || (bank_p->number_of_filters == GetNumberOfSlots(bank_p)))
+        {
+            bank_p = NULL;
+        }
+    }
+
+    if (bank_p == NULL)
+    {
+        assert(module.number_of_filter_banks < ElementsIn(module.filter_banks));
+
+        bank_p = &module.filter_banks[module.number_of_filter_banks];
+        *bank_p = (__typeof__(*bank_p)) {.fifo = filter_p->fifo, .list_mode = list_mode, .extended = filter_p->extended};
+        ++module.number_of_filter_banks;
+    }
+
+    bank_p->filters[bank_p->number_of_filters] = filter_p;
+    ++bank_p->number_of_filters;
+}
+
+static inline size_t GetNumberOfSlots(const struct filter_bank_t *bank_p)
+{
+    if (bank_p->extended)
+    {
+        return bank_p->list_mode ? IDS_PER_EXTENDED_LIST_BANK : FILTERS_PER_EXTENDED_MASK_BANK;
+    }
+
+    return bank_p->list_mode ? IDS_PER_LIST_BANK : FILTERS_PER_MASK_BANK;
+}
+
+/**
+ * Rebuild the listener table and reprogram all filter banks. The RX
+ * interrupts are disabled and the filters are held in init mode during the
+ * update, so no frame is accepted or routed with a partial configuration.
+ *
+ * The filter match index is numbered per FIFO, counting the slots of all
+ * banks assigned to that FIFO in bank order.
+ */
+static void ApplyFilterBanks(void)
+{
+    nvic_disable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+    nvic_disable_irq(NVIC_CAN_RX1_IRQ);
+
+    memset(module.listener_table, 0, sizeof(module.listener_table));
+    size_t number_of_slots_in_fifo[NUMBER_OF_RX_FIFOS] = {0};
+    uint32_t active_banks = 0;
+
+    BeginFilterUpdate();
+    for (size_t i = 0; i < module.number_of_filter_banks; ++i)
+    {
+        const struct filter_bank_t *bank_p = &module.filter_banks[i];
+        const size_t number_of_slots = GetNumberOfSlots(bank_p);
+
+        for (size_t slot = 0; slot < number_of_slots; ++slot)
+        {
+            /* Unused slots repeat the first filter of the bank. */
+            const struct filter_t *filter_p = bank_p->filters[(slot < bank_p->number_of_filters) ? slot : 0];
+            module.listener_table[bank_p->fifo][number_of_slots_in_fifo[bank_p->fifo] + slot] = filter_p->listener_p;
+        }
+        number_of_slots_in_fifo[bank_p->fifo] += number_of_slots;
+
+        WriteFilterBank(i, bank_p);
+        active_banks |= 1UL << i;
+
+        Logging_Debug(module.logger, "{bank=%u, fifo=%u, list_mode=%u, ext=%u, filters=%u}",
+                      i, bank_p->fifo, bank_p->list_mode, bank_p->extended, bank_p->number_of_filters);
+    }
+    EndFilterUpdate(active_banks);
+
+    nvic_enable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+    nvic_enable_irq(NVIC_CAN_RX1_IRQ);
+}
+
+static void DispatchFrames(uint8_t fifo)
+{
+    struct rx_ring_t *ring_p = &module.rx_rings[fifo];
+
+    const uint32_t head = ring_p->head;
+    atomic_signal_fence(memory_order_acquire);
+
+    while (ring_p->tail != head)
+    {
+        const struct rx_entry_t *entry_p = &ring_p->entries[ring_p->tail & (RX_RING_SIZE - 1)];
+
+        Logging_Debug(module.logger, "CANRX{id=0x%x}", entry_p->frame.id);
+        NotifyListener(fifo, entry_p);
+
+        atomic_signal_fence(memory_order_release);
+        ++ring_p->tail;
+    }
+
+    const uint32_t number_of_dropped_frames = ring_p->number_of_dropped_frames;
+    if (number_of_dropped_frames != ring_p->number_of_reported_dropped_frames)
+    {
+        Logging_Warning(module.logger, "RX ring full, %u frame(s) dropped",
+                        number_of_dropped_frames - ring_p->number_of_reported_dropped_frames);
+        ring_p->number_of_reported_dropped_frames = number_of_dropped_frames;
+    }
+}
+
+/**
+ * Drain the hardware FIFO into the corresponding RX ring, the hardware FIFO
+ * can hold up to three frames.
+ *
+ * NOTE: Called from ISR.
+ */
+static void ReceiveFrames(uint8_t fifo)
+{
+    struct rx_ring_t *ring_p = &module.rx_rings[fifo];
+
+    if ((GetReceiveFifoStatus(fifo) & CAN_RF0R_FOVR0) != 0)
+    {
+        ++ring_p->number_of_overruns;
+        ClearReceiveFifoOverrun(fifo);
+    }
+
+    /* All frames pending in the FIFO are stamped with the interrupt entry time. */
+    const uint32_t timestamp = SysTime_GetSystemTimeUs();
+    do
+    {
+        bool ext;
+        bool rtr;
+        struct rx_entry_t entry;
+
+        can_receive(CAN1, fifo, false, &entry.frame.id, &ext, &rtr, &entry.fmi, &entry.frame.size, entry.frame.data, NULL);
+        can_fifo_release(CAN1, fifo);
+        entry.frame.timestamp = timestamp;
+        if (ext)
+        {
+            entry.frame.id |= CANINTERFACE_EXTENDED_ID_FLAG;
+        }
+
+        entry.listener_p = NULL;
+        if (entry.fmi < ElementsIn(module.listener_table[fifo]))
+        {
+            entry.listener_p = module.listener_table[fifo][entry.fmi];
+        }
+
+        ++ring_p->number_of_frames;
+
+        const uint32_t head = ring_p->head;
+        if ((head - ring_p->tail) < RX_RING_SIZE)
+        {
+            ring_p->entries[head & (RX_RING_SIZE - 1)] = entry;
+            atomic_signal_fence(memory_order_release);
+            ring_p->head = head + 1;
+        }
+        else
+        {
+            ++ring_p->number_of_dropped_frames;
+        }
+    } while ((GetReceiveFifoStatus(fifo) & CAN_RF0R_FMP0_MASK) != 0);
+}
+
+/**
+ * Move queued frames to the mailboxes until either the queue is empty or no
+ * mailbox is available. Frames are transmitted in queue order since transmit
+ * FIFO priority is enabled.
+ *
+ * NOTE: Must not be interrupted by the TX ISR.
+ */
+static void FillMailboxes(void)
+{
+    SendPacedFrame();
+
+    struct tx_queue_t *queue_p = &module.tx_queue;
+
+    if (queue_p->tail == queue_p->head)
+    {
+        return;
+    }
+
+    const uint32_t time = SysTime_GetSystemTimeUs();
+    while ((queue_p->tail != queue_p->head) && can_available_mailbox(CAN1))
+    {
+        atomic_signal_fence(memory_order_acquire);
+        const uint32_t index = queue_p->tail & (TX_QUEUE_SIZE - 1);
+        struct can_frame_t *frame_p = &queue_p->frames[index];
+
+        const bool extended_id = CANInterface_IsExtendedID(frame_p->id);
+        const uint32_t id = frame_p->id & (extended_id ? CANINTERFACE_EXTENDED_ID_MASK : CANINTERFACE_STANDARD_ID_MASK);
+        const bool request_transmit = false;
+        if (can_transmit(CAN1, id, extended_id, request_transmit, frame_p->size, frame_p->data) == -1)
+        {
+            break;
+        }
+        ++queue_p->tail;
+        ++queue_p->number_of_frames;
+
+        const uint32_t wait_time = time - queue_p->enqueue_times[index];
+        if (wait_time > queue_p->max_wait_time)
+        {
+            queue_p->max_wait_time = wait_time;
+        }
+    }
+}
+
+/**
+ * Hand the next paced frame to the peripheral, unless a paced frame is
+ * already being transmitted or the separation time hasn't elapsed.
+ *
+ * NOTE: Must not be interrupted by the TX ISR.
+ */
+static void SendPacedFrame(void)
+{
+    struct paced_queue_t *queue_p = &module.paced_queue;
+
+    if ((queue_p->tail == queue_p->head) || (queue_p->mailbox != NO_MAILBOX) || queue_p->waiting ||
+        !can_available_mailbox(CAN1))
+    {
+        return;
+    }
+
+    atomic_signal_fence(memory_order_acquire);
+    const uint32_t index = queue_p->tail & (PACED_QUEUE_SIZE - 1);
+    struct can_frame_t *frame_p = &queue_p->frames[index];
+
+    const bool extended_id = CANInterface_IsExtendedID(frame_p->id);
+    const uint32_t id = frame_p->id & (extended_id ? CANINTERFACE_EXTENDED_ID_MASK : CANINTERFACE_STANDARD_ID_MASK);
+    const bool request_transmit = false;
+    const int mailbox = can_transmit(CAN1, id, extended_id, request_transmit, frame_p->size, frame_p->data);
+    if (mailbox != -1)
+    {
+        queue_p->mailbox = mailbox;
+        queue_p->id = frame_p->id;
+        queue_p->separation_time = queue_p->separation_times[index];
+        ++queue_p->tail;
+        ++module.tx_queue.number_of_frames;
+    }
+}
+
+/**
+ * Start the separation time once the paced frame has been transmitted, the
+ * next paced frame is sent when it has elapsed.
+ *
+ * NOTE: Must not be interrupted by the TX ISR.
+ */
+static void CheckPacedFrameCompleted(uint32_t transmit_status)
+{
+    struct paced_queue_t *queue_p = &module.paced_queue;
+
+    const uint32_t request_completed_flags[] = {CAN_TSR_RQCP0, CAN_TSR_RQCP1, CAN_TSR_RQCP2};
+    if ((queue_p->mailbox != NO_MAILBOX) && ((transmit_status & request_completed_flags[queue_p->mailbox]) != 0))
+    {
+        queue_p->mailbox = NO_MAILBOX;
+        if (queue_p->separation_time > 0)
+        {
+            StartPacingTimer(queue_p->separation_time);
+        }
+    }
+}
+
+static void UpdateFrameRate(struct frame_rate_t *rate_p, uint32_t number_of_frames, uint32_t time)
+{
+    const uint32_t elapsed_time = time - rate_p->period_start;
+    if (elapsed_time < FRAME_RATE_PERIOD_MS)
+    {
+        return;
+    }
+
+    /* Scale in case the main loop was late to close the period. */
+    rate_p->frames_per_second = ((number_of_frames - rate_p->last_number_of_frames) * FRAME_RATE_PERIOD_MS) / elapsed_time;
+    if (rate_p->frames_per_second > rate_p->max_frames_per_second)
+    {
+        rate_p->max_frames_per_second = rate_p->frames_per_second;
+    }
+
+    rate_p->last_number_of_frames = number_of_frames;
+    rate_p->period_start = time;
+}
+
+/**
+ * Count transitions into error passive and bus-off, and track the error
+ * counters.
+ *
+ * NOTE: Must not be interrupted by the status change ISR.
+ */
+static void UpdateErrorState(uint32_t error_status)
+{
+    struct error_state_t *state_p = &module.error_state;
+
+    const uint32_t flags = error_status & (CAN_ESR_EPVF | CAN_ESR_BOFF);
+    const uint32_t raised_flags = flags & ~state_p->flags;
+    if ((raised_flags & CAN_ESR_EPVF) != 0)
+    {
+        ++state_p->number_of_error_passive;
+    }
+    if ((raised_flags & CAN_ESR_BOFF) != 0)
+    {
+        ++state_p->number_of_bus_off;
+    }
+    state_p->flags = flags;
+
+    state_p->transmit_error_counter = TRANSMIT_ERROR_COUNTER(error_status);
+    state_p->receive_error_counter = RECEIVE_ERROR_COUNTER(error_status);
+    if (state_p->transmit_error_counter > state_p->max_transmit_error_counter)
+    {
+        state_p->max_transmit_error_counter = state_p->transmit_error_counter;
+    }
+    if (state_p->receive_error_counter > state_p->max_receive_error_counter)
+    {
+        state_p->max_receive_error_counter = state_p->receive_error_counter;
+    }
+}
+
+/* The FMP and FOVR bits are located at the same positions for both FIFOs. */
+static inline uint32_t GetReceiveFifoStatus(uint8_t fifo)
+{
+    return (fifo == 0) ? CAN_RF0R(CAN1) : CAN_RF1R(CAN1);
+}
+
+static inline void ClearReceiveFifoOverrun(uint8_t fifo)
+{
+    if (fifo == 0)
+    {
+        CAN_RF0R(CAN1) = CAN_RF0R_FOVR0;
+    }
+    else
+    {
+        CAN_RF1R(CAN1) = CAN_RF1R_FOVR1;
+    }
+}
+
+static inline uint32_t GetTransmitStatus(void)
+{
+    return CAN_TSR(CAN1);
+}
+
+/**
+ * Only the flags that have been read are cleared, a request completed
+ * meanwhile raises a new interrupt.
+ */
+static inline void ClearRequestCompletedFlags(uint32_t transmit_status)
+{
+    CAN_TSR(CAN1) = transmit_status & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2);
+}
+
+static inline uint32_t GetErrorStatus(void)
+{
+    return CAN_ESR(CAN1);
+}
+
+static inline void ClearErrorInterrupt(void)
+{
+    CAN_MSR(CAN1) = CAN_MSR_ERRI;
+}
+
+static inline void BeginFilterUpdate(void)
+{
+    CAN_FMR(CAN1) |= CAN_FMR_FINIT;
+    CAN_FA1R(CAN1) = 0;
+}
+
+/**
+ * The slots are stored in filter match index order. For 16-bit scale banks:
+ * FiR1[15:0], FiR1[31:16], FiR2[15:0], FiR2[31:16], where each register
+ * holds the ID in the lower and the mask in the upper half in mask mode. For
+ * 32-bit scale banks: FiR1, FiR2, where FiR2 holds the mask in mask mode.
+ */
+static inline void WriteFilterBank(size_t bank_index, const struct filter_bank_t *bank_p)
+{
+    uint32_t registers[2];
+
+    if (bank_p->extended)
+    {
+        const struct filter_t *first_filter_p = bank_p->filters[0];
+        const struct filter_t *last_filter_p = bank_p->filters[bank_p->number_of_filters - 1];
+
+        registers[0] = (first_filter_p->id << EXTENDED_FILTER_ID_SHIFT) | EXTENDED_FILTER_IDE;
+        if (bank_p->list_mode)
+        {
+            /* An unused slot repeats the first filter of the bank. */
+            registers[1] = (last_filter_p->id << EXTENDED_FILTER_ID_SHIFT) | EXTENDED_FILTER_IDE;
+        }
+        else
+        {
+            registers[1] = (first_filter_p->mask << EXTENDED_FILTER_ID_SHIFT) | EXTENDED_FILTER_RTR_IDE_MASK;
+        }
+    }
+    else
+    {
+        uint16_t values[IDS_PER_LIST_BANK];
+
+        if (bank_p->list_mode)
+        {
+            for (size_t slot = 0; slot < IDS_PER_LIST_BANK; ++slot)
+            {
+                const struct filter_t *filter_p = bank_p->filters[(slot < bank_p->number_of_filters) ? slot : 0];
+                values[slot] = (uint16_t)(filter_p->id << FILTER_ID_SHIFT);
+            }
+        }
+        else
+        {
+            for (size_t slot = 0; slot < FILTERS_PER_MASK_BANK; ++slot)
+            {
+                const struct filter_t *filter_p = bank_p->filters[(slot < bank_p->number_of_filters) ? slot : 0];
+                values[2 * slot] = (uint16_t)(filter_p->id << FILTER_ID_SHIFT);
+                values[2 * slot + 1] = (uint16_t)(filter_p->mask << FILTER_ID_SHIFT) | FILTER_RTR_IDE_MASK;
+            }
+        }
+
+        registers[0] = ((uint32_t)values[1] << 16) | values[0];
+        registers[1] = ((uint32_t)values[3] << 16) | values[2];
+    }
+
+    const uint32_t bank_bit = 1UL << bank_index;
+
+    if (bank_p->extended)
+    {
+        CAN_FS1R(CAN1) |= bank_bit;
+    }
+    else
+    {
+        CAN_FS1R(CAN1) &= ~bank_bit;
+    }
+
+    if (bank_p->list_mode)
+    {
+        CAN_FM1R(CAN1) |= bank_bit;
+    }
+    else
+    {
+        CAN_FM1R(CAN1) &= ~bank_bit;
+    }
+
+    if (bank_p->fifo == 1)
+    {
+        CAN_FFA1R(CAN1) |= bank_bit;
+    }
+    else
+    {
+        CAN_FFA1R(CAN1) &= ~bank_bit;
+    }
+
+    CAN_FiR1(CAN1, bank_index) = registers[0];
+    CAN_FiR2(CAN1, bank_index) = registers[1];
+}
+
+static inline void EndFilterUpdate(uint32_t active_banks)
+{
+    CAN_FA1R(CAN1) = active_banks;
+    CAN_FMR(CAN1) &= ~CAN_FMR_FINIT;
+}
+
 //////////////////////////////////////////////////////////////////////////
 //ISR
 //////////////////////////////////////////////////////////////////////////
 
 void usb_lp_can_rx0_isr(void)
 {
-    bool ext;
-    bool rtr;
-    uint8_t fmi;
-    struct can_frame_t frame;
+    ReceiveFrames(0);
+}
+
+void can_rx1_isr(void)
+{
+    ReceiveFrames(1);
+}
 
-    can_receive(CAN1, 0, false, &frame.id, &ext, &rtr, &fmi, &frame.size, frame.data, NULL);
-    can_fifo_release(CAN1, 0);
+void usb_hp_can_tx_isr(void)
+{
+    const uint32_t transmit_status = GetTransmitStatus();
+    ClearRequestCompletedFlags(transmit_status);
+    CheckPacedFrameCompleted(transmit_status);
+    FillMailboxes();
+}
+
+void tim1_up_isr(void)
+{
+    timer_clear_flag(PACING_TIMER, TIM_SR_UIF);
 
-    Logging_Debug(module.logger, "CANRX{id=0x%x}", frame.id);
-    NotifyListeners(&frame);
+    struct paced_queue_t *queue_p = &module.paced_queue;
+    if (queue_p->remaining_time > 0)
+    {
+        StartPacingTimer(queue_p->remaining_time);
+    }
+    else
+    {
+        queue_p->waiting = false;
+        FillMailboxes();
+    }
+}
+
+void can_sce_isr(void)
+{
+    ClearErrorInterrupt();
+    UpdateErrorState(GetErrorStatus());
 }
@@ -36,17 +36,77 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //TYPE DEFINITIONS
 //////////////////////////////////////////////////////////////////////////
 
+/**
+ * Extended (29-bit) IDs are marked with 'CANINTERFACE_EXTENDED_ID_FLAG', both
+ * in received frames and when transmitting or registering listeners.
+ */
 struct can_frame_t
 {
     uint32_t id;
     uint8_t size;
     uint8_t data[8];
+    uint32_t timestamp; /* Reception time in microseconds, see SysTime_GetSystemTimeUs. */
+};
+
+enum caninterface_priority_t
+{
+    CANINTERFACE_PRIORITY_CONTROL = 0,
+    CANINTERFACE_PRIORITY_BULK
+};
+
+/**
+ * Frame counters are totals since initialization. Peak values ('max') are
+ * tracked since the last call to 'CANInterface_ClearPeakStatistics'.
+ */
+struct caninterface_statistics_t
+{
+    uint32_t rx_frames;
+    uint32_t rx_control_frames;
+    uint32_t rx_bulk_frames;
+    uint32_t rx_unhandled_frames;
+    uint32_t rx_dropped_frames;
+    uint32_t rx_fifo0_overruns;
+    uint32_t rx_fifo1_overruns;
+    uint32_t rx_frames_per_second;
+    uint32_t rx_max_frames_per_second;
+    uint32_t tx_frames;
+    uint32_t tx_frames_per_second;
+    uint32_t tx_max_frames_per_second;
+    uint32_t tx_queue_depth;
+    uint32_t tx_queue_max_depth;
+    uint32_t tx_dropped_frames;
+    uint32_t tx_max_wait_time_us;
+    uint32_t transmit_error_counter;
+    uint32_t receive_error_counter;
+    uint32_t max_transmit_error_counter;
+    uint32_t max_receive_error_counter;
+    uint32_t error_passive_count;
+    uint32_t bus_off_count;
+};
+
+struct caninterface_bit_timing_t
+{
+    uint16_t prescaler;
+    uint8_t time_segment1;
+    uint8_t time_segment2;
+    uint8_t sync_jump_width;
+    uint16_t sample_point;
 };
 
 //////////////////////////////////////////////////////////////////////////
 //DEFINES
 //////////////////////////////////////////////////////////////////////////
 
+#define CANINTERFACE_DEFAULT_BIT_RATE 500000
+#define CANINTERFACE_MAX_BIT_RATE 1000000
+
+#define CANINTERFACE_STANDARD_ID_MASK 0x7FFUL
+#define CANINTERFACE_EXTENDED_ID_MASK 0x1FFFFFFFUL
+#define CANINTERFACE_EXTENDED_ID_FLAG (1UL << 31)
+
+#define CANInterface_ExtendedID(id) (((id) & CANINTERFACE_EXTENDED_ID_MASK) | CANINTERFACE_EXTENDED_ID_FLAG)
+#define CANInterface_IsExtendedID(id) (((id) & CANINTERFACE_EXTENDED_ID_FLAG) != 0)
+
 typedef void (*caninterface_listener_cb_t)(const struct can_frame_t *frame_p, void *arg_p);
 
 //////////////////////////////////////////////////////////////////////////
@@ -56,41 +116,155 @@ typedef void (*caninterface_listener_cb_t)(const struct can_frame_t *frame_p, vo
 /**
  * Initialize the CAN interface.
  *
- * Note: It's required to setup acceptance filters before any CAN-frames can be received.
- *       See 'CANInterface_AddFilter'.
+ * Note: No CAN-frames are received until a listener is registered.
+ *       See 'CANInterface_RegisterListener'.
+ *
+ * @param bit_rate Bit rate in bit/s. 'CANINTERFACE_DEFAULT_BIT_RATE' is used
+ *                 if zero or if no bit timing can be derived for the rate.
  */
-void CANInterface_Init(void);
+void CANInterface_Init(uint32_t bit_rate);
+
+/**
+ * Get the bit rate the CAN interface was initialized with.
+ *
+ * @return Bit rate in bit/s.
+ */
+uint32_t CANInterface_GetBitRate(void);
+
+/**
+ * Calculate the bit timing for a bit rate.
+ *
+ * The bit time is divided into 8-25 time quanta and the segments are
+ * selected to give a sample point as close to, but not after, 87.5%.
+ * Only rates that can be reached exactly from the CAN peripheral clock
+ * are accepted.
+ *
+ * @param bit_rate Bit rate in bit/s.
+ * @param timing_p Pointer to where the calculated timing is stored.
+ *
+ * @return True if a valid timing was found, otherwise false.
+ */
+bool CANInterface_CalculateBitTiming(uint32_t bit_rate, struct caninterface_bit_timing_t *timing_p);
 
 /**
  * Transmit a CAN-frame
  *
- * @param  id ID
+ * The frame is queued and handed to the CAN peripheral as soon as a
+ * transmit mailbox is available, the function never blocks.
+ *
+ * @param  id ID, with 'CANINTERFACE_EXTENDED_ID_FLAG' set for an extended ID.
  * @param  data_p Pointer to data.
  * @param  size Size of data, max 8.
  *
- * @return True if frame was sent/queued, otherwise false.
+ * @return True if frame was sent/queued, false if the queue is full.
  */
 bool CANInterface_Transmit(uint32_t id, void *data_p, size_t size);
 
 /**
- * Register a listener.
+ * Get the number of frames that can be queued for transmission right now.
+ *
+ * Lets a sender transmit a burst without having frames rejected by
+ * 'CANInterface_Transmit'.
+ *
+ * @return Number of free slots in the TX queue.
+ */
+size_t CANInterface_GetTransmitQueueSpace(void);
+
+/**
+ * Transmit a CAN-frame with a minimum separation to the next paced frame.
  *
- * The registered callback will be called when a CAN-frame is received.
- * Note that the callback is called from an ISR.
+ * Paced frames are queued separately from 'CANInterface_Transmit' and handed
+ * to the CAN peripheral one at a time. When a paced frame has been
+ * transmitted a hardware timer holds back the next one for the separation
+ * time, so the spacing doesn't depend on how often the main loop runs.
  *
+ * @param  id ID, with 'CANINTERFACE_EXTENDED_ID_FLAG' set for an extended ID.
+ * @param  data_p Pointer to data.
+ * @param  size Size of data, max 8.
+ * @param  separation_time_us Minimum time from the end of this frame to the
+ *                            start of the next paced frame.
+ *
+ * @return True if frame was queued, false if the queue is full.
+ */
+bool CANInterface_TransmitPaced(uint32_t id, void *data_p, size_t size, uint32_t separation_time_us);
+
+/**
+ * Get the number of frames that can be queued for paced transmission right now.
+ *
+ * @return Number of free slots in the paced TX queue.
+ */
+size_t CANInterface_GetPacedTransmitQueueSpace(void);
+
+/**
+ * Check if paced frames with the given ID are queued, being transmitted or
+ * waiting for the separation time.
+ *
+ * @param id CAN ID of the paced frames, as passed to 'CANInterface_TransmitPaced'.
+ *
+ * @return True if paced transmission of the ID is in progress, otherwise false.
+ */
+bool CANInterface_IsPacedTransmitPending(uint32_t id);
+
+/**
+ * Get the CAN interface statistics.
+ *
+ * @param statistics_p Pointer to struct where the statistics are stored.
+ */
+void CANInterface_GetStatistics(struct caninterface_statistics_t *statistics_p);
+
+/**
+ * Restart tracking of the peak values in the statistics.
+ */
+void CANInterface_ClearPeakStatistics(void);
+
+/**
+ * Dispatch received CAN-frames to the registered listeners.
+ *
+ * Frames are buffered by the RX interrupt and delivered in batch by this
+ * function, it should be called periodically from the main loop. The frame
+ * rates and bus error counters are also sampled here.
+ */
+void CANInterface_Process(void);
+
+/**
+ * Register a listener for CAN-frames matching an acceptance filter.
+ *
+ * Each listener is called with the frames matching its acceptance filters
+ * only. The callback is called from 'CANInterface_Process', not from an ISR.
+ * Registering the same callback and argument again adds another filter for
+ * that listener.
+ *
+ * The filter banks are reprogrammed on each call. Exact standard IDs (mask
+ * 0x7FF) are packed four to a bank, other standard filters two to a bank, so
+ * up to 56 exact IDs or 28 ID/mask filters fit. Extended filters need twice
+ * the space: two exact IDs or one ID/mask filter per bank. Standard filters
+ * only accept standard frames and extended filters only extended frames.
+ *
+ * Frames matching a control filter are received on a separate hardware FIFO
+ * with a higher interrupt priority than bulk frames, and are dispatched first
+ * by 'CANInterface_Process'.
+ *
+ * @param id CAN-frame ID, with 'CANINTERFACE_EXTENDED_ID_FLAG' set for an extended ID.
+ * @param mask CAN-frame ID bit mask.
+ * @param priority Priority class of the matching frames.
  * @param listener_cb Callback.
  * @param arg_p Argument passed to the callback.
  */
-void CANInterface_RegisterListener(caninterface_listener_cb_t listener_cb, void *arg_p);
+void CANInterface_RegisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p);
 
 /**
- * Add an acceptance filter to the CAN interface.
+ * Remove an acceptance filter added by 'CANInterface_RegisterListener'.
  *
- * Up to 28 filters can be added.
+ * The arguments must be the same as when the filter was registered. A filter
+ * that was merged with, or replaced by, a wider filter of the same listener
+ * is not removed, the listener may still be called with matching frames.
  *
- * @param id CAN-frame ID.
+ * @param id CAN-frame ID, with 'CANINTERFACE_EXTENDED_ID_FLAG' set for an extended ID.
  * @param mask CAN-frame ID bit mask.
+ * @param priority Priority class of the matching frames.
+ * @param listener_cb Callback.
+ * @param arg_p Argument passed to the callback.
  */
-void CANInterface_AddFilter(uint16_t id, uint16_t mask);
+void CANInterface_UnregisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p);
 
 #endif
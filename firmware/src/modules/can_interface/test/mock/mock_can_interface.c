@@ -54,9 +54,22 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
 
-__attribute__((weak)) void CANInterface_Init(void)
+__attribute__((weak)) void CANInterface_Init(uint32_t bit_rate)
 {
     function_called();
+    check_expected_uint(bit_rate);
+}
+
+__attribute__((weak)) uint32_t CANInterface_GetBitRate(void)
+{
+    return mock_type(uint32_t);
+}
+
+__attribute__((weak)) bool CANInterface_CalculateBitTiming(uint32_t bit_rate, struct caninterface_bit_timing_t *timing_p)
+{
+    assert_non_null(timing_p);
+    *timing_p = (__typeof__(*timing_p)) {0};
+    return mock_type(bool);
 }
 
 __attribute__((weak)) bool CANInterface_Transmit(uint32_t id, void *data_p, size_t size)
@@ -65,16 +78,59 @@ __attribute__((weak)) bool CANInterface_Transmit(uint32_t id, void *data_p, size
     mock_type(bool);
 }
 
-__attribute__((weak)) void CANInterface_RegisterListener(caninterface_listener_cb_t listener_cb, void *arg_p)
+__attribute__((weak)) size_t CANInterface_GetTransmitQueueSpace(void)
+{
+    return mock_type(size_t);
+}
+
+__attribute__((weak)) bool CANInterface_TransmitPaced(uint32_t id, void *data_p, size_t size, uint32_t separation_time_us)
+{
+    assert_non_null(data_p);
+    return mock_type(bool);
+}
+
+__attribute__((weak)) size_t CANInterface_GetPacedTransmitQueueSpace(void)
+{
+    return mock_type(size_t);
+}
+
+__attribute__((weak)) bool CANInterface_IsPacedTransmitPending(uint32_t id)
+{
+    return mock_type(bool);
+}
+
+__attribute__((weak)) void CANInterface_GetStatistics(struct caninterface_statistics_t *statistics_p)
+{
+    assert_non_null(statistics_p);
+    *statistics_p = *mock_ptr_type(struct caninterface_statistics_t *);
+}
+
+__attribute__((weak)) void CANInterface_ClearPeakStatistics(void)
+{
+    function_called();
+}
+
+__attribute__((weak)) void CANInterface_Process(void)
 {
     function_called();
+}
+
+__attribute__((weak)) void CANInterface_RegisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
+{
+    function_called();
+    check_expected_uint(id);
+    check_expected_uint(mask);
+    check_expected_uint(priority);
     assert_non_null(listener_cb);
 }
 
-__attribute__((weak)) void CANInterface_AddFilter(uint16_t id, uint16_t mask)
+__attribute__((weak)) void CANInterface_UnregisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
 {
+    function_called();
     check_expected_uint(id);
     check_expected_uint(mask);
+    check_expected_uint(priority);
+    assert_non_null(listener_cb);
 }
 
 //////////////////////////////////////////////////////////////////////////
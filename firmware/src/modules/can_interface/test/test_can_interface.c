@@ -32,8 +32,12 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include <cmocka.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include <libopencm3/stm32/can.h>
+#include <libopencm3/stm32/timer.h>
+#include "utility.h"
+#include "systime.h"
 #include "can_interface.h"
 
 //////////////////////////////////////////////////////////////////////////
@@ -41,6 +45,12 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////
 
 extern void usb_lp_can_rx0_isr(void);
+extern void usb_hp_can_tx_isr(void);
+extern void can_rx1_isr(void);
+extern void tim1_up_isr(void);
+extern void can_sce_isr(void);
+
+#define CAN_IRQS (CAN_IER_FMPIE0 | CAN_IER_FMPIE1 | CAN_IER_TMEIE | CAN_IER_EPVIE | CAN_IER_BOFIE | CAN_IER_ERRIE)
 
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
@@ -56,19 +66,41 @@ static struct logging_logger_t *dummy_logger;
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
 
-static int Setup(void **state)
+static void ExpectCANInit(uint32_t sjw, uint32_t ts1, uint32_t ts2, uint32_t brp, int result)
 {
-    will_return(Logging_GetLogger, dummy_logger);
-    will_return(can_init, 0);
+    will_return(can_init, result);
     expect_uint_value(can_init, canport, CAN1);
+    expect_uint_value(can_init, sjw, (sjw - 1) << CAN_BTR_SJW_SHIFT);
+    expect_uint_value(can_init, ts1, (ts1 - 1) << CAN_BTR_TS1_SHIFT);
+    expect_uint_value(can_init, ts2, (ts2 - 1) << CAN_BTR_TS2_SHIFT);
+    expect_uint_value(can_init, brp, brp);
     expect_uint_value(can_reset, canport, CAN1);
+}
+
+static void InitCANInterface(void)
+{
+    memset(&mock_can_registers, 0, sizeof(mock_can_registers));
+
+    will_return(Logging_GetLogger, dummy_logger);
+    ExpectCANInit(1, 6, 1, 9, 0);
     expect_uint_value(can_enable_irq, canport, CAN1);
-    expect_uint_value(can_enable_irq, irq, CAN_IER_FMPIE0);
-    CANInterface_Init();
+    expect_uint_value(can_enable_irq, irq, CAN_IRQS);
+    CANInterface_Init(CANINTERFACE_DEFAULT_BIT_RATE);
+}
 
+static int Setup(void **state)
+{
+    InitCANInterface();
     return 0;
 }
 
+/* Values queued by the setup function are dropped before the test runs. */
+static void IgnoreSystemTime(void)
+{
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetSystemTimeUs, 0);
+}
+
 static void Listener(const struct can_frame_t *frame_p, void *arg_p)
 {
     check_expected_uint(frame_p->id);
@@ -81,33 +113,70 @@ static void Listener(const struct can_frame_t *frame_p, void *arg_p)
     }
 }
 
-static void ReceiveCANFrame(const struct can_frame_t *frame_p)
+static void OtherListener(const struct can_frame_t *frame_p, void *arg_p)
+{
+    check_expected_uint(frame_p->id);
+}
+
+static void TimestampListener(const struct can_frame_t *frame_p, void *arg_p)
 {
+    check_expected_uint(frame_p->timestamp);
+}
+
+static void ExpectReceive(const struct can_frame_t *frame_p, uint8_t fmi)
+{
+    const bool extended = CANInterface_IsExtendedID(frame_p->id);
+
     expect_uint_value(can_receive, canport, CAN1);
-    will_return(can_receive, frame_p->id);
+    will_return(can_receive, frame_p->id & CANINTERFACE_EXTENDED_ID_MASK);
+    will_return(can_receive, extended);
     will_return(can_receive, frame_p->size);
     will_return(can_receive, frame_p->data);
-    usb_lp_can_rx0_isr();
+    will_return(can_receive, fmi);
 }
 
-static uint16_t ShiftedIDMask(uint16_t id_mask)
+static void ReceiveCANFrame(const struct can_frame_t *frame_p, uint8_t fmi)
 {
-    uint16_t result = id_mask;
+    ExpectReceive(frame_p, fmi);
+    usb_lp_can_rx0_isr();
+}
 
-    if (id_mask != 0xFFFF)
+static void ReceiveCANFrames(const struct can_frame_t *frames_p, size_t number_of_frames, uint8_t fmi)
+{
+    for (size_t i = 0; i < number_of_frames; ++i)
     {
-        result = id_mask << 5;
+        ReceiveCANFrame(&frames_p[i], fmi);
     }
-    return result;
 }
 
-static void ExpectCANFilterInit(uint32_t filter_id, uint16_t id1, uint16_t mask1, uint16_t id2, uint16_t mask2)
+static void ExpectListenerCall(const struct can_frame_t *frame_p)
+{
+    expect_uint_value(Listener, frame_p->id, frame_p->id);
+    expect_uint_value(Listener, frame_p->size, frame_p->size);
+    expect_memory(Listener, frame_p->data, frame_p->data, frame_p->size);
+}
+
+static void RegisterListener(uint16_t id, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb)
+{
+    const uint16_t mask = 0x7FF;
+
+    CANInterface_RegisterListener(id, mask, priority, listener_cb, NULL);
+}
+
+static void ExpectTransmit(uint32_t id, uint8_t *data_p, size_t size, int result)
+{
+    expect_uint_value(can_transmit, canport, CAN1);
+    expect_uint_value(can_transmit, id, id & CANINTERFACE_EXTENDED_ID_MASK);
+    expect_uint_value(can_transmit, ext, CANInterface_IsExtendedID(id));
+    expect_uint_value(can_transmit, length, size);
+    expect_memory(can_transmit, data, data_p, size);
+    will_return(can_transmit, result);
+}
+
+static void CompleteTransmission(uint32_t request_completed_flags)
 {
-    expect_uint_value(can_filter_id_mask_16bit_init, nr, filter_id);
-    expect_uint_value(can_filter_id_mask_16bit_init, id1, ShiftedIDMask(id1));
-    expect_uint_value(can_filter_id_mask_16bit_init, mask1, ShiftedIDMask(mask1));
-    expect_uint_value(can_filter_id_mask_16bit_init, id2, ShiftedIDMask(id2));
-    expect_uint_value(can_filter_id_mask_16bit_init, mask2, ShiftedIDMask(mask2));
+    mock_can_registers.tsr = request_completed_flags;
+    usb_hp_can_tx_isr();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -117,55 +186,171 @@ static void ExpectCANFilterInit(uint32_t filter_id, uint16_t id1, uint16_t mask1
 static void test_CANInterface_Init_Error(void **state)
 {
     will_return(Logging_GetLogger, dummy_logger);
-    will_return(can_init, 1);
-    expect_uint_value(can_init, canport, CAN1);
-    expect_uint_value(can_reset, canport, CAN1);
-    expect_assert_failure(CANInterface_Init())
+    ExpectCANInit(1, 6, 1, 9, 1);
+    expect_assert_failure(CANInterface_Init(CANINTERFACE_DEFAULT_BIT_RATE))
 }
 
 static void test_CANInterface_Init(void **state)
 {
     will_return(Logging_GetLogger, dummy_logger);
-    will_return(can_init, 0);
-    expect_uint_value(can_init, canport, CAN1);
-    expect_uint_value(can_reset, canport, CAN1);
+    ExpectCANInit(3, 14, 3, 2, 0);
     expect_uint_value(can_enable_irq, canport, CAN1);
-    expect_uint_value(can_enable_irq, irq, CAN_IER_FMPIE0);
-    CANInterface_Init();
+    expect_uint_value(can_enable_irq, irq, CAN_IRQS);
+    CANInterface_Init(1000000);
+
+    assert_int_equal(CANInterface_GetBitRate(), 1000000);
+}
+
+static void test_CANInterface_Init_DefaultBitRate(void **state)
+{
+    const uint32_t bit_rates[] = {0, 333333, 2000000};
+
+    for (size_t i = 0; i < ElementsIn(bit_rates); ++i)
+    {
+        will_return(Logging_GetLogger, dummy_logger);
+        ExpectCANInit(1, 6, 1, 9, 0);
+        expect_uint_value(can_enable_irq, canport, CAN1);
+        expect_uint_value(can_enable_irq, irq, CAN_IRQS);
+        CANInterface_Init(bit_rates[i]);
+
+        assert_int_equal(CANInterface_GetBitRate(), CANINTERFACE_DEFAULT_BIT_RATE);
+    }
+}
+
+static void test_CANInterface_CalculateBitTiming(void **state)
+{
+    const struct
+    {
+        uint32_t bit_rate;
+        struct caninterface_bit_timing_t timing;
+    } expected[] =
+    {
+        {1000000, {.prescaler = 2, .time_segment1 = 14, .time_segment2 = 3, .sync_jump_width = 3, .sample_point = 833}},
+        {500000, {.prescaler = 9, .time_segment1 = 6, .time_segment2 = 1, .sync_jump_width = 1, .sample_point = 875}},
+        {250000, {.prescaler = 9, .time_segment1 = 13, .time_segment2 = 2, .sync_jump_width = 2, .sample_point = 875}},
+        {125000, {.prescaler = 18, .time_segment1 = 13, .time_segment2 = 2, .sync_jump_width = 2, .sample_point = 875}}
+    };
+
+    for (size_t i = 0; i < ElementsIn(expected); ++i)
+    {
+        struct caninterface_bit_timing_t timing;
+        assert_true(CANInterface_CalculateBitTiming(expected[i].bit_rate, &timing));
+        assert_int_equal(timing.prescaler, expected[i].timing.prescaler);
+        assert_int_equal(timing.time_segment1, expected[i].timing.time_segment1);
+        assert_int_equal(timing.time_segment2, expected[i].timing.time_segment2);
+        assert_int_equal(timing.sync_jump_width, expected[i].timing.sync_jump_width);
+        assert_int_equal(timing.sample_point, expected[i].timing.sample_point);
+    }
+}
+
+static void test_CANInterface_CalculateBitTiming_Invalid(void **state)
+{
+    struct caninterface_bit_timing_t timing;
+
+    expect_assert_failure(CANInterface_CalculateBitTiming(500000, NULL));
+    assert_false(CANInterface_CalculateBitTiming(0, &timing));
+    assert_false(CANInterface_CalculateBitTiming(333333, &timing));
+    assert_false(CANInterface_CalculateBitTiming(2000000, &timing));
 }
 
 static void test_CANInterface_RegisterListener_Invalid(void **state)
 {
-    expect_assert_failure(CANInterface_RegisterListener(NULL, NULL))
+    expect_assert_failure(CANInterface_RegisterListener(0x1, 0x7FF, CANINTERFACE_PRIORITY_CONTROL, NULL, NULL))
 }
 
 static void test_CANInterface_RegisterListener_Full(void **state)
 {
-    const size_t max_number_of_listeners = 5;
-    for (size_t i = 0; i < max_number_of_listeners; ++i)
+    /* Exact IDs are packed four to a bank. */
+    const size_t max_number_of_ids = 56;
+    for (size_t i = 0; i < max_number_of_ids; ++i)
+    {
+        RegisterListener(i, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    }
+
+    expect_assert_failure(CANInterface_RegisterListener(0x100, 0x7FF, CANINTERFACE_PRIORITY_CONTROL, Listener, NULL));
+}
+
+static void test_CANInterface_RegisterListener_BanksFull(void **state)
+{
+    /* ID/mask filters for different listeners are not merged, two fit in a bank. */
+    const size_t max_number_of_masks = 28;
+    for (uintptr_t i = 0; i < max_number_of_masks; ++i)
     {
-        CANInterface_RegisterListener(Listener, NULL);
+        CANInterface_RegisterListener(i << 4, 0x7F0, CANINTERFACE_PRIORITY_CONTROL, Listener, (void *)(i + 1));
     }
 
-    expect_assert_failure(CANInterface_RegisterListener(Listener, NULL));
+    expect_assert_failure(CANInterface_RegisterListener(0x700, 0x7F0, CANINTERFACE_PRIORITY_CONTROL, Listener, NULL));
 }
 
 static void test_CANInterface_ReceiveWithNoListeners(void **state)
 {
     struct can_frame_t frame = {.id = 0x1, .size = 2, .data = {0x3, 0x4}};
-    ReceiveCANFrame(&frame);
+
+    IgnoreSystemTime();
+    ReceiveCANFrame(&frame, 0);
+    CANInterface_Process();
 }
 
 static void test_CANInterface_ReceiveWithListener(void **state)
 {
     const struct can_frame_t frame = {.id = 0x1, .size = 2, .data = {0x3, 0x4}};
 
-    expect_uint_value(Listener, frame_p->id, frame.id);
-    expect_uint_value(Listener, frame_p->size,frame.size);
-    expect_memory(Listener, frame_p->data, frame.data, frame.size);
+    IgnoreSystemTime();
+    RegisterListener(frame.id, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    ReceiveCANFrame(&frame, 0);
+
+    ExpectListenerCall(&frame);
+    CANInterface_Process();
+
+    /* Nothing more to dispatch. */
+    CANInterface_Process();
+}
+
+static void test_CANInterface_ReceiveBatch(void **state)
+{
+    const struct can_frame_t frames[] =
+    {
+        {.id = 0x1, .size = 1, .data = {0x1}},
+        {.id = 0x2, .size = 2, .data = {0x2, 0x3}},
+        {.id = 0x3, .size = 8, .data = {0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xA, 0xB}}
+    };
 
-    CANInterface_RegisterListener(Listener, NULL);
-    ReceiveCANFrame(&frame);
+    IgnoreSystemTime();
+    RegisterListener(0x0, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    ReceiveCANFrames(frames, ElementsIn(frames), 0);
+
+    for (size_t i = 0; i < ElementsIn(frames); ++i)
+    {
+        ExpectListenerCall(&frames[i]);
+    }
+    CANInterface_Process();
+}
+
+static void test_CANInterface_ReceiveRingFull(void **state)
+{
+    const size_t ring_size = 16;
+    struct can_frame_t frames[ring_size + 1];
+
+    IgnoreSystemTime();
+    for (size_t i = 0; i < ElementsIn(frames); ++i)
+    {
+        frames[i] = (struct can_frame_t) {.id = i, .size = 1, .data = {(uint8_t)i}};
+    }
+
+    RegisterListener(0x0, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    ReceiveCANFrames(frames, ElementsIn(frames), 0);
+
+    /* The last frame is dropped since the ring is full. */
+    for (size_t i = 0; i < ring_size; ++i)
+    {
+        ExpectListenerCall(&frames[i]);
+    }
+    CANInterface_Process();
+
+    /* The ring is usable again after it has been processed. */
+    ReceiveCANFrame(&frames[ring_size], 0);
+    ExpectListenerCall(&frames[ring_size]);
+    CANInterface_Process();
 }
 
 static void test_CANInterface_Transmit_Invalid(void **state)
@@ -182,36 +367,69 @@ static void test_CANInterface_Transmit_Error(void **state)
     const uint32_t id = 0x2;
     uint8_t data = 1;
 
-    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    IgnoreSystemTime();
+
+    /* The frame stays queued if the peripheral rejects it. */
     will_return_uint_maybe(can_available_mailbox, true);
-    expect_uint_value(can_transmit, canport, CAN1);
-    expect_uint_value(can_transmit, id, id);
-    expect_uint_value(can_transmit, length, sizeof(data));
-    expect_memory(can_transmit, data, &data, sizeof(data));
-    will_return(can_transmit, -1);
+    ExpectTransmit(id, &data, sizeof(data), -1);
+    assert_true(CANInterface_Transmit(id, &data, sizeof(data)));
 
-    assert_false(CANInterface_Transmit(id, &data, sizeof(data)));
+    ExpectTransmit(id, &data, sizeof(data), 0);
+    usb_hp_can_tx_isr();
+}
+
+static void test_CANInterface_Transmit_MailboxesBusy(void **state)
+{
+    const uint32_t id = 0x2;
+    uint8_t data1 = 1;
+    uint8_t data2 = 2;
+
+    IgnoreSystemTime();
+    will_return(can_available_mailbox, false);
+    assert_true(CANInterface_Transmit(id, &data1, sizeof(data1)));
+    will_return(can_available_mailbox, false);
+    assert_true(CANInterface_Transmit(id, &data2, sizeof(data2)));
+
+    struct caninterface_statistics_t statistics;
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.tx_queue_depth, 2);
+    assert_uint_equal(statistics.tx_queue_max_depth, 2);
+
+    /* Queued frames are sent in order when the mailboxes are emptied. */
+    will_return_count(can_available_mailbox, true, 2);
+    ExpectTransmit(id, &data1, sizeof(data1), 0);
+    ExpectTransmit(id, &data2, sizeof(data2), 1);
+    usb_hp_can_tx_isr();
+
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.tx_queue_depth, 0);
+    assert_uint_equal(statistics.tx_queue_max_depth, 2);
+
+    /* Nothing left to send. */
+    usb_hp_can_tx_isr();
 }
 
-static void test_CANInterface_Transmit_Timeout(void **state)
+static void test_CANInterface_Transmit_QueueFull(void **state)
 {
     const uint32_t id = 0x2;
     uint8_t data = 1;
-    const uint32_t timeout_ms = 2;
+    const size_t queue_size = 16;
 
-    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    IgnoreSystemTime();
     will_return_uint_maybe(can_available_mailbox, false);
-    for (uint32_t i = 0; i <= timeout_ms; ++i)
+    for (size_t i = 0; i < queue_size; ++i)
     {
-        will_return(SysTime_GetDifference, i);
+        assert_uint_equal(CANInterface_GetTransmitQueueSpace(), queue_size - i);
+        assert_true(CANInterface_Transmit(id, &data, sizeof(data)));
     }
-    expect_uint_value(can_transmit, canport, CAN1);
-    expect_uint_value(can_transmit, id, id);
-    expect_uint_value(can_transmit, length, sizeof(data));
-    expect_memory(can_transmit, data, &data, sizeof(data));
-    will_return(can_transmit, -1);
-
+    assert_uint_equal(CANInterface_GetTransmitQueueSpace(), 0);
     assert_false(CANInterface_Transmit(id, &data, sizeof(data)));
+
+    struct caninterface_statistics_t statistics;
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.tx_queue_depth, queue_size);
+    assert_uint_equal(statistics.tx_queue_max_depth, queue_size);
+    assert_uint_equal(statistics.tx_dropped_frames, 1);
 }
 
 static void test_CANInterface_Transmit(void **state)
@@ -220,57 +438,682 @@ static void test_CANInterface_Transmit(void **state)
     uint8_t data[] = {0, 1, 2, 3, 4, 5, 6, 7};
     int mailbox_number = 0;
 
-    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    IgnoreSystemTime();
     will_return_uint_maybe(can_available_mailbox, true);
-    expect_uint_value(can_transmit, canport, CAN1);
-    expect_uint_value(can_transmit, id, id);
-    expect_uint_value(can_transmit, length, sizeof(data));
-    expect_memory(can_transmit, data, &data, sizeof(data));
-    will_return(can_transmit, mailbox_number);
+    ExpectTransmit(id, data, sizeof(data), mailbox_number);
+
+    assert_true(CANInterface_Transmit(id, &data, sizeof(data)));
+}
+
+static void test_CANInterface_RegisterListener_ListMode(void **state)
+{
+    const struct can_frame_t frame1 = {.id = 0x1, .size = 1, .data = {0x1}};
+    const struct can_frame_t frame4 = {.id = 0x4, .size = 1, .data = {0x4}};
+    const struct can_frame_t frame5 = {.id = 0x5, .size = 1, .data = {0x5}};
+
+    IgnoreSystemTime();
+
+    /**
+     * Exact IDs use list mode:
+     *   bank 0: fmi 0-3 = 0x1, 0x2, 0x3, 0x4
+     *   bank 1: fmi 4 = 0x5, fmi 5-7 unused and repeat 0x5
+     */
+    RegisterListener(0x1, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+    RegisterListener(0x2, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+    RegisterListener(0x3, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+    RegisterListener(0x4, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    RegisterListener(0x5, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+
+    ReceiveCANFrame(&frame1, 0);
+    ReceiveCANFrame(&frame4, 3);
+    ReceiveCANFrame(&frame5, 4);
+    ReceiveCANFrame(&frame5, 7);
+    ReceiveCANFrame(&frame5, 8);
+
+    expect_uint_value(OtherListener, frame_p->id, frame1.id);
+    ExpectListenerCall(&frame4);
+    expect_uint_value_count(OtherListener, frame_p->id, frame5.id, 2);
+    CANInterface_Process();
+}
+
+static void test_CANInterface_RegisterListener_MaskMode(void **state)
+{
+    const struct can_frame_t frame1 = {.id = 0x1, .size = 1, .data = {0x1}};
+    const struct can_frame_t frame2 = {.id = 0x2, .size = 1, .data = {0x2}};
+    const struct can_frame_t frame3 = {.id = 0x123, .size = 1, .data = {0x3}};
+
+    IgnoreSystemTime();
+
+    /**
+     * A single exact ID shares the mask bank:
+     *   bank 0 (mask): fmi 0 = 0x120/0x7F0, fmi 1 = 0x1
+     */
+    CANInterface_RegisterListener(0x120, 0x7F0, CANINTERFACE_PRIORITY_CONTROL, OtherListener, NULL);
+    RegisterListener(frame1.id, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    ReceiveCANFrame(&frame1, 1);
+    ReceiveCANFrame(&frame3, 0);
+
+    /**
+     * The exact IDs are moved to a list bank:
+     *   bank 0 (list): fmi 0-3 = 0x1, 0x2
+     *   bank 1 (mask): fmi 4-5 = 0x120/0x7F0
+     */
+    RegisterListener(frame2.id, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    ReceiveCANFrame(&frame2, 1);
+    ReceiveCANFrame(&frame3, 4);
+
+    /* Frames received before the banks were reprogrammed keep their listener. */
+    ExpectListenerCall(&frame1);
+    expect_uint_value(OtherListener, frame_p->id, frame3.id);
+    ExpectListenerCall(&frame2);
+    expect_uint_value(OtherListener, frame_p->id, frame3.id);
+    CANInterface_Process();
+}
+
+static void test_CANInterface_RegisterListener_MergeMasks(void **state)
+{
+    const struct can_frame_t frame1 = {.id = 0x115, .size = 1, .data = {0x1}};
+    const struct can_frame_t frame2 = {.id = 0x201, .size = 1, .data = {0x2}};
+
+    IgnoreSystemTime();
+
+    /**
+     * Filters for the same listener differing in one ID bit are merged:
+     *   bank 0 (mask): fmi 0 = 0x100/0x7E0, fmi 1 = 0x200/0x7F0
+     */
+    CANInterface_RegisterListener(0x100, 0x7F0, CANINTERFACE_PRIORITY_CONTROL, OtherListener, NULL);
+    CANInterface_RegisterListener(0x110, 0x7F0, CANINTERFACE_PRIORITY_CONTROL, OtherListener, NULL);
+    CANInterface_RegisterListener(0x200, 0x7F0, CANINTERFACE_PRIORITY_CONTROL, Listener, NULL);
+
+    /* Already covered by the merged filter. */
+    CANInterface_RegisterListener(0x115, 0x7FF, CANINTERFACE_PRIORITY_CONTROL, OtherListener, NULL);
+
+    ReceiveCANFrame(&frame1, 0);
+    ReceiveCANFrame(&frame2, 1);
+
+    expect_uint_value(OtherListener, frame_p->id, frame1.id);
+    ExpectListenerCall(&frame2);
+    CANInterface_Process();
+}
+
+static void test_CANInterface_RegisterListener_RemoveCoveredFilters(void **state)
+{
+    const struct can_frame_t frame = {.id = 0x102, .size = 1, .data = {0x1}};
+
+    IgnoreSystemTime();
+
+    /**
+     *   bank 0 (list): fmi 0-3 = 0x101, 0x102, 0x203
+     */
+    RegisterListener(0x101, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+    RegisterListener(0x102, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+    RegisterListener(0x203, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    assert_uint_equal(mock_can_registers.fm1r, 0x1);
+
+    /**
+     * The exact IDs of the same listener are covered by the new filter:
+     *   bank 0 (mask): fmi 0 = 0x203, fmi 1 = 0x100/0x7F0
+     */
+    CANInterface_RegisterListener(0x100, 0x7F0, CANINTERFACE_PRIORITY_CONTROL, OtherListener, NULL);
+    assert_uint_equal(mock_can_registers.fa1r, 0x1);
+    assert_uint_equal(mock_can_registers.fm1r, 0x0);
+
+    ReceiveCANFrame(&frame, 1);
+    expect_uint_value(OtherListener, frame_p->id, frame.id);
+    CANInterface_Process();
+}
+
+static void test_CANInterface_UnregisterListener(void **state)
+{
+    const struct can_frame_t frame = {.id = 0x2, .size = 1, .data = {0x2}};
+
+    IgnoreSystemTime();
+    RegisterListener(0x1, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+    RegisterListener(0x2, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+    CANInterface_RegisterListener(0x100, 0x700, CANINTERFACE_PRIORITY_BULK, Listener, NULL);
+
+    /**
+     *   bank 0 (list): fmi 0-3 = 0x2
+     *   bank 1 (mask, FIFO 1): fmi 0 = 0x100/0x700
+     */
+    CANInterface_UnregisterListener(0x1, 0x7FF, CANINTERFACE_PRIORITY_CONTROL, OtherListener, NULL);
+    assert_uint_equal(mock_can_registers.fa1r, 0x3);
+    assert_uint_equal(mock_can_registers.filter_banks[0].fr1, 0x00400040);
+    assert_uint_equal(mock_can_registers.filter_banks[0].fr2, 0x00400040);
+
+    /* Only a filter registered with the same arguments is removed. */
+    CANInterface_UnregisterListener(0x2, 0x7FF, CANINTERFACE_PRIORITY_CONTROL, Listener, NULL);
+    CANInterface_UnregisterListener(0x2, 0x7FF, CANINTERFACE_PRIORITY_BULK, OtherListener, NULL);
+    CANInterface_UnregisterListener(0x100, 0x7FF, CANINTERFACE_PRIORITY_BULK, Listener, NULL);
+    assert_uint_equal(mock_can_registers.fa1r, 0x3);
 
+    ReceiveCANFrame(&frame, 0);
+    expect_uint_value(OtherListener, frame_p->id, frame.id);
+    CANInterface_Process();
+
+    CANInterface_UnregisterListener(0x100, 0x700, CANINTERFACE_PRIORITY_BULK, Listener, NULL);
+    assert_uint_equal(mock_can_registers.fa1r, 0x1);
+
+    expect_assert_failure(CANInterface_UnregisterListener(0x2, 0x7FF, CANINTERFACE_PRIORITY_CONTROL, NULL, NULL));
+}
+
+static void test_CANInterface_ReceivePriority(void **state)
+{
+    const struct can_frame_t bulk_frame = {.id = 0x1, .size = 2, .data = {0x3, 0x4}};
+    const struct can_frame_t control_frame = {.id = 0x9, .size = 1, .data = {0x5}};
+
+    IgnoreSystemTime();
+    RegisterListener(control_frame.id, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    RegisterListener(bulk_frame.id, CANINTERFACE_PRIORITY_BULK, Listener);
+
+    ExpectReceive(&bulk_frame, 0);
+    can_rx1_isr();
+    ExpectReceive(&control_frame, 0);
+    usb_lp_can_rx0_isr();
+
+    /* Control frames are dispatched first, regardless of arrival order. */
+    ExpectListenerCall(&control_frame);
+    ExpectListenerCall(&bulk_frame);
+    CANInterface_Process();
+}
+
+static void test_CANInterface_ReceiveByFilterMatchIndex(void **state)
+{
+    const struct can_frame_t frame1 = {.id = 0x1, .size = 1, .data = {0x1}};
+    const struct can_frame_t frame2 = {.id = 0x2, .size = 1, .data = {0x2}};
+    const struct can_frame_t frame3 = {.id = 0x3, .size = 1, .data = {0x3}};
+
+    IgnoreSystemTime();
+
+    /**
+     * Filter match indices are numbered per FIFO:
+     *   bank 0 (FIFO 0): fmi 0 = frame1, fmi 1 = frame3, fmi 2-3 unused
+     *   bank 1 (FIFO 1): fmi 0 = frame2, fmi 1-3 unused
+     */
+    RegisterListener(frame1.id, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+    RegisterListener(frame2.id, CANINTERFACE_PRIORITY_BULK, Listener);
+    RegisterListener(frame3.id, CANINTERFACE_PRIORITY_CONTROL, Listener);
+
+    ExpectReceive(&frame3, 1);
+    usb_lp_can_rx0_isr();
+    ExpectReceive(&frame1, 0);
+    usb_lp_can_rx0_isr();
+    ExpectReceive(&frame2, 0);
+    can_rx1_isr();
+
+    /* Each frame is only passed to the listener of the matching filter. */
+    ExpectListenerCall(&frame3);
+    expect_uint_value(OtherListener, frame_p->id, frame1.id);
+    ExpectListenerCall(&frame2);
+    CANInterface_Process();
+
+    /* Frames with an unknown filter match index are discarded. */
+    ExpectReceive(&frame1, 5);
+    usb_lp_can_rx0_isr();
+    CANInterface_Process();
+}
+
+static void test_CANInterface_Statistics_Receive(void **state)
+{
+    const struct can_frame_t control_frame = {.id = 0x1, .size = 1, .data = {0x1}};
+    const struct can_frame_t bulk_frame = {.id = 0x2, .size = 1, .data = {0x2}};
+    struct caninterface_statistics_t statistics;
+
+    InitCANInterface();
+    will_return_uint_maybe(SysTime_GetSystemTimeUs, 0);
+    RegisterListener(control_frame.id, CANINTERFACE_PRIORITY_CONTROL, Listener);
+
+    ReceiveCANFrame(&control_frame, 0);
+    ExpectReceive(&bulk_frame, 0);
+    can_rx1_isr();
+
+    /* The bulk frame has no listener. */
+    ExpectListenerCall(&control_frame);
+    will_return_uint(SysTime_GetSystemTime, 500);
+    CANInterface_Process();
+
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.rx_frames, 2);
+    assert_uint_equal(statistics.rx_control_frames, 1);
+    assert_uint_equal(statistics.rx_bulk_frames, 1);
+    assert_uint_equal(statistics.rx_unhandled_frames, 1);
+    assert_uint_equal(statistics.rx_frames_per_second, 0);
+
+    /* The rate is sampled once per second and the peak is kept. */
+    will_return_uint(SysTime_GetSystemTime, 1000);
+    CANInterface_Process();
+    will_return_uint(SysTime_GetSystemTime, 2000);
+    CANInterface_Process();
+
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.rx_frames_per_second, 0);
+    assert_uint_equal(statistics.rx_max_frames_per_second, 2);
+
+    CANInterface_ClearPeakStatistics();
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.rx_frames, 2);
+    assert_uint_equal(statistics.rx_max_frames_per_second, 0);
+}
+
+static void test_CANInterface_Statistics_Transmit(void **state)
+{
+    const uint32_t id = 0x2;
+    uint8_t data = 1;
+    struct caninterface_statistics_t statistics;
+
+    InitCANInterface();
+
+    will_return_uint_count(SysTime_GetSystemTimeUs, 100, 2);
+    will_return(can_available_mailbox, false);
     assert_true(CANInterface_Transmit(id, &data, sizeof(data)));
+
+    /* The wait time is measured from queueing until handed to a mailbox. */
+    will_return_uint(SysTime_GetSystemTimeUs, 350);
+    will_return(can_available_mailbox, true);
+    ExpectTransmit(id, &data, sizeof(data), 0);
+    usb_hp_can_tx_isr();
+
+    will_return_uint(SysTime_GetSystemTime, 1000);
+    CANInterface_Process();
+
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.tx_frames, 1);
+    assert_uint_equal(statistics.tx_frames_per_second, 1);
+    assert_uint_equal(statistics.tx_max_frames_per_second, 1);
+    assert_uint_equal(statistics.tx_queue_max_depth, 1);
+    assert_uint_equal(statistics.tx_max_wait_time_us, 250);
+
+    CANInterface_ClearPeakStatistics();
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.tx_frames, 1);
+    assert_uint_equal(statistics.tx_max_frames_per_second, 0);
+    assert_uint_equal(statistics.tx_queue_max_depth, 0);
+    assert_uint_equal(statistics.tx_max_wait_time_us, 0);
+}
+
+static void test_CANInterface_RegisterListener_ExtendedBanksFull(void **state)
+{
+    /* Exact extended IDs are packed two to a bank. */
+    const size_t max_number_of_ids = 28;
+    for (size_t i = 0; i < max_number_of_ids; ++i)
+    {
+        CANInterface_RegisterListener(CANInterface_ExtendedID(0x18FF0000 + i), CANINTERFACE_EXTENDED_ID_MASK,
+                                      CANINTERFACE_PRIORITY_BULK, Listener, NULL);
+    }
+
+    expect_assert_failure(CANInterface_RegisterListener(CANInterface_ExtendedID(0x18FE0000), CANINTERFACE_EXTENDED_ID_MASK,
+                                                        CANINTERFACE_PRIORITY_BULK, Listener, NULL));
+}
+
+static void test_CANInterface_ReceiveExtendedID(void **state)
+{
+    const struct can_frame_t standard_frame = {.id = 0x123, .size = 1, .data = {0x1}};
+    const struct can_frame_t extended_frame = {.id = CANInterface_ExtendedID(0x123), .size = 1, .data = {0x2}};
+    const struct can_frame_t masked_frame = {.id = CANInterface_ExtendedID(0x18FEF1AB), .size = 1, .data = {0x3}};
+
+    IgnoreSystemTime();
+
+    /**
+     * Standard and extended filters never share a bank:
+     *   bank 0 (16-bit list): fmi 0-3 = 0x123
+     *   bank 1 (32-bit list): fmi 4-5 = 0x123 (extended)
+     *   bank 2 (32-bit mask): fmi 6 = 0x18FEF100/0x1FFFFF00
+     */
+    RegisterListener(standard_frame.id, CANINTERFACE_PRIORITY_CONTROL, OtherListener);
+    CANInterface_RegisterListener(extended_frame.id, CANINTERFACE_EXTENDED_ID_MASK, CANINTERFACE_PRIORITY_CONTROL, Listener, NULL);
+    CANInterface_RegisterListener(CANInterface_ExtendedID(0x18FEF100), 0x1FFFFF00, CANINTERFACE_PRIORITY_CONTROL, Listener, NULL);
+
+    ReceiveCANFrame(&standard_frame, 0);
+    ReceiveCANFrame(&extended_frame, 4);
+    ReceiveCANFrame(&masked_frame, 6);
+
+    /* Extended IDs are passed on with the extended flag set. */
+    expect_uint_value(OtherListener, frame_p->id, standard_frame.id);
+    ExpectListenerCall(&extended_frame);
+    ExpectListenerCall(&masked_frame);
+    CANInterface_Process();
+}
+
+static void test_CANInterface_TransmitExtendedID(void **state)
+{
+    const uint32_t id = CANInterface_ExtendedID(0x18FF1234);
+    uint8_t data[] = {0, 1, 2};
+
+    IgnoreSystemTime();
+    will_return_uint_maybe(can_available_mailbox, true);
+    ExpectTransmit(id, data, sizeof(data), 0);
+
+    assert_true(CANInterface_Transmit(id, &data, sizeof(data)));
+}
+
+static void test_CANInterface_TransmitPaced_Invalid(void **state)
+{
+    const uint32_t id = 0x1;
+    uint8_t data;
+    expect_assert_failure(CANInterface_TransmitPaced(id, NULL, 1, 0));
+    expect_assert_failure(CANInterface_TransmitPaced(id, &data, 9, 0));
+}
+
+static void test_CANInterface_TransmitPaced(void **state)
+{
+    const uint32_t id = 0x4;
+    const uint32_t separation_time_us = 500;
+    uint8_t data1 = 1;
+    uint8_t data2 = 2;
+
+    will_return_uint_maybe(can_available_mailbox, true);
+    assert_false(CANInterface_IsPacedTransmitPending(id));
+
+    /* The first frame is sent right away, the next is held back while it's transmitted. */
+    ExpectTransmit(id, &data1, sizeof(data1), 0);
+    assert_true(CANInterface_TransmitPaced(id, &data1, sizeof(data1), separation_time_us));
+    assert_true(CANInterface_TransmitPaced(id, &data2, sizeof(data2), separation_time_us));
+    assert_true(CANInterface_IsPacedTransmitPending(id));
+
+    /* The separation time starts when the transmission has completed. */
+    expect_uint_value(timer_set_period, timer_peripheral, TIM1);
+    expect_uint_value(timer_set_period, period, separation_time_us - 1);
+    expect_uint_value(timer_enable_counter, timer_peripheral, TIM1);
+    CompleteTransmission(CAN_TSR_RQCP0);
+    assert_uint_equal(mock_can_registers.tsr, CAN_TSR_RQCP0);
+
+    ExpectTransmit(id, &data2, sizeof(data2), 1);
+    tim1_up_isr();
+
+    expect_uint_value(timer_set_period, timer_peripheral, TIM1);
+    expect_uint_value(timer_set_period, period, separation_time_us - 1);
+    expect_uint_value(timer_enable_counter, timer_peripheral, TIM1);
+    CompleteTransmission(CAN_TSR_RQCP1);
+    assert_true(CANInterface_IsPacedTransmitPending(id));
+
+    tim1_up_isr();
+    assert_false(CANInterface_IsPacedTransmitPending(id));
+
+    struct caninterface_statistics_t statistics;
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.tx_frames, 2);
 }
 
-static void test_CANInterface_AddFilter(void **state)
+static void test_CANInterface_TransmitPaced_LongSeparationTime(void **state)
 {
-    const uint16_t default_id_mask = 0xFFFF;
+    const uint32_t id = 0x4;
+    const uint32_t separation_time_us = 100000;
+    const uint32_t max_period_us = 65535;
+    uint8_t data1 = 1;
+    uint8_t data2 = 2;
+
+    will_return_uint_maybe(can_available_mailbox, true);
+    ExpectTransmit(id, &data1, sizeof(data1), 0);
+    assert_true(CANInterface_TransmitPaced(id, &data1, sizeof(data1), separation_time_us));
+    assert_true(CANInterface_TransmitPaced(id, &data2, sizeof(data2), 0));
 
-    const uint16_t id1 = 0xA0;
-    const uint16_t mask1 = 0xF0;
-    const uint16_t id2 = 0xB0;
-    const uint16_t mask2 = 0x0F;
-    uint32_t filter_id = 0;
+    /* Separation times longer than the timer range are split into several periods. */
+    expect_uint_value(timer_set_period, timer_peripheral, TIM1);
+    expect_uint_value(timer_set_period, period, max_period_us - 1);
+    expect_uint_value(timer_enable_counter, timer_peripheral, TIM1);
+    CompleteTransmission(CAN_TSR_RQCP0);
 
-    /* First filter on filter bank 0 */
-    ExpectCANFilterInit(filter_id, id1, mask1, default_id_mask, default_id_mask);
-    CANInterface_AddFilter(id1, mask1);
+    expect_uint_value(timer_set_period, timer_peripheral, TIM1);
+    expect_uint_value(timer_set_period, period, separation_time_us - max_period_us - 1);
+    expect_uint_value(timer_enable_counter, timer_peripheral, TIM1);
+    tim1_up_isr();
 
-    /* Second filter on filter bank 0 */
-    ExpectCANFilterInit(filter_id, id1, mask1, id2, mask2);
-    CANInterface_AddFilter(id2, mask2);
+    ExpectTransmit(id, &data2, sizeof(data2), 0);
+    tim1_up_isr();
 
-    /* First filter on filter bank 1 */
-    filter_id = 1;
-    ExpectCANFilterInit(filter_id, id1, mask1, default_id_mask, default_id_mask);
-    CANInterface_AddFilter(id1, mask1);
+    /* Without a separation time the next frame could be sent at once. */
+    CompleteTransmission(CAN_TSR_RQCP0);
+    assert_false(CANInterface_IsPacedTransmitPending(id));
+}
 
-    /* Second filter on filter bank 1 */
-    ExpectCANFilterInit(filter_id, id1, mask1, id2, mask2);
-    CANInterface_AddFilter(id2, mask2);
+static void test_CANInterface_TransmitPaced_ShortPeriods(void **state)
+{
+    const uint32_t id = 0x4;
+    uint8_t data = 1;
+
+    will_return_uint_maybe(can_available_mailbox, true);
+
+    /* The timer period is never shorter than two microseconds. */
+    ExpectTransmit(id, &data, sizeof(data), 0);
+    assert_true(CANInterface_TransmitPaced(id, &data, sizeof(data), 1));
+    expect_uint_value(timer_set_period, timer_peripheral, TIM1);
+    expect_uint_value(timer_set_period, period, 1);
+    expect_uint_value(timer_enable_counter, timer_peripheral, TIM1);
+    CompleteTransmission(CAN_TSR_RQCP0);
+    tim1_up_isr();
+
+    /* A separation time just above the timer range isn't split into a one microsecond period. */
+    ExpectTransmit(id, &data, sizeof(data), 0);
+    assert_true(CANInterface_TransmitPaced(id, &data, sizeof(data), 65536));
+    expect_uint_value(timer_set_period, timer_peripheral, TIM1);
+    expect_uint_value(timer_set_period, period, 65533);
+    expect_uint_value(timer_enable_counter, timer_peripheral, TIM1);
+    CompleteTransmission(CAN_TSR_RQCP0);
+
+    expect_uint_value(timer_set_period, timer_peripheral, TIM1);
+    expect_uint_value(timer_set_period, period, 1);
+    expect_uint_value(timer_enable_counter, timer_peripheral, TIM1);
+    tim1_up_isr();
+
+    tim1_up_isr();
+    assert_false(CANInterface_IsPacedTransmitPending(id));
+}
+
+static void test_CANInterface_TransmitPaced_PendingPerID(void **state)
+{
+    const uint32_t id1 = 0x4;
+    const uint32_t id2 = 0x6;
+    const uint32_t separation_time_us = 100;
+    uint8_t data1 = 1;
+    uint8_t data2 = 2;
+
+    will_return_uint_maybe(can_available_mailbox, true);
+    ExpectTransmit(id1, &data1, sizeof(data1), 0);
+    assert_true(CANInterface_TransmitPaced(id1, &data1, sizeof(data1), separation_time_us));
+    assert_true(CANInterface_TransmitPaced(id2, &data2, sizeof(data2), 0));
 
-    /* Use all remaining filter banks and expect assert when no more banks are available. */
-    const size_t max_number_of_filters = 28;
-    const size_t number_of_used_filters = 4;
-    for (size_t i = 0; i < (max_number_of_filters - number_of_used_filters); ++i)
+    /* Pending frames are tracked per ID, whether transmitted or queued. */
+    assert_true(CANInterface_IsPacedTransmitPending(id1));
+    assert_true(CANInterface_IsPacedTransmitPending(id2));
+    assert_false(CANInterface_IsPacedTransmitPending(0x5));
+
+    /* The separation time belongs to the frame it follows. */
+    expect_uint_value(timer_set_period, timer_peripheral, TIM1);
+    expect_uint_value(timer_set_period, period, separation_time_us - 1);
+    expect_uint_value(timer_enable_counter, timer_peripheral, TIM1);
+    CompleteTransmission(CAN_TSR_RQCP0);
+    assert_true(CANInterface_IsPacedTransmitPending(id1));
+
+    ExpectTransmit(id2, &data2, sizeof(data2), 1);
+    tim1_up_isr();
+    assert_false(CANInterface_IsPacedTransmitPending(id1));
+    assert_true(CANInterface_IsPacedTransmitPending(id2));
+
+    CompleteTransmission(CAN_TSR_RQCP1);
+    assert_false(CANInterface_IsPacedTransmitPending(id2));
+}
+
+static void test_CANInterface_TransmitPaced_SharedMailboxes(void **state)
+{
+    const uint32_t paced_id = 0x4;
+    const uint32_t id = 0x5;
+    uint8_t data1 = 1;
+    uint8_t data2 = 2;
+
+    IgnoreSystemTime();
+
+    /* A paced frame waits for a free mailbox and is sent before queued frames. */
+    will_return(can_available_mailbox, false);
+    assert_true(CANInterface_Transmit(id, &data1, sizeof(data1)));
+    will_return_count(can_available_mailbox, false, 2);
+    assert_true(CANInterface_TransmitPaced(paced_id, &data2, sizeof(data2), 0));
+
+    will_return_count(can_available_mailbox, true, 2);
+    ExpectTransmit(paced_id, &data2, sizeof(data2), 0);
+    ExpectTransmit(id, &data1, sizeof(data1), 1);
+    usb_hp_can_tx_isr();
+
+    /* The paced frame is still pending until its own mailbox has completed. */
+    CompleteTransmission(CAN_TSR_RQCP1);
+    assert_true(CANInterface_IsPacedTransmitPending(paced_id));
+
+    CompleteTransmission(CAN_TSR_RQCP0);
+    assert_false(CANInterface_IsPacedTransmitPending(paced_id));
+}
+
+static void test_CANInterface_TransmitPaced_QueueFull(void **state)
+{
+    const uint32_t id = 0x4;
+    uint8_t data = 1;
+    const size_t queue_size = 16;
+
+    will_return_uint_maybe(can_available_mailbox, false);
+    for (size_t i = 0; i < queue_size; ++i)
     {
-        expect_any(can_filter_id_mask_16bit_init, nr);
-        expect_any(can_filter_id_mask_16bit_init, id1);
-        expect_any(can_filter_id_mask_16bit_init, mask1);
-        expect_any(can_filter_id_mask_16bit_init, id2);
-        expect_any(can_filter_id_mask_16bit_init, mask2);
-        CANInterface_AddFilter(id1, mask1);
+        assert_uint_equal(CANInterface_GetPacedTransmitQueueSpace(), queue_size - i);
+        assert_true(CANInterface_TransmitPaced(id, &data, sizeof(data), 100));
     }
-    expect_assert_failure(CANInterface_AddFilter(id1, mask1));
+    assert_uint_equal(CANInterface_GetPacedTransmitQueueSpace(), 0);
+    assert_false(CANInterface_TransmitPaced(id, &data, sizeof(data), 100));
+
+    struct caninterface_statistics_t statistics;
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.tx_dropped_frames, 1);
+}
+
+static void test_CANInterface_TransmitPaced_CompletedTogether(void **state)
+{
+    const uint32_t paced_id = 0x4;
+    const uint32_t id = 0x5;
+    const uint32_t separation_time_us = 200;
+    uint8_t data1 = 1;
+    uint8_t data2 = 2;
+
+    IgnoreSystemTime();
+    will_return_uint_maybe(can_available_mailbox, true);
+    ExpectTransmit(id, &data1, sizeof(data1), 0);
+    assert_true(CANInterface_Transmit(id, &data1, sizeof(data1)));
+    ExpectTransmit(paced_id, &data2, sizeof(data2), 2);
+    assert_true(CANInterface_TransmitPaced(paced_id, &data2, sizeof(data2), separation_time_us));
+
+    /* All completed mailboxes are handled by a single interrupt. */
+    expect_uint_value(timer_set_period, timer_peripheral, TIM1);
+    expect_uint_value(timer_set_period, period, separation_time_us - 1);
+    expect_uint_value(timer_enable_counter, timer_peripheral, TIM1);
+    CompleteTransmission(CAN_TSR_RQCP0 | CAN_TSR_RQCP2);
+    assert_uint_equal(mock_can_registers.tsr, CAN_TSR_RQCP0 | CAN_TSR_RQCP2);
+
+    tim1_up_isr();
+    assert_false(CANInterface_IsPacedTransmitPending(paced_id));
+}
+
+static void test_CANInterface_ReceiveOverrun(void **state)
+{
+    const struct can_frame_t frame = {.id = 0x1, .size = 1, .data = {0x1}};
+    struct caninterface_statistics_t statistics;
+
+    IgnoreSystemTime();
+
+    /* Only the overrun flag is written to clear it. */
+    mock_can_registers.rf0r = CAN_RF0R_FOVR0 | CAN_RF0R_FULL0;
+    ReceiveCANFrame(&frame, 0);
+    assert_uint_equal(mock_can_registers.rf0r, CAN_RF0R_FOVR0);
+
+    mock_can_registers.rf1r = CAN_RF1R_FOVR1 | CAN_RF1R_FULL1;
+    ExpectReceive(&frame, 0);
+    can_rx1_isr();
+    assert_uint_equal(mock_can_registers.rf1r, CAN_RF1R_FOVR1);
+
+    /* The FIFOs are drained without further overruns. */
+    mock_can_registers.rf0r = 0;
+    ReceiveCANFrame(&frame, 0);
+
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.rx_fifo0_overruns, 1);
+    assert_uint_equal(statistics.rx_fifo1_overruns, 1);
+    assert_uint_equal(statistics.rx_frames, 3);
+}
+
+static void test_CANInterface_RegisterListener_FilterBanks(void **state)
+{
+    /**
+     *   bank 0 (FIFO 0, 16-bit list): 0x123
+     *   bank 1 (FIFO 0, 32-bit list): 0x18FEF1AB (extended)
+     *   bank 2 (FIFO 1, 16-bit mask): 0x200/0x700
+     */
+    RegisterListener(0x123, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    CANInterface_RegisterListener(CANInterface_ExtendedID(0x18FEF1AB), CANINTERFACE_EXTENDED_ID_MASK,
+                                  CANINTERFACE_PRIORITY_CONTROL, Listener, NULL);
+    CANInterface_RegisterListener(0x200, 0x700, CANINTERFACE_PRIORITY_BULK, OtherListener, NULL);
+
+    assert_uint_equal(mock_can_registers.fmr & CAN_FMR_FINIT, 0);
+    assert_uint_equal(mock_can_registers.fa1r, 0x7);
+    assert_uint_equal(mock_can_registers.fs1r, 0x2);
+    assert_uint_equal(mock_can_registers.fm1r, 0x3);
+    assert_uint_equal(mock_can_registers.ffa1r, 0x4);
+
+    /* Unused list slots repeat the first ID. */
+    assert_uint_equal(mock_can_registers.filter_banks[0].fr1, 0x24602460);
+    assert_uint_equal(mock_can_registers.filter_banks[0].fr2, 0x24602460);
+
+    /* IDE is set and compared for extended IDs. */
+    assert_uint_equal(mock_can_registers.filter_banks[1].fr1, 0xC7F78D5C);
+    assert_uint_equal(mock_can_registers.filter_banks[1].fr2, 0xC7F78D5C);
+
+    /* The RTR and IDE bits are compared to only accept standard data frames. */
+    assert_uint_equal(mock_can_registers.filter_banks[2].fr1, 0xE0184000);
+    assert_uint_equal(mock_can_registers.filter_banks[2].fr2, 0xE0184000);
+
+    /* Only the banks in use are activated. */
+    mock_can_registers.fa1r = 0xFF;
+    RegisterListener(0x124, CANINTERFACE_PRIORITY_CONTROL, Listener);
+    assert_uint_equal(mock_can_registers.fa1r, 0x7);
+}
+
+static void test_CANInterface_Statistics_ErrorState(void **state)
+{
+    struct caninterface_statistics_t statistics;
+
+    IgnoreSystemTime();
+
+    /* Error passive with TEC=128 and REC=5. */
+    mock_can_registers.esr = (5 << 24) | (128 << 16) | CAN_ESR_EPVF;
+    can_sce_isr();
+    assert_uint_equal(mock_can_registers.msr, CAN_MSR_ERRI);
+
+    mock_can_registers.esr = (5 << 24) | (255 << 16) | CAN_ESR_EPVF | CAN_ESR_BOFF;
+    can_sce_isr();
+
+    /* The error counters are also sampled from the main loop. */
+    mock_can_registers.esr = 0;
+    CANInterface_Process();
+
+    CANInterface_GetStatistics(&statistics);
+    assert_uint_equal(statistics.error_passive_count, 1);
+    assert_uint_equal(statistics.bus_off_count, 1);
+    assert_uint_equal(statistics.transmit_error_counter, 0);
+    assert_uint_equal(statistics.receive_error_counter, 0);
+    assert_uint_equal(statistics.max_transmit_error_counter, 255);
+    assert_uint_equal(statistics.max_receive_error_counter, 5);
+}
+
+static void test_CANInterface_ReceiveTimestamp(void **state)
+{
+    const struct can_frame_t frame = {.id = 0x1, .size = 1, .data = {0x1}};
+
+    InitCANInterface();
+    RegisterListener(frame.id, CANINTERFACE_PRIORITY_CONTROL, TimestampListener);
+
+    will_return_uint(SysTime_GetSystemTimeUs, 1200);
+    ReceiveCANFrame(&frame, 0);
+    will_return_uint(SysTime_GetSystemTimeUs, 3400);
+    ReceiveCANFrame(&frame, 0);
+
+    /* Frames are stamped on reception, not when dispatched. */
+    expect_uint_value(TimestampListener, frame_p->timestamp, 1200);
+    expect_uint_value(TimestampListener, frame_p->timestamp, 3400);
+    will_return_uint(SysTime_GetSystemTime, 0);
+    CANInterface_Process();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -283,15 +1126,45 @@ int main(int argc, char *argv[])
     {
         cmocka_unit_test(test_CANInterface_Init_Error),
         cmocka_unit_test(test_CANInterface_Init),
+        cmocka_unit_test(test_CANInterface_Init_DefaultBitRate),
+        cmocka_unit_test(test_CANInterface_CalculateBitTiming),
+        cmocka_unit_test(test_CANInterface_CalculateBitTiming_Invalid),
         cmocka_unit_test_setup(test_CANInterface_RegisterListener_Invalid, Setup),
         cmocka_unit_test_setup(test_CANInterface_RegisterListener_Full, Setup),
+        cmocka_unit_test_setup(test_CANInterface_RegisterListener_BanksFull, Setup),
         cmocka_unit_test_setup(test_CANInterface_ReceiveWithNoListeners, Setup),
         cmocka_unit_test_setup(test_CANInterface_ReceiveWithListener, Setup),
+        cmocka_unit_test_setup(test_CANInterface_ReceiveBatch, Setup),
+        cmocka_unit_test_setup(test_CANInterface_ReceiveRingFull, Setup),
         cmocka_unit_test_setup(test_CANInterface_Transmit_Invalid, Setup),
         cmocka_unit_test_setup(test_CANInterface_Transmit_Error, Setup),
-        cmocka_unit_test_setup(test_CANInterface_Transmit_Timeout, Setup),
+        cmocka_unit_test_setup(test_CANInterface_Transmit_MailboxesBusy, Setup),
+        cmocka_unit_test_setup(test_CANInterface_Transmit_QueueFull, Setup),
         cmocka_unit_test_setup(test_CANInterface_Transmit, Setup),
-        cmocka_unit_test_setup(test_CANInterface_AddFilter, Setup),
+        cmocka_unit_test_setup(test_CANInterface_RegisterListener_ListMode, Setup),
+        cmocka_unit_test_setup(test_CANInterface_RegisterListener_MaskMode, Setup),
+        cmocka_unit_test_setup(test_CANInterface_RegisterListener_MergeMasks, Setup),
+        cmocka_unit_test_setup(test_CANInterface_RegisterListener_RemoveCoveredFilters, Setup),
+        cmocka_unit_test_setup(test_CANInterface_UnregisterListener, Setup),
+        cmocka_unit_test_setup(test_CANInterface_ReceivePriority, Setup),
+        cmocka_unit_test_setup(test_CANInterface_ReceiveByFilterMatchIndex, Setup),
+        cmocka_unit_test_setup(test_CANInterface_RegisterListener_ExtendedBanksFull, Setup),
+        cmocka_unit_test_setup(test_CANInterface_ReceiveExtendedID, Setup),
+        cmocka_unit_test_setup(test_CANInterface_TransmitExtendedID, Setup),
+        cmocka_unit_test_setup(test_CANInterface_TransmitPaced_Invalid, Setup),
+        cmocka_unit_test_setup(test_CANInterface_TransmitPaced, Setup),
+        cmocka_unit_test_setup(test_CANInterface_TransmitPaced_LongSeparationTime, Setup),
+        cmocka_unit_test_setup(test_CANInterface_TransmitPaced_ShortPeriods, Setup),
+        cmocka_unit_test_setup(test_CANInterface_TransmitPaced_PendingPerID, Setup),
+        cmocka_unit_test_setup(test_CANInterface_TransmitPaced_SharedMailboxes, Setup),
+        cmocka_unit_test_setup(test_CANInterface_TransmitPaced_QueueFull, Setup),
+        cmocka_unit_test_setup(test_CANInterface_TransmitPaced_CompletedTogether, Setup),
+        cmocka_unit_test_setup(test_CANInterface_ReceiveOverrun, Setup),
+        cmocka_unit_test_setup(test_CANInterface_RegisterListener_FilterBanks, Setup),
+        cmocka_unit_test_setup(test_CANInterface_Statistics_ErrorState, Setup),
+        cmocka_unit_test(test_CANInterface_ReceiveTimestamp),
+        cmocka_unit_test(test_CANInterface_Statistics_Receive),
+        cmocka_unit_test(test_CANInterface_Statistics_Transmit),
     };
 
     if (argc >= 2)
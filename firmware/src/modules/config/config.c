@@ -64,6 +64,7 @@ struct module_t
 {
     struct config_t config;
     bool valid_config;
+    uint32_t can_bit_rate;
 };
 
 struct parameter_t
@@ -92,6 +93,10 @@ static const struct parameter_t parameters[12] =
     {"rx_id", &module.config.rx_id},
     {"tx_id", &module.config.tx_id}
 };
+static const struct parameter_t optional_parameters[1] =
+{
+    {CONFIG_CAN_BIT_RATE_KEY, &module.can_bit_rate}
+};
 
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTION PROTOTYPES
@@ -120,6 +125,14 @@ void Config_Init(void)
     {
         module = (__typeof__(module)) {0};
     }
+
+    for (size_t i = 0; i < ElementsIn(optional_parameters); ++i)
+    {
+        if (!NVS_Retrieve(optional_parameters[i].name, optional_parameters[i].storage_p))
+        {
+            *optional_parameters[i].storage_p = 0;
+        }
+    }
 }
 
 bool Config_IsValid(void)
@@ -169,6 +182,16 @@ uint32_t Config_GetStallCurrent(void)
     return module.config.stall_current;
 }
 
+uint32_t Config_GetCANBitRate(void)
+{
+    return module.can_bit_rate;
+}
+
+bool Config_SetCANBitRate(uint32_t bit_rate)
+{
+    return NVS_Store(CONFIG_CAN_BIT_RATE_KEY, bit_rate);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
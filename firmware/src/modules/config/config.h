@@ -32,6 +32,9 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //DEFINES
 //////////////////////////////////////////////////////////////////////////
 
+/* NVS key of the CAN bit rate, also read by the bootloader. */
+#define CONFIG_CAN_BIT_RATE_KEY "can_bitrate"
+
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
 //////////////////////////////////////////////////////////////////////////
@@ -101,3 +104,24 @@ uint32_t Config_GetNoLoadCurrent(void);
  * @return Stall current in mA.
  */
 uint32_t Config_GetStallCurrent(void);
+
+/**
+ * Get the CAN bus bit rate.
+ *
+ * The bit rate is optional and is available even if the rest of the
+ * configuration is invalid.
+ *
+ * @return Bit rate in bit/s, or zero if not configured.
+ */
+uint32_t Config_GetCANBitRate(void);
+
+/**
+ * Store a new CAN bus bit rate in NVS.
+ *
+ * The bit rate is not validated and takes effect after the next restart.
+ *
+ * @param bit_rate Bit rate in bit/s.
+ *
+ * @return True if the bit rate was stored, otherwise false.
+ */
+bool Config_SetCANBitRate(uint32_t bit_rate);
@@ -94,6 +94,17 @@ __attribute__((weak)) uint32_t Config_GetStallCurrent(void)
     return mock_type(uint32_t);
 }
 
+__attribute__((weak)) uint32_t Config_GetCANBitRate(void)
+{
+    return mock_type(uint32_t);
+}
+
+__attribute__((weak)) bool Config_SetCANBitRate(uint32_t bit_rate)
+{
+    check_expected_uint(bit_rate);
+    return mock_type(bool);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
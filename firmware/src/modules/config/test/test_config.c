@@ -79,6 +79,8 @@ static int Setup(void **state)
         will_return(NVS_Retrieve, 2);
         will_return(NVS_Retrieve, true);
     }
+    will_return(NVS_Retrieve, 0);
+    will_return(NVS_Retrieve, false);
     Config_Init();
 
     return 0;
@@ -130,6 +132,8 @@ static void test_Config_Valid(void **state)
     will_return(NVS_Retrieve, true);
     will_return(NVS_Retrieve, config.tx_id);
     will_return(NVS_Retrieve, true);
+    will_return(NVS_Retrieve, 1000000);
+    will_return(NVS_Retrieve, true);
 
     Config_Init();
 
@@ -146,6 +150,7 @@ static void test_Config_Valid(void **state)
     assert_int_equal(Config_GetValue("imin"), config.imin);
     assert_int_equal(Config_GetValue("rx_id"), config.rx_id);
     assert_int_equal(Config_GetValue("tx_id"), config.tx_id);
+    assert_int_equal(Config_GetCANBitRate(), 1000000);
 }
 
 static void test_Config_Invalid(void **state)
@@ -159,6 +164,8 @@ static void test_Config_Invalid(void **state)
             will_return(NVS_Retrieve, true);
         }
 
+        will_return(NVS_Retrieve, 0);
+        will_return(NVS_Retrieve, false);
         will_return(NVS_Retrieve, 0);
         will_return(NVS_Retrieve, false);
 
@@ -175,6 +182,8 @@ static void test_Config_Invalid_ParameterZeroCheck(void **state)
     will_return(NVS_Retrieve, true);
     will_return(NVS_Retrieve, 4);
     will_return(NVS_Retrieve, false);
+    will_return(NVS_Retrieve, 500000);
+    will_return(NVS_Retrieve, true);
 
     Config_Init();
 
@@ -191,6 +200,7 @@ static void test_Config_Invalid_ParameterZeroCheck(void **state)
     assert_int_equal(Config_GetValue("imin"), 0);
     assert_int_equal(Config_GetValue("rx_id"), 0);
     assert_int_equal(Config_GetValue("tx_id"), 0);
+    assert_int_equal(Config_GetCANBitRate(), 500000);
 }
 
 static void test_Config_GetValue_NULL(void **state)
@@ -207,6 +217,15 @@ static void test_Config_GetValue(void **state)
     assert_int_equal(Config_GetValue("number_of_motors"), 2);
 }
 
+static void test_Config_SetCANBitRate(void **state)
+{
+    will_return(NVS_Store, true);
+    assert_true(Config_SetCANBitRate(1000000));
+
+    will_return(NVS_Store, false);
+    assert_false(Config_SetCANBitRate(1000000));
+}
+
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -220,6 +239,7 @@ int main(int argc, char *argv[])
         cmocka_unit_test(test_Config_Invalid_ParameterZeroCheck),
         cmocka_unit_test_setup(test_Config_GetValue_NULL, Setup),
         cmocka_unit_test_setup(test_Config_GetValue, Setup),
+        cmocka_unit_test(test_Config_SetCANBitRate),
 
     };
 
@@ -27,10 +27,14 @@ along with SillyCat firmware.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <assert.h>
 #include <stddef.h>
+#include <string.h>
 #include "memfault/components.h"
 #include "logging.h"
 #include "systime.h"
 #include "transport.h"
+#include "can_interface.h"
+#include "nvs.h"
+#include "firmware_manager.h"
 #include "device_monitoring.h"
 
 //////////////////////////////////////////////////////////////////////////
@@ -46,12 +50,25 @@ along with SillyCat firmware.  If not, see <http://www.gnu.org/licenses/>.
 //TYPE DEFINITIONS
 //////////////////////////////////////////////////////////////////////////
 
+struct latency_t
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t histogram[DEV_MON_LATENCY_HISTOGRAM_SIZE];
+};
+
 struct module_t
 {
     logging_logger_t *logger_p;
     uint32_t last_callback_time;
     uint32_t timer_callback_period;
     device_monitoring_timer_cb_t timer_callback;
+    struct caninterface_statistics_t reported_can_statistics;
+    struct isotp_statistics_t reported_firmware_isotp_statistics;
+    struct isotp_statistics_t reported_transport_isotp_statistics;
+    struct latency_t latencies[DEV_MON_LATENCY_END];
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -66,6 +83,11 @@ static struct module_t module;
 
 eMemfaultRebootReason ResetReasonToMemfault(enum device_monitoring_reboot_reason reason);
 MemfaultMetricId MetricIdToMemfault(enum device_monitoring_metric_id id);
+static void CollectCANMetrics(void);
+static void CollectISOTPMetrics(void);
+static void CollectLatencyMetrics(void);
+static void CollectNVSMetrics(void);
+static size_t GetHistogramBucket(uint32_t latency);
 
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
@@ -125,6 +147,50 @@ void DeviceMonitoring_StopTimer(enum device_monitoring_metric_id id)
     memfault_metrics_heartbeat_timer_stop(MetricIdToMemfault(id));
 }
 
+void DeviceMonitoring_RecordLatency(enum device_monitoring_latency_id id, uint32_t start_time)
+{
+    assert(id < DEV_MON_LATENCY_END);
+
+    const uint32_t latency = SysTime_GetSystemTimeUs() - start_time;
+    struct latency_t *latency_p = &module.latencies[id];
+
+    if ((latency_p->count == 0) || (latency < latency_p->min))
+    {
+        latency_p->min = latency;
+    }
+    if (latency > latency_p->max)
+    {
+        latency_p->max = latency;
+    }
+    latency_p->sum += latency;
+    ++latency_p->count;
+    ++latency_p->histogram[GetHistogramBucket(latency)];
+}
+
+void DeviceMonitoring_GetLatency(enum device_monitoring_latency_id id, struct device_monitoring_latency_t *latency_p)
+{
+    assert(id < DEV_MON_LATENCY_END);
+    assert(latency_p != NULL);
+
+    const struct latency_t *source_p = &module.latencies[id];
+    latency_p->count = source_p->count;
+    latency_p->min = source_p->min;
+    latency_p->max = source_p->max;
+    latency_p->average = (source_p->count > 0) ? (uint32_t)(source_p->sum / source_p->count) : 0;
+    memcpy(latency_p->histogram, source_p->histogram, sizeof(latency_p->histogram));
+}
+
+/**
+ * Called by the Memfault SDK at the end of every heartbeat interval.
+ */
+void memfault_metrics_heartbeat_collect_data(void)
+{
+    CollectCANMetrics();
+    CollectISOTPMetrics();
+    CollectLatencyMetrics();
+    CollectNVSMetrics();
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -164,3 +230,128 @@ MemfaultMetricId MetricIdToMemfault(enum device_monitoring_metric_id id)
             assert(0);
     }
 }
+
+/**
+ * Report the CAN counters as the change since the last heartbeat and the
+ * peaks as seen during the heartbeat interval.
+ */
+static void CollectCANMetrics(void)
+{
+    struct caninterface_statistics_t statistics;
+    CANInterface_GetStatistics(&statistics);
+    const struct caninterface_statistics_t *reported_p = &module.reported_can_statistics;
+
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_rx_frames),
+                                            statistics.rx_frames - reported_p->rx_frames);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_rx_control_frames),
+                                            statistics.rx_control_frames - reported_p->rx_control_frames);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_rx_bulk_frames),
+                                            statistics.rx_bulk_frames - reported_p->rx_bulk_frames);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_rx_unhandled_frames),
+                                            statistics.rx_unhandled_frames - reported_p->rx_unhandled_frames);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_rx_dropped_frames),
+                                            statistics.rx_dropped_frames - reported_p->rx_dropped_frames);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_rx_overruns),
+                                            (statistics.rx_fifo0_overruns + statistics.rx_fifo1_overruns) -
+                                            (reported_p->rx_fifo0_overruns + reported_p->rx_fifo1_overruns));
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_rx_max_fps), statistics.rx_max_frames_per_second);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_tx_frames),
+                                            statistics.tx_frames - reported_p->tx_frames);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_tx_dropped_frames),
+                                            statistics.tx_dropped_frames - reported_p->tx_dropped_frames);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_tx_max_fps), statistics.tx_max_frames_per_second);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_tx_max_queue_depth), statistics.tx_queue_max_depth);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_tx_max_wait_time_us), statistics.tx_max_wait_time_us);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_max_tec), statistics.max_transmit_error_counter);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_max_rec), statistics.max_receive_error_counter);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_error_passive),
+                                            statistics.error_passive_count - reported_p->error_passive_count);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(can_bus_off),
+                                            statistics.bus_off_count - reported_p->bus_off_count);
+
+    module.reported_can_statistics = statistics;
+    CANInterface_ClearPeakStatistics();
+}
+
+/**
+ * Report the ISO-TP throughput peaks since boot and the flow control
+ * counters as the change since the last heartbeat, for the firmware update
+ * link and the debug data transport link.
+ */
+static void CollectISOTPMetrics(void)
+{
+    struct isotp_statistics_t statistics;
+    const struct isotp_statistics_t *reported_p = &module.reported_firmware_isotp_statistics;
+
+    FirmwareManager_GetTransferStatistics(&statistics);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(isotp_fw_max_rx_bytes_per_process),
+                                            statistics.max_rx_bytes_per_process);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(isotp_fw_max_tx_bytes_per_process),
+                                            statistics.max_tx_bytes_per_process);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(isotp_fw_wait_frames),
+                                            statistics.wait_frames - reported_p->wait_frames);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(isotp_fw_overflow_aborts),
+                                            statistics.overflow_aborts - reported_p->overflow_aborts);
+    module.reported_firmware_isotp_statistics = statistics;
+
+    reported_p = &module.reported_transport_isotp_statistics;
+    Transport_GetStatistics(&statistics);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(isotp_dbg_max_rx_bytes_per_process),
+                                            statistics.max_rx_bytes_per_process);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(isotp_dbg_max_tx_bytes_per_process),
+                                            statistics.max_tx_bytes_per_process);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(isotp_dbg_wait_frames),
+                                            statistics.wait_frames - reported_p->wait_frames);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(isotp_dbg_overflow_aborts),
+                                            statistics.overflow_aborts - reported_p->overflow_aborts);
+    module.reported_transport_isotp_statistics = statistics;
+}
+
+static void CollectLatencyMetrics(void)
+{
+    const MemfaultMetricId keys[DEV_MON_LATENCY_END][2] =
+    {
+        [DEV_MON_LATENCY_SIGNAL] = {MEMFAULT_METRICS_KEY(signal_latency_avg_us), MEMFAULT_METRICS_KEY(signal_latency_max_us)},
+        [DEV_MON_LATENCY_PID_UPDATE] = {MEMFAULT_METRICS_KEY(pid_latency_avg_us), MEMFAULT_METRICS_KEY(pid_latency_max_us)},
+        [DEV_MON_LATENCY_PWM_WRITE] = {MEMFAULT_METRICS_KEY(pwm_latency_avg_us), MEMFAULT_METRICS_KEY(pwm_latency_max_us)}
+    };
+
+    for (size_t i = 0; i < DEV_MON_LATENCY_END; ++i)
+    {
+        struct device_monitoring_latency_t latency;
+        DeviceMonitoring_GetLatency(i, &latency);
+
+        memfault_metrics_heartbeat_set_unsigned(keys[i][0], latency.average);
+        memfault_metrics_heartbeat_set_unsigned(keys[i][1], latency.max);
+    }
+
+    memset(module.latencies, 0, sizeof(module.latencies));
+}
+
+/**
+ * Report the wear of the most worn NVS page and the longest store since boot.
+ */
+static void CollectNVSMetrics(void)
+{
+    struct nvs_statistics_t statistics;
+    NVS_GetStatistics(&statistics);
+
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(nvs_max_erase_count), statistics.max_erase_count);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(nvs_remaining_erase_cycles),
+                                            statistics.remaining_erase_cycles);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(nvs_store_latency_max_us), statistics.max_store_time_us);
+}
+
+static size_t GetHistogramBucket(uint32_t latency)
+{
+    size_t bucket = 0;
+    uint32_t limit = DEV_MON_LATENCY_HISTOGRAM_FIRST_LIMIT_US;
+
+    while ((bucket < (DEV_MON_LATENCY_HISTOGRAM_SIZE - 1)) && (latency >= limit))
+    {
+        ++bucket;
+        limit <<= 1;
+    }
+
+    return bucket;
+}
@@ -34,6 +34,9 @@ along with SillyCat firmware.  If not, see <http://www.gnu.org/licenses/>.
 //DEFINES
 //////////////////////////////////////////////////////////////////////////
 
+#define DEV_MON_LATENCY_HISTOGRAM_SIZE 10
+#define DEV_MON_LATENCY_HISTOGRAM_FIRST_LIMIT_US 125
+
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
 //////////////////////////////////////////////////////////////////////////
@@ -52,6 +55,32 @@ enum device_monitoring_metric_id
     DEV_MON_METRIC_MAIN_TASK_TIME,
 };
 
+/**
+ * Stages of the control path, each latency is measured from the reception of
+ * the CAN frame.
+ */
+enum device_monitoring_latency_id
+{
+    DEV_MON_LATENCY_SIGNAL = 0,
+    DEV_MON_LATENCY_PID_UPDATE,
+    DEV_MON_LATENCY_PWM_WRITE,
+    DEV_MON_LATENCY_END
+};
+
+/**
+ * Latency statistics in microseconds. Bucket n of the histogram counts
+ * latencies below DEV_MON_LATENCY_HISTOGRAM_FIRST_LIMIT_US << n, the last
+ * bucket counts everything above.
+ */
+struct device_monitoring_latency_t
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t average;
+    uint32_t histogram[DEV_MON_LATENCY_HISTOGRAM_SIZE];
+};
+
 typedef void (*device_monitoring_timer_cb_t)(void);
 
 //////////////////////////////////////////////////////////////////////////
@@ -111,6 +140,23 @@ void DeviceMonitoring_StartTimer(enum device_monitoring_metric_id id);
  */
 void DeviceMonitoring_StopTimer(enum device_monitoring_metric_id id);
 
+/**
+ * Record the latency of a control path stage.
+ *
+ * @param id Stage ID.
+ * @param start_time Reception time of the CAN frame, in microseconds.
+ */
+void DeviceMonitoring_RecordLatency(enum device_monitoring_latency_id id, uint32_t start_time);
+
+/**
+ * Get the latency statistics of a control path stage, collected since the
+ * last heartbeat.
+ *
+ * @param id Stage ID.
+ * @param latency_p Pointer to the statistics.
+ */
+void DeviceMonitoring_GetLatency(enum device_monitoring_latency_id id, struct device_monitoring_latency_t *latency_p);
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
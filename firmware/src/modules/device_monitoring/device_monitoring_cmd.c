@@ -26,7 +26,13 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////
 
 #include <assert.h>
+#include <stdio.h>
+#include <inttypes.h>
 #include "memfault/components.h"
+#include "can_interface.h"
+#include "isotp.h"
+#include "firmware_manager.h"
+#include "transport.h"
 #include "device_monitoring.h"
 #include "device_monitoring_cmd.h"
 
@@ -42,10 +48,19 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //VARIABLES
 //////////////////////////////////////////////////////////////////////////
 
+static const char *latency_names[DEV_MON_LATENCY_END] =
+{
+    [DEV_MON_LATENCY_SIGNAL] = "signal",
+    [DEV_MON_LATENCY_PID_UPDATE] = "pid",
+    [DEV_MON_LATENCY_PWM_WRITE] = "pwm"
+};
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTION PROTOTYPES
 //////////////////////////////////////////////////////////////////////////
 
+static void PrintISOTPStatistics(const char *name_p, const struct isotp_statistics_t *statistics_p);
+
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -56,6 +71,76 @@ bool DeviceMonitoringCmd_DumpData(void)
     return true;
 }
 
+bool DeviceMonitoringCmd_PrintCANStatistics(void)
+{
+    struct caninterface_statistics_t statistics;
+    CANInterface_GetStatistics(&statistics);
+
+    printf("rx: %" PRIu32 " (control: %" PRIu32 ", bulk: %" PRIu32 ", unhandled: %" PRIu32 ")\r\n",
+           statistics.rx_frames, statistics.rx_control_frames, statistics.rx_bulk_frames,
+           statistics.rx_unhandled_frames);
+    printf("rx lost: %" PRIu32 " dropped, %" PRIu32 "/%" PRIu32 " overruns\r\n",
+           statistics.rx_dropped_frames, statistics.rx_fifo0_overruns, statistics.rx_fifo1_overruns);
+    printf("rx rate: %" PRIu32 " fps (max: %" PRIu32 ")\r\n",
+           statistics.rx_frames_per_second, statistics.rx_max_frames_per_second);
+    printf("tx: %" PRIu32 " (dropped: %" PRIu32 ")\r\n", statistics.tx_frames, statistics.tx_dropped_frames);
+    printf("tx rate: %" PRIu32 " fps (max: %" PRIu32 ")\r\n",
+           statistics.tx_frames_per_second, statistics.tx_max_frames_per_second);
+    printf("tx queue: %" PRIu32 " (max: %" PRIu32 ", max wait: %" PRIu32 " us)\r\n",
+           statistics.tx_queue_depth, statistics.tx_queue_max_depth, statistics.tx_max_wait_time_us);
+    printf("tec: %" PRIu32 " (max: %" PRIu32 "), rec: %" PRIu32 " (max: %" PRIu32 ")\r\n",
+           statistics.transmit_error_counter, statistics.max_transmit_error_counter,
+           statistics.receive_error_counter, statistics.max_receive_error_counter);
+    printf("error passive: %" PRIu32 ", bus-off: %" PRIu32 "\r\n",
+           statistics.error_passive_count, statistics.bus_off_count);
+
+    return true;
+}
+
+bool DeviceMonitoringCmd_PrintISOTPStatistics(void)
+{
+    struct isotp_statistics_t statistics;
+
+    FirmwareManager_GetTransferStatistics(&statistics);
+    PrintISOTPStatistics("firmware", &statistics);
+    Transport_GetStatistics(&statistics);
+    PrintISOTPStatistics("transport", &statistics);
+
+    return true;
+}
+
+bool DeviceMonitoringCmd_PrintLatency(void)
+{
+    for (size_t i = 0; i < DEV_MON_LATENCY_END; ++i)
+    {
+        struct device_monitoring_latency_t latency;
+        DeviceMonitoring_GetLatency(i, &latency);
+
+        printf("%s: n: %" PRIu32 ", min: %" PRIu32 " us, avg: %" PRIu32 " us, max: %" PRIu32 " us\r\n",
+               latency_names[i], latency.count, latency.min, latency.average, latency.max);
+
+        uint32_t limit = DEV_MON_LATENCY_HISTOGRAM_FIRST_LIMIT_US;
+        for (size_t n = 0; n < (DEV_MON_LATENCY_HISTOGRAM_SIZE - 1); ++n)
+        {
+            printf("  <%" PRIu32 ": %" PRIu32 "\r\n", limit, latency.histogram[n]);
+            limit <<= 1;
+        }
+        printf("  >=%" PRIu32 ": %" PRIu32 "\r\n", limit >> 1, latency.histogram[DEV_MON_LATENCY_HISTOGRAM_SIZE - 1]);
+    }
+
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
+
+static void PrintISOTPStatistics(const char *name_p, const struct isotp_statistics_t *statistics_p)
+{
+    printf("%s rx: %" PRIu32 " bytes/process (max: %" PRIu32 "), tx: %" PRIu32 " bytes/process (max: %" PRIu32 ")\r\n",
+           name_p, statistics_p->rx_bytes_per_process, statistics_p->max_rx_bytes_per_process,
+           statistics_p->tx_bytes_per_process, statistics_p->max_tx_bytes_per_process);
+    printf("%s flow control: wait: %" PRIu32 ", overflow: %" PRIu32 ", block size: %u, stmin: %u ms\r\n",
+           name_p, statistics_p->wait_frames, statistics_p->overflow_aborts,
+           statistics_p->block_size, statistics_p->separation_time);
+}
@@ -53,4 +53,25 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
  */
 bool DeviceMonitoringCmd_DumpData(void);
 
+/**
+ * Print the CAN bus statistics.
+ *
+ * @return Command status.
+ */
+bool DeviceMonitoringCmd_PrintCANStatistics(void);
+
+/**
+ * Print the ISO-TP link statistics.
+ *
+ * @return Command status.
+ */
+bool DeviceMonitoringCmd_PrintISOTPStatistics(void);
+
+/**
+ * Print the control path latency statistics.
+ *
+ * @return Command status.
+ */
+bool DeviceMonitoringCmd_PrintLatency(void);
+
 #endif
@@ -91,11 +91,37 @@ __attribute__((weak)) void DeviceMonitoring_StopTimer(enum device_monitoring_met
 
 }
 
+__attribute__((weak)) void DeviceMonitoring_RecordLatency(enum device_monitoring_latency_id id, uint32_t start_time)
+{
+
+}
+
+__attribute__((weak)) void DeviceMonitoring_GetLatency(enum device_monitoring_latency_id id, struct device_monitoring_latency_t *latency_p)
+{
+    assert_non_null(latency_p);
+    *latency_p = (__typeof__(*latency_p)) {0};
+}
+
 __attribute__((weak)) bool DeviceMonitoringCmd_DumpData(void)
 {
     return mock_type(bool);
 }
 
+__attribute__((weak)) bool DeviceMonitoringCmd_PrintCANStatistics(void)
+{
+    return mock_type(bool);
+}
+
+__attribute__((weak)) bool DeviceMonitoringCmd_PrintISOTPStatistics(void)
+{
+    return mock_type(bool);
+}
+
+__attribute__((weak)) bool DeviceMonitoringCmd_PrintLatency(void)
+{
+    return mock_type(bool);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
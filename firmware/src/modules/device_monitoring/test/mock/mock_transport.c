@@ -64,6 +64,12 @@ __attribute__((weak)) void Transport_Update(void)
 
 }
 
+__attribute__((weak)) void Transport_GetStatistics(struct isotp_statistics_t *statistics_p)
+{
+    assert_non_null(statistics_p);
+    *statistics_p = *mock_ptr_type(struct isotp_statistics_t *);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -37,6 +37,9 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include "utility.h"
 #include "logging.h"
 #include "isotp.h"
+#include "can_interface.h"
+#include "nvs.h"
+#include "firmware_manager.h"
 #include "device_monitoring.h"
 #include "device_monitoring_cmd.h"
 
@@ -60,11 +63,10 @@ static isotp_status_callback_t tx_cb_fp;
 //MOCKS
 //////////////////////////////////////////////////////////////////////////
 
-void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint16_t rx_id, uint16_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp)
+void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint32_t rx_id, uint32_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp)
 {
     assert_non_null(ctx_p);
     assert_non_null(rx_buffer_p);
-    assert_non_null(tx_buffer_p);
 
     rx_cb_fp = rx_callback_fp;
     tx_cb_fp = tx_callback_fp;
@@ -104,9 +106,9 @@ void test_DeviceMonitoring_TimerCallback(void **state)
     /* Default expectations for 'Transport_Update()'. */
     will_return_uint_always(ISOTP_IsSending, false);
     will_return_uint_always(memfault_packetizer_get_chunk, true);
-    will_return_uint_always(ISOTP_Send, true);
-    expect_any_always(ISOTP_Send, data_p);
-    expect_function_call_any(ISOTP_Proccess);
+    will_return_uint_always(ISOTP_SendBuffers, true);
+    expect_any_always(ISOTP_SendBuffers, buffers_p);
+    expect_value_count(ISOTP_SendBuffers, number_of_buffers, 1, -1);
 
     /* No callback set. */
     DeviceMonitoring_Update();
@@ -133,9 +135,9 @@ void test_DeviceMonitoring_TransportLayer(void **state)
     /* Send successful. */
     will_return(ISOTP_IsSending, false);
     will_return(memfault_packetizer_get_chunk, true);
-    will_return(ISOTP_Send, true);
-    expect_any(ISOTP_Send, data_p);
-    expect_function_call(ISOTP_Proccess);
+    will_return(ISOTP_SendBuffers, true);
+    expect_any(ISOTP_SendBuffers, buffers_p);
+    expect_value(ISOTP_SendBuffers, number_of_buffers, 1);
     DeviceMonitoring_Update();
 
     tx_cb_fp(ISOTP_STATUS_WAITING);
@@ -147,21 +149,19 @@ void test_DeviceMonitoring_TransportLayer_ErrorHandling(void **state)
     /* No data available, do nothing. */
     will_return(ISOTP_IsSending, false);
     will_return(memfault_packetizer_get_chunk, false);
-    expect_function_call(ISOTP_Proccess);
     DeviceMonitoring_Update();
 
     /* Already sending, do nothing. */
     will_return(ISOTP_IsSending, true);
-    expect_function_call(ISOTP_Proccess);
     DeviceMonitoring_Update();
 
     /* Send failed. */
     will_return(ISOTP_IsSending, false);
     will_return(memfault_packetizer_get_chunk, true);
-    will_return(ISOTP_Send, false);
-    expect_any(ISOTP_Send, data_p);
+    will_return(ISOTP_SendBuffers, false);
+    expect_any(ISOTP_SendBuffers, buffers_p);
+    expect_value(ISOTP_SendBuffers, number_of_buffers, 1);
     expect_function_call(memfault_packetizer_abort);
-    expect_function_call(ISOTP_Proccess);
     DeviceMonitoring_Update();
 
     /* ISOTP errors. */
@@ -176,9 +176,9 @@ void test_DeviceMonitoring_TransportLayer_ErrorHandling(void **state)
     {
         will_return(ISOTP_IsSending, false);
         will_return(memfault_packetizer_get_chunk, true);
-        will_return(ISOTP_Send, true);
-        expect_any(ISOTP_Send, data_p);
-        expect_function_call(ISOTP_Proccess);
+        will_return(ISOTP_SendBuffers, true);
+        expect_any(ISOTP_SendBuffers, buffers_p);
+        expect_value(ISOTP_SendBuffers, number_of_buffers, 1);
         DeviceMonitoring_Update();
 
         /* Fake callback. */
@@ -236,12 +236,230 @@ void test_DeviceMonitoring_Timer(void **state)
     DeviceMonitoring_StopTimer(DEV_MON_METRIC_MAIN_TASK_TIME);
 }
 
+void test_DeviceMonitoring_CollectCANMetrics(void **state)
+{
+    will_return_uint_always(memfault_metrics_heartbeat_set_unsigned, 0);
+
+    struct caninterface_statistics_t statistics =
+    {
+        .rx_frames = 100,
+        .rx_control_frames = 60,
+        .rx_bulk_frames = 40,
+        .rx_unhandled_frames = 5,
+        .rx_dropped_frames = 2,
+        .rx_fifo0_overruns = 1,
+        .rx_fifo1_overruns = 3,
+        .rx_max_frames_per_second = 50,
+        .tx_frames = 80,
+        .tx_dropped_frames = 1,
+        .tx_max_frames_per_second = 40,
+        .tx_queue_max_depth = 7,
+        .tx_max_wait_time_us = 900,
+        .max_transmit_error_counter = 8,
+        .max_receive_error_counter = 16,
+        .error_passive_count = 1,
+        .bus_off_count = 0
+    };
+    const uint32_t expected_values[][16] =
+    {
+        {100, 60, 40, 5, 2, 4, 50, 80, 1, 40, 7, 900, 8, 16, 1, 0},
+        /* Counters are reported as the change since the last heartbeat. */
+        {50, 30, 20, 0, 0, 1, 10, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    };
+
+    for (size_t i = 0; i < ElementsIn(expected_values); ++i)
+    {
+        will_return_ptr(CANInterface_GetStatistics, &statistics);
+        for (size_t n = 0; n < ElementsIn(expected_values[i]); ++n)
+        {
+            expect_uint_value(memfault_metrics_heartbeat_set_unsigned, unsigned_value, expected_values[i][n]);
+        }
+        expect_function_call(CANInterface_ClearPeakStatistics);
+        will_return_ptr(FirmwareManager_GetTransferStatistics, &(struct isotp_statistics_t) {0});
+        will_return_ptr(ISOTP_GetStatistics, &(struct isotp_statistics_t) {0});
+        expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 8);
+        expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 2 * DEV_MON_LATENCY_END);
+        will_return_ptr(NVS_GetStatistics, &(struct nvs_statistics_t) {0});
+        expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 3);
+        memfault_metrics_heartbeat_collect_data();
+
+        statistics = (__typeof__(statistics)) {
+            .rx_frames = 150,
+            .rx_control_frames = 90,
+            .rx_bulk_frames = 60,
+            .rx_unhandled_frames = 5,
+            .rx_dropped_frames = 2,
+            .rx_fifo0_overruns = 2,
+            .rx_fifo1_overruns = 3,
+            .rx_max_frames_per_second = 10,
+            .tx_frames = 80,
+            .tx_dropped_frames = 1,
+            .error_passive_count = 1,
+            .bus_off_count = 1
+        };
+    }
+}
+
+void test_DeviceMonitoring_CollectISOTPMetrics(void **state)
+{
+    will_return_uint_always(memfault_metrics_heartbeat_set_unsigned, 0);
+
+    struct isotp_statistics_t firmware_statistics =
+    {
+        .max_rx_bytes_per_process = 350,
+        .max_tx_bytes_per_process = 14,
+        .wait_frames = 3,
+        .overflow_aborts = 1
+    };
+    struct isotp_statistics_t transport_statistics =
+    {
+        .max_rx_bytes_per_process = 7,
+        .max_tx_bytes_per_process = 64,
+        .wait_frames = 2,
+        .overflow_aborts = 0
+    };
+    const uint32_t expected_values[][8] =
+    {
+        {350, 14, 3, 1, 7, 64, 2, 0},
+        /* Counters are reported as the change since the last heartbeat. */
+        {350, 14, 2, 0, 7, 64, 0, 1},
+    };
+
+    for (size_t i = 0; i < ElementsIn(expected_values); ++i)
+    {
+        will_return_ptr(CANInterface_GetStatistics, &(struct caninterface_statistics_t) {0});
+        expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 16);
+        expect_function_call(CANInterface_ClearPeakStatistics);
+        will_return_ptr(FirmwareManager_GetTransferStatistics, &firmware_statistics);
+        will_return_ptr(ISOTP_GetStatistics, &transport_statistics);
+        for (size_t n = 0; n < ElementsIn(expected_values[i]); ++n)
+        {
+            expect_uint_value(memfault_metrics_heartbeat_set_unsigned, unsigned_value, expected_values[i][n]);
+        }
+        expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 2 * DEV_MON_LATENCY_END);
+        will_return_ptr(NVS_GetStatistics, &(struct nvs_statistics_t) {0});
+        expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 3);
+        memfault_metrics_heartbeat_collect_data();
+
+        firmware_statistics.wait_frames = 5;
+        firmware_statistics.overflow_aborts = 1;
+        transport_statistics.overflow_aborts = 1;
+    }
+}
+
+void test_DeviceMonitoring_CollectNVSMetrics(void **state)
+{
+    will_return_uint_always(memfault_metrics_heartbeat_set_unsigned, 0);
+
+    const struct nvs_statistics_t statistics =
+    {
+        .max_erase_count = 120,
+        .remaining_erase_cycles = 9880,
+        .max_store_time_us = 4500
+    };
+
+    will_return_ptr(CANInterface_GetStatistics, &(struct caninterface_statistics_t) {0});
+    expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 16);
+    expect_function_call(CANInterface_ClearPeakStatistics);
+    will_return_ptr(FirmwareManager_GetTransferStatistics, &(struct isotp_statistics_t) {0});
+    will_return_ptr(ISOTP_GetStatistics, &(struct isotp_statistics_t) {0});
+    expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 8);
+    expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 2 * DEV_MON_LATENCY_END);
+    will_return_ptr(NVS_GetStatistics, &statistics);
+    expect_uint_value(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 120);
+    expect_uint_value(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 9880);
+    expect_uint_value(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 4500);
+    memfault_metrics_heartbeat_collect_data();
+}
+
+void test_DeviceMonitoring_Latency_Invalid(void **state)
+{
+    struct device_monitoring_latency_t latency;
+
+    expect_assert_failure(DeviceMonitoring_RecordLatency(DEV_MON_LATENCY_END, 0));
+    expect_assert_failure(DeviceMonitoring_GetLatency(DEV_MON_LATENCY_END, &latency));
+    expect_assert_failure(DeviceMonitoring_GetLatency(DEV_MON_LATENCY_SIGNAL, NULL));
+}
+
+void test_DeviceMonitoring_Latency(void **state)
+{
+    struct device_monitoring_latency_t latency;
+
+    DeviceMonitoring_GetLatency(DEV_MON_LATENCY_PID_UPDATE, &latency);
+    assert_uint_equal(latency.count, 0);
+    assert_uint_equal(latency.average, 0);
+
+    /* Latencies are measured from the start time, also across a wrap. */
+    const uint32_t start_times[] = {1000, 5000, UINT32_MAX - 99};
+    const uint32_t end_times[] = {1100, 6000, 40000};
+    for (size_t i = 0; i < ElementsIn(start_times); ++i)
+    {
+        will_return(SysTime_GetSystemTimeUs, end_times[i]);
+        DeviceMonitoring_RecordLatency(DEV_MON_LATENCY_PID_UPDATE, start_times[i]);
+    }
+
+    DeviceMonitoring_GetLatency(DEV_MON_LATENCY_PID_UPDATE, &latency);
+    assert_uint_equal(latency.count, 3);
+    assert_uint_equal(latency.min, 100);
+    assert_uint_equal(latency.max, 40100);
+    assert_uint_equal(latency.average, 13733);
+
+    /* Buckets: <125, <250, <500, <1000, <2000, ..., <32000, >=32000. */
+    const uint32_t expected_histogram[DEV_MON_LATENCY_HISTOGRAM_SIZE] = {1, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    assert_memory_equal(latency.histogram, expected_histogram, sizeof(expected_histogram));
+
+    /* Other stages are not affected. */
+    DeviceMonitoring_GetLatency(DEV_MON_LATENCY_SIGNAL, &latency);
+    assert_uint_equal(latency.count, 0);
+
+    /* The average and max are reported and cleared every heartbeat. */
+    will_return_uint_always(memfault_metrics_heartbeat_set_unsigned, 0);
+    will_return_ptr(CANInterface_GetStatistics, &(struct caninterface_statistics_t) {0});
+    expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 16);
+    expect_function_call(CANInterface_ClearPeakStatistics);
+    will_return_ptr(FirmwareManager_GetTransferStatistics, &(struct isotp_statistics_t) {0});
+    will_return_ptr(ISOTP_GetStatistics, &(struct isotp_statistics_t) {0});
+    expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 8);
+    expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 2);
+    expect_uint_value(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 13733);
+    expect_uint_value(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 40100);
+    expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 2);
+    will_return_ptr(NVS_GetStatistics, &(struct nvs_statistics_t) {0});
+    expect_uint_value_count(memfault_metrics_heartbeat_set_unsigned, unsigned_value, 0, 3);
+    memfault_metrics_heartbeat_collect_data();
+
+    DeviceMonitoring_GetLatency(DEV_MON_LATENCY_PID_UPDATE, &latency);
+    assert_uint_equal(latency.count, 0);
+}
+
 void test_DeviceMonitoringCmd_DumpData(void **state)
 {
     expect_function_call(memfault_data_export_dump_chunks);
     assert_true(DeviceMonitoringCmd_DumpData());
 }
 
+void test_DeviceMonitoringCmd_PrintCANStatistics(void **state)
+{
+    const struct caninterface_statistics_t statistics = {.rx_frames = 1, .tx_frames = 2};
+
+    will_return_ptr(CANInterface_GetStatistics, &statistics);
+    assert_true(DeviceMonitoringCmd_PrintCANStatistics());
+}
+
+void test_DeviceMonitoringCmd_PrintISOTPStatistics(void **state)
+{
+    const struct isotp_statistics_t statistics = {.rx_bytes_per_process = 7, .block_size = 8};
+
+    will_return_ptr(FirmwareManager_GetTransferStatistics, &statistics);
+    will_return_ptr(ISOTP_GetStatistics, &statistics);
+    assert_true(DeviceMonitoringCmd_PrintISOTPStatistics());
+}
+
+void test_DeviceMonitoringCmd_PrintLatency(void **state)
+{
+    assert_true(DeviceMonitoringCmd_PrintLatency());
+}
+
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -257,12 +475,20 @@ int main(int argc, char *argv[])
         cmocka_unit_test_setup(test_DeviceMonitoring_ResetImminent, Setup),
         cmocka_unit_test_setup(test_DeviceMonitoring_Count_InvalidId, Setup),
         cmocka_unit_test_setup(test_DeviceMonitoring_Count, Setup),
-        cmocka_unit_test_setup(test_DeviceMonitoring_Timer, Setup)
+        cmocka_unit_test_setup(test_DeviceMonitoring_Timer, Setup),
+        cmocka_unit_test_setup(test_DeviceMonitoring_CollectCANMetrics, Setup),
+        cmocka_unit_test_setup(test_DeviceMonitoring_CollectISOTPMetrics, Setup),
+        cmocka_unit_test_setup(test_DeviceMonitoring_CollectNVSMetrics, Setup),
+        cmocka_unit_test_setup(test_DeviceMonitoring_Latency_Invalid, Setup),
+        cmocka_unit_test_setup(test_DeviceMonitoring_Latency, Setup)
     };
 
     const struct CMUnitTest test_device_monitoring_cmd[] =
     {
-        cmocka_unit_test(test_DeviceMonitoringCmd_DumpData)
+        cmocka_unit_test(test_DeviceMonitoringCmd_DumpData),
+        cmocka_unit_test(test_DeviceMonitoringCmd_PrintCANStatistics),
+        cmocka_unit_test(test_DeviceMonitoringCmd_PrintISOTPStatistics),
+        cmocka_unit_test(test_DeviceMonitoringCmd_PrintLatency)
     };
 
     if (argc >= 2)
@@ -39,7 +39,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////
 
 #define RX_BUFFER_SIZE 32
-#define TX_BUFFER_SIZE 256
+#define CHUNK_SIZE 64
 
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
@@ -50,7 +50,8 @@ struct module_t
     logging_logger_t *logger_p;
     struct isotp_ctx_t ctx;
     uint8_t rx_buffer[RX_BUFFER_SIZE];
-    uint8_t tx_buffer[TX_BUFFER_SIZE];
+    uint8_t chunk[CHUNK_SIZE];
+    struct isotp_buffer_t chunk_buffer;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -78,8 +79,8 @@ void Transport_Init(logging_logger_t *logger_p)
     ISOTP_Bind(&module.ctx,
                module.rx_buffer,
                sizeof(module.rx_buffer),
-               module.tx_buffer,
-               sizeof(module.tx_buffer),
+               NULL,
+               0,
                0x03,
                0x04,
                RxStatusCallback,
@@ -89,20 +90,24 @@ void Transport_Init(logging_logger_t *logger_p)
 
 void Transport_Update(void)
 {
-    uint8_t data[64];
-    size_t number_of_bytes = sizeof(data);
+    size_t number_of_bytes = sizeof(module.chunk);
 
-    if ((!ISOTP_IsSending(&module.ctx)) && memfault_packetizer_get_chunk(data, &number_of_bytes))
+    /* The chunk is sent in place and can't be reused until the transfer is finished. */
+    if ((!ISOTP_IsSending(&module.ctx)) && memfault_packetizer_get_chunk(module.chunk, &number_of_bytes))
     {
         Logging_Debug(module.logger_p, "Chunk available: {length: %u}", number_of_bytes);
-        if (!ISOTP_Send(&module.ctx, data, number_of_bytes))
+        module.chunk_buffer = (struct isotp_buffer_t) {.data_p = module.chunk, .length = number_of_bytes};
+        if (!ISOTP_SendBuffers(&module.ctx, &module.chunk_buffer, 1))
         {
             Logging_Warning(module.logger_p, "Failed to send chunk: {length: %u}", number_of_bytes);
             memfault_packetizer_abort();
         }
     }
+}
 
-    ISOTP_Proccess(&module.ctx);
+void Transport_GetStatistics(struct isotp_statistics_t *statistics_p)
+{
+    ISOTP_GetStatistics(&module.ctx, statistics_p);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -33,6 +33,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////
 
 #include "logging.h"
+#include "isotp.h"
 
 //////////////////////////////////////////////////////////////////////////
 //DEFINES
@@ -58,4 +59,11 @@ void Transport_Init(logging_logger_t *logger_p);
  */
 void Transport_Update(void);
 
+/**
+ * Get the throughput statistics of the transport link.
+ *
+ * @param statistics_p Pointer to struct where the statistics are stored.
+ */
+void Transport_GetStatistics(struct isotp_statistics_t *statistics_p);
+
 #endif
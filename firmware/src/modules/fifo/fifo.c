@@ -27,6 +27,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <string.h>
 #include <assert.h>
+#include <stdatomic.h>
 #include "fifo.h"
 
 //////////////////////////////////////////////////////////////////////////
@@ -45,10 +46,10 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //LOCAL FUNCTION PROTOTYPES
 //////////////////////////////////////////////////////////////////////////
 
-static inline void *GetHeadPosition(const struct fifo_t *self_p);
-static inline void *GetTailPosition(const struct fifo_t *self_p);
-static inline void MoveHead(struct fifo_t *self_p);
-static inline void MoveTail(struct fifo_t *self_p);
+static inline uint32_t GetNumberOfElements(const struct fifo_t *self_p, uint32_t head, uint32_t tail);
+static inline uint32_t GetIndex(const struct fifo_t *self_p, uint32_t position);
+static inline uint32_t Advance(const struct fifo_t *self_p, uint32_t position, uint32_t number_of_items);
+static inline uint32_t Min(uint32_t a, uint32_t b);
 
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
@@ -59,16 +60,39 @@ bool FIFO_Push(struct fifo_t *self_p, const void *item_p)
     assert(self_p != NULL);
     assert(item_p != NULL);
 
-    if (!FIFO_IsFull(self_p))
+    return FIFO_PushN(self_p, item_p, 1) == 1;
+}
+
+uint32_t FIFO_PushN(struct fifo_t *self_p, const void *items_p, uint32_t number_of_items)
+{
+    assert(self_p != NULL);
+    assert(items_p != NULL);
+
+    const uint32_t head = self_p->head;
+    const uint32_t tail = self_p->tail;
+
+    /* Do not write to slots before the consumer is done reading them. */
+    atomic_signal_fence(memory_order_acquire);
+
+    const uint32_t available_slots = self_p->max_number_of_elements - GetNumberOfElements(self_p, head, tail);
+    number_of_items = Min(number_of_items, available_slots);
+
+    if (number_of_items > 0)
     {
-        void *position_p = GetHeadPosition(self_p);
-        memcpy(position_p, item_p, self_p->element_size);
+        const uint32_t index = GetIndex(self_p, head);
+        const uint32_t first_segment = Min(number_of_items, self_p->max_number_of_elements - index);
+        const size_t first_size = (size_t)first_segment * self_p->element_size;
 
-        MoveHead(self_p);
-        return true;
+        memcpy(self_p->data_p + (size_t)index * self_p->element_size, items_p, first_size);
+        memcpy(self_p->data_p, (const uint8_t *)items_p + first_size,
+               (size_t)(number_of_items - first_segment) * self_p->element_size);
+
+        /* Publish the items before the consumer can see the new head. */
+        atomic_signal_fence(memory_order_release);
+        self_p->head = Advance(self_p, head, number_of_items);
     }
 
-    return false;
+    return number_of_items;
 }
 
 bool FIFO_Pop(struct fifo_t *self_p, void *item_p)
@@ -76,16 +100,38 @@ bool FIFO_Pop(struct fifo_t *self_p, void *item_p)
     assert(self_p != NULL);
     assert(item_p != NULL);
 
-    if (!FIFO_IsEmpty(self_p))
+    return FIFO_PopN(self_p, item_p, 1) == 1;
+}
+
+uint32_t FIFO_PopN(struct fifo_t *self_p, void *items_p, uint32_t number_of_items)
+{
+    assert(self_p != NULL);
+    assert(items_p != NULL);
+
+    const uint32_t head = self_p->head;
+    const uint32_t tail = self_p->tail;
+
+    /* Do not read slots before the producer has published them. */
+    atomic_signal_fence(memory_order_acquire);
+
+    number_of_items = Min(number_of_items, GetNumberOfElements(self_p, head, tail));
+
+    if (number_of_items > 0)
     {
-        const void *position_p = GetTailPosition(self_p);
-        memcpy(item_p, position_p, self_p->element_size);
+        const uint32_t index = GetIndex(self_p, tail);
+        const uint32_t first_segment = Min(number_of_items, self_p->max_number_of_elements - index);
+        const size_t first_size = (size_t)first_segment * self_p->element_size;
 
-        MoveTail(self_p);
-        return true;
+        memcpy(items_p, self_p->data_p + (size_t)index * self_p->element_size, first_size);
+        memcpy((uint8_t *)items_p + first_size, self_p->data_p,
+               (size_t)(number_of_items - first_segment) * self_p->element_size);
+
+        /* Finish reading before the producer can reuse the slots. */
+        atomic_signal_fence(memory_order_release);
+        self_p->tail = Advance(self_p, tail, number_of_items);
     }
 
-    return false;
+    return number_of_items;
 }
 
 bool FIFO_Peek(const struct fifo_t *self_p, void *item_p)
@@ -93,9 +139,14 @@ bool FIFO_Peek(const struct fifo_t *self_p, void *item_p)
     assert(self_p != NULL);
     assert(item_p != NULL);
 
-    if (!FIFO_IsEmpty(self_p))
+    const uint32_t head = self_p->head;
+    const uint32_t tail = self_p->tail;
+
+    atomic_signal_fence(memory_order_acquire);
+
+    if (head != tail)
     {
-        const void *position_p = GetTailPosition(self_p);
+        const void *position_p = self_p->data_p + (size_t)GetIndex(self_p, tail) * self_p->element_size;
         memcpy(item_p, position_p, self_p->element_size);
 
         return true;
@@ -108,58 +159,52 @@ bool FIFO_IsEmpty(const struct fifo_t *self_p)
 {
     assert(self_p != NULL);
 
-    return self_p->number_of_elements == 0;
+    return self_p->head == self_p->tail;
 }
 
 bool FIFO_IsFull(const struct fifo_t *self_p)
 {
     assert(self_p != NULL);
 
-    return self_p->max_number_of_elements == self_p->number_of_elements;
+    return GetNumberOfElements(self_p, self_p->head, self_p->tail) == self_p->max_number_of_elements;
 }
 
 void FIFO_Clear(struct fifo_t *self_p)
 {
     assert(self_p != NULL);
 
-    self_p->head = 0;
-    self_p->tail = 0;
-    self_p->number_of_elements = 0;
+    atomic_signal_fence(memory_order_release);
+    self_p->tail = self_p->head;
 }
 
-uint8_t FIFO_GetAvailableSlots(const struct fifo_t *self_p)
+uint32_t FIFO_GetAvailableSlots(const struct fifo_t *self_p)
 {
     assert(self_p != NULL);
 
-    return self_p->max_number_of_elements - self_p->number_of_elements;
+    return self_p->max_number_of_elements - GetNumberOfElements(self_p, self_p->head, self_p->tail);
 }
 
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
 
-static inline void *GetHeadPosition(const struct fifo_t *self_p)
+static inline uint32_t GetNumberOfElements(const struct fifo_t *self_p, uint32_t head, uint32_t tail)
 {
-    return self_p->data_p + ((size_t)self_p->head * (size_t)self_p->element_size);
+    return head >= tail ? head - tail : head + 2 * self_p->max_number_of_elements - tail;
 }
 
-static inline void *GetTailPosition(const struct fifo_t *self_p)
+static inline uint32_t GetIndex(const struct fifo_t *self_p, uint32_t position)
 {
-    return self_p->data_p + ((size_t)self_p->tail * (size_t)self_p->element_size);
+    return position < self_p->max_number_of_elements ? position : position - self_p->max_number_of_elements;
 }
 
-static inline void MoveHead(struct fifo_t *self_p)
+static inline uint32_t Advance(const struct fifo_t *self_p, uint32_t position, uint32_t number_of_items)
 {
-    assert(self_p->number_of_elements < UINT8_MAX);
-
-    self_p->head = (self_p->head + 1) % self_p->max_number_of_elements;
-    self_p->number_of_elements += 1;
+    position += number_of_items;
+    return position < 2 * self_p->max_number_of_elements ? position : position - 2 * self_p->max_number_of_elements;
 }
 
-static inline void MoveTail(struct fifo_t *self_p)
+static inline uint32_t Min(uint32_t a, uint32_t b)
 {
-    assert(self_p->number_of_elements > 0);
-
-    self_p->tail = (self_p->tail + 1) % self_p->max_number_of_elements;
-    self_p->number_of_elements -= 1;
+    return a < b ? a : b;
 }
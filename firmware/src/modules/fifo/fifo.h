@@ -34,25 +34,137 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 //////////////////////////////////////////////////////////////////////////
 //DEFINES
 //////////////////////////////////////////////////////////////////////////
 
-#define FIFO_New(data) (struct fifo_t){(uint8_t *)data, 0, 0, sizeof(data[0]), (sizeof(data) / sizeof(data[0])), 0}
+#define FIFO_New(data) (struct fifo_t){                            \
+        .data_p = (uint8_t *)data,                                    \
+        .head = 0,                                                    \
+        .tail = 0,                                                    \
+        .element_size = sizeof(data[0]),                              \
+        .max_number_of_elements = (sizeof(data) / sizeof(data[0]))   \
+    }
+
+/**
+ * Define a single producer, single consumer FIFO for one element type.
+ *
+ * Emits 'struct name_t' and the inline functions name_Init, name_Push,
+ * name_Pop, name_Peek, name_IsEmpty, name_IsFull and name_GetAvailableSlots
+ * with the same semantics as the generic FIFO functions. Items are copied by
+ * assignment, and the capacity must be a power of two so slots are found with
+ * a mask. The indices run freely and wrap at 2^32.
+ *
+ * @param name Prefix of the emitted type and functions.
+ * @param type Element type.
+ * @param capacity Max number of elements, a power of two.
+ */
+#define FIFO_DEFINE(name, type, capacity)                                               \
+    _Static_assert((capacity) > 0 && ((capacity) & ((capacity) - 1)) == 0,              \
+                   #name " capacity must be a power of two");                           \
+                                                                                        \
+    struct name##_t                                                                     \
+    {                                                                                   \
+        type data[(capacity)];                                                          \
+        volatile uint32_t head;                                                         \
+        volatile uint32_t tail;                                                         \
+    };                                                                                  \
+                                                                                        \
+    static inline __attribute__((unused)) void name##_Init(struct name##_t *self_p)     \
+    {                                                                                   \
+        self_p->head = 0;                                                               \
+        self_p->tail = 0;                                                               \
+    }                                                                                   \
+                                                                                        \
+    static inline __attribute__((unused)) bool name##_Push(struct name##_t *self_p,     \
+                                                           const type *item_p)          \
+    {                                                                                   \
+        const uint32_t head = self_p->head;                                             \
+        const uint32_t tail = self_p->tail;                                             \
+        atomic_signal_fence(memory_order_acquire);                                      \
+                                                                                        \
+        if ((head - tail) >= (capacity))                                                \
+        {                                                                               \
+            return false;                                                               \
+        }                                                                               \
+                                                                                        \
+        self_p->data[head & ((capacity) - 1)] = *item_p;                                \
+        atomic_signal_fence(memory_order_release);                                      \
+        self_p->head = head + 1;                                                        \
+        return true;                                                                    \
+    }                                                                                   \
+                                                                                        \
+    static inline __attribute__((unused)) bool name##_Pop(struct name##_t *self_p,      \
+                                                          type *item_p)                 \
+    {                                                                                   \
+        const uint32_t head = self_p->head;                                             \
+        const uint32_t tail = self_p->tail;                                             \
+        atomic_signal_fence(memory_order_acquire);                                      \
+                                                                                        \
+        if (head == tail)                                                               \
+        {                                                                               \
+            return false;                                                               \
+        }                                                                               \
+                                                                                        \
+        *item_p = self_p->data[tail & ((capacity) - 1)];                                \
+        atomic_signal_fence(memory_order_release);                                      \
+        self_p->tail = tail + 1;                                                        \
+        return true;                                                                    \
+    }                                                                                   \
+                                                                                        \
+    static inline __attribute__((unused)) bool name##_Peek(const struct name##_t *self_p, \
+                                                           type *item_p)                \
+    {                                                                                   \
+        const uint32_t head = self_p->head;                                             \
+        const uint32_t tail = self_p->tail;                                             \
+        atomic_signal_fence(memory_order_acquire);                                      \
+                                                                                        \
+        if (head == tail)                                                               \
+        {                                                                               \
+            return false;                                                               \
+        }                                                                               \
+                                                                                        \
+        *item_p = self_p->data[tail & ((capacity) - 1)];                                \
+        return true;                                                                    \
+    }                                                                                   \
+                                                                                        \
+    static inline __attribute__((unused)) bool name##_IsEmpty(const struct name##_t *self_p) \
+    {                                                                                   \
+        return self_p->head == self_p->tail;                                            \
+    }                                                                                   \
+                                                                                        \
+    static inline __attribute__((unused)) bool name##_IsFull(const struct name##_t *self_p) \
+    {                                                                                   \
+        return (self_p->head - self_p->tail) >= (capacity);                             \
+    }                                                                                   \
+                                                                                        \
+    static inline __attribute__((unused)) uint32_t name##_GetAvailableSlots(const struct name##_t *self_p) \
+    {                                                                                   \
+        return (capacity) - (self_p->head - self_p->tail);                              \
+    }
 
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
 //////////////////////////////////////////////////////////////////////////
 
+/**
+ * Single producer, single consumer FIFO.
+ *
+ * One context may push while another context pops, e.g. a CAN RX interrupt and
+ * the main loop, without a critical section. The head is only written by the
+ * producer and the tail only by the consumer. Both run from zero to twice the
+ * capacity so that a full FIFO can be told apart from an empty one without a
+ * shared element count.
+ */
 struct fifo_t
 {
     uint8_t *data_p;
-    uint8_t head;
-    uint8_t tail;
-    uint8_t element_size;
-    uint8_t max_number_of_elements;
-    uint8_t number_of_elements;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t element_size;
+    uint32_t max_number_of_elements;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -69,6 +181,19 @@ struct fifo_t
  */
 bool FIFO_Push(struct fifo_t *self_p, const void *item_p);
 
+/**
+ * Push up to 'number_of_items' items to the FIFO.
+ *
+ * Items are pushed until the FIFO is full, with at most two copies.
+ *
+ * @param fifo Pointer to FIFO.
+ * @param items_p Pointer to the items to push.
+ * @param number_of_items Number of items to push.
+ *
+ * @return Number of pushed items.
+ */
+uint32_t FIFO_PushN(struct fifo_t *self_p, const void *items_p, uint32_t number_of_items);
+
 /**
  * Get and remove the first item in the FIFO.
  *
@@ -79,6 +204,19 @@ bool FIFO_Push(struct fifo_t *self_p, const void *item_p);
  */
 bool FIFO_Pop(struct fifo_t *self_p, void *item_p);
 
+/**
+ * Get and remove up to 'number_of_items' items from the FIFO.
+ *
+ * Items are popped until the FIFO is empty, with at most two copies.
+ *
+ * @param fifo Pointer to FIFO.
+ * @param items_p Pointer to where the items will be stored.
+ * @param number_of_items Max number of items to pop.
+ *
+ * @return Number of popped items.
+ */
+uint32_t FIFO_PopN(struct fifo_t *self_p, void *items_p, uint32_t number_of_items);
+
 /**
  * Get the first item in the FIFO without removing it.
  *
@@ -108,7 +246,9 @@ bool FIFO_IsFull(const struct fifo_t *self_p);
 bool FIFO_IsEmpty(const struct fifo_t *self_p);
 
 /**
- * Reset FIFO.
+ * Remove all items from the FIFO.
+ *
+ * Only called from the consumer context.
  *
  * @param fifo Pointer to FIFO.
  */
@@ -121,6 +261,6 @@ void FIFO_Clear(struct fifo_t *self_p);
  *
  * @return Number of available slots.
  */
-uint8_t FIFO_GetAvailableSlots(const struct fifo_t *self_p);
+uint32_t FIFO_GetAvailableSlots(const struct fifo_t *self_p);
 
 #endif
@@ -33,6 +33,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdbool.h>
 
+#include "utility.h"
 #include "fifo.h"
 
 //////////////////////////////////////////////////////////////////////////
@@ -43,6 +44,14 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //TYPE DEFINITIONS
 //////////////////////////////////////////////////////////////////////////
 
+struct test_item_t
+{
+    uint32_t id;
+    uint8_t data[8];
+};
+
+FIFO_DEFINE(TestFIFO, struct test_item_t, 4)
+
 //////////////////////////////////////////////////////////////////////////
 //VARIABLES
 //////////////////////////////////////////////////////////////////////////
@@ -75,7 +84,6 @@ void test_FIFO_New(void **state)
     assert_int_equal(fifo.tail, 0);
     assert_int_equal(fifo.element_size, 1);
     assert_int_equal(fifo.max_number_of_elements, 8);
-    assert_int_equal(fifo.number_of_elements, 0);
 }
 
 void test_FIFO_Push_NULL_arguments(void **state)
@@ -314,29 +322,202 @@ void test_FIFO_GetAvailableSlots_NotEmpty(void **state)
 
 void test_FIFO_MaxSize(void **state)
 {
-    struct dummy_item
-    {
-        uint8_t data[UINT8_MAX];
-    };
-    struct dummy_item buffer[UINT8_MAX];
+    uint16_t buffer[1000];
     struct fifo_t fifo = FIFO_New(buffer);
 
-    for (size_t i = 0; i < UINT8_MAX; ++i)
+    for (uint16_t i = 0; i < ElementsIn(buffer); ++i)
     {
-        struct dummy_item item = {i};
-        assert_true(FIFO_Push(&fifo, &item));
+        assert_true(FIFO_Push(&fifo, &i));
     }
     assert_true(FIFO_IsFull(&fifo));
 
-    for (size_t i = 0; i < UINT8_MAX; ++i)
+    for (uint16_t i = 0; i < ElementsIn(buffer); ++i)
     {
-        struct dummy_item item;
+        uint16_t item;
         assert_true(FIFO_Pop(&fifo, &item));
-        assert_int_equal(i, item.data[0]);
+        assert_int_equal(i, item);
     }
     assert_true(FIFO_IsEmpty(&fifo));
 }
 
+void test_FIFO_WrapAround(void **state)
+{
+    uint32_t buffer[5];
+    struct fifo_t fifo = FIFO_New(buffer);
+
+    /* Run the indices around several times to cover both halves of the index range. */
+    uint32_t pushed = 0;
+    uint32_t popped = 0;
+    for (size_t i = 0; i < 4 * ElementsIn(buffer); ++i)
+    {
+        assert_true(FIFO_Push(&fifo, &pushed));
+        ++pushed;
+        assert_true(FIFO_Push(&fifo, &pushed));
+        ++pushed;
+        assert_int_equal(FIFO_GetAvailableSlots(&fifo), ElementsIn(buffer) - 2);
+
+        uint32_t item;
+        assert_true(FIFO_Peek(&fifo, &item));
+        assert_int_equal(item, popped);
+        assert_true(FIFO_Pop(&fifo, &item));
+        assert_int_equal(item, popped++);
+        assert_true(FIFO_Pop(&fifo, &item));
+        assert_int_equal(item, popped++);
+        assert_true(FIFO_IsEmpty(&fifo));
+    }
+}
+
+void test_FIFO_PushN_NULL_arguments(void **state)
+{
+    uint8_t dummy_items[2];
+    struct fifo_t dummy_fifo;
+
+    expect_assert_failure(FIFO_PushN(NULL, dummy_items, ElementsIn(dummy_items)));
+    expect_assert_failure(FIFO_PushN(&dummy_fifo, NULL, ElementsIn(dummy_items)));
+}
+
+void test_FIFO_PushN(void **state)
+{
+    uint8_t buffer[8] = {0};
+    const uint8_t items[] = {1, 2, 3, 4, 5, 6};
+    struct fifo_t fifo = FIFO_New(buffer);
+
+    assert_int_equal(FIFO_PushN(&fifo, items, 0), 0);
+    assert_true(FIFO_IsEmpty(&fifo));
+
+    assert_int_equal(FIFO_PushN(&fifo, items, ElementsIn(items)), ElementsIn(items));
+    assert_int_equal(FIFO_GetAvailableSlots(&fifo), 2);
+
+    /* Only the items that fit are pushed. */
+    assert_int_equal(FIFO_PushN(&fifo, items, ElementsIn(items)), 2);
+    assert_true(FIFO_IsFull(&fifo));
+    assert_int_equal(FIFO_PushN(&fifo, items, ElementsIn(items)), 0);
+
+    const uint8_t expected_buffer_content[8] = {1, 2, 3, 4, 5, 6, 1, 2};
+    assert_memory_equal(expected_buffer_content, buffer, sizeof(expected_buffer_content));
+}
+
+void test_FIFO_PopN_NULL_arguments(void **state)
+{
+    uint8_t dummy_items[2];
+    struct fifo_t dummy_fifo;
+
+    expect_assert_failure(FIFO_PopN(NULL, dummy_items, ElementsIn(dummy_items)));
+    expect_assert_failure(FIFO_PopN(&dummy_fifo, NULL, ElementsIn(dummy_items)));
+}
+
+void test_FIFO_PopN(void **state)
+{
+    uint8_t buffer[8];
+    uint8_t items[8] = {0};
+    struct fifo_t fifo = FIFO_New(buffer);
+
+    assert_int_equal(FIFO_PopN(&fifo, items, ElementsIn(items)), 0);
+
+    FillBuffer(&fifo, 5);
+    assert_int_equal(FIFO_PopN(&fifo, items, 2), 2);
+    assert_int_equal(items[0], 0);
+    assert_int_equal(items[1], 1);
+
+    /* Only the available items are popped. */
+    assert_int_equal(FIFO_PopN(&fifo, items, ElementsIn(items)), 3);
+    assert_int_equal(items[0], 2);
+    assert_int_equal(items[1], 3);
+    assert_int_equal(items[2], 4);
+    assert_true(FIFO_IsEmpty(&fifo));
+}
+
+void test_FIFO_PushN_PopN_WrapAround(void **state)
+{
+    uint16_t buffer[7];
+    struct fifo_t fifo = FIFO_New(buffer);
+
+    uint16_t next_push = 0;
+    uint16_t next_pop = 0;
+    for (size_t i = 0; i < 20; ++i)
+    {
+        uint16_t items[5];
+        for (size_t j = 0; j < ElementsIn(items); ++j)
+        {
+            items[j] = next_push + j;
+        }
+        assert_int_equal(FIFO_PushN(&fifo, items, ElementsIn(items)), ElementsIn(items));
+        next_push += ElementsIn(items);
+
+        assert_int_equal(FIFO_PopN(&fifo, items, ElementsIn(items)), ElementsIn(items));
+        for (size_t j = 0; j < ElementsIn(items); ++j)
+        {
+            assert_int_equal(items[j], next_pop++);
+        }
+        assert_true(FIFO_IsEmpty(&fifo));
+    }
+}
+
+void test_FIFO_Define_Init(void **state)
+{
+    struct TestFIFO_t fifo;
+    TestFIFO_Init(&fifo);
+
+    assert_true(TestFIFO_IsEmpty(&fifo));
+    assert_false(TestFIFO_IsFull(&fifo));
+    assert_int_equal(TestFIFO_GetAvailableSlots(&fifo), 4);
+}
+
+void test_FIFO_Define_PushPop(void **state)
+{
+    struct TestFIFO_t fifo;
+    TestFIFO_Init(&fifo);
+
+    struct test_item_t item = {0};
+    assert_false(TestFIFO_Pop(&fifo, &item));
+    assert_false(TestFIFO_Peek(&fifo, &item));
+
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        item = (__typeof__(item)) {.id = i, .data = {i, i}};
+        assert_true(TestFIFO_Push(&fifo, &item));
+    }
+    assert_true(TestFIFO_IsFull(&fifo));
+    assert_int_equal(TestFIFO_GetAvailableSlots(&fifo), 0);
+    assert_false(TestFIFO_Push(&fifo, &item));
+
+    assert_true(TestFIFO_Peek(&fifo, &item));
+    assert_int_equal(item.id, 0);
+
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        assert_true(TestFIFO_Pop(&fifo, &item));
+        assert_int_equal(item.id, i);
+        assert_int_equal(item.data[1], i);
+    }
+    assert_true(TestFIFO_IsEmpty(&fifo));
+}
+
+void test_FIFO_Define_WrapAround(void **state)
+{
+    struct TestFIFO_t fifo;
+    TestFIFO_Init(&fifo);
+
+    /* Start close to the end of the index range to cover the wrap at 2^32. */
+    fifo.head = UINT32_MAX - 2;
+    fifo.tail = UINT32_MAX - 2;
+
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        struct test_item_t item = {.id = i};
+        assert_true(TestFIFO_Push(&fifo, &item));
+        item.id = i + 100;
+        assert_true(TestFIFO_Push(&fifo, &item));
+        assert_int_equal(TestFIFO_GetAvailableSlots(&fifo), 2);
+
+        assert_true(TestFIFO_Pop(&fifo, &item));
+        assert_int_equal(item.id, i);
+        assert_true(TestFIFO_Pop(&fifo, &item));
+        assert_int_equal(item.id, i + 100);
+        assert_true(TestFIFO_IsEmpty(&fifo));
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -370,6 +551,15 @@ int main(int argc, char *argv[])
         cmocka_unit_test(test_FIFO_GetAvailableSlots_Full),
         cmocka_unit_test(test_FIFO_GetAvailableSlots_NotEmpty),
         cmocka_unit_test(test_FIFO_MaxSize),
+        cmocka_unit_test(test_FIFO_WrapAround),
+        cmocka_unit_test(test_FIFO_PushN_NULL_arguments),
+        cmocka_unit_test(test_FIFO_PushN),
+        cmocka_unit_test(test_FIFO_PopN_NULL_arguments),
+        cmocka_unit_test(test_FIFO_PopN),
+        cmocka_unit_test(test_FIFO_PushN_PopN_WrapAround),
+        cmocka_unit_test(test_FIFO_Define_Init),
+        cmocka_unit_test(test_FIFO_Define_PushPop),
+        cmocka_unit_test(test_FIFO_Define_WrapAround),
     };
 
     if (argc >= 2)
@@ -69,12 +69,21 @@ enum download_state_t
     ACTIVE
 };
 
+enum message_state_t
+{
+    MESSAGE_WAIT_FOR_HEADER = 0,
+    MESSAGE_VALID,
+    MESSAGE_INVALID
+};
+
 struct payload_info_t
 {
     uint32_t size;
     uint32_t received_bytes;
     uint32_t crc;
     enum download_state_t state;
+    uint8_t word[4];
+    size_t word_length;
 };
 
 struct module_t
@@ -84,6 +93,9 @@ struct module_t
     firmware_manager_allowed_t update_allowed_func;
     firmware_manager_reset_t reset_func;
     struct payload_info_t payload;
+    struct message_header_t header;
+    size_t header_length;
+    enum message_state_t message_state;
     struct isotp_ctx_t ctx;
     uint8_t rx_buffer[RX_BUFFER_SIZE];
     uint8_t tx_buffer[TX_BUFFER_SIZE];
@@ -104,13 +116,16 @@ static struct module_t module;
 
 static void RxStatusCallback(enum isotp_status_t status);
 static void TxStatusCallback(enum isotp_status_t status);
-static void HandleMessage(void);
+static void HandleMessage(bool complete);
+static void ReceiveMessageHeader(bool complete);
 static void OnReqFirmwareInformation(void);
 static void OnReqReset(void);
 static void OnReqUpdate(void);
 static void OnFirmwareHeader(const struct message_header_t *message_header_p);
-static void OnFirmwareData(const struct message_header_t *message_header_p);
+static void OnFirmwareData(void);
+static void WriteData(const uint8_t *data_p, size_t length);
 static uint32_t GetPageAddress(uint32_t page_index);
+static uint32_t GetMaxImageSize(void);
 static void StoreData(uint32_t address, const uint8_t *data_p, size_t length);
 static void UpdatePageIndex(void);
 
@@ -142,15 +157,15 @@ void FirmwareManager_Init(firmware_manager_reset_t reset)
     Logging_Info(module.logger_p, "Firmware manager initialized");
 }
 
-void FirmwareManager_SetActionChecks(firmware_manager_allowed_t reset, firmware_manager_allowed_t update)
+void FirmwareManager_Process(void)
 {
-    module.reset_allowed_func = reset;
-    module.update_allowed_func = update;
+    HandleMessage(false);
 }
 
-void FirmwareManager_Update(void)
+void FirmwareManager_SetActionChecks(firmware_manager_allowed_t reset, firmware_manager_allowed_t update)
 {
-    ISOTP_Proccess(&module.ctx);
+    module.reset_allowed_func = reset;
+    module.update_allowed_func = update;
 }
 
 bool FirmwareManager_Active(void)
@@ -163,6 +178,11 @@ bool FirmwareManager_DownloadActive(void)
     return module.payload.state == ACTIVE;
 }
 
+void FirmwareManager_GetTransferStatistics(struct isotp_statistics_t *statistics_p)
+{
+    ISOTP_GetStatistics(&module.ctx, statistics_p);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -172,23 +192,29 @@ static void RxStatusCallback(enum isotp_status_t status)
     switch(status)
     {
         case ISOTP_STATUS_DONE:
-            HandleMessage();
+            HandleMessage(true);
             break;
         case ISOTP_STATUS_WAITING:
             /**
-             * Do nothing here, waiting for space in RX-buffer. No need to check for
-             * timeout since it's handled by the ISO-TP layer.
+             * The RX-buffer is full, firmware data is stored to make room for the
+             * rest of the message if 'FirmwareManager_Process' didn't keep up.
+             * No need to check for timeout since it's handled by the ISO-TP layer.
              */
+            HandleMessage(false);
             break;
         case ISOTP_STATUS_TIMEOUT:
         case ISOTP_STATUS_LOST_FRAME:
         case ISOTP_STATUS_OVERFLOW_ABORT:
             Logging_Warning(module.logger_p, "Failed to receive: {status: %u}", (uint32_t)status);
             module.payload.state = IDLE;
+            module.message_state = MESSAGE_WAIT_FOR_HEADER;
+            module.header_length = 0;
             break;
         default:
             Logging_Warning(module.logger_p, "Unknown status: {status: %u}", (uint32_t)status);
             module.payload.state = IDLE;
+            module.message_state = MESSAGE_WAIT_FOR_HEADER;
+            module.header_length = 0;
             break;
     }
 }
@@ -217,23 +243,27 @@ static void TxStatusCallback(enum isotp_status_t status)
     }
 }
 
-static void HandleMessage(void)
+/**
+ * Handle a received message, or the part of one received so far. Firmware
+ * data is stored as soon as it's received so that the whole image can be
+ * sent as one message, all other messages are handled when complete.
+ */
+static void HandleMessage(bool complete)
 {
-    struct message_header_t header;
-    const size_t number_of_bytes = ISOTP_Receive(&module.ctx, &header, sizeof(header));
-    if (number_of_bytes == sizeof(header))
+    if (module.message_state == MESSAGE_WAIT_FOR_HEADER)
     {
-        const uint32_t header_crc = CRC_Calculate(&header, sizeof(header) - sizeof(header.header_crc));
-        Logging_Debug(module.logger_p,
-                      "header: {type: %u, size: %u, crc: %x, expected_crc: %x}",
-                      header.type,
-                      header.size,
-                      header.header_crc,
-                      header_crc);
+        ReceiveMessageHeader(complete);
+    }
 
-        if (header.header_crc == header_crc)
+    if (module.message_state == MESSAGE_VALID)
+    {
+        if (module.header.type == REQ_FW_DATA)
+        {
+            OnFirmwareData();
+        }
+        else if (complete)
         {
-            switch (header.type)
+            switch (module.header.type)
             {
                 case REQ_FW_INFO:
                     OnReqFirmwareInformation();
@@ -245,24 +275,65 @@ static void HandleMessage(void)
                     OnReqUpdate();
                     break;
                 case REQ_FW_HEADER:
-                    OnFirmwareHeader(&header);
-                    break;
-                case REQ_FW_DATA:
-                    OnFirmwareData(&header);
+                    OnFirmwareHeader(&module.header);
                     break;
                 default:
-                    Logging_Warning(module.logger_p, "Unknown type: {type: %u}", header.type);
+                    Logging_Warning(module.logger_p, "Unknown type: {type: %u}", module.header.type);
                     break;
             }
         }
         else
         {
-            Logging_Error(module.logger_p, "CRC mismatch: {crc: %x, expected_crc: %x}", header.header_crc, header_crc);
+            /* Wait for the rest of the message. */
         }
     }
+
+    if (complete)
+    {
+        module.message_state = MESSAGE_WAIT_FOR_HEADER;
+        module.header_length = 0;
+    }
+}
+
+/**
+ * Collect the message header, the header of a message that is still being
+ * received may be split over several calls.
+ */
+static void ReceiveMessageHeader(bool complete)
+{
+    struct message_header_t *header_p = &module.header;
+    module.header_length += ISOTP_Receive(&module.ctx,
+                                          (uint8_t *)header_p + module.header_length,
+                                          sizeof(*header_p) - module.header_length);
+
+    if (module.header_length == sizeof(*header_p))
+    {
+        const uint32_t header_crc = CRC_Calculate(header_p, sizeof(*header_p) - sizeof(header_p->header_crc));
+        Logging_Debug(module.logger_p,
+                      "header: {type: %u, size: %u, crc: %x, expected_crc: %x}",
+                      header_p->type,
+                      header_p->size,
+                      header_p->header_crc,
+                      header_crc);
+
+        if (header_p->header_crc == header_crc)
+        {
+            module.message_state = MESSAGE_VALID;
+        }
+        else
+        {
+            Logging_Error(module.logger_p, "CRC mismatch: {crc: %x, expected_crc: %x}", header_p->header_crc, header_crc);
+            module.message_state = MESSAGE_INVALID;
+        }
+    }
+    else if (complete)
+    {
+        Logging_Error(module.logger_p, "Incomplete header: {size: %u}", module.header_length);
+        module.message_state = MESSAGE_INVALID;
+    }
     else
     {
-        Logging_Error(module.logger_p, "Incomplete header: {size: %u}", number_of_bytes);
+        /* Wait for the rest of the header. */
     }
 }
 
@@ -346,7 +417,15 @@ static void OnFirmwareHeader(const struct message_header_t *message_header_p)
                          message_header_p->payload_crc,
                          crc);
 
-            if (message_header_p->payload_crc == crc)
+            if (message_header_p->payload_crc != crc)
+            {
+                Logging_Error(module.logger_p, "CRC mismatch: {crc: %x, expected_crc: %x}", message_header_p->payload_crc, crc);
+            }
+            else if (image.size > GetMaxImageSize())
+            {
+                Logging_Error(module.logger_p, "Image too large: {size: %u, max_size: %u}", image.size, GetMaxImageSize());
+            }
+            else
             {
                 const uint32_t page_address = GetPageAddress(0);
                 if (Flash_ErasePage(page_address))
@@ -354,14 +433,11 @@ static void OnFirmwareHeader(const struct message_header_t *message_header_p)
                     module.payload.size = image.size;
                     module.payload.crc = image.crc;
                     module.payload.received_bytes = 0;
+                    module.payload.word_length = 0;
                     module.payload.state = ACTIVE;
                     module.page_index = 0;
                 }
             }
-            else
-            {
-                Logging_Error(module.logger_p, "CRC mismatch: {crc: %x, expected_crc: %x}", message_header_p->payload_crc, crc);
-            }
         }
     }
     else
@@ -375,30 +451,67 @@ static uint32_t GetPageAddress(uint32_t page_index)
     return page_index * PAGE_SIZE + Board_GetApplicationAddress();
 }
 
-static void OnFirmwareData(const struct message_header_t *message_header_p __attribute__((unused)))
+static uint32_t GetMaxImageSize(void)
 {
-    uint8_t data[128];
-    _Static_assert(PAGE_SIZE % (sizeof(data)) == 0, "Invalid buffer size");
+    /* The image must not reach into NVS, the configuration would be erased. */
+    return Board_GetNVSAddress() - Board_GetApplicationAddress();
+}
 
-    size_t number_of_bytes;
+static void OnFirmwareData(void)
+{
     while (module.payload.state == ACTIVE)
     {
-        number_of_bytes = ISOTP_Receive(&module.ctx, data, sizeof(data));
+        const void *data_p;
+        size_t number_of_bytes = ISOTP_Peek(&module.ctx, &data_p);
         if (number_of_bytes == 0)
         {
             break;
         }
 
-        const uint32_t address = (uint32_t)Board_GetApplicationAddress() + module.payload.received_bytes;
-        const uint32_t number_of_pages = (module.payload.size + PAGE_SIZE - 1) / PAGE_SIZE;
-        const uint32_t page_index = (module.payload.received_bytes) / PAGE_SIZE;
-        Logging_Debug(module.logger_p, "data: {received_bytes: %u, pages: %u, page_index: %u, address: %x}", module.payload.received_bytes, number_of_pages, page_index, address);
+        /* The next page is erased when the current one is filled, never write past it. */
+        const size_t remaining_page_bytes = PAGE_SIZE - (module.payload.received_bytes % PAGE_SIZE);
+        number_of_bytes = number_of_bytes < remaining_page_bytes ? number_of_bytes : remaining_page_bytes;
 
-        module.payload.received_bytes += number_of_bytes;
-        StoreData(address, data, number_of_bytes);
+        /**
+         * Flash is programmed directly from the RX buffer one word at a time. A word
+         * split by the end of the RX buffer, or by the end of the data received so
+         * far, is collected separately so that it's programmed in one piece.
+         */
+        if ((module.payload.word_length == 0) && (number_of_bytes >= sizeof(module.payload.word)))
+        {
+            number_of_bytes -= number_of_bytes % sizeof(module.payload.word);
+            WriteData(data_p, number_of_bytes);
+            ISOTP_Consume(&module.ctx, number_of_bytes);
+        }
+        else
+        {
+            const size_t missing_bytes = sizeof(module.payload.word) - module.payload.word_length;
+            number_of_bytes = number_of_bytes < missing_bytes ? number_of_bytes : missing_bytes;
+            module.payload.word_length += ISOTP_Receive(&module.ctx,
+                                                        &module.payload.word[module.payload.word_length],
+                                                        number_of_bytes);
+
+            const bool last_word = module.payload.received_bytes + module.payload.word_length >= module.payload.size;
+            if ((module.payload.word_length == sizeof(module.payload.word)) || last_word)
+            {
+                WriteData(module.payload.word, module.payload.word_length);
+                module.payload.word_length = 0;
+            }
+        }
     }
 }
 
+static void WriteData(const uint8_t *data_p, size_t length)
+{
+    const uint32_t address = (uint32_t)Board_GetApplicationAddress() + module.payload.received_bytes;
+    const uint32_t number_of_pages = (module.payload.size + PAGE_SIZE - 1) / PAGE_SIZE;
+    const uint32_t page_index = (module.payload.received_bytes) / PAGE_SIZE;
+    Logging_Debug(module.logger_p, "data: {received_bytes: %u, pages: %u, page_index: %u, address: %x}", module.payload.received_bytes, number_of_pages, page_index, address);
+
+    module.payload.received_bytes += length;
+    StoreData(address, data_p, length);
+}
+
 static void StoreData(uint32_t address, const uint8_t *data_p, size_t length)
 {
     if (Flash_Write(address, data_p, length))
@@ -33,6 +33,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////
 
 #include <stdbool.h>
+#include "isotp.h"
 
 //////////////////////////////////////////////////////////////////////////
 //DEFINES
@@ -54,6 +55,14 @@ typedef void (*firmware_manager_reset_t)(void);
  */
 void FirmwareManager_Init(firmware_manager_reset_t reset);
 
+/**
+ * Store received firmware data, call after 'ISOTP_Proccess'.
+ *
+ * Data is stored as it arrives so that the RX-buffer never fills up during a
+ * download, and the sender isn't held back by WAIT flow control frames.
+ */
+void FirmwareManager_Process(void);
+
 /**
  * Set callbacks used determine if an action is allowed.
  *
@@ -62,11 +71,6 @@ void FirmwareManager_Init(firmware_manager_reset_t reset);
  */
 void FirmwareManager_SetActionChecks(firmware_manager_allowed_t reset, firmware_manager_allowed_t update);
 
-/**
- * Update the internal state.
- */
-void FirmwareManager_Update(void);
-
 /**
  * Check if the firmware manager is active.
  *
@@ -81,4 +85,11 @@ bool FirmwareManager_Active(void);
  */
 bool FirmwareManager_DownloadActive(void);
 
+/**
+ * Get the throughput statistics of the firmware transfer link.
+ *
+ * @param statistics_p Pointer to struct where the statistics are stored.
+ */
+void FirmwareManager_GetTransferStatistics(struct isotp_statistics_t *statistics_p);
+
 #endif
@@ -58,12 +58,12 @@ __attribute__((weak)) void FirmwareManager_Init(firmware_manager_reset_t reset)
 
 }
 
-__attribute__((weak)) void FirmwareManager_SetActionChecks(firmware_manager_allowed_t reset, firmware_manager_allowed_t update)
+__attribute__((weak)) void FirmwareManager_Process(void)
 {
 
 }
 
-__attribute__((weak)) void FirmwareManager_Update(void)
+__attribute__((weak)) void FirmwareManager_SetActionChecks(firmware_manager_allowed_t reset, firmware_manager_allowed_t update)
 {
 
 }
@@ -78,6 +78,12 @@ __attribute__((weak)) bool FirmwareManager_DownloadActive(void)
     return mock_type(bool);
 }
 
+__attribute__((weak)) void FirmwareManager_GetTransferStatistics(struct isotp_statistics_t *statistics_p)
+{
+    assert_non_null(statistics_p);
+    *statistics_p = *mock_ptr_type(struct isotp_statistics_t *);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
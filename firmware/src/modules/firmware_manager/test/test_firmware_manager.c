@@ -69,7 +69,7 @@ static isotp_status_callback_t tx_cb_fp;
 //MOCKS
 //////////////////////////////////////////////////////////////////////////
 
-void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint16_t rx_id, uint16_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp)
+void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint32_t rx_id, uint32_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp)
 {
     assert_non_null(ctx_p);
     assert_non_null(rx_buffer_p);
@@ -115,6 +115,13 @@ static void ExpectFirmwareImage(struct firmware_image_t *image_p, uint32_t crc)
     will_return(CRC_Calculate, crc);
 }
 
+static void ExpectFirmwareData(const void *data_p, size_t length)
+{
+    will_return(ISOTP_Peek, length);
+    will_return(ISOTP_Peek, data_p);
+    expect_value(ISOTP_Consume, length, length);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //TESTS
 //////////////////////////////////////////////////////////////////////////
@@ -129,12 +136,6 @@ static void test_FirmwareManager_Init(void **state)
     assert_false(FirmwareManager_DownloadActive());
 }
 
-static void test_FirmwareManager_Update(void **state)
-{
-    expect_function_call(ISOTP_Proccess);
-    FirmwareManager_Update();
-}
-
 static void test_FirmwareManager_GetFirmwareInformation(void **state)
 {
     const uint32_t fake_crc = 0xAABBCCDD;
@@ -420,13 +421,13 @@ static void test_FirmwareManager_RequestUpdate_Allowed(void **state)
 
 static void test_FirmwareManager_WaitForRxSpace(void **state)
 {
-    /* Expect nothing to happen while waiting */
-    rx_cb_fp(ISOTP_STATUS_WAITING);
-
     const uint32_t fake_crc = 0xAABCDEFF;
     struct message_header_t message_header = {REQ_RESET, 0, 0, fake_crc};
     ExpectMessageHeader(&message_header, fake_crc);
 
+    /* Only the header is received while waiting, the message is handled when complete. */
+    rx_cb_fp(ISOTP_STATUS_WAITING);
+
     expect_function_call(ResetCallback);
     rx_cb_fp(ISOTP_STATUS_DONE);
     assert_false(FirmwareManager_Active());
@@ -470,6 +471,7 @@ static void test_FirmwareManager_DownloadFirmware(void **state)
     const uint32_t fake_crc = 0xAABBCCDD;
 
     will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
     will_return_uint_count(Flash_ErasePage, true, image_size / page_size);
     will_return_uint_always(Flash_Write, true);
 
@@ -490,13 +492,164 @@ static void test_FirmwareManager_DownloadFirmware(void **state)
     const uint8_t data[128] = {0};
     for (size_t i = 0; i < image_size / sizeof(data); ++i)
     {
-        will_return(ISOTP_Receive, sizeof(data));
-        will_return(ISOTP_Receive, data);
+        ExpectFirmwareData(data, sizeof(data));
     }
     rx_cb_fp(ISOTP_STATUS_DONE);
     assert_false(FirmwareManager_DownloadActive());
 }
 
+static void test_FirmwareManager_DownloadFirmware_SplitRegions(void **state)
+{
+    const uint32_t page_size = 1024;
+    const uint32_t image_size = page_size * 2;
+    const uint32_t fake_crc = 0xAABBCCDD;
+
+    will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
+    will_return_uint_count(Flash_ErasePage, true, image_size / page_size);
+    will_return_uint_count(Flash_Write, true, 4);
+
+    /* Firmware header part */
+    struct message_header_t message_header = {REQ_FW_HEADER, 0, fake_crc, fake_crc};
+    ExpectMessageHeader(&message_header, fake_crc);
+
+    struct firmware_image_t image = {1, image_size, fake_crc};
+    ExpectFirmwareImage(&image, fake_crc);
+
+    rx_cb_fp(ISOTP_STATUS_DONE);
+    assert_true(FirmwareManager_DownloadActive());
+
+    /* Firmware data part */
+    message_header = (struct message_header_t) {REQ_FW_DATA, 0, 0, fake_crc};
+    ExpectMessageHeader(&message_header, fake_crc);
+
+    static const uint8_t data[1030] = {0};
+
+    /* A region is never written past the end of a page. */
+    will_return(ISOTP_Peek, sizeof(data));
+    will_return(ISOTP_Peek, data);
+    expect_value(ISOTP_Consume, length, page_size);
+
+    /* Only whole words are written from a region. */
+    will_return(ISOTP_Peek, 6);
+    will_return(ISOTP_Peek, data);
+    expect_value(ISOTP_Consume, length, 4);
+
+    /* A word split by the end of the RX buffer is copied. */
+    will_return(ISOTP_Peek, 2);
+    will_return(ISOTP_Peek, data);
+    will_return(ISOTP_Receive, 2);
+    will_return(ISOTP_Receive, data);
+    will_return(ISOTP_Peek, sizeof(data));
+    will_return(ISOTP_Peek, data);
+    will_return(ISOTP_Receive, 2);
+    will_return(ISOTP_Receive, data);
+
+    ExpectFirmwareData(data, page_size - 8);
+    rx_cb_fp(ISOTP_STATUS_DONE);
+    assert_false(FirmwareManager_DownloadActive());
+}
+
+static void test_FirmwareManager_DownloadFirmware_SingleMessage(void **state)
+{
+    const uint32_t page_size = 1024;
+    const uint32_t image_size = page_size * 2;
+    const uint32_t fake_crc = 0xAABBCCDD;
+
+    will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
+    will_return_uint_count(Flash_ErasePage, true, image_size / page_size);
+    will_return_uint_count(Flash_Write, true, 3);
+
+    /* Firmware header part */
+    struct message_header_t message_header = {REQ_FW_HEADER, 0, fake_crc, fake_crc};
+    ExpectMessageHeader(&message_header, fake_crc);
+
+    struct firmware_image_t image = {1, image_size, fake_crc};
+    ExpectFirmwareImage(&image, fake_crc);
+
+    rx_cb_fp(ISOTP_STATUS_DONE);
+    assert_true(FirmwareManager_DownloadActive());
+
+    /* The whole image is sent in one message that is larger than the RX buffer. */
+    message_header = (struct message_header_t) {REQ_FW_DATA, image_size, 0, fake_crc};
+    ExpectMessageHeader(&message_header, fake_crc);
+
+    /* Data is stored while waiting for RX space, a partial word is kept until the rest is received. */
+    static const uint8_t data[1024] = {0};
+    will_return(ISOTP_Peek, page_size - 2);
+    will_return(ISOTP_Peek, data);
+    expect_value(ISOTP_Consume, length, page_size - 4);
+    will_return(ISOTP_Peek, 2);
+    will_return(ISOTP_Peek, data);
+    will_return(ISOTP_Receive, 2);
+    will_return(ISOTP_Receive, data);
+    will_return(ISOTP_Peek, 0);
+    will_return(ISOTP_Peek, data);
+    rx_cb_fp(ISOTP_STATUS_WAITING);
+    assert_true(FirmwareManager_DownloadActive());
+
+    will_return(ISOTP_Peek, page_size + 2);
+    will_return(ISOTP_Peek, data);
+    will_return(ISOTP_Receive, 2);
+    will_return(ISOTP_Receive, data);
+    ExpectFirmwareData(data, page_size);
+    rx_cb_fp(ISOTP_STATUS_DONE);
+    assert_false(FirmwareManager_DownloadActive());
+}
+
+static void test_FirmwareManager_DownloadFirmware_Process(void **state)
+{
+    const uint32_t page_size = 1024;
+    const uint32_t image_size = page_size * 2;
+    const uint32_t fake_crc = 0xAABBCCDD;
+
+    will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
+    will_return_uint_count(Flash_ErasePage, true, image_size / page_size);
+    will_return_uint_count(Flash_Write, true, 2);
+
+    /* Nothing is received while idle. */
+    will_return(ISOTP_Receive, 0);
+    will_return(ISOTP_Receive, NULL);
+    FirmwareManager_Process();
+
+    /* Firmware header part */
+    struct message_header_t message_header = {REQ_FW_HEADER, 0, fake_crc, fake_crc};
+    ExpectMessageHeader(&message_header, fake_crc);
+
+    struct firmware_image_t image = {1, image_size, fake_crc};
+    ExpectFirmwareImage(&image, fake_crc);
+
+    rx_cb_fp(ISOTP_STATUS_DONE);
+    assert_true(FirmwareManager_DownloadActive());
+
+    /* The header is collected from the parts received so far. */
+    message_header = (struct message_header_t) {REQ_FW_DATA, image_size, 0, fake_crc};
+    will_return(ISOTP_Receive, 9);
+    will_return(ISOTP_Receive, &message_header);
+    FirmwareManager_Process();
+
+    will_return(ISOTP_Receive, sizeof(message_header) - 9);
+    will_return(ISOTP_Receive, (uint8_t *)&message_header + 9);
+    will_return(CRC_Calculate, fake_crc);
+    will_return(ISOTP_Peek, 0);
+    will_return(ISOTP_Peek, NULL);
+    FirmwareManager_Process();
+
+    /* Data is stored as it arrives, before the RX-buffer is full. */
+    static const uint8_t data[1024] = {0};
+    ExpectFirmwareData(data, page_size);
+    will_return(ISOTP_Peek, 0);
+    will_return(ISOTP_Peek, NULL);
+    FirmwareManager_Process();
+    assert_true(FirmwareManager_DownloadActive());
+
+    ExpectFirmwareData(data, page_size);
+    rx_cb_fp(ISOTP_STATUS_DONE);
+    assert_false(FirmwareManager_DownloadActive());
+}
+
 static void test_FirmwareManager_DownloadFirmware_NoFirmwareHeader(void **state)
 {
     const uint32_t fake_crc = 0xAABBCCDD;
@@ -538,6 +691,32 @@ static void test_FirmwareManager_DownloadFirmware_FirmwareHeaderCRCMismatch(void
     rx_cb_fp(ISOTP_STATUS_DONE);
 }
 
+static void test_FirmwareManager_DownloadFirmware_ImageTooLarge(void **state)
+{
+    const uint32_t max_image_size = 0x17000 - 0x1000;
+    const uint32_t fake_crc = 0xAABBCCDD;
+
+    will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
+
+    /* Firmware header part */
+    struct message_header_t message_header = {REQ_FW_HEADER, 0, fake_crc, fake_crc};
+    ExpectMessageHeader(&message_header, fake_crc);
+
+    struct firmware_image_t image = {1, max_image_size + 4, fake_crc};
+    ExpectFirmwareImage(&image, fake_crc);
+
+    rx_cb_fp(ISOTP_STATUS_DONE);
+
+    /* Firmware data part */
+    message_header = (struct message_header_t) {REQ_FW_DATA, 0, 0, fake_crc};
+    ExpectMessageHeader(&message_header, fake_crc);
+
+    /* Discard firmware data message, no page is erased. */
+    rx_cb_fp(ISOTP_STATUS_DONE);
+    assert_false(FirmwareManager_DownloadActive());
+}
+
 static void test_FirmwareManager_DownloadFirmware_Timeout(void **state)
 {
     const uint32_t page_size = 1024;
@@ -545,6 +724,7 @@ static void test_FirmwareManager_DownloadFirmware_Timeout(void **state)
     const uint32_t fake_crc = 0xAABBCCDD;
 
     will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
     will_return(Flash_ErasePage, true);
 
     /* Firmware header part */
@@ -572,6 +752,7 @@ static void test_FirmwareManager_DownloadFirmware_UnknownStatus(void **state)
     const uint32_t fake_crc = 0xAABBCCDD;
 
     will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
     will_return(Flash_ErasePage, true);
 
     /* Firmware header part */
@@ -599,6 +780,7 @@ static void test_FirmwareManager_DownloadFirmware_FailedHeaderErasePage(void **s
     const uint32_t fake_crc = 0xAABBCCDD;
 
     will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
     will_return(Flash_ErasePage, false);
 
     /* Firmware header part */
@@ -625,6 +807,7 @@ static void test_FirmwareManager_DownloadFirmware_FailedWrite(void **state)
     const uint32_t fake_crc = 0xAABBCCDD;
 
     will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
     will_return(Flash_ErasePage, true);
     will_return(Flash_Write, false);
 
@@ -643,8 +826,7 @@ static void test_FirmwareManager_DownloadFirmware_FailedWrite(void **state)
 
     /* Only expect one data chunk since the download is aborted on flash write failure */
     const uint8_t data[128] = {0};
-    will_return(ISOTP_Receive, sizeof(data));
-    will_return(ISOTP_Receive, data);
+    ExpectFirmwareData(data, sizeof(data));
     rx_cb_fp(ISOTP_STATUS_DONE);
 }
 
@@ -655,6 +837,7 @@ static void test_FirmwareManager_DownloadFirmware_FailedDataErasePage(void **sta
     const uint32_t fake_crc = 0xAABBCCDD;
 
     will_return_uint_maybe(Board_GetApplicationAddress, 0x1000);
+    will_return_uint_maybe(Board_GetNVSAddress, 0x17000);
     will_return_uint_always(Flash_Write, true);
 
     /* Firmware header part */
@@ -675,8 +858,7 @@ static void test_FirmwareManager_DownloadFirmware_FailedDataErasePage(void **sta
     const uint8_t data[128] = {0};
     for (size_t i = 0; i < page_size / sizeof(data); ++i)
     {
-        will_return(ISOTP_Receive, sizeof(data));
-        will_return(ISOTP_Receive, data);
+        ExpectFirmwareData(data, sizeof(data));
     }
     will_return(Flash_ErasePage, false);
     rx_cb_fp(ISOTP_STATUS_DONE);
@@ -691,7 +873,6 @@ int main(int argc, char *argv[])
     const struct CMUnitTest test_firmware_manager[] =
     {
         cmocka_unit_test(test_FirmwareManager_Init),
-        cmocka_unit_test_setup(test_FirmwareManager_Update, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_GetFirmwareInformation, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_GetFirmwareInformation_InvalidImageHeader, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_GetFirmwareInformation_InvalidImage, Setup),
@@ -710,9 +891,13 @@ int main(int argc, char *argv[])
         cmocka_unit_test_setup(test_FirmwareManager_HeaderCRCMismatch, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_HeaderUnknownType, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware, Setup),
+        cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_SplitRegions, Setup),
+        cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_SingleMessage, Setup),
+        cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_Process, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_NoFirmwareHeader, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_FirmwareHeaderSizeMismatch, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_FirmwareHeaderCRCMismatch, Setup),
+        cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_ImageTooLarge, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_Timeout, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_UnknownStatus, Setup),
         cmocka_unit_test_setup(test_FirmwareManager_DownloadFirmware_FailedHeaderErasePage, Setup),
@@ -42,10 +42,18 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 
 #define SF_DATA_LENGTH 7
 #define FF_DATA_LENGTH 6
+#define ESCAPE_FF_DATA_LENGTH 2
 #define CF_DATA_LENGTH 7
 #define WF_MAX 10
 #define CF_TIMEOUT_MS 1000
 #define FC_TIMEOUT_MS 1000
+#define FF_DL_MAX 4095
+#define MAX_PAYLOAD_SIZE UINT32_MAX /* FF_DL is 32 bits when the escape sequence is used. */
+#define MAX_ADAPTIVE_ST_MS 127
+#define INITIAL_BLOCK_SIZE (ISOTP_FRAME_POOL_SIZE / 2)
+#define NO_FRAME UINT8_MAX
+
+_Static_assert(ISOTP_FRAME_POOL_SIZE < NO_FRAME, "The frame pool is indexed with 8 bits!");
 
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
@@ -81,6 +89,17 @@ struct isotp_ff_t
     uint8_t size_low;
     uint8_t data[FF_DATA_LENGTH];
 };
+
+/* First frame with the ISO 15765-2:2016 escape sequence, used for payloads larger than FF_DL_MAX. */
+struct isotp_escape_ff_t
+{
+    uint8_t size_high : 4;
+    uint8_t type : 4;
+    uint8_t size_low;
+    uint8_t size[4];
+    uint8_t data[ESCAPE_FF_DATA_LENGTH];
+};
+
 struct isotp_cf_t
 {
     uint8_t index : 4;
@@ -96,44 +115,103 @@ struct isotp_fc_t
     uint8_t st;
 };
 
+struct pool_frame_t
+{
+    struct can_frame_t frame;
+    uint8_t next;
+};
+
+struct channel_t
+{
+    uint32_t rx_id;
+    struct isotp_ctx_t *ctx_p;
+};
+
+struct module_t
+{
+    struct channel_t channels[ISOTP_MAX_NUMBER_OF_CHANNELS];
+    size_t number_of_channels;
+    struct pool_frame_t frame_pool[ISOTP_FRAME_POOL_SIZE];
+    struct isotp_frame_queue_t free_frames;
+};
+
 //////////////////////////////////////////////////////////////////////////
 //VARIABLES
 //////////////////////////////////////////////////////////////////////////
 
+static struct module_t module;
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTION PROTOTYPES
 //////////////////////////////////////////////////////////////////////////
 
-static inline void ConfigureRxLink(struct isotp_recv_link_t *link_p, void *rx_buffer_p, size_t rx_buffer_size, uint16_t rx_id, uint16_t tx_id, uint8_t separation_time, isotp_status_callback_t callback_fp);
-static inline void ConfigureTxLink(struct isotp_send_link_t *link_p, void *tx_buffer_p, size_t tx_buffer_size, uint16_t rx_id, uint16_t tx_id, isotp_status_callback_t callback_fp);
+static inline void ConfigureRxLink(struct isotp_recv_link_t *link_p, void *rx_buffer_p, size_t rx_buffer_size, uint32_t rx_id, uint32_t tx_id, uint8_t separation_time, isotp_status_callback_t callback_fp);
+static inline void ConfigureTxLink(struct isotp_send_link_t *link_p, void *tx_buffer_p, size_t tx_buffer_size, uint32_t rx_id, uint32_t tx_id, isotp_status_callback_t callback_fp);
 static void ProccessRxLink(struct isotp_recv_link_t *link_p);
 static void ProccessTxLink(struct isotp_send_link_t *link_p);
+static void UpdateStatistics(struct isotp_ctx_t *ctx_p);
+static struct channel_t *GetChannel(const struct isotp_ctx_t *ctx_p, uint32_t rx_id);
+static struct isotp_ctx_t *GetContext(uint32_t rx_id);
+static void EnqueueFrame(struct isotp_frame_queue_t *queue_p, uint8_t index);
+static uint8_t DequeueFrame(struct isotp_frame_queue_t *queue_p);
+static bool PushFrame(struct isotp_link_t *link_p, const struct can_frame_t *frame_p);
+static bool PopFrame(struct isotp_link_t *link_p, struct can_frame_t *frame_p);
+static void ReleaseFrames(struct isotp_link_t *link_p);
 static void CanListener(const struct can_frame_t *frame_p, void *arg_p);
 static inline enum isotp_frame_type_t GetFrameType(const struct can_frame_t *frame_p);
 static void HandleSingleFrame(struct isotp_recv_link_t *link_p, const struct can_frame_t *frame_p);
 static void HandleFirstFrame(struct isotp_recv_link_t *link_p, const struct can_frame_t *frame_p);
-static void CheckForFirstAndSingleFrame(struct isotp_recv_link_t *link_p);
+static bool CheckForFirstAndSingleFrame(struct isotp_recv_link_t *link_p);
 static void SendFlowControlFrame(struct isotp_recv_link_t *link_p, enum isotp_flow_control_flag_t status);
-static void CheckForConsecutiveFrame(struct isotp_recv_link_t *link_p);
+static bool CheckForConsecutiveFrame(struct isotp_recv_link_t *link_p);
 static void HandleConsecutiveFrame(struct isotp_recv_link_t *link_p, const struct can_frame_t *frame_p);
-static void CheckIfReadyForData(struct isotp_recv_link_t *link_p);
+static bool CheckIfReadyForData(struct isotp_recv_link_t *link_p);
 static uint8_t GetBlockSize(const struct isotp_recv_link_t *link_p);
-static bool SendSingleFrame(const struct isotp_send_link_t *link_p, const void *data_p, size_t length);
+static uint8_t GetSeparationTime(const struct isotp_recv_link_t *link_p);
+static void UpdateFrameQueuePeak(struct isotp_recv_link_t *link_p);
+static void AdaptFlowControl(struct isotp_recv_link_t *link_p);
+static bool SendSingleFrame(struct isotp_send_link_t *link_p, const void *data_p, size_t length);
 static bool SendFirstFrame(struct isotp_send_link_t *link_p, size_t length);
-static void CheckIfSeparationTimeHasElapsed(struct isotp_send_link_t *link_p);
-static void CheckForFlowControlFrame(struct isotp_send_link_t *link_p);
+static size_t ReadTxData(struct isotp_send_link_t *link_p, void *destination_p, size_t length);
+static bool CheckIfPacedFramesAreSent(struct isotp_send_link_t *link_p);
+static bool CheckForFlowControlFrame(struct isotp_send_link_t *link_p);
 static void HandleFlowControlFrame(struct isotp_send_link_t *link_p, const struct can_frame_t *frame_p);
 static uint32_t SeparationTimeToUs(uint8_t st);
+static bool HasTransmitQueueSpace(const struct isotp_send_link_t *link_p);
 static bool SendConsecutiveFrame(struct isotp_send_link_t *link_p);
 
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
 
-void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint16_t rx_id, uint16_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp)
+void ISOTP_Init(void)
+{
+    module = (__typeof__(module)) {0};
+    for (uint8_t i = 0; i < ISOTP_FRAME_POOL_SIZE; ++i)
+    {
+        EnqueueFrame(&module.free_frames, i);
+    }
+}
+
+void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint32_t rx_id, uint32_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp)
 {
     assert(ctx_p != NULL);
 
+    const uint32_t id_mask = CANINTERFACE_EXTENDED_ID_MASK;
+    struct channel_t *channel_p = GetChannel(ctx_p, rx_id);
+    const bool new_rx_id = (channel_p->ctx_p == NULL) || (channel_p->rx_id != rx_id);
+    if (channel_p->ctx_p != NULL)
+    {
+        ReleaseFrames(&channel_p->ctx_p->rx_link.base);
+        ReleaseFrames(&channel_p->ctx_p->tx_link.base);
+
+        /* The channel is moved to the new RX ID, the old one is no longer received. */
+        if (new_rx_id)
+        {
+            CANInterface_UnregisterListener(channel_p->rx_id, id_mask, CANINTERFACE_PRIORITY_BULK, CanListener, &module);
+        }
+    }
+
     *ctx_p = (__typeof__(*ctx_p)) {0};
     ctx_p->logger_p = Logging_GetLogger(ISOTP_LOGGER_NAME);
     Logging_SetLevel(ctx_p->logger_p, ISOTP_LOGGER_DEBUG_LEVEL);
@@ -142,10 +220,18 @@ void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_s
     ConfigureRxLink(&ctx_p->rx_link, rx_buffer_p, rx_buffer_size, rx_id, tx_id, default_separation_time, rx_callback_fp);
     ConfigureTxLink(&ctx_p->tx_link, tx_buffer_p, tx_buffer_size, rx_id, tx_id, tx_callback_fp);
 
-    const uint32_t id_mask = 0xffff;
-    CANInterface_AddFilter(rx_id, id_mask);
-    CANInterface_RegisterListener(CanListener, &ctx_p->rx_link);
-    CANInterface_RegisterListener(CanListener, &ctx_p->tx_link);
+    if (channel_p->ctx_p == NULL)
+    {
+        ++module.number_of_channels;
+    }
+    channel_p->rx_id = rx_id;
+    channel_p->ctx_p = ctx_p;
+
+    /* All channels share one listener, only a filter is added for each RX ID. */
+    if (new_rx_id)
+    {
+        CANInterface_RegisterListener(rx_id, id_mask, CANINTERFACE_PRIORITY_BULK, CanListener, &module);
+    }
 
     Logging_Info(ctx_p->logger_p, "ISO-TP connection initialized: {rx_id: 0x%x, tx_id: 0x%x}", rx_id, tx_id);
 }
@@ -156,12 +242,15 @@ void ISOTP_SetSeparationTime(struct isotp_ctx_t *ctx_p, uint8_t separation_time)
     ctx_p->rx_link.base.separation_time = separation_time;
 }
 
-void ISOTP_Proccess(struct isotp_ctx_t *ctx_p)
+void ISOTP_Proccess(void)
 {
-    assert(ctx_p != NULL);
-
-    ProccessRxLink(&ctx_p->rx_link);
-    ProccessTxLink(&ctx_p->tx_link);
+    for (size_t i = 0; i < module.number_of_channels; ++i)
+    {
+        struct isotp_ctx_t *ctx_p = module.channels[i].ctx_p;
+        ProccessRxLink(&ctx_p->rx_link);
+        ProccessTxLink(&ctx_p->tx_link);
+        UpdateStatistics(ctx_p);
+    }
 }
 
 bool ISOTP_Send(struct isotp_ctx_t *ctx_p, const void *data_p, size_t length)
@@ -172,6 +261,7 @@ bool ISOTP_Send(struct isotp_ctx_t *ctx_p, const void *data_p, size_t length)
     bool status = false;
     if (ctx_p->tx_link.state == ISOTP_TX_INACTIVE)
     {
+        ctx_p->tx_link.buffers_p = NULL;
         if (length <= SF_DATA_LENGTH)
         {
             /* No need to write data to the TX stream since all data fits in this frame. */
@@ -191,11 +281,62 @@ bool ISOTP_Send(struct isotp_ctx_t *ctx_p, const void *data_p, size_t length)
     return status;
 }
 
+bool ISOTP_SendBuffers(struct isotp_ctx_t *ctx_p, const struct isotp_buffer_t *buffers_p, size_t number_of_buffers)
+{
+    assert(ctx_p != NULL);
+    assert(buffers_p != NULL);
+
+    size_t length = 0;
+    bool valid_length = true;
+    for (size_t i = 0; i < number_of_buffers; ++i)
+    {
+        assert((buffers_p[i].data_p != NULL) || (buffers_p[i].length == 0));
+        valid_length = valid_length && (buffers_p[i].length <= MAX_PAYLOAD_SIZE - length);
+        length += buffers_p[i].length;
+    }
+
+    struct isotp_send_link_t *link_p = &ctx_p->tx_link;
+
+    bool status = false;
+    if ((link_p->state == ISOTP_TX_INACTIVE) && valid_length)
+    {
+        link_p->buffers_p = buffers_p;
+        link_p->number_of_buffers = number_of_buffers;
+        link_p->buffer_index = 0;
+        link_p->buffer_offset = 0;
+
+        if (length <= SF_DATA_LENGTH)
+        {
+            uint8_t data[SF_DATA_LENGTH];
+            ReadTxData(link_p, data, length);
+            status = SendSingleFrame(link_p, data, length);
+        }
+        else
+        {
+            status = SendFirstFrame(link_p, length);
+            if (status)
+            {
+                link_p->state = ISOTP_TX_WAIT_FOR_FC;
+                link_p->base.active = true;
+            }
+        }
+    }
+    return status;
+}
+
 bool ISOTP_IsSending(const struct isotp_ctx_t *ctx_p)
 {
     return ctx_p->tx_link.state != ISOTP_TX_INACTIVE;
 }
 
+void ISOTP_GetStatistics(const struct isotp_ctx_t *ctx_p, struct isotp_statistics_t *statistics_p)
+{
+    assert(ctx_p != NULL);
+    assert(statistics_p != NULL);
+
+    *statistics_p = ctx_p->statistics;
+}
+
 size_t ISOTP_Receive(struct isotp_ctx_t *ctx_p, void *destination_p, size_t length)
 {
     assert(ctx_p != NULL);
@@ -204,31 +345,50 @@ size_t ISOTP_Receive(struct isotp_ctx_t *ctx_p, void *destination_p, size_t leng
     return Stream_Read(&ctx_p->rx_link.rx_stream, destination_p, length);
 }
 
+size_t ISOTP_Peek(const struct isotp_ctx_t *ctx_p, const void **data_pp)
+{
+    assert(ctx_p != NULL);
+    assert(data_pp != NULL);
+
+    return Stream_PeekContiguous(&ctx_p->rx_link.rx_stream, data_pp);
+}
+
+size_t ISOTP_Consume(struct isotp_ctx_t *ctx_p, size_t length)
+{
+    assert(ctx_p != NULL);
+
+    return Stream_Skip(&ctx_p->rx_link.rx_stream, length);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
 
-static inline void ConfigureRxLink(struct isotp_recv_link_t *link_p, void *rx_buffer_p, size_t rx_buffer_size, uint16_t rx_id, uint16_t tx_id, uint8_t separation_time, isotp_status_callback_t callback_fp)
+static inline void ConfigureRxLink(struct isotp_recv_link_t *link_p, void *rx_buffer_p, size_t rx_buffer_size, uint32_t rx_id, uint32_t tx_id, uint8_t separation_time, isotp_status_callback_t callback_fp)
 {
     Stream_Init(&link_p->rx_stream, rx_buffer_p, rx_buffer_size);
     link_p->base.rx_id = rx_id;
     link_p->base.tx_id = tx_id;
     link_p->base.separation_time = separation_time;
-    link_p->base.frame_fifo = FIFO_New(link_p->base.frame_buffer);
     link_p->base.callback_fp = callback_fp;
     link_p->base.active = true;
+    link_p->max_block_size = INITIAL_BLOCK_SIZE;
+    link_p->adaptive_separation_time = 0;
     link_p->state = ISOTP_RX_WAIT_FOR_FF_SF;
 
     const logging_logger_t *logger_p = Logging_GetLogger(ISOTP_LOGGER_NAME);
     Logging_Info(logger_p, "RX-link: {id: 0x%x, separation_time: %u, cb: 0x%x}", link_p->base.rx_id, link_p->base.separation_time, (uintptr_t)link_p->base.callback_fp);
 }
 
-static inline void ConfigureTxLink(struct isotp_send_link_t *link_p, void *tx_buffer_p, size_t tx_buffer_size, uint16_t rx_id, uint16_t tx_id, isotp_status_callback_t callback_fp)
+static inline void ConfigureTxLink(struct isotp_send_link_t *link_p, void *tx_buffer_p, size_t tx_buffer_size, uint32_t rx_id, uint32_t tx_id, isotp_status_callback_t callback_fp)
 {
-    Stream_Init(&link_p->tx_stream, tx_buffer_p, tx_buffer_size);
+    /* Without a TX buffer the stream stays empty and can't be written to. */
+    if ((tx_buffer_p != NULL) || (tx_buffer_size != 0))
+    {
+        Stream_Init(&link_p->tx_stream, tx_buffer_p, tx_buffer_size);
+    }
     link_p->base.rx_id = rx_id;
     link_p->base.tx_id = tx_id;
-    link_p->base.frame_fifo = FIFO_New(link_p->base.frame_buffer);
     link_p->base.callback_fp = callback_fp;
     link_p->base.active = false;
     link_p->state = ISOTP_TX_INACTIVE;
@@ -237,69 +397,224 @@ static inline void ConfigureTxLink(struct isotp_send_link_t *link_p, void *tx_bu
     Logging_Info(logger_p, "TX-link: {id: 0x%x, cb: 0x%x}", link_p->base.tx_id, (uintptr_t)link_p->base.callback_fp);
 }
 
+/**
+ * Step the RX state machine until no frame is pending or the frame budget is
+ * used up.
+ */
 static void ProccessRxLink(struct isotp_recv_link_t *link_p)
 {
     assert(link_p != NULL);
 
-    switch (link_p->state)
+    UpdateFrameQueuePeak(link_p);
+
+    bool progress = true;
+    for (size_t i = 0; progress && (i < ISOTP_MAX_FRAMES_PER_PROCESS); ++i)
     {
-        case ISOTP_RX_WAIT_FOR_FF_SF:
-            CheckForFirstAndSingleFrame(link_p);
-            break;
-        case ISOTP_RX_WAIT_FOR_CF:
-            CheckForConsecutiveFrame(link_p);
-            break;
-        case ISOTP_RX_WAIT:
-            CheckIfReadyForData(link_p);
-            break;
-        default:
-            break;
+        switch (link_p->state)
+        {
+            case ISOTP_RX_WAIT_FOR_FF_SF:
+                progress = CheckForFirstAndSingleFrame(link_p);
+                break;
+            case ISOTP_RX_WAIT_FOR_CF:
+                progress = CheckForConsecutiveFrame(link_p);
+                break;
+            case ISOTP_RX_WAIT:
+                progress = CheckIfReadyForData(link_p);
+                break;
+            default:
+                progress = false;
+                break;
+        }
     }
 }
 
+/**
+ * Step the TX state machine until it has to wait for the receiver or space in
+ * the CAN TX queue, or the frame budget is used up. Consecutive frames with a
+ * separation time are queued for paced transmission, the CAN interface holds
+ * them back so the main loop doesn't have to wait for the separation time.
+ */
 static void ProccessTxLink(struct isotp_send_link_t *link_p)
 {
     assert(link_p != NULL);
 
-    switch (link_p->state)
+    bool progress = true;
+    for (size_t i = 0; progress && (i < ISOTP_MAX_FRAMES_PER_PROCESS); ++i)
     {
-        case ISOTP_TX_INACTIVE:
-            break;
-        case ISOTP_TX_SEND_CF:
-            SendConsecutiveFrame(link_p);
-            break;
-        case ISOTP_TX_WAIT_FOR_ST:
-            CheckIfSeparationTimeHasElapsed(link_p);
-            break;
-        case ISOTP_TX_WAIT_FOR_FC:
-            CheckForFlowControlFrame(link_p);
-            break;
-        default:
-            break;
+        switch (link_p->state)
+        {
+            case ISOTP_TX_SEND_CF:
+                progress = HasTransmitQueueSpace(link_p) && SendConsecutiveFrame(link_p);
+                break;
+            case ISOTP_TX_WAIT_FOR_PACED:
+                progress = CheckIfPacedFramesAreSent(link_p);
+                break;
+            case ISOTP_TX_WAIT_FOR_FC:
+                progress = CheckForFlowControlFrame(link_p);
+                break;
+            case ISOTP_TX_INACTIVE:
+            default:
+                progress = false;
+                break;
+        }
     }
 }
 
-/* NOTE: This function may be called from an ISR. */
-static void CanListener(const struct can_frame_t *frame_p, void *arg_p)
+static void UpdateStatistics(struct isotp_ctx_t *ctx_p)
 {
-    assert(frame_p != NULL);
-    assert(arg_p != NULL);
+    struct isotp_statistics_t *statistics_p = &ctx_p->statistics;
 
-    /* Only use base link struct since this listener is shared by both RX and TX links. */
-    struct isotp_link_t *link_p = (struct isotp_link_t *)arg_p;
+    statistics_p->rx_bytes_per_process = ctx_p->rx_link.base.number_of_bytes;
+    if (statistics_p->rx_bytes_per_process > statistics_p->max_rx_bytes_per_process)
+    {
+        statistics_p->max_rx_bytes_per_process = statistics_p->rx_bytes_per_process;
+    }
 
-    if (link_p->active && (frame_p->id == link_p->rx_id))
+    statistics_p->tx_bytes_per_process = ctx_p->tx_link.base.number_of_bytes;
+    if (statistics_p->tx_bytes_per_process > statistics_p->max_tx_bytes_per_process)
     {
-        const bool status = FIFO_Push(&link_p->frame_fifo, frame_p);
-        if (!status)
+        statistics_p->max_tx_bytes_per_process = statistics_p->tx_bytes_per_process;
+    }
+
+    statistics_p->wait_frames = ctx_p->rx_link.base.number_of_wait_frames + ctx_p->tx_link.base.number_of_wait_frames;
+    statistics_p->overflow_aborts = ctx_p->rx_link.base.number_of_overflow_aborts + ctx_p->tx_link.base.number_of_overflow_aborts;
+    statistics_p->block_size = ctx_p->rx_link.max_block_size;
+    statistics_p->separation_time = ctx_p->rx_link.adaptive_separation_time;
+
+    ctx_p->rx_link.base.number_of_bytes = 0;
+    ctx_p->tx_link.base.number_of_bytes = 0;
+}
+
+/**
+ * Get the channel bound to a context or RX ID, or the next free channel if
+ * there is none. A free channel is claimed by the caller when bound.
+ */
+static struct channel_t *GetChannel(const struct isotp_ctx_t *ctx_p, uint32_t rx_id)
+{
+    struct channel_t *channel_p = NULL;
+    for (size_t i = 0; (channel_p == NULL) && (i < module.number_of_channels); ++i)
+    {
+        if ((module.channels[i].ctx_p == ctx_p) || (module.channels[i].rx_id == rx_id))
+        {
+            channel_p = &module.channels[i];
+        }
+    }
+
+    if (channel_p == NULL)
+    {
+        assert(module.number_of_channels < ISOTP_MAX_NUMBER_OF_CHANNELS);
+        channel_p = &module.channels[module.number_of_channels];
+    }
+
+    return channel_p;
+}
+
+static struct isotp_ctx_t *GetContext(uint32_t rx_id)
+{
+    struct isotp_ctx_t *ctx_p = NULL;
+    for (size_t i = 0; (ctx_p == NULL) && (i < module.number_of_channels); ++i)
+    {
+        if (module.channels[i].rx_id == rx_id)
+        {
+            ctx_p = module.channels[i].ctx_p;
+        }
+    }
+
+    return ctx_p;
+}
+
+static void EnqueueFrame(struct isotp_frame_queue_t *queue_p, uint8_t index)
+{
+    module.frame_pool[index].next = NO_FRAME;
+    if (queue_p->number_of_frames == 0)
+    {
+        queue_p->head = index;
+    }
+    else
+    {
+        module.frame_pool[queue_p->tail].next = index;
+    }
+    queue_p->tail = index;
+    ++queue_p->number_of_frames;
+}
+
+static uint8_t DequeueFrame(struct isotp_frame_queue_t *queue_p)
+{
+    uint8_t index = NO_FRAME;
+    if (queue_p->number_of_frames > 0)
+    {
+        index = queue_p->head;
+        queue_p->head = module.frame_pool[index].next;
+        --queue_p->number_of_frames;
+    }
+
+    return index;
+}
+
+static bool PushFrame(struct isotp_link_t *link_p, const struct can_frame_t *frame_p)
+{
+    const uint8_t index = DequeueFrame(&module.free_frames);
+    const bool status = index != NO_FRAME;
+    if (status)
+    {
+        module.frame_pool[index].frame = *frame_p;
+        EnqueueFrame(&link_p->frame_queue, index);
+    }
+
+    return status;
+}
+
+static bool PopFrame(struct isotp_link_t *link_p, struct can_frame_t *frame_p)
+{
+    const uint8_t index = DequeueFrame(&link_p->frame_queue);
+    const bool status = index != NO_FRAME;
+    if (status)
+    {
+        *frame_p = module.frame_pool[index].frame;
+        EnqueueFrame(&module.free_frames, index);
+    }
+
+    return status;
+}
+
+static void ReleaseFrames(struct isotp_link_t *link_p)
+{
+    struct can_frame_t frame;
+    while (PopFrame(link_p, &frame))
+    {
+        /* Discard the frame. */
+    }
+}
+
+/* NOTE: Called from CANInterface_Process. */
+static void CanListener(const struct can_frame_t *frame_p, void *arg_p __attribute__((unused)))
+{
+    assert(frame_p != NULL);
+
+    struct isotp_ctx_t *ctx_p = GetContext(frame_p->id);
+    if (ctx_p != NULL)
+    {
+        /* Flow control frames are consumed by the TX link, all other frames by the RX link. */
+        struct isotp_link_t *link_p = &ctx_p->rx_link.base;
+        if (GetFrameType(frame_p) == ISOTP_FLOW_CONTROL_FRAME)
+        {
+            link_p = &ctx_p->tx_link.base;
+        }
+
+        if (link_p->active && !PushFrame(link_p, frame_p))
         {
             /**
-             * The frame fifo should never be full due to the use of flow control. If it happens
-             * it's probably an unrelated frame and can safely be discarded. Otherwise the missing
-             * frame will be detected later on and the transfer will abort/timeout.
+             * The frame pool should never be exhausted due to the use of flow control. If it
+             * happens it's probably an unrelated frame and can safely be discarded. Otherwise
+             * the missing frame will be detected later on and the transfer will abort/timeout.
              */
+            if (link_p == &ctx_p->rx_link.base)
+            {
+                ctx_p->rx_link.congested = true;
+            }
+
             const logging_logger_t *logger_p = Logging_GetLogger(ISOTP_LOGGER_NAME);
-            Logging_Warning(logger_p, "Discarded frame: {frame_id: %u, arg: 0x%x}", frame_p->id, (uintptr_t)arg_p);
+            Logging_Warning(logger_p, "Discarded frame: {frame_id: 0x%x}", frame_p->id);
         }
     }
 }
@@ -332,6 +647,7 @@ static void HandleSingleFrame(struct isotp_recv_link_t *link_p, const struct can
     {
         /* No need to check the result, it's already verified that the data fits. */
         Stream_Write(&link_p->rx_stream, isotp_frame.data, isotp_frame.size);
+        link_p->base.number_of_bytes += isotp_frame.size;
         link_p->base.callback_fp(ISOTP_STATUS_DONE);
     }
     else
@@ -347,20 +663,45 @@ static void HandleFirstFrame(struct isotp_recv_link_t *link_p, const struct can_
     struct isotp_ff_t isotp_frame;
     memcpy(&isotp_frame, frame_p->data, frame_p->size);
 
-    uint16_t total_size = (uint16_t)(isotp_frame.size_low | ((isotp_frame.size_high & 0x0F) << 8));
+    uint32_t total_size = (uint32_t)(isotp_frame.size_low | ((isotp_frame.size_high & 0x0F) << 8));
+    const uint8_t *data_p = isotp_frame.data;
+    size_t data_length = sizeof(isotp_frame.data);
+
+    struct isotp_escape_ff_t escape_frame;
+    const bool escape = total_size == 0;
+    if (escape)
+    {
+        /* The size doesn't fit in 12 bits, it's sent as a 32-bit big-endian value instead. */
+        memcpy(&escape_frame, frame_p->data, frame_p->size);
+        total_size = ((uint32_t)escape_frame.size[0] << 24) |
+                     ((uint32_t)escape_frame.size[1] << 16) |
+                     ((uint32_t)escape_frame.size[2] << 8) |
+                     (uint32_t)escape_frame.size[3];
+        data_p = escape_frame.data;
+        data_length = sizeof(escape_frame.data);
+    }
+
     const logging_logger_t *logger_p = Logging_GetLogger(ISOTP_LOGGER_NAME);
     Logging_Debug(logger_p, "Received FF: {total_size: %u}", total_size);
 
     /* Set rx_size early since it's needed when calling 'SendFlowControlFrame' */
     link_p->base.payload_size = total_size;
-    if (sizeof(isotp_frame.data) <= Stream_GetAvailableSpace(&link_p->rx_stream))
+    if (escape && (total_size <= FF_DL_MAX))
+    {
+        /* The escape sequence must only be used for sizes larger than FF_DL_MAX, ignore the frame. */
+        Logging_Warning(logger_p, "Invalid escape FF: {total_size: %u}", total_size);
+    }
+    else if (data_length <= Stream_GetAvailableSpace(&link_p->rx_stream))
     {
         /* No need to check the result is it's already checked that the data fits. */
-        Stream_Write(&link_p->rx_stream, isotp_frame.data, sizeof(isotp_frame.data));
+        Stream_Write(&link_p->rx_stream, data_p, data_length);
+        link_p->base.number_of_bytes += data_length;
 
         link_p->base.sequence_number = 1;
-        link_p->received_bytes = sizeof(isotp_frame.data);
+        link_p->received_bytes = data_length;
         link_p->base.block_count = 0;
+        link_p->frame_queue_peak = 0;
+        link_p->congested = false;
         link_p->state = ISOTP_RX_WAIT_FOR_CF;
         SendFlowControlFrame(link_p, ISOTP_FC_CONTINUE_TO_SEND);
     }
@@ -373,10 +714,11 @@ static void HandleFirstFrame(struct isotp_recv_link_t *link_p, const struct can_
     }
 }
 
-static void CheckForFirstAndSingleFrame(struct isotp_recv_link_t *link_p)
+static bool CheckForFirstAndSingleFrame(struct isotp_recv_link_t *link_p)
 {
     struct can_frame_t frame;
-    if (FIFO_Pop(&link_p->base.frame_fifo, &frame))
+    const bool status = PopFrame(&link_p->base, &frame);
+    if (status)
     {
         const enum isotp_frame_type_t frame_type = GetFrameType(&frame);
         switch (frame_type)
@@ -391,12 +733,15 @@ static void CheckForFirstAndSingleFrame(struct isotp_recv_link_t *link_p)
                 break;
         }
     }
+
+    return status;
 }
 
-static void CheckForConsecutiveFrame(struct isotp_recv_link_t *link_p)
+static bool CheckForConsecutiveFrame(struct isotp_recv_link_t *link_p)
 {
     struct can_frame_t frame;
-    if (FIFO_Pop(&link_p->base.frame_fifo, &frame) && (GetFrameType(&frame) == ISOTP_CONSECUTIVE_FRAME))
+    const bool status = PopFrame(&link_p->base, &frame);
+    if (status && (GetFrameType(&frame) == ISOTP_CONSECUTIVE_FRAME))
     {
         HandleConsecutiveFrame(link_p, &frame);
     }
@@ -412,6 +757,8 @@ static void CheckForConsecutiveFrame(struct isotp_recv_link_t *link_p)
     {
         /* Do nothing and keep waiting for an consecutive frame. */
     }
+
+    return status;
 }
 
 static void HandleConsecutiveFrame(struct isotp_recv_link_t *link_p, const struct can_frame_t *frame_p)
@@ -434,6 +781,7 @@ static void HandleConsecutiveFrame(struct isotp_recv_link_t *link_p, const struc
         {
             Stream_Write(&link_p->rx_stream, isotp_frame.data, remaining_bytes);
 
+            link_p->base.number_of_bytes += remaining_bytes;
             link_p->received_bytes += remaining_bytes;
             link_p->base.sequence_number = (link_p->base.sequence_number + 1) % 16;
             link_p->base.block_count += 1;
@@ -447,6 +795,7 @@ static void HandleConsecutiveFrame(struct isotp_recv_link_t *link_p, const struc
             }
             else if (link_p->base.block_count == link_p->base.block_size)
             {
+                AdaptFlowControl(link_p);
                 SendFlowControlFrame(link_p, ISOTP_FC_CONTINUE_TO_SEND);
                 link_p->base.block_count = 0;
             }
@@ -465,7 +814,9 @@ static void HandleConsecutiveFrame(struct isotp_recv_link_t *link_p, const struc
     }
     else
     {
-        /* Abort transfer if a frame is lost. */
+        /* Abort transfer if a frame is lost, most likely discarded since the frame pool was exhausted. */
+        link_p->congested = true;
+        AdaptFlowControl(link_p);
         link_p->state = ISOTP_RX_WAIT_FOR_FF_SF;
         Stream_Clear(&link_p->rx_stream);
         link_p->base.callback_fp(ISOTP_STATUS_LOST_FRAME);
@@ -488,6 +839,7 @@ static void SendFlowControlFrame(struct isotp_recv_link_t *link_p, enum isotp_fl
         Logging_Warning(logger_p, "ISOTP_FC_WAIT");
         isotp_frame.flag = ISOTP_FC_WAIT;
         link_p->base.wf_count += 1;
+        link_p->base.number_of_wait_frames += 1;
         link_p->state = ISOTP_RX_WAIT;
         if (link_p->base.wf_count == 1)
         {
@@ -498,16 +850,20 @@ static void SendFlowControlFrame(struct isotp_recv_link_t *link_p, enum isotp_fl
     {
         isotp_frame.flag = (uint8_t)status;
         link_p->base.wf_count = 0;
+        if (status == ISOTP_FC_OVERFLOW_ABORT)
+        {
+            link_p->base.number_of_overflow_aborts += 1;
+        }
     }
 
     link_p->wait_timer = SysTime_GetSystemTime();
-    isotp_frame.st = (uint8_t)link_p->base.separation_time;
+    isotp_frame.st = GetSeparationTime(link_p);
 
     Logging_Debug(logger_p, "Send FC {flag: %u, bs: %u, st: %u}", isotp_frame.flag, isotp_frame.block_size, isotp_frame.st);
     CANInterface_Transmit(link_p->base.tx_id, &isotp_frame, 3);
 }
 
-static void CheckIfReadyForData(struct isotp_recv_link_t *link_p)
+static bool CheckIfReadyForData(struct isotp_recv_link_t *link_p)
 {
     if (SysTime_GetDifference(link_p->wait_timer) > 100)
     {
@@ -527,6 +883,9 @@ static void CheckIfReadyForData(struct isotp_recv_link_t *link_p)
             link_p->base.callback_fp(ISOTP_STATUS_TIMEOUT);
         }
     }
+
+    /* Frames can only be handled again if the sender was allowed to continue. */
+    return link_p->state == ISOTP_RX_WAIT_FOR_CF;
 }
 
 static uint8_t GetBlockSize(const struct isotp_recv_link_t *link_p)
@@ -534,21 +893,105 @@ static uint8_t GetBlockSize(const struct isotp_recv_link_t *link_p)
     const size_t remaining_bytes = link_p->base.payload_size - link_p->received_bytes;
     const size_t stream_slot_size = remaining_bytes < CF_DATA_LENGTH ? remaining_bytes : CF_DATA_LENGTH;
     const size_t available_stream_slots = stream_slot_size > 0 ? (Stream_GetAvailableSpace(&link_p->rx_stream) / stream_slot_size) : 0;
-    const uint8_t available_frame_slots = FIFO_GetAvailableSlots(&link_p->base.frame_fifo);
 
     uint8_t block_size;
-    if (available_stream_slots > available_frame_slots)
+    if (available_stream_slots > link_p->max_block_size)
     {
-        block_size = available_frame_slots;
+        block_size = link_p->max_block_size;
     }
     else
     {
-        block_size = available_stream_slots < UINT8_MAX ? (uint8_t)available_stream_slots : UINT8_MAX;
+        block_size = (uint8_t)available_stream_slots;
     }
     return block_size;
 }
 
-static bool SendSingleFrame(const struct isotp_send_link_t *link_p, const void *data_p, size_t length)
+/**
+ * Use the adaptive separation time if it's longer than the configured one.
+ */
+static uint8_t GetSeparationTime(const struct isotp_recv_link_t *link_p)
+{
+    const uint8_t configured_separation_time = (uint8_t)link_p->base.separation_time;
+    const uint32_t adaptive_separation_time_us = link_p->adaptive_separation_time * 1000;
+
+    uint8_t separation_time = configured_separation_time;
+    if ((adaptive_separation_time_us > 0) && (adaptive_separation_time_us > SeparationTimeToUs(configured_separation_time)))
+    {
+        separation_time = link_p->adaptive_separation_time;
+    }
+    return separation_time;
+}
+
+/**
+ * The number of frames pending when the link is processed is a measure of
+ * the main loop latency relative to the rate frames are sent at.
+ */
+static void UpdateFrameQueuePeak(struct isotp_recv_link_t *link_p)
+{
+    if (link_p->state == ISOTP_RX_WAIT_FOR_CF)
+    {
+        const uint8_t pending_frames = link_p->base.frame_queue.number_of_frames;
+        if (pending_frames > link_p->frame_queue_peak)
+        {
+            link_p->frame_queue_peak = pending_frames;
+        }
+
+        const uint32_t outstanding_frames = link_p->base.block_size - link_p->base.block_count;
+        if ((module.free_frames.number_of_frames == 0) && (outstanding_frames > pending_frames))
+        {
+            link_p->congested = true;
+        }
+    }
+}
+
+/**
+ * Adapt the flow control parameters at the end of a block, additive increase
+ * while the frame queue drains quickly and multiplicative decrease if the frame
+ * pool overflows or is about to. The separation time is lowered before the
+ * block size is grown.
+ */
+static void AdaptFlowControl(struct isotp_recv_link_t *link_p)
+{
+    if (link_p->congested)
+    {
+        link_p->max_block_size = link_p->max_block_size > 1 ? link_p->max_block_size / 2 : 1;
+        if (link_p->adaptive_separation_time == 0)
+        {
+            link_p->adaptive_separation_time = 1;
+        }
+        else if (link_p->adaptive_separation_time < MAX_ADAPTIVE_ST_MS / 2)
+        {
+            link_p->adaptive_separation_time *= 2;
+        }
+        else
+        {
+            link_p->adaptive_separation_time = MAX_ADAPTIVE_ST_MS;
+        }
+
+        const logging_logger_t *logger_p = Logging_GetLogger(ISOTP_LOGGER_NAME);
+        Logging_Debug(logger_p, "Congested: {bs: %u, st: %u}", link_p->max_block_size, link_p->adaptive_separation_time);
+    }
+    else if (link_p->frame_queue_peak <= ISOTP_FRAME_POOL_SIZE / 4)
+    {
+        if (link_p->adaptive_separation_time > 0)
+        {
+            link_p->adaptive_separation_time /= 2;
+        }
+        else if (link_p->max_block_size < UINT8_MAX)
+        {
+            link_p->max_block_size += 1;
+        }
+    }
+    else
+    {
+        /* Keep the current parameters, the frame pool is used but not overflowing. */
+    }
+
+    link_p->frame_queue_peak = 0;
+    link_p->congested = false;
+}
+
+static bool SendSingleFrame(struct isotp_send_link_t *link_p, const void *data_p, size_t length)
 {
     struct isotp_sf_t isotp_frame;
     isotp_frame.type = ISOTP_SINGLE_FRAME;
@@ -559,24 +1002,52 @@ static bool SendSingleFrame(const struct isotp_send_link_t *link_p, const void *
     Logging_Debug(logger_p, "Send SF: {total_size: %u}", length);
 
     const size_t frame_size = length + 1;
-    return CANInterface_Transmit(link_p->base.tx_id, &isotp_frame, frame_size);
+    const bool status = CANInterface_Transmit(link_p->base.tx_id, &isotp_frame, frame_size);
+    if (status)
+    {
+        link_p->base.number_of_bytes += length;
+    }
+
+    return status;
 }
 
 static bool SendFirstFrame(struct isotp_send_link_t *link_p, size_t length)
 {
     struct isotp_ff_t isotp_frame;
-    isotp_frame.type = ISOTP_FIRST_FRAME;
-    isotp_frame.size_low = (uint8_t)(length & 0xFF);
-    isotp_frame.size_high = (uint8_t)((length >> 8) & 0x0F);
-    Stream_Read(&link_p->tx_stream, isotp_frame.data, sizeof(isotp_frame.data));
+    struct isotp_escape_ff_t escape_frame;
+    void *frame_p = &isotp_frame;
+    size_t data_length = sizeof(isotp_frame.data);
+
+    if (length <= FF_DL_MAX)
+    {
+        isotp_frame.type = ISOTP_FIRST_FRAME;
+        isotp_frame.size_low = (uint8_t)(length & 0xFF);
+        isotp_frame.size_high = (uint8_t)((length >> 8) & 0x0F);
+        ReadTxData(link_p, isotp_frame.data, sizeof(isotp_frame.data));
+    }
+    else
+    {
+        /* Escape sequence, the 12-bit size is zero and followed by the 32-bit big-endian size. */
+        escape_frame.type = ISOTP_FIRST_FRAME;
+        escape_frame.size_low = 0;
+        escape_frame.size_high = 0;
+        escape_frame.size[0] = (uint8_t)((length >> 24) & 0xFF);
+        escape_frame.size[1] = (uint8_t)((length >> 16) & 0xFF);
+        escape_frame.size[2] = (uint8_t)((length >> 8) & 0xFF);
+        escape_frame.size[3] = (uint8_t)(length & 0xFF);
+        ReadTxData(link_p, escape_frame.data, sizeof(escape_frame.data));
+        frame_p = &escape_frame;
+        data_length = sizeof(escape_frame.data);
+    }
 
     const logging_logger_t *logger_p = Logging_GetLogger(ISOTP_LOGGER_NAME);
     Logging_Debug(logger_p, "Send FF: {total_size: %u}", length);
 
     bool status = false;
-    if (CANInterface_Transmit(link_p->base.tx_id, &isotp_frame, sizeof(isotp_frame.data) + 2))
+    if (CANInterface_Transmit(link_p->base.tx_id, frame_p, sizeof(isotp_frame)))
     {
-        link_p->sent_bytes = sizeof(isotp_frame.data);
+        link_p->sent_bytes = data_length;
+        link_p->base.number_of_bytes += data_length;
         link_p->base.payload_size = length;
         link_p->base.sequence_number = 1;
         link_p->wait_timer = SysTime_GetSystemTime();
@@ -587,22 +1058,72 @@ static bool SendFirstFrame(struct isotp_send_link_t *link_p, size_t length)
     return status;
 }
 
-static void CheckIfSeparationTimeHasElapsed(struct isotp_send_link_t *link_p)
+/**
+ * Read the next part of the payload, either from the TX stream or by
+ * gathering it from the caller-owned buffers.
+ */
+static size_t ReadTxData(struct isotp_send_link_t *link_p, void *destination_p, size_t length)
+{
+    size_t number_of_bytes = 0;
+    if (link_p->buffers_p == NULL)
+    {
+        number_of_bytes = Stream_Read(&link_p->tx_stream, destination_p, length);
+    }
+    else
+    {
+        while ((number_of_bytes < length) && (link_p->buffer_index < link_p->number_of_buffers))
+        {
+            const struct isotp_buffer_t *buffer_p = &link_p->buffers_p[link_p->buffer_index];
+            const size_t remaining_bytes = buffer_p->length - link_p->buffer_offset;
+            const size_t chunk_size = remaining_bytes < (length - number_of_bytes) ? remaining_bytes : (length - number_of_bytes);
+
+            memcpy((uint8_t *)destination_p + number_of_bytes, (const uint8_t *)buffer_p->data_p + link_p->buffer_offset, chunk_size);
+            number_of_bytes += chunk_size;
+            link_p->buffer_offset += chunk_size;
+
+            if (link_p->buffer_offset == buffer_p->length)
+            {
+                link_p->buffer_index += 1;
+                link_p->buffer_offset = 0;
+            }
+        }
+    }
+
+    return number_of_bytes;
+}
+
+/**
+ * The last consecutive frame of a paced message is reported as done when it
+ * has left the paced TX queue, so that the first frame of the next message
+ * can't overtake it in the CAN TX queue. Paced frames of other links don't
+ * hold back the link.
+ */
+static bool CheckIfPacedFramesAreSent(struct isotp_send_link_t *link_p)
 {
-    const uint32_t time_diff_us = SysTime_GetSystemTimeUs() - link_p->wait_timer;
-    if (time_diff_us >= link_p->base.separation_time)
+    const bool status = !CANInterface_IsPacedTransmitPending(link_p->base.tx_id);
+    if (status)
     {
-        link_p->state = ISOTP_TX_SEND_CF;
+        link_p->state = ISOTP_TX_INACTIVE;
+        link_p->base.active = false;
+        link_p->base.callback_fp(ISOTP_STATUS_DONE);
     }
+
+    return status;
 }
 
-static void CheckForFlowControlFrame(struct isotp_send_link_t *link_p)
+static bool CheckForFlowControlFrame(struct isotp_send_link_t *link_p)
 {
     struct can_frame_t frame;
-    if (FIFO_Pop(&link_p->base.frame_fifo, &frame) && (GetFrameType(&frame) == ISOTP_FLOW_CONTROL_FRAME))
+    const bool status = PopFrame(&link_p->base, &frame);
+    if (status && (GetFrameType(&frame) == ISOTP_FLOW_CONTROL_FRAME))
     {
         HandleFlowControlFrame(link_p, &frame);
     }
+    else if (CANInterface_IsPacedTransmitPending(link_p->base.tx_id))
+    {
+        /* The timeout starts when the last frame of the block has been sent. */
+        link_p->wait_timer = SysTime_GetSystemTime();
+    }
     else if (SysTime_GetDifference(link_p->wait_timer) > FC_TIMEOUT_MS)
     {
         Stream_Clear(&link_p->tx_stream);
@@ -616,6 +1137,8 @@ static void CheckForFlowControlFrame(struct isotp_send_link_t *link_p)
     {
         /* Do nothing and keep waiting for a flow control frame. */
     }
+
+    return status;
 }
 
 static void HandleFlowControlFrame(struct isotp_send_link_t *link_p, const struct can_frame_t *frame_p)
@@ -635,6 +1158,7 @@ static void HandleFlowControlFrame(struct isotp_send_link_t *link_p, const struc
             link_p->state = ISOTP_TX_SEND_CF;
             break;
         case ISOTP_FC_WAIT:
+            link_p->base.number_of_wait_frames += 1;
             if (link_p->base.wf_count >= WF_MAX)
             {
                 /* Abort if max number of WAIT is exceeded. */
@@ -652,6 +1176,7 @@ static void HandleFlowControlFrame(struct isotp_send_link_t *link_p, const struc
             break;
         case ISOTP_FC_OVERFLOW_ABORT:
             /* Abort at client request. */
+            link_p->base.number_of_overflow_aborts += 1;
             link_p->base.callback_fp(ISOTP_STATUS_OVERFLOW_ABORT);
             link_p->state = ISOTP_TX_INACTIVE;
             link_p->base.active = false;
@@ -684,20 +1209,52 @@ static uint32_t SeparationTimeToUs(uint8_t st)
     return result;
 }
 
+static bool HasTransmitQueueSpace(const struct isotp_send_link_t *link_p)
+{
+    size_t space;
+    if (link_p->base.separation_time > 0)
+    {
+        space = CANInterface_GetPacedTransmitQueueSpace();
+    }
+    else
+    {
+        space = CANInterface_GetTransmitQueueSpace();
+    }
+
+    return space > 0;
+}
+
 static bool SendConsecutiveFrame(struct isotp_send_link_t *link_p)
 {
     struct isotp_cf_t frame;
     frame.type = ISOTP_CONSECUTIVE_FRAME;
     frame.index = link_p->base.sequence_number;
-    const size_t number_of_bytes = Stream_Read(&link_p->tx_stream, frame.data, sizeof(frame.data));
+    const size_t number_of_bytes = ReadTxData(link_p, frame.data, sizeof(frame.data));
 
     const logging_logger_t *logger_p = Logging_GetLogger(ISOTP_LOGGER_NAME);
     Logging_Debug(logger_p, "Send CF: {index: %u, number_of_bytes: %u}", frame.index, number_of_bytes);
 
+    const bool paced = link_p->base.separation_time > 0;
+    const bool last_in_message = (link_p->sent_bytes + number_of_bytes) >= link_p->base.payload_size;
+    const bool last_in_block = (link_p->base.block_size != 0) && ((link_p->base.block_count + 1) >= link_p->base.block_size);
+
+    bool transmitted;
+    if (paced)
+    {
+        /* No separation is needed before a flow control frame or the next message. */
+        const uint32_t separation_time_us = (last_in_message || last_in_block) ? 0 : link_p->base.separation_time;
+        transmitted = CANInterface_TransmitPaced(link_p->base.tx_id, &frame, number_of_bytes + 1, separation_time_us);
+    }
+    else
+    {
+        transmitted = CANInterface_Transmit(link_p->base.tx_id, &frame, number_of_bytes + 1);
+    }
+
     bool status = false;
-    if (CANInterface_Transmit(link_p->base.tx_id, &frame, number_of_bytes + 1))
+    if (transmitted)
     {
         link_p->sent_bytes += number_of_bytes;
+        link_p->base.number_of_bytes += number_of_bytes;
 
         if (link_p->sent_bytes < link_p->base.payload_size)
         {
@@ -706,15 +1263,7 @@ static bool SendConsecutiveFrame(struct isotp_send_link_t *link_p)
 
             if ((link_p->base.block_count < link_p->base.block_size) || (link_p->base.block_size == 0))
             {
-                if (link_p->base.separation_time == 0)
-                {
-                    link_p->state = ISOTP_TX_SEND_CF;
-                }
-                else
-                {
-                    link_p->wait_timer = SysTime_GetSystemTimeUs();
-                    link_p->state = ISOTP_TX_WAIT_FOR_ST;
-                }
+                link_p->state = ISOTP_TX_SEND_CF;
             }
             else
             {
@@ -722,6 +1271,10 @@ static bool SendConsecutiveFrame(struct isotp_send_link_t *link_p)
                 link_p->state = ISOTP_TX_WAIT_FOR_FC;
             }
         }
+        else if (paced)
+        {
+            link_p->state = ISOTP_TX_WAIT_FOR_PACED;
+        }
         else
         {
             link_p->base.callback_fp(ISOTP_STATUS_DONE);
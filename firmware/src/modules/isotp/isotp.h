@@ -31,7 +31,6 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
-#include "fifo.h"
 #include "stream.h"
 #include "logging.h"
 #include "can_interface.h"
@@ -40,7 +39,16 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //DEFINES
 //////////////////////////////////////////////////////////////////////////
 
-#define ISOTP_FRAME_BUFFER_SIZE 5
+/* Received frames waiting to be processed, shared by all channels. */
+#ifndef ISOTP_FRAME_POOL_SIZE
+#define ISOTP_FRAME_POOL_SIZE 10
+#endif
+
+#ifndef ISOTP_MAX_NUMBER_OF_CHANNELS
+#define ISOTP_MAX_NUMBER_OF_CHANNELS 4
+#endif
+
+#define ISOTP_MAX_FRAMES_PER_PROCESS 16
 
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
@@ -59,7 +67,7 @@ enum isotp_tx_state_t
 {
     ISOTP_TX_INACTIVE = 0,
     ISOTP_TX_SEND_CF,
-    ISOTP_TX_WAIT_FOR_ST,
+    ISOTP_TX_WAIT_FOR_PACED,
     ISOTP_TX_WAIT_FOR_FC
 };
 
@@ -78,10 +86,29 @@ enum isotp_link_type_t
 
 typedef void (*isotp_status_callback_t)(enum isotp_status_t status);
 
+/**
+ * Frames received on a link, linked through the shared frame pool.
+ */
+struct isotp_frame_queue_t
+{
+    uint8_t head;
+    uint8_t tail;
+    uint8_t number_of_frames;
+};
+
+/**
+ * Caller-owned buffer, see 'ISOTP_SendBuffers'.
+ */
+struct isotp_buffer_t
+{
+    const void *data_p;
+    size_t length;
+};
+
 struct isotp_link_t
 {
-    uint16_t rx_id;
-    uint16_t tx_id;
+    uint32_t rx_id;
+    uint32_t tx_id;
     uint32_t separation_time;
     uint8_t block_size;
     uint8_t block_count;
@@ -89,8 +116,10 @@ struct isotp_link_t
     uint8_t wf_count;
     size_t payload_size;
     isotp_status_callback_t callback_fp;
-    struct can_frame_t frame_buffer[ISOTP_FRAME_BUFFER_SIZE];
-    struct fifo_t frame_fifo;
+    uint32_t number_of_bytes; /* Payload bytes moved since the last call to 'ISOTP_Proccess'. */
+    uint32_t number_of_wait_frames;
+    uint32_t number_of_overflow_aborts;
+    struct isotp_frame_queue_t frame_queue;
     bool active;
 };
 
@@ -100,6 +129,10 @@ struct isotp_recv_link_t
     size_t received_bytes;
     uint32_t wait_timer;
     struct stream_t rx_stream;
+    uint8_t max_block_size; /* Adapted to how fast the frame queue is drained. */
+    uint8_t adaptive_separation_time; /* In ms, raised when frames arrive faster than they are drained. */
+    uint8_t frame_queue_peak; /* Highest number of pending frames during the current block. */
+    bool congested; /* The frame pool was exhausted with frames of the current block still to come. */
     enum isotp_rx_state_t state;
 };
 
@@ -109,48 +142,88 @@ struct isotp_send_link_t
     size_t sent_bytes;
     uint32_t wait_timer;
     struct stream_t tx_stream;
+    const struct isotp_buffer_t *buffers_p; /* Data is read from 'tx_stream' if NULL. */
+    size_t number_of_buffers;
+    size_t buffer_index;
+    size_t buffer_offset;
     enum isotp_tx_state_t state;
 };
 
+/**
+ * Payload throughput per call to 'ISOTP_Proccess' and flow control state.
+ * Peak values ('max') and counters are tracked since the link was bound.
+ */
+struct isotp_statistics_t
+{
+    uint32_t rx_bytes_per_process;
+    uint32_t max_rx_bytes_per_process;
+    uint32_t tx_bytes_per_process;
+    uint32_t max_tx_bytes_per_process;
+    uint32_t wait_frames; /* Sent and received FC WAIT frames. */
+    uint32_t overflow_aborts; /* Sent and received FC OVERFLOW frames. */
+    uint8_t block_size; /* Current max block size granted by the receiver. */
+    uint8_t separation_time; /* Current adaptive separation time in ms. */
+};
+
 struct isotp_ctx_t
 {
     struct isotp_recv_link_t rx_link;
     struct isotp_send_link_t tx_link;
+    struct isotp_statistics_t statistics;
     logging_logger_t *logger_p;
 };
 
 //////////////////////////////////////////////////////////////////////////
 //FUNCTION PROTOTYPES
 //////////////////////////////////////////////////////////////////////////
+/**
+ * Initialize the ISO-TP router.
+ *
+ * Must be called after 'CANInterface_Init' and before any channel is bound.
+ * All channels are unbound and their frames released.
+ */
+void ISOTP_Init(void);
+
 /**
  * Create a link between two endpoints.
  *
+ * The channel is added to the router, which receives the frames of all
+ * channels through a single CAN listener and buffers them in a shared frame
+ * pool. Binding a context or RX ID again replaces the previous channel.
+ *
  * @param ctx_p Pointer to link context.
  * @param rx_buffer_p Pointer to RX buffer.
  * @param rx_buffer_size Size of RX buffer.
- * @param tx_buffer_p Pointer to TX buffer.
- * @param tx_buffer_size Size of TX buffer.
- * @param rx_id ID of RX endpoint.
- * @param tx_id ID of TX endpoint
+ * @param tx_buffer_p Pointer to TX buffer, NULL if only 'ISOTP_SendBuffers' and single frames are sent.
+ * @param tx_buffer_size Size of TX buffer, zero if 'tx_buffer_p' is NULL.
+ * @param rx_id ID of RX endpoint, OR CANINTERFACE_EXTENDED_ID_FLAG into it for a 29-bit ID.
+ * @param tx_id ID of TX endpoint, OR CANINTERFACE_EXTENDED_ID_FLAG into it for a 29-bit ID.
  * @param rx_callback_fp Callback for RX events.
  * @param tx_callback_fp Callback for TX events.
  */
-void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint16_t rx_id, uint16_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp);
+void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint32_t rx_id, uint32_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp);
 
 /**
  * Set separation time parameter.
  *
+ * The receiver raises the separation time above this value if frames arrive
+ * faster than they are processed.
+ *
  * @param ctx_p Pointer to link context.
- * @param separation_time Separation time between frames.
+ * @param separation_time Minimum separation time between frames.
  */
 void ISOTP_SetSeparationTime(struct isotp_ctx_t *ctx_p, uint8_t separation_time);
 
 /**
- * Process RX and TX data.
+ * Process RX and TX data of all bound channels.
  *
- * @param ctx_p Pointer to link context.
+ * All frames pending in the RX links are handled, and consecutive frames are
+ * queued until the block ends or the CAN TX queue is full. Frames with a
+ * separation time are spaced by the CAN interface, see
+ * 'CANInterface_TransmitPaced'. At most 'ISOTP_MAX_FRAMES_PER_PROCESS' frames are
+ * handled per link and call to bound the time spent.
  */
-void ISOTP_Proccess(struct isotp_ctx_t *ctx_p);
+void ISOTP_Proccess(void);
 
 /**
  * Send data.
@@ -163,6 +236,25 @@ void ISOTP_Proccess(struct isotp_ctx_t *ctx_p);
  */
 bool ISOTP_Send(struct isotp_ctx_t *ctx_p, const void *data_p, size_t length);
 
+/**
+ * Send data directly from caller-owned buffers.
+ *
+ * The buffers are sent back to back as one message, e.g. a header followed
+ * by a body, and read as frames are transmitted instead of being copied to
+ * the TX buffer. The buffers, and the array describing them, must stay valid
+ * until the transfer is finished. Completion is reported through the TX
+ * status callback, except for messages that fit in a single frame which are
+ * sent before this function returns. Messages larger than 4095 bytes are
+ * sent with the ISO 15765-2:2016 escape first frame.
+ *
+ * @param ctx_p Pointer to link context.
+ * @param buffers_p Pointer to array of buffers.
+ * @param number_of_buffers Number of buffers in array.
+ *
+ * @return True if send was successful, otherwise false.
+ */
+bool ISOTP_SendBuffers(struct isotp_ctx_t *ctx_p, const struct isotp_buffer_t *buffers_p, size_t number_of_buffers);
+
 /**
  * Check if the link is currently sending.
  *
@@ -171,6 +263,14 @@ bool ISOTP_Send(struct isotp_ctx_t *ctx_p, const void *data_p, size_t length);
  */
 bool ISOTP_IsSending(const struct isotp_ctx_t *ctx_p);
 
+/**
+ * Get the link throughput statistics.
+ *
+ * @param ctx_p Pointer to link context.
+ * @param statistics_p Pointer to struct where the statistics are stored.
+ */
+void ISOTP_GetStatistics(const struct isotp_ctx_t *ctx_p, struct isotp_statistics_t *statistics_p);
+
 /**
  * Receive any available data.
  *
@@ -182,4 +282,28 @@ bool ISOTP_IsSending(const struct isotp_ctx_t *ctx_p);
  */
 size_t ISOTP_Receive(struct isotp_ctx_t *ctx_p, void *destination_p, size_t length);
 
+/**
+ * Get a pointer to received data without copying it.
+ *
+ * The data stays in the RX buffer until released with 'ISOTP_Consume', and
+ * the pointer is valid until then. Received data that wraps around the end of
+ * the RX buffer is returned in two parts.
+ *
+ * @param ctx_p Pointer to link context.
+ * @param data_pp Pointer to where a pointer to the received data is stored.
+ *
+ * @return Number of contiguous bytes available, zero if no data is available.
+ */
+size_t ISOTP_Peek(const struct isotp_ctx_t *ctx_p, const void **data_pp);
+
+/**
+ * Release received data returned by 'ISOTP_Peek'.
+ *
+ * @param ctx_p Pointer to link context.
+ * @param length Number of bytes to release.
+ *
+ * @return Number of bytes released.
+ */
+size_t ISOTP_Consume(struct isotp_ctx_t *ctx_p, size_t length);
+
 #endif
@@ -54,7 +54,12 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
 
-__attribute__((weak)) void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint16_t rx_id, uint16_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp)
+__attribute__((weak)) void ISOTP_Init(void)
+{
+
+}
+
+__attribute__((weak)) void ISOTP_Bind(struct isotp_ctx_t *ctx_p, void *rx_buffer_p, size_t rx_buffer_size, void *tx_buffer_p, size_t tx_buffer_size, uint32_t rx_id, uint32_t tx_id, isotp_status_callback_t rx_callback_fp, isotp_status_callback_t tx_callback_fp)
 {
     assert_non_null(ctx_p);
 }
@@ -65,12 +70,18 @@ __attribute__((weak)) void ISOTP_SetSeparationTime(struct isotp_ctx_t *ctx_p, ui
     check_expected_uint(separation_time);
 }
 
-__attribute__((weak)) void ISOTP_Proccess(struct isotp_ctx_t *ctx_p)
+__attribute__((weak)) void ISOTP_Proccess(void)
 {
-    assert_non_null(ctx_p);
     function_called();
 }
 
+__attribute__((weak)) void ISOTP_GetStatistics(const struct isotp_ctx_t *ctx_p, struct isotp_statistics_t *statistics_p)
+{
+    assert_non_null(ctx_p);
+    assert_non_null(statistics_p);
+    *statistics_p = *mock_ptr_type(struct isotp_statistics_t *);
+}
+
 __attribute__((weak)) size_t ISOTP_Receive(struct isotp_ctx_t *ctx_p, void *destination_p, size_t length)
 {
     assert_non_null(ctx_p);
@@ -79,6 +90,21 @@ __attribute__((weak)) size_t ISOTP_Receive(struct isotp_ctx_t *ctx_p, void *dest
     return number_of_bytes;
 }
 
+__attribute__((weak)) size_t ISOTP_Peek(const struct isotp_ctx_t *ctx_p, const void **data_pp)
+{
+    assert_non_null(ctx_p);
+    size_t number_of_bytes = mock_type(size_t);
+    *data_pp = mock_ptr_type(const void *);
+    return number_of_bytes;
+}
+
+__attribute__((weak)) size_t ISOTP_Consume(struct isotp_ctx_t *ctx_p, size_t length)
+{
+    assert_non_null(ctx_p);
+    check_expected(length);
+    return length;
+}
+
 __attribute__((weak)) bool ISOTP_Send(struct isotp_ctx_t *ctx_p, const void *data_p, size_t length)
 {
     assert_non_null(ctx_p);
@@ -86,6 +112,14 @@ __attribute__((weak)) bool ISOTP_Send(struct isotp_ctx_t *ctx_p, const void *dat
     return mock_type(bool);
 }
 
+__attribute__((weak)) bool ISOTP_SendBuffers(struct isotp_ctx_t *ctx_p, const struct isotp_buffer_t *buffers_p, size_t number_of_buffers)
+{
+    assert_non_null(ctx_p);
+    check_expected_ptr(buffers_p);
+    check_expected(number_of_buffers);
+    return mock_type(bool);
+}
+
 __attribute__((weak)) bool ISOTP_IsSending(const struct isotp_ctx_t *ctx_p)
 {
     assert_non_null(ctx_p);
@@ -42,6 +42,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////
 
 #define ISOTP_MAX_DATA_LENGTH 4095
+#define INITIAL_BLOCK_SIZE (ISOTP_FRAME_POOL_SIZE / 2)
 
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
@@ -59,28 +60,52 @@ struct listener_t
 
 static struct isotp_ctx_t ctx;
 static struct logging_logger_t *dummy_logger;
-static struct listener_t rx_listener;
-static struct listener_t tx_listener;
-static bool drop_frame;
+static struct listener_t listener;
+static size_t number_of_transmitted_frames;
+static size_t drop_frame_number;
+static size_t tx_queue_space;
+static struct can_frame_t last_transmitted_frame;
+static size_t paced_queue_space;
+static size_t number_of_paced_frames;
+static uint32_t separation_times_us[8];
+static bool paced_transmit_pending;
+static uint32_t paced_transmit_pending_id;
 static bool got_callback;
-static uint32_t system_time_us;
 static uint8_t tx_buffer[ISOTP_MAX_DATA_LENGTH];
 
 //////////////////////////////////////////////////////////////////////////
 //MOCKS
 //////////////////////////////////////////////////////////////////////////
 
-void CANInterface_RegisterListener(caninterface_listener_cb_t listener_cb, void *arg_p)
+void CANInterface_RegisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
 {
-    if (rx_listener.listener_cb == NULL)
-    {
-        rx_listener.listener_cb = listener_cb;
-        rx_listener.arg_p = arg_p;
-    }
-    else
+    check_expected_uint(priority);
+
+    listener.listener_cb = listener_cb;
+    listener.arg_p = arg_p;
+}
+
+void CANInterface_UnregisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
+{
+    check_expected_uint(id);
+    assert_ptr_equal(listener_cb, listener.listener_cb);
+    assert_ptr_equal(arg_p, listener.arg_p);
+}
+
+static void LoopBackFrame(uint32_t id, const void *data_p, size_t size)
+{
+    struct can_frame_t frame;
+    frame.id = id;
+    frame.size = size;
+    memcpy(frame.data, data_p, size);
+
+    last_transmitted_frame = frame;
+    ++number_of_transmitted_frames;
+    if (number_of_transmitted_frames != drop_frame_number)
     {
-        tx_listener.listener_cb = listener_cb;
-        tx_listener.arg_p = arg_p;
+        /* Create a loop back by changing the TX ID. */
+        frame.id = 0x01;
+        listener.listener_cb(&frame, listener.arg_p);
     }
 }
 
@@ -89,36 +114,36 @@ bool CANInterface_Transmit(uint32_t id, void *data_p, size_t size)
     bool status = mock_type(bool);
     if (status)
     {
-        struct can_frame_t frame;
-        frame.id = id;
-        frame.size = size;
-        memcpy(frame.data, data_p, size);
-
-        if (!drop_frame)
-        {
-            /**
-             * Create a loop back by changing the TX ID and directing frames by
-             * ISOTP frame type to the correct listener.
-             */
-            frame.id = 0x01;
-            if ((frame.data[0] & 0xf0) < 0x30)
-            {
-                rx_listener.listener_cb(&frame, rx_listener.arg_p);
-            }
-            else
-            {
-                tx_listener.listener_cb(&frame, tx_listener.arg_p);
-            }
-        }
-        drop_frame = false;
+        LoopBackFrame(id, data_p, size);
     }
     return status;
 }
 
-uint32_t SysTime_GetSystemTimeUs(void)
+size_t CANInterface_GetTransmitQueueSpace(void)
+{
+    return tx_queue_space;
+}
+
+bool CANInterface_TransmitPaced(uint32_t id, void *data_p, size_t size, uint32_t separation_time_us)
+{
+    if (number_of_paced_frames < ElementsIn(separation_times_us))
+    {
+        separation_times_us[number_of_paced_frames] = separation_time_us;
+    }
+    ++number_of_paced_frames;
+
+    LoopBackFrame(id, data_p, size);
+    return true;
+}
+
+size_t CANInterface_GetPacedTransmitQueueSpace(void)
 {
-    system_time_us += 100;
-    return system_time_us;
+    return paced_queue_space;
+}
+
+bool CANInterface_IsPacedTransmitPending(uint32_t id)
+{
+    return paced_transmit_pending && (id == paced_transmit_pending_id);
 }
 
 static void MockRxStatusHandler(enum isotp_status_t status)
@@ -139,16 +164,22 @@ static void MockTxStatusHandler(enum isotp_status_t status)
 static int Setup(void **state)
 {
     ctx = (__typeof__(ctx)) {0};
-    rx_listener = (__typeof__(rx_listener)) {0};
-    tx_listener = (__typeof__(tx_listener)) {0};
-    drop_frame = false;
+    listener = (__typeof__(listener)) {0};
+    number_of_transmitted_frames = 0;
+    drop_frame_number = 0;
+    tx_queue_space = 16;
+    paced_queue_space = 16;
+    number_of_paced_frames = 0;
+    memset(separation_times_us, 0, sizeof(separation_times_us));
+    paced_transmit_pending = false;
+    paced_transmit_pending_id = 0;
     got_callback = false;
-    system_time_us = 0;
     memset(tx_buffer, 0, sizeof(tx_buffer));
+    ISOTP_Init();
     return 0;
 }
 
-static void ProccessUntilStatus(struct isotp_ctx_t *ctx_p, enum isotp_status_t expected_status)
+static void ProccessUntilStatus(enum isotp_status_t expected_status)
 {
     expect_uint_value(MockRxStatusHandler, status, expected_status);
 
@@ -156,7 +187,7 @@ static void ProccessUntilStatus(struct isotp_ctx_t *ctx_p, enum isotp_status_t e
     const size_t max_iterations = 2000;
     for (size_t i = 0; i < 2000; ++i)
     {
-        ISOTP_Proccess(ctx_p);
+        ISOTP_Proccess();
 
         if (got_callback)
         {
@@ -166,11 +197,11 @@ static void ProccessUntilStatus(struct isotp_ctx_t *ctx_p, enum isotp_status_t e
     }
 }
 
-static void Proccess(struct isotp_ctx_t *ctx_p, uint32_t count)
+static void Proccess(uint32_t count)
 {
     for (size_t i = 0; i < count; ++i)
     {
-        ISOTP_Proccess(ctx_p);
+        ISOTP_Proccess();
     }
 }
 
@@ -192,6 +223,42 @@ static void InjectFlowControlFrame(uint32_t id)
     CANInterface_Transmit(frame.id, frame.data,frame.size);
 }
 
+static void InjectFrame(const uint8_t *data_p, size_t size)
+{
+    struct can_frame_t frame;
+    frame.id = 0x01;
+    frame.size = size;
+    memcpy(frame.data, data_p, size);
+
+    listener.listener_cb(&frame, listener.arg_p);
+}
+
+static void InjectFirstFrame(uint16_t length)
+{
+    const uint8_t data[] = {0x10 | (length >> 8), length & 0xFF, 0, 1, 2, 3, 4, 5};
+    InjectFrame(data, sizeof(data));
+}
+
+static void InjectConsecutiveFrame(uint8_t sequence_number)
+{
+    const uint8_t data[] = {0x20 | (sequence_number & 0x0F), 0, 1, 2, 3, 4, 5, 6};
+    InjectFrame(data, sizeof(data));
+}
+
+static void AssertFlowControlFrame(uint8_t flag, uint8_t block_size, uint8_t separation_time)
+{
+    assert_int_equal(last_transmitted_frame.size, 3);
+    assert_int_equal(last_transmitted_frame.data[0], 0x30 | flag);
+    assert_int_equal(last_transmitted_frame.data[1], block_size);
+    assert_int_equal(last_transmitted_frame.data[2], separation_time);
+}
+
+static void InjectClearToSendFrame(uint8_t block_size)
+{
+    const uint8_t data[] = {0x30, block_size, 0x00};
+    CANInterface_Transmit(0x02, (void *)data, sizeof(data));
+}
+
 //////////////////////////////////////////////////////////////////////////
 //TESTS
 //////////////////////////////////////////////////////////////////////////
@@ -208,11 +275,6 @@ static void test_ISOTP_Bind_InvalidParameters(void **state)
     expect_assert_failure(ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, 0, 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler));
 }
 
-static void test_ISOTP_Process_InvalidParameters(void **state)
-{
-    expect_assert_failure(ISOTP_Proccess(NULL));
-}
-
 static void test_ISOTP_Receive_InvalidParameters(void **state)
 {
     uint8_t rx_data[8];
@@ -220,6 +282,22 @@ static void test_ISOTP_Receive_InvalidParameters(void **state)
     expect_assert_failure(ISOTP_Receive(&ctx, NULL, sizeof(rx_data)));
 }
 
+static void test_ISOTP_SendBuffers_InvalidParameters(void **state)
+{
+    const struct isotp_buffer_t buffers[] = {{NULL, 1}};
+    expect_assert_failure(ISOTP_SendBuffers(NULL, buffers, 0));
+    expect_assert_failure(ISOTP_SendBuffers(&ctx, NULL, 0));
+    expect_assert_failure(ISOTP_SendBuffers(&ctx, buffers, ElementsIn(buffers)));
+}
+
+static void test_ISOTP_PeekConsume_InvalidParameters(void **state)
+{
+    const void *data_p;
+    expect_assert_failure(ISOTP_Peek(NULL, &data_p));
+    expect_assert_failure(ISOTP_Peek(&ctx, NULL));
+    expect_assert_failure(ISOTP_Consume(NULL, 1));
+}
+
 static void test_ISOTP_Send_InvalidParameters(void **state)
 {
     uint8_t tx_data[8];
@@ -230,20 +308,19 @@ static void test_ISOTP_Send_InvalidParameters(void **state)
 static void test_ISOTP_SingleFrame(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
 
     uint8_t rx_buffer[32];
     ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
-    ISOTP_Proccess(&ctx);
+    ISOTP_Proccess();
 
     uint8_t tx_data[] = {1, 2, 3, 4, 5, 6};
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
 
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
     assert_false(ISOTP_IsSending(&ctx));
 
     uint8_t rx_data[8];
@@ -255,8 +332,7 @@ static void test_ISOTP_SingleFrame(void **state)
 static void test_ISOTP_SingleFrameOverflow(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
@@ -266,15 +342,14 @@ static void test_ISOTP_SingleFrameOverflow(void **state)
 
     uint8_t tx_data[] = {1, 2, 3, 4, 5, 6};
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_OVERFLOW_ABORT);
+    ProccessUntilStatus(ISOTP_STATUS_OVERFLOW_ABORT);
     assert_false(ISOTP_IsSending(&ctx));
 }
 
 static void test_ISOTP_FirstFrameOverflow(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
@@ -286,15 +361,14 @@ static void test_ISOTP_FirstFrameOverflow(void **state)
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
 
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_OVERFLOW_ABORT);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_OVERFLOW_ABORT);
+    ProccessUntilStatus(ISOTP_STATUS_OVERFLOW_ABORT);
     assert_false(ISOTP_IsSending(&ctx));
 }
 
 static void test_ISOTP_MultiplePacketsOverflow(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 101);
@@ -306,15 +380,15 @@ static void test_ISOTP_MultiplePacketsOverflow(void **state)
 
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
 
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
 
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_OVERFLOW_ABORT);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_OVERFLOW_ABORT);
+    ProccessUntilStatus(ISOTP_STATUS_OVERFLOW_ABORT);
     assert_false(ISOTP_IsSending(&ctx));
 
     uint8_t rx_data[32];
@@ -325,8 +399,7 @@ static void test_ISOTP_MultiplePacketsOverflow(void **state)
 static void test_ISOTP_MulipleFrames(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
@@ -340,7 +413,7 @@ static void test_ISOTP_MulipleFrames(void **state)
     assert_true(ISOTP_IsSending(&ctx));
 
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
     assert_false(ISOTP_IsSending(&ctx));
 
     uint8_t rx_data[32];
@@ -352,8 +425,7 @@ static void test_ISOTP_MulipleFrames(void **state)
 static void test_ISOTP_MaxDataLength(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
@@ -366,7 +438,7 @@ static void test_ISOTP_MaxDataLength(void **state)
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
 
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
 
     uint8_t rx_data[ISOTP_MAX_DATA_LENGTH];
     size_t res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
@@ -377,8 +449,7 @@ static void test_ISOTP_MaxDataLength(void **state)
 static void test_ISOTP_ConsecutiveFrameTimeout(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
 
     /* Should cause timeout while waiting for the first consecutive frame. */
@@ -392,7 +463,7 @@ static void test_ISOTP_ConsecutiveFrameTimeout(void **state)
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
 
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_TIMEOUT);
+    ProccessUntilStatus(ISOTP_STATUS_TIMEOUT);
     assert_false(ISOTP_IsSending(&ctx));
 
     uint8_t rx_data[32];
@@ -403,8 +474,7 @@ static void test_ISOTP_ConsecutiveFrameTimeout(void **state)
 static void test_ISOTP_FlowControlFrameTimeout(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
 
     /* Should cause timeout while waiting for the first flow control frame. */
@@ -415,12 +485,12 @@ static void test_ISOTP_FlowControlFrameTimeout(void **state)
     ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
 
     /* Drop the First frame so that the receiver does not send a Flow control frame in response.*/
-    drop_frame = true;
+    drop_frame_number = number_of_transmitted_frames + 1;
     uint8_t tx_data[ISOTP_MAX_DATA_LENGTH] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
 
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_TIMEOUT);
-    Proccess(&ctx, 1);
+    Proccess(1);
 
     /* Make sure that the buffer is cleared after a flow control frame timeout. */
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
@@ -429,8 +499,7 @@ static void test_ISOTP_FlowControlFrameTimeout(void **state)
 static void test_ISOTP_ConsecutiveFrameLost(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
@@ -442,10 +511,11 @@ static void test_ISOTP_ConsecutiveFrameLost(void **state)
     FillBuffer(tx_data, sizeof(tx_data));
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
 
+    /* Frames are sent in the order FF, FC, CF1, CF2, drop the second consecutive frame. */
+    drop_frame_number = 4;
+
     expect_uint_value(MockRxStatusHandler, status, ISOTP_STATUS_LOST_FRAME);
-    Proccess(&ctx, 2);
-    drop_frame = true;
-    Proccess(&ctx, 5);
+    Proccess(2);
 
     uint8_t rx_data[32];
     size_t res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
@@ -455,8 +525,7 @@ static void test_ISOTP_ConsecutiveFrameLost(void **state)
 static void test_ISOTP_TxBufferFull(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
@@ -470,8 +539,7 @@ static void test_ISOTP_TxBufferFull(void **state)
 static void test_ISOTP_SendWithActiveTransfer(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
@@ -485,7 +553,7 @@ static void test_ISOTP_SendWithActiveTransfer(void **state)
     assert_false(ISOTP_Send(&ctx, tx_data_2, sizeof(tx_data_2)));
 
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
 
     uint8_t rx_data[32];
     size_t res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
@@ -496,8 +564,7 @@ static void test_ISOTP_SendWithActiveTransfer(void **state)
 static void test_ISOTP_SendWithCanTransmitError(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, false);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
@@ -512,8 +579,7 @@ static void test_ISOTP_SendWithCanTransmitError(void **state)
 static void test_ISOTP_TxCanTransmitError(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
@@ -527,15 +593,14 @@ static void test_ISOTP_TxCanTransmitError(void **state)
     will_return(CANInterface_Transmit, true);
     will_return(CANInterface_Transmit, false);
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_OVERFLOW_ABORT);
-    Proccess(&ctx, 2);
+    Proccess(2);
     assert_false(ISOTP_IsSending(&ctx));
 }
 
 static void test_ISOTP_WaitingForRxSpace(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 101);
@@ -548,10 +613,10 @@ static void test_ISOTP_WaitingForRxSpace(void **state)
 
     uint8_t rx_data[16];
     size_t res;
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_WAITING);
+    ProccessUntilStatus(ISOTP_STATUS_WAITING);
     res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
     res += ISOTP_Receive(&ctx, rx_data + res, sizeof(rx_data) - res);
     assert_int_equal(res, sizeof(tx_data));
     assert_memory_equal(rx_data, tx_data, res);
@@ -560,8 +625,7 @@ static void test_ISOTP_WaitingForRxSpace(void **state)
 static void test_ISOTP_RxWaitingTimeout(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_count(SysTime_GetDifference, 100, 2);
@@ -573,20 +637,26 @@ static void test_ISOTP_RxWaitingTimeout(void **state)
     uint8_t tx_data[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
 
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_WAITING);
+    ProccessUntilStatus(ISOTP_STATUS_WAITING);
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_OVERFLOW_ABORT);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_TIMEOUT);
+    ProccessUntilStatus(ISOTP_STATUS_TIMEOUT);
 
     uint8_t rx_data[32];
     size_t res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
     assert_int_equal(res, 0);
+
+    /* Both the receiver and the sender count the WAIT frames (max 10) and the abort. */
+    struct isotp_statistics_t statistics;
+    Proccess(1);
+    ISOTP_GetStatistics(&ctx, &statistics);
+    assert_int_equal(statistics.wait_frames, 2 * 10);
+    assert_int_equal(statistics.overflow_aborts, 2);
 }
 
 static void test_ISOTP_TxWaitingTimeout(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 101);
@@ -597,8 +667,8 @@ static void test_ISOTP_TxWaitingTimeout(void **state)
     uint8_t tx_data[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
     assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
 
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_WAITING);
-    Proccess(&ctx, 7);
+    ProccessUntilStatus(ISOTP_STATUS_WAITING);
+    Proccess(7);
 
     /**
      * Inject extra flow control frames with flag=WAIT to trigger timeout on the tx side.
@@ -609,75 +679,568 @@ static void test_ISOTP_TxWaitingTimeout(void **state)
     InjectFlowControlFrame(0x02);
 
     expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_TIMEOUT);
-    ProccessUntilStatus(&ctx, ISOTP_STATUS_TIMEOUT);
+    ProccessUntilStatus(ISOTP_STATUS_TIMEOUT);
     assert_false(ISOTP_IsSending(&ctx));
 }
 
 static void test_ISOTP_SeparationTime(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
-    expect_any_always(CANInterface_AddFilter, id);
-    expect_any_always(CANInterface_AddFilter, mask);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
     will_return_uint_maybe(CANInterface_Transmit, true);
     will_return_uint_maybe(SysTime_GetSystemTime, 0);
     will_return_uint_maybe(SysTime_GetDifference, 1);
 
     uint8_t rx_buffer[32];
-    const uint8_t tx_data[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    const uint8_t tx_data[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
 
-    /* Millisecond range */
-    const uint8_t separation_times_ms[] = {0, 1, 60, 126, 127};
-    for (size_t i = 0; i < ElementsIn(separation_times_ms); ++i)
+    /* ST codes and the expected separation in microseconds, invalid codes use 10 ms. */
+    const struct
+    {
+        uint8_t st;
+        uint32_t separation_time_us;
+    } separation_times[] =
+    {
+        {1, 1000}, {60, 60000}, {126, 126000}, {127, 127000},
+        {241, 100}, {242, 200}, {245, 500}, {248, 800}, {249, 900},
+        {128, 10000}, {240, 10000}, {250, 10000}, {UINT8_MAX, 10000}
+    };
+    for (size_t i = 0; i < ElementsIn(separation_times); ++i)
     {
-        const uint32_t start_system_time_us = system_time_us;
+        number_of_paced_frames = 0;
         ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
-        ISOTP_SetSeparationTime(&ctx, separation_times_ms[i]);
+        ISOTP_SetSeparationTime(&ctx, separation_times[i].st);
 
         assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
         expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+        ProccessUntilStatus(ISOTP_STATUS_DONE);
+
+        /* All consecutive frames are paced, no separation after the last one. */
+        assert_int_equal(number_of_paced_frames, 2);
+        assert_int_equal(separation_times_us[0], separation_times[i].separation_time_us);
+        assert_int_equal(separation_times_us[1], 0);
+    }
+
+    /* Without a separation time the frames are not paced. */
+    number_of_paced_frames = 0;
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+    ISOTP_SetSeparationTime(&ctx, 0);
+
+    assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
+    expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+    assert_int_equal(number_of_paced_frames, 0);
+}
+
+static void test_ISOTP_SeparationTime_PacedQueue(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    uint8_t rx_buffer[64];
+    uint8_t tx_data[41]; /* First frame and one block of consecutive frames. */
+    FillBuffer(tx_data, sizeof(tx_data));
+
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+    ISOTP_SetSeparationTime(&ctx, 0xF5);
+
+    /* Consecutive frames wait for space in the paced queue. */
+    paced_queue_space = 0;
+    assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
+    Proccess(10);
+    assert_int_equal(number_of_paced_frames, 0);
+
+    /* All frames are queued in one call, the receiver gets them immediately. */
+    paced_queue_space = 16;
+    paced_transmit_pending = true;
+    paced_transmit_pending_id = 0x2;
+    ISOTP_Proccess();
+    assert_int_equal(number_of_paced_frames, INITIAL_BLOCK_SIZE);
+    assert_int_equal(separation_times_us[0], 500);
+
+    /* TX is done when the last frame has left the paced queue. */
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+    assert_true(ISOTP_IsSending(&ctx));
+
+    /* Paced frames of another link don't hold back the link. */
+    paced_transmit_pending_id = 0x3;
+    expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    ISOTP_Proccess();
+    assert_false(ISOTP_IsSending(&ctx));
+
+    uint8_t rx_data[64];
+    assert_int_equal(ISOTP_Receive(&ctx, rx_data, sizeof(rx_data)), sizeof(tx_data));
+    assert_memory_equal(rx_data, tx_data, sizeof(tx_data));
+}
+
+static void test_ISOTP_ProccessDrainsPendingFrames(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    uint8_t rx_buffer[32];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    uint8_t tx_data[20];
+    FillBuffer(tx_data, sizeof(tx_data));
+    assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
+
+    /* The FF is handled, the FC is consumed and both CFs are sent in the same call. */
+    expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    Proccess(1);
+    assert_false(ISOTP_IsSending(&ctx));
+    assert_int_equal(number_of_transmitted_frames, 4);
+
+    /* Both CFs are received in the next call. */
+    expect_uint_value(MockRxStatusHandler, status, ISOTP_STATUS_DONE);
+    Proccess(1);
+
+    uint8_t rx_data[32];
+    size_t res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
+    assert_int_equal(res, sizeof(tx_data));
+    assert_memory_equal(rx_data, tx_data, res);
+}
+
+static void test_ISOTP_TransmitQueueFull(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    uint8_t rx_buffer[32];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    uint8_t tx_data[20];
+    FillBuffer(tx_data, sizeof(tx_data));
+    assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
+
+    /* No CFs are sent while the CAN TX queue is full, the transfer waits instead of aborting. */
+    tx_queue_space = 0;
+    Proccess(5);
+    assert_true(ISOTP_IsSending(&ctx));
+    assert_int_equal(number_of_transmitted_frames, 2);
+
+    tx_queue_space = 1;
+    expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+
+    uint8_t rx_data[32];
+    size_t res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
+    assert_int_equal(res, sizeof(tx_data));
+    assert_memory_equal(rx_data, tx_data, res);
+}
+
+static void test_ISOTP_MaxFramesPerProccess(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    uint8_t rx_buffer[32];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    /* Drop the FF and let the sender send all CFs without waiting for another FC. */
+    drop_frame_number = 1;
+    uint8_t tx_data[ISOTP_MAX_DATA_LENGTH];
+    FillBuffer(tx_data, sizeof(tx_data));
+    assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
+    InjectClearToSendFrame(0);
+
+    size_t start_number_of_transmitted_frames = number_of_transmitted_frames;
+    Proccess(1);
+    assert_true(ISOTP_IsSending(&ctx));
+    assert_in_range(number_of_transmitted_frames - start_number_of_transmitted_frames, 1, ISOTP_MAX_FRAMES_PER_PROCESS);
+
+    start_number_of_transmitted_frames = number_of_transmitted_frames;
+    Proccess(1);
+    assert_int_equal(number_of_transmitted_frames - start_number_of_transmitted_frames, ISOTP_MAX_FRAMES_PER_PROCESS);
+}
+
+static void test_ISOTP_Statistics(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
 
-        ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
-        if (separation_times_ms[i] > 0)
+    uint8_t rx_buffer[32];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    struct isotp_statistics_t statistics;
+    expect_assert_failure(ISOTP_GetStatistics(NULL, &statistics));
+    expect_assert_failure(ISOTP_GetStatistics(&ctx, NULL));
+
+    uint8_t tx_data[20];
+    FillBuffer(tx_data, sizeof(tx_data));
+    assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
+
+    expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    Proccess(1);
+    ISOTP_GetStatistics(&ctx, &statistics);
+    assert_int_equal(statistics.rx_bytes_per_process, 6);
+    assert_int_equal(statistics.tx_bytes_per_process, sizeof(tx_data));
+
+    expect_uint_value(MockRxStatusHandler, status, ISOTP_STATUS_DONE);
+    Proccess(1);
+    ISOTP_GetStatistics(&ctx, &statistics);
+    assert_int_equal(statistics.rx_bytes_per_process, 14);
+    assert_int_equal(statistics.tx_bytes_per_process, 0);
+    assert_int_equal(statistics.max_rx_bytes_per_process, 14);
+    assert_int_equal(statistics.max_tx_bytes_per_process, sizeof(tx_data));
+}
+
+static void test_ISOTP_PeekConsume(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    uint8_t rx_buffer[16];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    const void *data_p;
+    assert_int_equal(ISOTP_Peek(&ctx, &data_p), 0);
+
+    uint8_t tx_data[10];
+    FillBuffer(tx_data, sizeof(tx_data));
+    assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
+    expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+
+    /* The data is read in place from the RX buffer. */
+    assert_int_equal(ISOTP_Peek(&ctx, &data_p), sizeof(tx_data));
+    assert_ptr_equal(data_p, rx_buffer);
+    assert_memory_equal(data_p, tx_data, sizeof(tx_data));
+    assert_int_equal(ISOTP_Consume(&ctx, sizeof(tx_data)), sizeof(tx_data));
+    assert_int_equal(ISOTP_Peek(&ctx, &data_p), 0);
+
+    /* The second message wraps around the end of the RX buffer and is returned in two parts. */
+    assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
+    expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+
+    const size_t first_part_size = sizeof(rx_buffer) - sizeof(tx_data);
+    assert_int_equal(ISOTP_Peek(&ctx, &data_p), first_part_size);
+    assert_memory_equal(data_p, tx_data, first_part_size);
+    assert_int_equal(ISOTP_Consume(&ctx, first_part_size), first_part_size);
+
+    assert_int_equal(ISOTP_Peek(&ctx, &data_p), sizeof(tx_data) - first_part_size);
+    assert_ptr_equal(data_p, rx_buffer);
+    assert_memory_equal(data_p, tx_data + first_part_size, sizeof(tx_data) - first_part_size);
+    assert_int_equal(ISOTP_Consume(&ctx, sizeof(tx_data)), sizeof(tx_data) - first_part_size);
+}
+
+static void test_ISOTP_SendBuffers(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    /* No TX buffer is needed when sending from caller-owned buffers. */
+    uint8_t rx_buffer[128];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), NULL, 0, 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    uint8_t expected_data[105];
+    FillBuffer(expected_data, sizeof(expected_data));
+    const struct isotp_buffer_t buffers[] =
+    {
+        {expected_data, 5},
+        {NULL, 0},
+        {expected_data + 5, sizeof(expected_data) - 5}
+    };
+    assert_true(ISOTP_SendBuffers(&ctx, buffers, ElementsIn(buffers)));
+    assert_true(ISOTP_IsSending(&ctx));
+    assert_false(ISOTP_SendBuffers(&ctx, buffers, ElementsIn(buffers)));
+
+    expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+    assert_false(ISOTP_IsSending(&ctx));
+
+    uint8_t rx_data[128];
+    size_t res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
+    assert_int_equal(res, sizeof(expected_data));
+    assert_memory_equal(rx_data, expected_data, res);
+
+    /* Single frames are gathered and sent directly. */
+    const struct isotp_buffer_t short_buffers[] = {{expected_data, 3}, {expected_data + 3, 2}};
+    assert_true(ISOTP_SendBuffers(&ctx, short_buffers, ElementsIn(short_buffers)));
+    assert_false(ISOTP_IsSending(&ctx));
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+    res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
+    assert_int_equal(res, 5);
+    assert_memory_equal(rx_data, expected_data, res);
+
+    /* Only single frames can be sent with 'ISOTP_Send' without a TX buffer. */
+    assert_false(ISOTP_Send(&ctx, expected_data, sizeof(expected_data)));
+    assert_true(ISOTP_Send(&ctx, expected_data, 7));
+}
+
+static void test_ISOTP_SendBuffers_TooLong(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+
+    uint8_t rx_buffer[32];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), NULL, 0, 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    /* The size must fit in the 32-bit FF_DL of an escape first frame. */
+    const struct isotp_buffer_t buffers[] = {{tx_buffer, UINT32_MAX}, {tx_buffer, 1}};
+    assert_false(ISOTP_SendBuffers(&ctx, buffers, ElementsIn(buffers)));
+    assert_false(ISOTP_IsSending(&ctx));
+}
+
+static void test_ISOTP_AdaptiveFlowControl_Grow(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    uint8_t rx_buffer[1024];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    InjectFirstFrame(1000);
+    Proccess(1);
+    AssertFlowControlFrame(0, INITIAL_BLOCK_SIZE, 0);
+
+    /* Each frame is processed before the next arrives, the block size grows by one per block. */
+    uint8_t sequence_number = 1;
+    for (uint8_t block_size = INITIAL_BLOCK_SIZE; block_size < INITIAL_BLOCK_SIZE + 3; ++block_size)
+    {
+        for (uint8_t i = 0; i < block_size; ++i)
         {
-            assert_int_equal(system_time_us - start_system_time_us - 100, separation_times_ms[i] * 1000);
+            InjectConsecutiveFrame(sequence_number++);
+            Proccess(1);
         }
-        else
+        AssertFlowControlFrame(0, block_size + 1, 0);
+    }
+
+    struct isotp_statistics_t statistics;
+    ISOTP_GetStatistics(&ctx, &statistics);
+    assert_int_equal(statistics.block_size, INITIAL_BLOCK_SIZE + 3);
+    assert_int_equal(statistics.separation_time, 0);
+}
+
+static void test_ISOTP_AdaptiveFlowControl_Congested(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    uint8_t rx_buffer[1024];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    InjectFirstFrame(1000);
+    Proccess(1);
+
+    /* Grow the block size past the frame pool size. */
+    uint8_t sequence_number = 1;
+    for (uint8_t block_size = INITIAL_BLOCK_SIZE; block_size <= ISOTP_FRAME_POOL_SIZE; ++block_size)
+    {
+        for (uint8_t i = 0; i < block_size; ++i)
         {
-            assert_int_equal(system_time_us - start_system_time_us, 0);
+            InjectConsecutiveFrame(sequence_number++);
+            Proccess(1);
         }
     }
+    AssertFlowControlFrame(0, ISOTP_FRAME_POOL_SIZE + 1, 0);
 
-    /* Microseconds range */
-    const uint8_t separation_times_us[] = {241, 242, 245, 248, 249};
-    for (size_t i = 0; i < ElementsIn(separation_times_us); ++i)
+    /* A slow main loop exhausts the frame pool, the frame is lost and the transfer aborted. */
+    for (uint8_t i = 0; i < ISOTP_FRAME_POOL_SIZE + 1; ++i)
     {
-        const uint32_t start_system_time_us = system_time_us;
-        ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
-        ISOTP_SetSeparationTime(&ctx, separation_times_us[i]);
+        InjectConsecutiveFrame(sequence_number++);
+    }
+    Proccess(1);
+    InjectConsecutiveFrame(sequence_number++);
+    expect_uint_value(MockRxStatusHandler, status, ISOTP_STATUS_LOST_FRAME);
+    Proccess(1);
+
+    struct isotp_statistics_t statistics;
+    ISOTP_GetStatistics(&ctx, &statistics);
+    assert_int_equal(statistics.block_size, (ISOTP_FRAME_POOL_SIZE + 1) / 2);
+    assert_int_equal(statistics.separation_time, 1);
+
+    /* The next transfer starts with the reduced block size and a separation time. */
+    InjectFirstFrame(1000);
+    Proccess(1);
+    AssertFlowControlFrame(0, (ISOTP_FRAME_POOL_SIZE + 1) / 2, 1);
+
+    /* A configured separation time longer than the adaptive one is kept. */
+    ISOTP_SetSeparationTime(&ctx, 2);
+    sequence_number = 1;
+    for (uint8_t i = 0; i < (ISOTP_FRAME_POOL_SIZE + 1) / 2; ++i)
+    {
+        InjectConsecutiveFrame(sequence_number++);
+        Proccess(1);
+    }
+    AssertFlowControlFrame(0, (ISOTP_FRAME_POOL_SIZE + 1) / 2, 2);
 
-        assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
-        expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    /* The separation time is lowered before the block size grows. */
+    ISOTP_GetStatistics(&ctx, &statistics);
+    assert_int_equal(statistics.block_size, (ISOTP_FRAME_POOL_SIZE + 1) / 2);
+    assert_int_equal(statistics.separation_time, 0);
+}
 
-        ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
-        /* Microseconds timer is not implemented yet so always expect 1 ms. */
-        assert_int_equal(system_time_us - start_system_time_us - 100, (separation_times_us[i] - 240) * 100);
-    }
+static void test_ISOTP_MultipleChannels(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, 2);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
 
-    /* Invalid range */
-    const uint8_t separation_times_invalid[] = {128, 240, 250, UINT8_MAX};
-    for (size_t i = 0; i < ElementsIn(separation_times_invalid); ++i)
-    {
-        const uint32_t start_system_time_us = system_time_us;
-        ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
-        ISOTP_SetSeparationTime(&ctx, separation_times_invalid[i]);
+    uint8_t rx_buffer[32];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+    const struct listener_t first_listener = listener;
 
-        assert_true(ISOTP_Send(&ctx, tx_data, sizeof(tx_data)));
-        expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    struct isotp_ctx_t other_ctx;
+    uint8_t other_rx_buffer[32];
+    ISOTP_Bind(&other_ctx, other_rx_buffer, sizeof(other_rx_buffer), NULL, 0, 0x3, 0x4, MockRxStatusHandler, MockTxStatusHandler);
+
+    /* All channels share one listener. */
+    assert_ptr_equal(listener.listener_cb, first_listener.listener_cb);
+    assert_ptr_equal(listener.arg_p, first_listener.arg_p);
+
+    /* Frames are routed to the channel bound to the RX ID. */
+    struct can_frame_t frame = {.id = 0x3, .size = 4, .data = {0x03, 1, 2, 3}};
+    listener.listener_cb(&frame, listener.arg_p);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+
+    uint8_t rx_data[8];
+    assert_int_equal(ISOTP_Receive(&other_ctx, rx_data, sizeof(rx_data)), 3);
+    assert_memory_equal(rx_data, &frame.data[1], 3);
+    assert_int_equal(ISOTP_Receive(&ctx, rx_data, sizeof(rx_data)), 0);
+
+    /* Frames for unbound RX IDs are ignored. */
+    frame.id = 0x5;
+    listener.listener_cb(&frame, listener.arg_p);
+    Proccess(1);
+    assert_int_equal(ISOTP_Receive(&ctx, rx_data, sizeof(rx_data)), 0);
+    assert_int_equal(ISOTP_Receive(&other_ctx, rx_data, sizeof(rx_data)), 0);
+
+    /* Rebinding a context reuses its channel, the filter is already registered. */
+    ISOTP_Bind(&other_ctx, other_rx_buffer, sizeof(other_rx_buffer), NULL, 0, 0x3, 0x4, MockRxStatusHandler, MockTxStatusHandler);
+    frame.id = 0x3;
+    listener.listener_cb(&frame, listener.arg_p);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+    assert_int_equal(ISOTP_Receive(&other_ctx, rx_data, sizeof(rx_data)), 3);
+
+    /* Rebinding a context to another RX ID replaces the filter. */
+    expect_uint_value(CANInterface_UnregisterListener, id, 0x3);
+    expect_uint_value(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK);
+    ISOTP_Bind(&other_ctx, other_rx_buffer, sizeof(other_rx_buffer), NULL, 0, 0x5, 0x4, MockRxStatusHandler, MockTxStatusHandler);
+    listener.listener_cb(&frame, listener.arg_p);
+    Proccess(1);
+    assert_int_equal(ISOTP_Receive(&other_ctx, rx_data, sizeof(rx_data)), 0);
+
+    frame.id = 0x5;
+    listener.listener_cb(&frame, listener.arg_p);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+    assert_int_equal(ISOTP_Receive(&other_ctx, rx_data, sizeof(rx_data)), 3);
+}
+
+static void test_ISOTP_MultipleChannels_PoolExhausted(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, 2);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
 
-        ProccessUntilStatus(&ctx, ISOTP_STATUS_DONE);
-        /* Expect default value (10 ms) when separation time is invalid. */
-        assert_int_equal(system_time_us - start_system_time_us - 100, 10000);
+    uint8_t rx_buffer[32];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    struct isotp_ctx_t other_ctx;
+    uint8_t other_rx_buffer[32];
+    ISOTP_Bind(&other_ctx, other_rx_buffer, sizeof(other_rx_buffer), NULL, 0, 0x3, 0x4, MockRxStatusHandler, MockTxStatusHandler);
+
+    /* Frames pending on one channel use up the pool shared with the other channel. */
+    for (uint8_t i = 0; i < ISOTP_FRAME_POOL_SIZE; ++i)
+    {
+        InjectConsecutiveFrame(i);
     }
+
+    struct can_frame_t frame = {.id = 0x3, .size = 4, .data = {0x03, 1, 2, 3}};
+    listener.listener_cb(&frame, listener.arg_p);
+    Proccess(1);
+
+    uint8_t rx_data[8];
+    assert_int_equal(ISOTP_Receive(&other_ctx, rx_data, sizeof(rx_data)), 0);
+
+    /* The frames are returned to the pool when processed. */
+    listener.listener_cb(&frame, listener.arg_p);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+    assert_int_equal(ISOTP_Receive(&other_ctx, rx_data, sizeof(rx_data)), 3);
+}
+
+static void test_ISOTP_EscapeFirstFrame(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(CANInterface_Transmit, true);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    static uint8_t rx_buffer[ISOTP_MAX_DATA_LENGTH + 905];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), NULL, 0, 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    static uint8_t tx_data[sizeof(rx_buffer)];
+    FillBuffer(tx_data, sizeof(tx_data));
+    const struct isotp_buffer_t buffers[] = {{tx_data, sizeof(tx_data)}};
+    assert_true(ISOTP_SendBuffers(&ctx, buffers, ElementsIn(buffers)));
+
+    /* The 12-bit size is zero and followed by the 32-bit size, leaving two data bytes. */
+    const uint8_t expected_frame[] = {0x10, 0x00, 0x00, 0x00, 0x13, 0x88, 0x00, 0x01};
+    assert_int_equal(last_transmitted_frame.size, sizeof(expected_frame));
+    assert_memory_equal(last_transmitted_frame.data, expected_frame, sizeof(expected_frame));
+
+    expect_uint_value(MockTxStatusHandler, status, ISOTP_STATUS_DONE);
+    ProccessUntilStatus(ISOTP_STATUS_DONE);
+
+    static uint8_t rx_data[sizeof(rx_buffer)];
+    size_t res = ISOTP_Receive(&ctx, rx_data, sizeof(rx_data));
+    assert_int_equal(res, sizeof(tx_data));
+    assert_memory_equal(rx_data, tx_data, res);
+}
+
+static void test_ISOTP_EscapeFirstFrame_Invalid(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    expect_uint_value_count(CANInterface_RegisterListener, priority, CANINTERFACE_PRIORITY_BULK, -1);
+    will_return_uint_maybe(SysTime_GetSystemTime, 0);
+    will_return_uint_maybe(SysTime_GetDifference, 1);
+
+    uint8_t rx_buffer[32];
+    ISOTP_Bind(&ctx, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer), 0x1, 0x2, MockRxStatusHandler, MockTxStatusHandler);
+
+    /* The escape sequence must not be used for sizes that fit in 12 bits, the frame is ignored. */
+    const uint8_t data[] = {0x10, 0x00, 0x00, 0x00, 0x0F, 0xFF, 0, 1};
+    InjectFrame(data, sizeof(data));
+    Proccess(1);
+
+    assert_int_equal(number_of_transmitted_frames, 0);
+    assert_false(got_callback);
+
+    const void *data_p;
+    assert_int_equal(ISOTP_Peek(&ctx, &data_p), 0);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -689,8 +1252,9 @@ int main(int argc, char *argv[])
     const struct CMUnitTest test_ISOTP[] =
     {
         cmocka_unit_test_setup(test_ISOTP_Bind_InvalidParameters, Setup),
-        cmocka_unit_test_setup(test_ISOTP_Process_InvalidParameters, Setup),
         cmocka_unit_test_setup(test_ISOTP_Receive_InvalidParameters, Setup),
+        cmocka_unit_test_setup(test_ISOTP_SendBuffers_InvalidParameters, Setup),
+        cmocka_unit_test_setup(test_ISOTP_PeekConsume_InvalidParameters, Setup),
         cmocka_unit_test_setup(test_ISOTP_Send_InvalidParameters, Setup),
         cmocka_unit_test_setup(test_ISOTP_SingleFrame, Setup),
         cmocka_unit_test_setup(test_ISOTP_SingleFrameOverflow, Setup),
@@ -709,6 +1273,20 @@ int main(int argc, char *argv[])
         cmocka_unit_test_setup(test_ISOTP_RxWaitingTimeout, Setup),
         cmocka_unit_test_setup(test_ISOTP_TxWaitingTimeout, Setup),
         cmocka_unit_test_setup(test_ISOTP_SeparationTime, Setup),
+        cmocka_unit_test_setup(test_ISOTP_SeparationTime_PacedQueue, Setup),
+        cmocka_unit_test_setup(test_ISOTP_ProccessDrainsPendingFrames, Setup),
+        cmocka_unit_test_setup(test_ISOTP_TransmitQueueFull, Setup),
+        cmocka_unit_test_setup(test_ISOTP_MaxFramesPerProccess, Setup),
+        cmocka_unit_test_setup(test_ISOTP_Statistics, Setup),
+        cmocka_unit_test_setup(test_ISOTP_PeekConsume, Setup),
+        cmocka_unit_test_setup(test_ISOTP_SendBuffers, Setup),
+        cmocka_unit_test_setup(test_ISOTP_SendBuffers_TooLong, Setup),
+        cmocka_unit_test_setup(test_ISOTP_AdaptiveFlowControl_Grow, Setup),
+        cmocka_unit_test_setup(test_ISOTP_AdaptiveFlowControl_Congested, Setup),
+        cmocka_unit_test_setup(test_ISOTP_MultipleChannels, Setup),
+        cmocka_unit_test_setup(test_ISOTP_MultipleChannels_PoolExhausted, Setup),
+        cmocka_unit_test_setup(test_ISOTP_EscapeFirstFrame, Setup),
+        cmocka_unit_test_setup(test_ISOTP_EscapeFirstFrame_Invalid, Setup),
     };
 
     if (argc >= 2)
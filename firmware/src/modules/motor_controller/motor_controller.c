@@ -36,6 +36,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include "systime.h"
 #include "pid.h"
 #include "system_monitor.h"
+#include "device_monitoring.h"
 #include "motor_controller.h"
 
 //////////////////////////////////////////////////////////////////////////
@@ -62,6 +63,8 @@ struct motor_instance_t
     struct motor_t motor;
     struct pid_t rpm_pid;
     struct pid_t current_pid;
+    uint32_t setpoint_time;
+    bool setpoint_pending;
 };
 
 struct motor_controller_t
@@ -150,6 +153,14 @@ void MotorController_SetCurrent(size_t index, int16_t current)
     Logging_Debug(module.logger_p, "M%u sp: {current: %i}", index, limited_current);
 }
 
+void MotorController_SetSetpointTime(size_t index, uint32_t timestamp)
+{
+    assert(index < Config_GetNumberOfMotors());
+
+    module.instances[index].setpoint_time = timestamp;
+    module.instances[index].setpoint_pending = true;
+}
+
 void MotorController_Run(size_t index)
 {
     assert(index < Config_GetNumberOfMotors());
@@ -273,8 +284,19 @@ static inline void UpdateMotorSpeeds(void)
             const int32_t current_cv = PID_Update(&instance_p->current_pid, Motor_GetCurrent(&instance_p->motor));
             Logging_Debug(module.logger_p, "{i: %u, rpm_cv: %i, current_cv: %i, rpm_sp: %i, current_sp: %i}", i, rpm_cv, current_cv, PID_GetSetpoint(&instance_p->rpm_pid), PID_GetSetpoint(&instance_p->current_pid));
 
+            if (instance_p->setpoint_pending)
+            {
+                DeviceMonitoring_RecordLatency(DEV_MON_LATENCY_PID_UPDATE, instance_p->setpoint_time);
+            }
+
             const int32_t cv = (abs(current_cv) < abs(rpm_cv)) ? current_cv : rpm_cv;
             Motor_SetSpeed(&instance_p->motor, (int16_t)cv);
+
+            if (instance_p->setpoint_pending)
+            {
+                DeviceMonitoring_RecordLatency(DEV_MON_LATENCY_PWM_WRITE, instance_p->setpoint_time);
+                instance_p->setpoint_pending = false;
+            }
         }
     }
 }
@@ -91,6 +91,16 @@ void MotorController_SetRPM(size_t index, int16_t rpm);
  */
 void MotorController_SetCurrent(size_t index, int16_t current);
 
+/**
+ * Set the reception time of the latest setpoints for the selected motor.
+ *
+ * The latency from reception to the next PID and PWM update is recorded.
+ *
+ * @param index Motor index.
+ * @param timestamp Reception time in microseconds.
+ */
+void MotorController_SetSetpointTime(size_t index, uint32_t timestamp);
+
 /**
  * Resume running after coast/brake.
  *
@@ -75,6 +75,11 @@ __attribute__((weak)) void MotorController_SetCurrent(size_t index, int16_t curr
     check_expected_int(current);
 }
 
+__attribute__((weak)) void MotorController_SetSetpointTime(size_t index, uint32_t timestamp)
+{
+
+}
+
 __attribute__((weak)) void MotorController_Run(size_t index)
 {
     check_expected_uint(index);
@@ -57,6 +57,10 @@ struct nvcom_internal_data_t
     uint16_t reserved_5;
     uint16_t reset_flags_low;
     uint16_t reserved_6;
+    uint16_t can_bit_rate_high;
+    uint16_t reserved_7;
+    uint16_t can_bit_rate_low;
+    uint16_t reserved_8;
 };
 _Static_assert(sizeof(struct nvcom_internal_data_t) <= 40, "Backup registers full");
 
@@ -107,6 +111,8 @@ void NVCom_SetData(const struct nvcom_data_t *data_p)
     internal_data_p->number_of_watchdog_restarts = data_p->number_of_watchdog_restarts;
     internal_data_p->number_of_restarts = data_p->number_of_restarts;
     internal_data_p->bootloader_flags = (uint16_t)data_p->request_firmware_update | (uint16_t)((uint16_t)data_p->firmware_was_updated << 1);
+    internal_data_p->can_bit_rate_high = (uint16_t)(data_p->can_bit_rate >> 16);
+    internal_data_p->can_bit_rate_low = (uint16_t)(data_p->can_bit_rate & 0xFFFF);
     pwr_enable_backup_domain_write_protect();
 }
 
@@ -131,6 +137,7 @@ static void InitData(void)
         module.data.number_of_restarts = 0;
         module.data.request_firmware_update = false;
         module.data.firmware_was_updated = false;
+        module.data.can_bit_rate = 0;
     }
     else
     {
@@ -139,6 +146,7 @@ static void InitData(void)
         module.data.number_of_restarts = internal_data_p->number_of_restarts;
         module.data.request_firmware_update = (bool)(internal_data_p->bootloader_flags & (1 << 0));
         module.data.firmware_was_updated = (bool)(internal_data_p->bootloader_flags & (1 << 1));
+        module.data.can_bit_rate = (uint32_t)internal_data_p->can_bit_rate_high << 16 | (uint32_t)internal_data_p->can_bit_rate_low;
     }
 }
 
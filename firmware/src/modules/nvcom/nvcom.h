@@ -50,6 +50,7 @@ struct nvcom_data_t
     uint16_t number_of_restarts;
     bool request_firmware_update;
     bool firmware_was_updated;
+    uint32_t can_bit_rate;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -75,6 +75,7 @@ static void test_NVCom_ColdRestart(void **state)
     assert_int_equal(data_p->number_of_restarts, 0);
     assert_false(data_p->request_firmware_update);
     assert_false(data_p->firmware_was_updated);
+    assert_int_equal(data_p->can_bit_rate, 0);
 }
 
 static void test_NVCom_WarmRestart(void **state)
@@ -89,6 +90,7 @@ static void test_NVCom_WarmRestart(void **state)
     data_p->number_of_restarts = 3;
     data_p->request_firmware_update = true;
     data_p->firmware_was_updated = true;
+    data_p->can_bit_rate = 1000000;
     NVCom_SetData(data_p);
     NVCom_Init();
 
@@ -98,6 +100,7 @@ static void test_NVCom_WarmRestart(void **state)
     assert_int_equal(data_p->number_of_restarts, 3);
     assert_true(data_p->request_firmware_update);
     assert_true(data_p->firmware_was_updated);
+    assert_int_equal(data_p->can_bit_rate, 1000000);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -29,12 +29,15 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include <libopencm3/stm32/flash.h>
 #include <libopencm3/stm32/crc.h>
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 #include "utility.h"
 #include "logging.h"
 #include "crc.h"
+#include "systime.h"
 #include "nvs.h"
 
+
 //////////////////////////////////////////////////////////////////////////
 //DEFINES
 //////////////////////////////////////////////////////////////////////////
@@ -47,27 +50,117 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #define FLASH_START 0x08000000
 #define FLASH_END 0x8020000
 #define FLASH_MIN_NUMBER_OF_PAGES 2
+#define FLASH_MAX_NUMBER_OF_PAGES 16
 #define FLASH_PAGE_SIZE 0x400
 
+/* Guaranteed number of erase cycles per page, from the STM32F103 datasheet. */
+#define FLASH_ENDURANCE 10000
+
+/* One unused page is kept so the oldest page can always be reclaimed. */
+#define RESERVED_PAGES 1
+
 #define PAGE_HEADER_SIZE_WITHOUT_CRC (sizeof(struct nvs_page_header_t) - sizeof(uint32_t))
+#define ITEM_HEADER_SIZE_WITHOUT_CRC (sizeof(struct nvs_item_t) - sizeof(uint32_t))
+
+/**
+ * The erase record is a blob item with the erase count of the page, written
+ * directly after the page header when the page is erased.
+ */
+#define ERASE_RECORD_HASH 0
+#define ERASE_RECORD_SIZE (sizeof(struct nvs_item_t) + 2 * sizeof(uint32_t))
+#define FIRST_ITEM_OFFSET (sizeof(struct nvs_page_header_t) + ERASE_RECORD_SIZE)
+#define UNKNOWN_ERASE_COUNT UINT32_MAX
+
+/* Number of slots in the RAM index, at least one is always empty. */
+#define INDEX_SIZE 64
+_Static_assert((INDEX_SIZE & (INDEX_SIZE - 1)) == 0, "INDEX_SIZE must be a power of two");
+#define INDEX_EMPTY 0
+#define MAX_NUMBER_OF_KEYS (INDEX_SIZE - 1)
+
+/**
+ * Blob items have a CRC of the payload after the item header and items with a
+ * key check have it before any CRC, see 'GetItemLength'.
+ */
+#define ITEM_FLAG_BLOB 0x8000
+#define ITEM_FLAG_KEY_CHECK 0x4000
+#define ITEM_SIZE_MASK 0x3FFF
+#define COPY_BUFFER_SIZE 32
+
+/* Start compacting in the background when less free space than this is left. */
+#define COMPACTION_THRESHOLD 256
+#define COMPACTION_ITEMS_PER_STEP 4
 
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
 //////////////////////////////////////////////////////////////////////////
 
+/**
+ * Location of the latest item for a key, as an offset from the first page.
+ *
+ * The key check is a second, independent hash of the key stored with each
+ * item, so two keys with the same hash are detected instead of silently
+ * sharing a value. Items stored without a key check leave it 0 until the
+ * key is first used after boot.
+ */
+struct nvs_index_entry_t
+{
+    uint32_t hash;
+    uint16_t offset;
+    uint16_t key_check;
+};
+
+enum nvs_compaction_state_t
+{
+    COMPACTION_IDLE = 0,
+    COMPACTION_COPY,
+    COMPACTION_ERASE
+};
+
+enum nvs_page_status_t
+{
+    PAGE_STATUS_DIRTY = 0,
+    PAGE_STATUS_FREE,
+    PAGE_STATUS_USED
+};
+
+/**
+ * RAM copy of the page state.
+ *
+ * Dirty pages must be erased before they are used. Free pages are erased and
+ * have an erase record. Used pages hold items, ordered by sequence number.
+ * Pages from before the erase records have no erase count and their items
+ * start directly after the page header.
+ */
+struct nvs_page_t
+{
+    enum nvs_page_status_t status;
+    uint32_t sequence_number;
+    uint32_t erase_count;
+    uint16_t first_item_offset;
+    uint16_t end_offset;
+    uint16_t live_space;
+};
+
 struct nvs_t
 {
     uint32_t start_page_address;
     size_t number_of_pages;
-    uint32_t active_page_address;
-    uint32_t active_sequence_number;
-    uint32_t active_address;
+    struct nvs_page_t pages[FLASH_MAX_NUMBER_OF_PAGES];
+    size_t head;
+    uint32_t sequence_number;
+    uint32_t assumed_erase_count;
+    struct nvs_index_entry_t index[INDEX_SIZE];
+    size_t number_of_keys;
+    enum nvs_compaction_state_t compaction_state;
+    size_t compaction_page;
+    uint32_t compaction_source;
+    uint32_t max_store_time_us;
     logging_logger_t *logger_p;
 };
 
 enum nvs_page_state_t
 {
-    PAGE_ERASED = 0,
+    PAGE_ERASED = 0xFFFFFFFF,
     PAGE_IN_USE = 0x0C00FFE0
 };
 
@@ -92,6 +185,12 @@ struct nvs_item_t
     uint32_t crc;
 };
 
+_Static_assert(FLASH_MAX_NUMBER_OF_PAGES * FLASH_PAGE_SIZE <= UINT16_MAX + 1,
+               "Index offsets must fit in 16 bits");
+_Static_assert(NVS_MAX_BLOB_SIZE == FLASH_PAGE_SIZE - FIRST_ITEM_OFFSET - sizeof(struct nvs_item_t) - sizeof(uint16_t) -
+               sizeof(uint32_t),
+               "A blob of max size must fit on an empty page");
+
 //////////////////////////////////////////////////////////////////////////
 //VARIABLES
 //////////////////////////////////////////////////////////////////////////
@@ -104,15 +203,46 @@ static struct nvs_t self;
 
 static bool ErasePage(uint32_t page_address);
 static bool WriteToFlash(uint32_t address, const void *data_p, size_t length);
-static void FindActivePage(void);
+static void ScanPages(void);
 static void GetPageHeader(uint32_t address, struct nvs_page_header_t *page_header_p);
-static uint32_t GetActiveAddress(void);
+static uint32_t ReadEraseRecord(uint32_t page_address);
+static bool IsBlank(uint32_t address, uint32_t length);
+static bool ResetPage(size_t page_index);
+static bool WriteEraseRecord(size_t page_index, uint32_t erase_count);
+static bool AllocatePage(void);
+static uint32_t GetPageAddress(size_t page_index);
+static size_t GetOldestPage(void);
+static size_t GetNumberOfUnusedPages(void);
+static size_t GetUsedPagesInOrder(size_t order[FLASH_MAX_NUMBER_OF_PAGES]);
+static uint32_t GetEraseCount(const struct nvs_page_t *page_p);
+static bool StoreItem(const char *key_p, const void *data_p, size_t size, uint16_t flags);
+static bool WriteItem(uint32_t address, const struct nvs_item_t *item_p, uint16_t key_check, const void *data_p);
+static bool WritePayload(uint32_t address, const void *data_p, size_t size);
+static bool CopyItem(uint32_t source, uint32_t destination, const struct nvs_item_t *item_p);
+static bool RepairItem(uint32_t address, uint32_t max_length);
+static bool HasSpace(uint32_t length, bool use_reserve);
+static uint32_t GetHeadFreeSpace(void);
+static uint32_t GetFreeSpace(void);
+static uint32_t GetLiveSpace(void);
+static uint32_t GetReclaimableSpace(void);
+static uint32_t GetItemLength(const struct nvs_item_t *item_p);
+static uint32_t GetIndexedItemLength(const struct nvs_index_entry_t *entry_p);
+static void BuildIndex(void);
+static void IndexPage(size_t page_index);
+static struct nvs_index_entry_t *GetIndexEntry(uint32_t hash);
+static void SetIndexEntry(struct nvs_index_entry_t *entry_p, uint32_t offset, uint32_t length);
+static void RemoveIndexEntry(struct nvs_index_entry_t *entry_p);
+static bool ClaimKey(struct nvs_index_entry_t *entry_p, const char *key_p);
 static uint32_t CalculateHash(const char *str_p);
+static uint16_t CalculateKeyCheck(const char *str_p);
 static uint32_t CalculateItemCRC(const struct nvs_item_t *item_p);
 static void ReadFromFlash(uint32_t address, void *data_p, size_t length);
-static bool GetValueByHash(uint32_t page_address, uint32_t hash, uint32_t *value_p);
-static void MoveItemsToNewPage(void);
-static uint32_t GetNextPageAddress(void);
+static bool RemoveItems(size_t page_index, const char *key_p, uint32_t hash, size_t *number_of_items_p);
+static bool ShouldStartCompaction(void);
+static void StartCompaction(void);
+static void CompleteCompaction(void);
+static void CompactionStep(void);
+static void CopyItems(void);
 
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
@@ -121,131 +251,152 @@ static uint32_t GetNextPageAddress(void);
 void NVS_Init(uint32_t start_page_address, size_t number_of_pages)
 {
     assert(number_of_pages >= FLASH_MIN_NUMBER_OF_PAGES);
+    assert(number_of_pages <= FLASH_MAX_NUMBER_OF_PAGES);
 
     self = (__typeof__(self)) {0};
     self.start_page_address = start_page_address;
-    self.active_page_address = start_page_address;
-    self.active_sequence_number = 0;
     self.number_of_pages = number_of_pages;
     self.logger_p = Logging_GetLogger(NVS_LOGGER_NAME);
     Logging_SetLevel(self.logger_p, NVS_LOGGER_DEBUG_LEVEL);
 
-    FindActivePage();
-    self.active_address = GetActiveAddress();
-
-    struct nvs_page_header_t page_header;
-    GetPageHeader(self.active_page_address, &page_header);
-    const uint32_t crc = CRC_Calculate(&page_header, PAGE_HEADER_SIZE_WITHOUT_CRC);
+    ScanPages();
 
-    if ((page_header.state != PAGE_IN_USE) || (page_header.crc != crc))
+    if (self.pages[self.head].status != PAGE_STATUS_USED)
     {
-        Logging_Debug(self.logger_p, "Reset page: {page_address: 0x%x}", self.active_page_address);
+        Logging_Debug(self.logger_p, "Reset NVS: {start_page_address: 0x%x}", self.start_page_address);
 
-        if(ErasePage(self.active_page_address))
+        if (!AllocatePage())
         {
-            page_header.state = PAGE_IN_USE;
-            page_header.sequence_number = self.active_sequence_number;
-            page_header.crc = CRC_Calculate(&page_header, PAGE_HEADER_SIZE_WITHOUT_CRC);
-            WriteToFlash(self.active_page_address, &page_header, sizeof(page_header));
+            /* Keep a full page as head so nothing is stored. */
+            Logging_Critical(self.logger_p, "No usable page");
+            self.head = 0;
+            self.pages[self.head] = (__typeof__(self.pages[self.head])) {0};
+            self.pages[self.head].status = PAGE_STATUS_USED;
+            self.pages[self.head].first_item_offset = FLASH_PAGE_SIZE;
+            self.pages[self.head].end_offset = FLASH_PAGE_SIZE;
         }
     }
 
+    BuildIndex();
+
+    /* A compaction interrupted by a reset may have used the reserved page. */
+    if (GetNumberOfUnusedPages() < RESERVED_PAGES)
+    {
+        StartCompaction();
+        CompleteCompaction();
+    }
+
     Logging_Info(self.logger_p,
                  "NVS initialized: {page_address: 0x%x, sequence_number: %u, active_address: 0x%x}",
-                 self.active_page_address,
-                 self.active_sequence_number,
-                 self.active_address);
+                 GetPageAddress(self.head),
+                 self.pages[self.head].sequence_number,
+                 self.pages[self.head].end_offset);
 }
 
 bool NVS_Store(const char *key_p, uint32_t value)
 {
+    Logging_Debug(self.logger_p, "Store: {key: %s, value: %u}", key_p, value);
+
+    return StoreItem(key_p, &value, sizeof(value), 0);
+}
+
+bool NVS_StoreBlob(const char *key_p, const void *data_p, size_t size)
+{
+    assert(data_p != NULL);
+    assert(size <= NVS_MAX_BLOB_SIZE);
+
+    return StoreItem(key_p, data_p, size, ITEM_FLAG_BLOB);
+}
+
+bool NVS_Retrieve(const char *key_p, uint32_t *value_p)
+{
+    size_t size;
+    return NVS_RetrieveBlob(key_p, value_p, sizeof(*value_p), &size) && (size == sizeof(*value_p));
+}
+
+bool NVS_RetrieveBlob(const char *key_p, void *data_p, size_t max_size, size_t *size_p)
+{
+    assert(data_p != NULL);
+    assert(size_p != NULL);
+
+    const uint32_t hash = CalculateHash(key_p);
+    Logging_Debug(self.logger_p, "Retrieve: {key: %s, hash: %u}", key_p, hash);
 
-    if ((sizeof(struct nvs_item_t) + sizeof(value)) > (FLASH_PAGE_SIZE - self.active_address))
+    struct nvs_index_entry_t *entry_p = GetIndexEntry(hash);
+    if ((entry_p->offset == INDEX_EMPTY) || !ClaimKey(entry_p, key_p))
     {
-        MoveItemsToNewPage();
+        return false;
     }
 
-    assert((sizeof(struct nvs_item_t) + sizeof(value)) <= (FLASH_PAGE_SIZE - self.active_address));
-
     struct nvs_item_t item;
-    item.hash = CalculateHash(key_p);
-    item.status = ITEM_USED;
-    item.size = sizeof(value);
-    item.crc = CalculateItemCRC(&item);
+    uint32_t address = self.start_page_address + entry_p->offset;
+    ReadFromFlash(address, &item, sizeof(item));
+    address += sizeof(item);
 
-    const uint32_t destination = self.active_page_address + self.active_address;
-    Logging_Debug(self.logger_p,
-                  "Store: {key: %s, value: %u, hash: %u, size: %u, crc: 0x%x, destination: 0x%x}",
-                  key_p,
-                  value,
-                  item.hash,
-                  item.size,
-                  item.crc,
-                  destination);
+    if ((item.size & ITEM_FLAG_KEY_CHECK) != 0)
+    {
+        address += sizeof(uint16_t);
+    }
 
-    const bool status = WriteToFlash(destination, &item, sizeof(item)) &&
-                        WriteToFlash(destination + sizeof(item), &value, sizeof(value));
+    *size_p = item.size & ITEM_SIZE_MASK;
+    if (*size_p > max_size)
+    {
+        return false;
+    }
 
-    if (status)
+    if ((item.size & ITEM_FLAG_BLOB) != 0)
     {
-        self.active_address += sizeof(item) + sizeof(value);
+        uint32_t crc;
+        ReadFromFlash(address, &crc, sizeof(crc));
+        ReadFromFlash(address + sizeof(crc), data_p, *size_p);
+
+        if (CRC_Calculate(data_p, *size_p) != crc)
+        {
+            Logging_Error(self.logger_p, "Corrupt blob: {key: %s, hash: %u, size: %u}", key_p, hash, *size_p);
+            return false;
+        }
     }
     else
     {
-        Logging_Critical(self.logger_p, "Corrupt page: {page_address: 0x%x}", self.active_page_address);
+        ReadFromFlash(address, data_p, *size_p);
     }
 
-    return status;
-}
-
-bool NVS_Retrieve(const char *key_p, uint32_t *value_p)
-{
-    const uint32_t hash = CalculateHash(key_p);
-    Logging_Debug(self.logger_p, "Retrieve: {key: %s, hash: %u}", key_p, hash);
-
-    const bool status = GetValueByHash(self.active_page_address, hash, value_p);
-    return status;
+    return true;
 }
 
 bool NVS_Remove(const char *key_p)
 {
-    bool status = false;
     const uint32_t hash = CalculateHash(key_p);
 
-    uint32_t item_address = self.active_page_address + sizeof(struct nvs_page_header_t);
-    while(item_address + sizeof(struct nvs_item_t) <= self.active_page_address + FLASH_PAGE_SIZE)
+    struct nvs_index_entry_t *entry_p = GetIndexEntry(hash);
+    if ((entry_p->offset == INDEX_EMPTY) || !ClaimKey(entry_p, key_p))
     {
-        struct nvs_item_t item;
-        ReadFromFlash(item_address, &item, sizeof(item));
-        const uint32_t crc = CalculateItemCRC(&item);
+        return false;
+    }
 
-        if ((item.hash == hash) && (item.crc == crc) && (item.status == ITEM_USED))
-        {
-            const uint16_t item_status = ITEM_DELETED;
-            const size_t status_offset = 6;
-            status = WriteToFlash(item_address + status_offset, &item_status, sizeof(item_status));
+    /**
+     * Older items for the key may be on any used page, remove them as well.
+     * The latest item is removed last, so an older value never comes back if
+     * the remove is interrupted by a reset.
+     */
+    size_t order[FLASH_MAX_NUMBER_OF_PAGES];
+    const size_t number_of_used_pages = GetUsedPagesInOrder(order);
 
-            if (!status)
-            {
-                status = false;
-                Logging_Error(self.logger_p,
-                              "Failed to remove item: {key: %s, hash: %u, size: %u}",
-                              key_p,
-                              item.hash,
-                              item.size);
-                break;
-            }
-        }
-        else if (item.crc != crc)
-        {
-            /* Abort when all valid items are checked. */
-            break;
-        }
-        else
-        {
-            /* Do nothing, item is valid but does not match the supplied key. */
-        }
-        item_address += sizeof(item) + item.size;
+    bool status = true;
+    size_t total_number_of_items = 0;
+    for (size_t i = 0; (i < number_of_used_pages) && status; ++i)
+    {
+        size_t number_of_items;
+        status = RemoveItems(order[i], key_p, hash, &number_of_items);
+        total_number_of_items += number_of_items;
+    }
+
+    status = status && (total_number_of_items > 0);
+    if (status)
+    {
+        self.pages[entry_p->offset / FLASH_PAGE_SIZE].live_space -= GetIndexedItemLength(entry_p);
+        RemoveIndexEntry(entry_p);
+        --self.number_of_keys;
     }
 
     return status;
@@ -258,12 +409,10 @@ bool NVS_Clear(void)
     bool status = true;
     for (size_t i = 0; i < self.number_of_pages; ++i)
     {
-        const uint32_t page_address = self.start_page_address + (i * FLASH_PAGE_SIZE);
-
-        Logging_Debug(self.logger_p,"Erase page: {page_address: 0x%x}", page_address);
-        if (!ErasePage(page_address))
+        Logging_Debug(self.logger_p,"Erase page: {page_address: 0x%x}", GetPageAddress(i));
+        if (!ResetPage(i))
         {
-            Logging_Critical(self.logger_p, "Erase failed: {page_address: 0x%x}", page_address);
+            Logging_Critical(self.logger_p, "Erase failed: {page_address: 0x%x}", GetPageAddress(i));
             status = false;
             break;
         }
@@ -273,6 +422,49 @@ bool NVS_Clear(void)
     return status;
 }
 
+void NVS_Process(void)
+{
+    if ((self.compaction_state == COMPACTION_IDLE) && ShouldStartCompaction())
+    {
+        StartCompaction();
+    }
+
+    if (self.compaction_state != COMPACTION_IDLE)
+    {
+        CompactionStep();
+    }
+}
+
+void NVS_GetStatistics(struct nvs_statistics_t *statistics_p)
+{
+    assert(statistics_p != NULL);
+
+    *statistics_p = (__typeof__(*statistics_p)) {0};
+    statistics_p->number_of_pages = (uint32_t)self.number_of_pages;
+    statistics_p->min_erase_count = UINT32_MAX;
+    statistics_p->live_space = GetLiveSpace();
+    statistics_p->free_space = GetFreeSpace();
+    statistics_p->max_store_time_us = self.max_store_time_us;
+
+    for (size_t i = 0; i < self.number_of_pages; ++i)
+    {
+        const uint32_t erase_count = GetEraseCount(&self.pages[i]);
+        if (erase_count < statistics_p->min_erase_count)
+        {
+            statistics_p->min_erase_count = erase_count;
+        }
+        if (erase_count > statistics_p->max_erase_count)
+        {
+            statistics_p->max_erase_count = erase_count;
+        }
+    }
+
+    if (statistics_p->max_erase_count < FLASH_ENDURANCE)
+    {
+        statistics_p->remaining_erase_cycles = FLASH_ENDURANCE - statistics_p->max_erase_count;
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -333,21 +525,87 @@ static bool WriteToFlash(uint32_t address, const void *data_p, size_t length)
     return status;
 }
 
-static void FindActivePage(void)
+/**
+ * Read the state of all pages, the used page with the highest sequence
+ * number is the head where new items are stored.
+ */
+static void ScanPages(void)
 {
+    size_t newest_legacy_page = self.number_of_pages;
+
     for (size_t i = 0; i < self.number_of_pages; ++i)
     {
-        const uint32_t address = self.start_page_address + (i * FLASH_PAGE_SIZE);
-        struct nvs_page_header_t page_header;
-        GetPageHeader(address, &page_header);
+        struct nvs_page_t *page_p = &self.pages[i];
+        const uint32_t page_address = GetPageAddress(i);
 
+        struct nvs_page_header_t page_header;
+        GetPageHeader(page_address, &page_header);
         const uint32_t crc = CRC_Calculate(&page_header, PAGE_HEADER_SIZE_WITHOUT_CRC);
-        if ((page_header.state == PAGE_IN_USE) &&
-                (page_header.sequence_number > self.active_sequence_number) &&
-                (page_header.crc == crc))
+
+        page_p->erase_count = ReadEraseRecord(page_address);
+        page_p->first_item_offset = FIRST_ITEM_OFFSET;
+
+        if ((page_header.state == PAGE_IN_USE) && (page_header.crc == crc))
+        {
+            page_p->status = PAGE_STATUS_USED;
+            page_p->sequence_number = page_header.sequence_number;
+            if (page_header.sequence_number > self.sequence_number)
+            {
+                self.sequence_number = page_header.sequence_number;
+            }
+
+            if (page_p->erase_count == UNKNOWN_ERASE_COUNT)
+            {
+                page_p->first_item_offset = sizeof(struct nvs_page_header_t);
+                if ((newest_legacy_page == self.number_of_pages) ||
+                        (page_p->sequence_number > self.pages[newest_legacy_page].sequence_number))
+                {
+                    newest_legacy_page = i;
+                }
+            }
+        }
+        else if ((page_p->erase_count != UNKNOWN_ERASE_COUNT) &&
+                 (page_header.state == PAGE_ERASED) &&
+                 (page_header.sequence_number == UINT32_MAX) &&
+                 (page_header.crc == UINT32_MAX))
+        {
+            page_p->status = PAGE_STATUS_FREE;
+        }
+        else if (IsBlank(page_address, FLASH_PAGE_SIZE))
+        {
+            /* Never used, e.g. on a new device, the erase record is written when it is used. */
+            page_p->status = PAGE_STATUS_FREE;
+        }
+        else
+        {
+            page_p->status = PAGE_STATUS_DIRTY;
+        }
+    }
+
+    /* Before the erase records only the newest page was live, older pages are stale copies. */
+    for (size_t i = 0; i < self.number_of_pages; ++i)
+    {
+        if ((self.pages[i].status == PAGE_STATUS_USED) &&
+                (self.pages[i].first_item_offset == sizeof(struct nvs_page_header_t)) &&
+                (i != newest_legacy_page))
+        {
+            self.pages[i].status = PAGE_STATUS_DIRTY;
+        }
+    }
+
+    for (size_t i = 0; i < self.number_of_pages; ++i)
+    {
+        if ((self.pages[i].status == PAGE_STATUS_USED) &&
+                ((self.pages[self.head].status != PAGE_STATUS_USED) ||
+                 (self.pages[i].sequence_number > self.pages[self.head].sequence_number)))
         {
-            self.active_sequence_number = page_header.sequence_number;
-            self.active_page_address = address;
+            self.head = i;
+        }
+
+        if ((self.pages[i].erase_count != UNKNOWN_ERASE_COUNT) &&
+                (self.pages[i].erase_count > self.assumed_erase_count))
+        {
+            self.assumed_erase_count = self.pages[i].erase_count;
         }
     }
 }
@@ -357,146 +615,925 @@ static void GetPageHeader(uint32_t address, struct nvs_page_header_t *page_heade
     ReadFromFlash(address, page_header_p, sizeof(*page_header_p));
 }
 
-static uint32_t GetActiveAddress(void)
+/**
+ * Read the erase count from the erase record of a page.
+ *
+ * @return The erase count, or UNKNOWN_ERASE_COUNT if the page has no valid
+ *         erase record.
+ */
+static uint32_t ReadEraseRecord(uint32_t page_address)
 {
-    uint32_t active_address = self.active_page_address + sizeof(struct nvs_page_header_t);
+    const uint32_t address = page_address + sizeof(struct nvs_page_header_t);
+
+    struct nvs_item_t item;
+    ReadFromFlash(address, &item, sizeof(item));
 
-    while(active_address + sizeof(struct nvs_item_t) <= self.active_page_address + FLASH_PAGE_SIZE)
+    if ((item.crc != CalculateItemCRC(&item)) ||
+            (item.hash != ERASE_RECORD_HASH) ||
+            (item.size != (sizeof(uint32_t) | ITEM_FLAG_BLOB)))
     {
-        struct nvs_item_t item;
-        ReadFromFlash(active_address, &item, sizeof(item));
+        return UNKNOWN_ERASE_COUNT;
+    }
 
-        if (item.crc != CalculateItemCRC(&item))
+    uint32_t record[2];
+    ReadFromFlash(address + sizeof(item), record, sizeof(record));
+
+    return CRC_Calculate(&record[1], sizeof(record[1])) == record[0] ? record[1] : UNKNOWN_ERASE_COUNT;
+}
+
+static bool IsBlank(uint32_t address, uint32_t length)
+{
+    for (uint32_t offset = 0; offset < length; offset += COPY_BUFFER_SIZE)
+    {
+        uint8_t buffer[COPY_BUFFER_SIZE];
+        const uint32_t chunk_size = (length - offset) < COPY_BUFFER_SIZE ? (length - offset) : COPY_BUFFER_SIZE;
+        ReadFromFlash(address + offset, buffer, chunk_size);
+
+        for (size_t i = 0; i < chunk_size; ++i)
         {
-            break;
+            if (buffer[i] != 0xFF)
+            {
+                return false;
+            }
         }
-
-        active_address += sizeof(item) + item.size;
     }
 
-    return active_address - self.active_page_address;
+    return true;
 }
 
 /**
- * Calculate FNV-1a hash for given string.
+ * Erase a page and write a new erase record, the page is free afterwards.
  */
-static uint32_t CalculateHash(const char *str_p)
+static bool ResetPage(size_t page_index)
 {
-    const uint32_t fnv_offset = 2166136261;
-    const uint32_t fnv_prime = 16777619;
+    struct nvs_page_t *page_p = &self.pages[page_index];
+    const uint32_t erase_count = GetEraseCount(page_p) + 1;
 
-    uint32_t hash = fnv_offset;
-    for (const char *p = str_p; *p != '\0'; ++p)
+    *page_p = (__typeof__(*page_p)) {0};
+    page_p->erase_count = UNKNOWN_ERASE_COUNT;
+
+    if (!ErasePage(GetPageAddress(page_index)) || !WriteEraseRecord(page_index, erase_count))
     {
-        hash ^= (uint32_t)(*p);
-        hash *= fnv_prime;
+        return false;
     }
-    return hash;
+
+    page_p->status = PAGE_STATUS_FREE;
+    return true;
 }
 
-static uint32_t CalculateItemCRC(const struct nvs_item_t *item_p)
+static bool WriteEraseRecord(size_t page_index, uint32_t erase_count)
 {
-    const size_t item_size_without_crc = 6;
-    return CRC_Calculate(item_p, item_size_without_crc);
+    struct nvs_item_t item;
+    item.hash = ERASE_RECORD_HASH;
+    item.size = sizeof(erase_count) | ITEM_FLAG_BLOB;
+    item.status = ITEM_USED;
+    item.crc = CalculateItemCRC(&item);
+
+    if (!WriteItem(GetPageAddress(page_index) + sizeof(struct nvs_page_header_t), &item, 0, &erase_count))
+    {
+        return false;
+    }
+
+    self.pages[page_index].erase_count = erase_count;
+    return true;
 }
 
-static bool GetValueByHash(uint32_t page_address, uint32_t hash, uint32_t *value_p)
+/**
+ * Start a new head page, the least worn unused page is picked.
+ */
+static bool AllocatePage(void)
 {
-    bool status = false;
-    uint32_t item_address = page_address + sizeof(struct nvs_page_header_t);
-    while(item_address + sizeof(struct nvs_item_t) <= page_address + FLASH_PAGE_SIZE)
-    {
-        struct nvs_item_t item;
-        ReadFromFlash(item_address, &item, sizeof(item));
+    size_t page_index = self.number_of_pages;
 
-        const uint32_t crc = CalculateItemCRC(&item);
-        if ((item.hash == hash) && (item.crc == crc) && (item.status == ITEM_USED))
-        {
-            const uint32_t data_address = item_address + sizeof(item);
-            ReadFromFlash(data_address, value_p, item.size);
-            status = true;
-        }
-        else if (item.crc != crc)
+    for (size_t i = 0; i < self.number_of_pages; ++i)
+    {
+        const struct nvs_page_t *page_p = &self.pages[i];
+        if (page_p->status == PAGE_STATUS_USED)
         {
-            /* Abort when all valid items are checked. */
-            break;
+            continue;
         }
-        else
+
+        /* Prefer free pages on a tie, dirty pages must be erased first. */
+        if ((page_index == self.number_of_pages) ||
+                (GetEraseCount(page_p) < GetEraseCount(&self.pages[page_index])) ||
+                ((GetEraseCount(page_p) == GetEraseCount(&self.pages[page_index])) &&
+                 (page_p->status == PAGE_STATUS_FREE) &&
+                 (self.pages[page_index].status == PAGE_STATUS_DIRTY)))
         {
-            /* Do nothing, item is valid but is removed or does not match the supplied hash. */
+            page_index = i;
         }
+    }
+
+    if ((page_index == self.number_of_pages) ||
+            ((self.pages[page_index].status == PAGE_STATUS_DIRTY) && !ResetPage(page_index)))
+    {
+        return false;
+    }
+
+    struct nvs_page_t *page_p = &self.pages[page_index];
+    struct nvs_page_header_t page_header;
+    page_header.state = PAGE_IN_USE;
+    page_header.sequence_number = self.sequence_number + 1;
+    page_header.crc = CRC_Calculate(&page_header, PAGE_HEADER_SIZE_WITHOUT_CRC);
 
-        item_address += sizeof(item) + item.size;
+    if (((page_p->erase_count == UNKNOWN_ERASE_COUNT) && !WriteEraseRecord(page_index, GetEraseCount(page_p))) ||
+            !WriteToFlash(GetPageAddress(page_index), &page_header, sizeof(page_header)))
+    {
+        page_p->status = PAGE_STATUS_DIRTY;
+        return false;
     }
 
-    return status;
+    page_p->status = PAGE_STATUS_USED;
+    page_p->sequence_number = page_header.sequence_number;
+    page_p->first_item_offset = FIRST_ITEM_OFFSET;
+    page_p->end_offset = FIRST_ITEM_OFFSET;
+    page_p->live_space = 0;
+    self.sequence_number = page_header.sequence_number;
+    self.head = page_index;
+
+    Logging_Debug(self.logger_p,
+                  "New page: {page_address: 0x%x, sequence_number: %u, erase_count: %u}",
+                  GetPageAddress(page_index),
+                  page_p->sequence_number,
+                  page_p->erase_count);
+    return true;
 }
 
-static void MoveItemsToNewPage(void)
+static uint32_t GetPageAddress(size_t page_index)
 {
-    Logging_Info(self.logger_p, "Move items to new page: {active_page_address: 0x%x, new_page_address: 0x%x}",
-                 self.active_page_address,
-                 GetNextPageAddress()
-                );
+    return self.start_page_address + (page_index * FLASH_PAGE_SIZE);
+}
 
-    ErasePage(GetNextPageAddress());
+static size_t GetOldestPage(void)
+{
+    size_t oldest_page = self.head;
 
-    uint32_t destination = GetNextPageAddress() + sizeof(struct nvs_page_header_t);
-    uint32_t item_address = self.active_page_address + sizeof(struct nvs_page_header_t);
-    while(item_address + sizeof(struct nvs_item_t) <= self.active_page_address + FLASH_PAGE_SIZE)
+    for (size_t i = 0; i < self.number_of_pages; ++i)
     {
-        struct nvs_item_t item;
-        ReadFromFlash(item_address, &item, sizeof(item));
-
-        const uint32_t crc = CalculateItemCRC(&item);
-        if (item.crc == crc)
+        if ((self.pages[i].status == PAGE_STATUS_USED) &&
+                (self.pages[i].sequence_number < self.pages[oldest_page].sequence_number))
         {
-            uint32_t value;
-            GetValueByHash(self.active_page_address, item.hash, &value);
-
-            if (!GetValueByHash(GetNextPageAddress(), item.hash, &value))
-            {
-                Logging_Debug(self.logger_p,
-                              "Move: {value: %u, hash: %u, size: %u, crc: %u, destination: 0x%x}",
-                              value,
-                              item.hash,
-                              item.size,
-                              item.crc,
-                              destination);
-                WriteToFlash(destination, &item, sizeof(item));
-                WriteToFlash(destination + sizeof(item), &value, sizeof(value));
-
-                destination += sizeof(item) + sizeof(value);
-            }
+            oldest_page = i;
         }
-
-        item_address += sizeof(item) + item.size;
     }
 
-    struct nvs_page_header_t page_header;
-    page_header.state = PAGE_IN_USE;
-    page_header.sequence_number = self.active_sequence_number + 1;
-    page_header.crc = CRC_Calculate(&page_header, PAGE_HEADER_SIZE_WITHOUT_CRC);
-    WriteToFlash(GetNextPageAddress(), &page_header, sizeof(page_header));
-
-    self.active_sequence_number = page_header.sequence_number;
-    self.active_page_address = GetNextPageAddress();
-    self.active_address = destination - self.active_page_address;
-
-    Logging_Info(self.logger_p,
-                 "Items moved to new page: {page_address: 0x%x, sequence_number: %u, active_address: 0x%x}",
-                 self.active_page_address,
-                 self.active_sequence_number,
-                 self.active_address);
+    return oldest_page;
 }
 
-static uint32_t GetNextPageAddress(void)
+static size_t GetNumberOfUnusedPages(void)
 {
-    uint32_t next_page_address = self.active_page_address + FLASH_PAGE_SIZE;
+    size_t number_of_pages = 0;
 
-    if (next_page_address >= (self.start_page_address + (self.number_of_pages * FLASH_PAGE_SIZE)))
+    for (size_t i = 0; i < self.number_of_pages; ++i)
     {
-        next_page_address = self.start_page_address;
+        if (self.pages[i].status != PAGE_STATUS_USED)
+        {
+            ++number_of_pages;
+        }
+    }
+
+    return number_of_pages;
+}
+
+/**
+ * Get the used pages ordered from the oldest to the newest.
+ *
+ * @return The number of used pages.
+ */
+static size_t GetUsedPagesInOrder(size_t order[FLASH_MAX_NUMBER_OF_PAGES])
+{
+    size_t number_of_used_pages = 0;
+
+    for (size_t i = 0; i < self.number_of_pages; ++i)
+    {
+        if (self.pages[i].status == PAGE_STATUS_USED)
+        {
+            size_t n = number_of_used_pages;
+            while ((n > 0) && (self.pages[order[n - 1]].sequence_number > self.pages[i].sequence_number))
+            {
+                order[n] = order[n - 1];
+                --n;
+            }
+            order[n] = i;
+            ++number_of_used_pages;
+        }
+    }
+
+    return number_of_used_pages;
+}
+
+/**
+ * Get the erase count of a page, pages without an erase record are assumed
+ * to be as worn as the most worn page at init.
+ */
+static uint32_t GetEraseCount(const struct nvs_page_t *page_p)
+{
+    return page_p->erase_count != UNKNOWN_ERASE_COUNT ? page_p->erase_count : self.assumed_erase_count;
+}
+
+/**
+ * Append an item to the head page and point the index to it.
+ *
+ * @param flags ITEM_FLAG_BLOB to store a CRC of the payload, otherwise 0.
+ */
+static bool StoreItem(const char *key_p, const void *data_p, size_t size, uint16_t flags)
+{
+    const uint32_t start_time = SysTime_GetSystemTimeUs();
+
+    struct nvs_item_t item;
+    item.hash = CalculateHash(key_p);
+    item.size = (uint16_t)size | flags | ITEM_FLAG_KEY_CHECK;
+    item.status = ITEM_USED;
+    item.crc = CalculateItemCRC(&item);
+
+    const uint32_t length = GetItemLength(&item);
+    if (!HasSpace(length, false))
+    {
+        /**
+         * Normally the oldest page is reclaimed in the background before the
+         * space runs out, finish an ongoing compaction here otherwise. More
+         * pages are reclaimed until the item fits, as long as removed and
+         * replaced items leave room for it.
+         */
+        CompleteCompaction();
+
+        for (size_t i = 0; (i < self.number_of_pages) && !HasSpace(length, false) &&
+                ((GetFreeSpace() + GetReclaimableSpace()) >= length); ++i)
+        {
+            StartCompaction();
+            CompleteCompaction();
+        }
+    }
+
+    bool status = false;
+    struct nvs_index_entry_t *entry_p = GetIndexEntry(item.hash);
+
+    if (!HasSpace(length, false))
+    {
+        Logging_Error(self.logger_p, "Storage full: {key: %s, size: %u}", key_p, size);
+    }
+    else if ((entry_p->offset == INDEX_EMPTY) && (self.number_of_keys >= MAX_NUMBER_OF_KEYS))
+    {
+        Logging_Error(self.logger_p, "Too many keys: {key: %s}", key_p);
+    }
+    else if ((entry_p->offset == INDEX_EMPTY) || ClaimKey(entry_p, key_p))
+    {
+        if (length > GetHeadFreeSpace())
+        {
+            AllocatePage();
+        }
+
+        struct nvs_page_t *head_p = &self.pages[self.head];
+        const uint32_t destination = GetPageAddress(self.head) + head_p->end_offset;
+        Logging_Debug(self.logger_p,
+                      "Store: {key: %s, hash: %u, size: %u, crc: 0x%x, destination: 0x%x}",
+                      key_p,
+                      item.hash,
+                      item.size,
+                      item.crc,
+                      destination);
+
+        status = (length <= GetHeadFreeSpace()) && WriteItem(destination, &item, CalculateKeyCheck(key_p), data_p);
+        if (status)
+        {
+            if (entry_p->offset == INDEX_EMPTY)
+            {
+                entry_p->hash = item.hash;
+                ClaimKey(entry_p, key_p);
+                ++self.number_of_keys;
+            }
+            SetIndexEntry(entry_p, (self.head * FLASH_PAGE_SIZE) + head_p->end_offset, length);
+            head_p->end_offset += length;
+        }
+        else
+        {
+            /* Nothing can be written over a failed item, continue on a new page. */
+            Logging_Critical(self.logger_p, "Corrupt page: {page_address: 0x%x}", GetPageAddress(self.head));
+            head_p->end_offset = FLASH_PAGE_SIZE;
+        }
+    }
+
+    const uint32_t store_time = SysTime_GetSystemTimeUs() - start_time;
+    if (store_time > self.max_store_time_us)
+    {
+        self.max_store_time_us = store_time;
+    }
+
+    return status;
+}
+
+/**
+ * Write an item header and its payload, blobs get a CRC of the payload.
+ *
+ * The item CRC is written last, so an item torn by a reset is never valid and
+ * the item it replaces is kept. See 'RepairItem'.
+ */
+static bool WriteItem(uint32_t address, const struct nvs_item_t *item_p, uint16_t key_check, const void *data_p)
+{
+    const size_t size = item_p->size & ITEM_SIZE_MASK;
+    uint32_t payload_address = address + sizeof(*item_p);
+    bool status = WriteToFlash(address, item_p, ITEM_HEADER_SIZE_WITHOUT_CRC);
+
+    if (status && ((item_p->size & ITEM_FLAG_KEY_CHECK) != 0))
+    {
+        status = WriteToFlash(payload_address, &key_check, sizeof(key_check));
+        payload_address += sizeof(key_check);
+    }
+
+    if (status && ((item_p->size & ITEM_FLAG_BLOB) != 0))
+    {
+        const uint32_t crc = CRC_Calculate(data_p, size);
+        status = WriteToFlash(payload_address, &crc, sizeof(crc));
+        payload_address += sizeof(crc);
+    }
+
+    status = status && WritePayload(payload_address, data_p, size);
+
+    return status && WriteToFlash(address + ITEM_HEADER_SIZE_WITHOUT_CRC, &item_p->crc, sizeof(item_p->crc));
+}
+
+/**
+ * Write a payload of any size, an odd last byte is padded to a half word.
+ */
+static bool WritePayload(uint32_t address, const void *data_p, size_t size)
+{
+    const size_t even_size = size & ~(size_t)1;
+    bool status = WriteToFlash(address, data_p, even_size);
+
+    if (status && (even_size != size))
+    {
+        const uint16_t last = 0xFF00 | ((const uint8_t *)data_p)[even_size];
+        status = WriteToFlash(address + even_size, &last, sizeof(last));
+    }
+
+    return status;
+}
+
+/**
+ * Copy an item in the same order as 'WriteItem', with the item CRC last.
+ */
+static bool CopyItem(uint32_t source, uint32_t destination, const struct nvs_item_t *item_p)
+{
+    const uint32_t length = GetItemLength(item_p);
+    bool status = WriteToFlash(destination, item_p, ITEM_HEADER_SIZE_WITHOUT_CRC);
+
+    for (uint32_t n = sizeof(*item_p); status && (n < length); n += COPY_BUFFER_SIZE)
+    {
+        uint8_t buffer[COPY_BUFFER_SIZE];
+        const uint32_t chunk_size = (length - n) < COPY_BUFFER_SIZE ? (length - n) : COPY_BUFFER_SIZE;
+        ReadFromFlash(source + n, buffer, chunk_size);
+        status = WriteToFlash(destination + n, buffer, chunk_size);
+    }
+
+    return status && WriteToFlash(destination + ITEM_HEADER_SIZE_WITHOUT_CRC, &item_p->crc, sizeof(item_p->crc));
+}
+
+/**
+ * Repair an item torn by a reset, so the items stored after it can be read.
+ *
+ * Only erased half words are programmed. An item with a partly written CRC
+ * has all of its payload and is completed, any other torn item is marked as
+ * removed.
+ *
+ * @param max_length Space left on the page from the item address.
+ *
+ * @return False if the item could not be repaired.
+ */
+static bool RepairItem(uint32_t address, uint32_t max_length)
+{
+    struct nvs_item_t item;
+    ReadFromFlash(address, &item, sizeof(item));
+
+    /* The size is never all ones, the reset came before it and the payload. */
+    if (item.size == UINT16_MAX)
+    {
+        item.size = 0;
+        if (!WriteToFlash(address + offsetof(struct nvs_item_t, size), &item.size, sizeof(item.size)))
+        {
+            return false;
+        }
+    }
+
+    if (GetItemLength(&item) > max_length)
+    {
+        return false;
+    }
+
+    const uint32_t crc = CalculateItemCRC(&item);
+    const uint16_t crc_high = (uint16_t)(crc >> 16);
+    Logging_Warning(self.logger_p, "Repair item: {address: 0x%x, hash: %u, size: %u}", address, item.hash, item.size);
+
+    if (item.crc == UINT32_MAX)
+    {
+        const uint16_t item_status = ITEM_DELETED;
+        return WriteToFlash(address + offsetof(struct nvs_item_t, status), &item_status, sizeof(item_status)) &&
+               WriteToFlash(address + ITEM_HEADER_SIZE_WITHOUT_CRC, &crc, sizeof(crc));
+    }
+
+    return ((item.crc & UINT16_MAX) == (crc & UINT16_MAX)) &&
+           ((item.crc >> 16) == UINT16_MAX) &&
+           WriteToFlash(address + ITEM_HEADER_SIZE_WITHOUT_CRC + sizeof(uint16_t), &crc_high, sizeof(crc_high));
+}
+
+/**
+ * Check if an item fits on the head page or on a new page.
+ *
+ * @param use_reserve True if the reserved page may be used, only when the
+ *                    oldest page is reclaimed.
+ */
+static bool HasSpace(uint32_t length, bool use_reserve)
+{
+    const size_t min_number_of_unused_pages = use_reserve ? 0 : RESERVED_PAGES;
+
+    return (length <= GetHeadFreeSpace()) ||
+           ((GetNumberOfUnusedPages() > min_number_of_unused_pages) &&
+            (length <= (FLASH_PAGE_SIZE - FIRST_ITEM_OFFSET)));
+}
+
+static uint32_t GetHeadFreeSpace(void)
+{
+    return FLASH_PAGE_SIZE - (uint32_t)self.pages[self.head].end_offset;
+}
+
+/**
+ * Get the space left for items without reclaiming any page.
+ */
+static uint32_t GetFreeSpace(void)
+{
+    uint32_t free_space = GetHeadFreeSpace();
+
+    const size_t number_of_unused_pages = GetNumberOfUnusedPages();
+    if (number_of_unused_pages > RESERVED_PAGES)
+    {
+        free_space += (number_of_unused_pages - RESERVED_PAGES) * (FLASH_PAGE_SIZE - FIRST_ITEM_OFFSET);
+    }
+
+    return free_space;
+}
+
+static uint32_t GetLiveSpace(void)
+{
+    uint32_t live_space = 0;
+
+    for (size_t i = 0; i < self.number_of_pages; ++i)
+    {
+        live_space += self.pages[i].live_space;
+    }
+
+    return live_space;
+}
+
+/**
+ * Get the space taken by removed and replaced items on the used pages.
+ */
+static uint32_t GetReclaimableSpace(void)
+{
+    uint32_t reclaimable_space = 0;
+
+    for (size_t i = 0; i < self.number_of_pages; ++i)
+    {
+        const struct nvs_page_t *page_p = &self.pages[i];
+        if (page_p->status == PAGE_STATUS_USED)
+        {
+            reclaimable_space += (uint32_t)(page_p->end_offset - page_p->first_item_offset) - page_p->live_space;
+        }
+    }
+
+    return reclaimable_space;
+}
+
+/**
+ * Get the number of bytes an item occupies in flash.
+ *
+ * Scalar items are the item header followed by the value. Blob items are the
+ * item header, a CRC of the payload and the payload padded to a half word.
+ * Items with a key check have it right after the item header.
+ */
+static uint32_t GetItemLength(const struct nvs_item_t *item_p)
+{
+    const uint32_t payload_size = item_p->size & ITEM_SIZE_MASK;
+    uint32_t length = sizeof(*item_p) + payload_size;
+
+    if ((item_p->size & ITEM_FLAG_KEY_CHECK) != 0)
+    {
+        length += sizeof(uint16_t);
+    }
+
+    if ((item_p->size & ITEM_FLAG_BLOB) != 0)
+    {
+        length += sizeof(uint32_t) + (payload_size % 2);
+    }
+
+    return length;
+}
+
+static uint32_t GetIndexedItemLength(const struct nvs_index_entry_t *entry_p)
+{
+    struct nvs_item_t item;
+    ReadFromFlash(self.start_page_address + entry_p->offset, &item, sizeof(item));
+
+    return GetItemLength(&item);
+}
+
+/**
+ * Index the latest used item for each key, the used pages are read from the
+ * oldest to the newest in one pass.
+ */
+static void BuildIndex(void)
+{
+    memset(self.index, 0, sizeof(self.index));
+    self.number_of_keys = 0;
+
+    size_t order[FLASH_MAX_NUMBER_OF_PAGES];
+    const size_t number_of_used_pages = GetUsedPagesInOrder(order);
+
+    for (size_t i = 0; i < number_of_used_pages; ++i)
+    {
+        IndexPage(order[i]);
+    }
+}
+
+static void IndexPage(size_t page_index)
+{
+    struct nvs_page_t *page_p = &self.pages[page_index];
+    const uint32_t page_address = GetPageAddress(page_index);
+    uint32_t offset = page_p->first_item_offset;
+
+    page_p->live_space = 0;
+
+    while(offset + sizeof(struct nvs_item_t) <= FLASH_PAGE_SIZE)
+    {
+        struct nvs_item_t item;
+        ReadFromFlash(page_address + offset, &item, sizeof(item));
+
+        if (item.crc != CalculateItemCRC(&item))
+        {
+            const uint32_t space = FLASH_PAGE_SIZE - offset;
+            if (IsBlank(page_address + offset, space))
+            {
+                break;
+            }
+
+            if (!RepairItem(page_address + offset, space))
+            {
+                /* Nothing can be written over the torn item, keep the page full. */
+                Logging_Error(self.logger_p, "Corrupt page: {page_address: 0x%x}", page_address);
+                offset = FLASH_PAGE_SIZE;
+                break;
+            }
+
+            ReadFromFlash(page_address + offset, &item, sizeof(item));
+        }
+
+        const uint32_t length = GetItemLength(&item);
+        if (item.status == ITEM_USED)
+        {
+            struct nvs_index_entry_t *entry_p = GetIndexEntry(item.hash);
+            if (entry_p->offset != INDEX_EMPTY)
+            {
+                SetIndexEntry(entry_p, (page_index * FLASH_PAGE_SIZE) + offset, length);
+            }
+            else if (self.number_of_keys < MAX_NUMBER_OF_KEYS)
+            {
+                entry_p->hash = item.hash;
+                SetIndexEntry(entry_p, (page_index * FLASH_PAGE_SIZE) + offset, length);
+                ++self.number_of_keys;
+            }
+            else
+            {
+                Logging_Error(self.logger_p, "Too many keys: {hash: %u}", item.hash);
+            }
+
+            if ((entry_p->offset != INDEX_EMPTY) && ((item.size & ITEM_FLAG_KEY_CHECK) != 0))
+            {
+                ReadFromFlash(page_address + offset + sizeof(item), &entry_p->key_check, sizeof(entry_p->key_check));
+            }
+        }
+
+        offset += length;
+    }
+
+    page_p->end_offset = (uint16_t)offset;
+}
+
+/**
+ * Find the index entry for a hash with linear probing.
+ *
+ * @return The entry for the hash, or the empty entry where it belongs.
+ */
+static struct nvs_index_entry_t *GetIndexEntry(uint32_t hash)
+{
+    size_t slot = hash & (INDEX_SIZE - 1);
+
+    while ((self.index[slot].offset != INDEX_EMPTY) && (self.index[slot].hash != hash))
+    {
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+    }
+
+    return &self.index[slot];
+}
+
+/**
+ * Point an entry to a new item and move the live space of the replaced item,
+ * if any, to the page of the new item.
+ */
+static void SetIndexEntry(struct nvs_index_entry_t *entry_p, uint32_t offset, uint32_t length)
+{
+    if (entry_p->offset != INDEX_EMPTY)
+    {
+        self.pages[entry_p->offset / FLASH_PAGE_SIZE].live_space -= GetIndexedItemLength(entry_p);
+    }
+
+    entry_p->offset = (uint16_t)offset;
+    self.pages[offset / FLASH_PAGE_SIZE].live_space += length;
+}
+
+/**
+ * Remove an entry and shift back the following entries in its probe
+ * sequence, so no lookup is cut short by the new gap.
+ */
+static void RemoveIndexEntry(struct nvs_index_entry_t *entry_p)
+{
+    size_t gap = (size_t)(entry_p - self.index);
+    size_t slot = gap;
+
+    while (true)
+    {
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+        if (self.index[slot].offset == INDEX_EMPTY)
+        {
+            break;
+        }
+
+        /* Move the entry unless its home slot lies cyclically in (gap, slot]. */
+        const size_t home = self.index[slot].hash & (INDEX_SIZE - 1);
+        if (((slot - home) & (INDEX_SIZE - 1)) >= ((slot - gap) & (INDEX_SIZE - 1)))
+        {
+            self.index[gap] = self.index[slot];
+            gap = slot;
+        }
+    }
+
+    self.index[gap] = (__typeof__(self.index[gap])) {0};
+}
+
+/**
+ * Check that the key is the one stored with the item, or the one the entry
+ * was first used with since boot for items stored without a key check.
+ *
+ * @return False if another key with the same hash already uses the entry.
+ */
+static bool ClaimKey(struct nvs_index_entry_t *entry_p, const char *key_p)
+{
+    const uint16_t key_check = CalculateKeyCheck(key_p);
+
+    if (entry_p->key_check == 0)
+    {
+        entry_p->key_check = key_check;
+    }
+    else if (entry_p->key_check != key_check)
+    {
+        Logging_Error(self.logger_p, "Key collision: {key: %s, hash: %u}", key_p, entry_p->hash);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Calculate FNV-1a hash for given string.
+ */
+static uint32_t CalculateHash(const char *str_p)
+{
+    const uint32_t fnv_offset = 2166136261;
+    const uint32_t fnv_prime = 16777619;
+
+    uint32_t hash = fnv_offset;
+    for (const char *p = str_p; *p != '\0'; ++p)
+    {
+        hash ^= (uint32_t)(*p);
+        hash *= fnv_prime;
+    }
+    return hash;
+}
+
+/**
+ * Calculate a 16-bit djb2 hash for given string, never zero.
+ */
+static uint16_t CalculateKeyCheck(const char *str_p)
+{
+    uint32_t hash = 5381;
+    for (const char *p = str_p; *p != '\0'; ++p)
+    {
+        hash = (hash * 33) + (uint32_t)(*p);
+    }
+
+    const uint16_t key_check = (uint16_t)(hash ^ (hash >> 16));
+    return key_check != 0 ? key_check : 1;
+}
+
+static uint32_t CalculateItemCRC(const struct nvs_item_t *item_p)
+{
+    const size_t item_size_without_crc = 6;
+    return CRC_Calculate(item_p, item_size_without_crc);
+}
+
+/**
+ * Mark all used items for a hash on a page as deleted.
+ *
+ * @param number_of_items_p Pointer to the number of removed items.
+ *
+ * @return False if an item could not be removed, otherwise true.
+ */
+static bool RemoveItems(size_t page_index, const char *key_p, uint32_t hash, size_t *number_of_items_p)
+{
+    bool status = true;
+    *number_of_items_p = 0;
+
+    const struct nvs_page_t *page_p = &self.pages[page_index];
+    const uint32_t page_address = GetPageAddress(page_index);
+
+    uint32_t item_address = page_address + page_p->first_item_offset;
+    while(item_address < page_address + page_p->end_offset)
+    {
+        struct nvs_item_t item;
+        ReadFromFlash(item_address, &item, sizeof(item));
+        const uint32_t crc = CalculateItemCRC(&item);
+
+        if ((item.hash == hash) && (item.crc == crc) && (item.status == ITEM_USED))
+        {
+            const uint16_t item_status = ITEM_DELETED;
+            const size_t status_offset = 6;
+            status = WriteToFlash(item_address + status_offset, &item_status, sizeof(item_status));
+
+            if (!status)
+            {
+                Logging_Error(self.logger_p,
+                              "Failed to remove item: {key: %s, hash: %u, size: %u}",
+                              key_p,
+                              item.hash,
+                              item.size);
+                break;
+            }
+            ++(*number_of_items_p);
+        }
+        else if (item.crc != crc)
+        {
+            /* Abort when all valid items are checked. */
+            break;
+        }
+        else
+        {
+            /* Do nothing, item is valid but does not match the supplied key. */
+        }
+        item_address += GetItemLength(&item);
+    }
+
+    return status;
+}
+
+/**
+ * Compact when the free space is low, but only if reclaiming the oldest page
+ * frees enough space to not compact again right away.
+ */
+static bool ShouldStartCompaction(void)
+{
+    const uint32_t free_space = GetFreeSpace();
+    if (free_space >= COMPACTION_THRESHOLD)
+    {
+        return false;
+    }
+
+    const struct nvs_page_t *page_p = &self.pages[GetOldestPage()];
+    const uint32_t used_space = page_p->end_offset - page_p->first_item_offset;
+    return (free_space + (used_space - page_p->live_space)) >= COMPACTION_THRESHOLD;
+}
+
+/**
+ * Start to reclaim the oldest page. When it is also the head page, the
+ * compaction starts by moving the head to a new page.
+ */
+static void StartCompaction(void)
+{
+    self.compaction_page = GetOldestPage();
+
+    Logging_Info(self.logger_p, "Start compaction: {page_address: 0x%x, erase_count: %u}",
+                 GetPageAddress(self.compaction_page),
+                 self.pages[self.compaction_page].erase_count);
+
+    if ((self.compaction_page == self.head) && !AllocatePage())
+    {
+        Logging_Error(self.logger_p, "Compaction failed: {page_address: 0x%x}", GetPageAddress(self.compaction_page));
+        return;
+    }
+
+    self.compaction_source = self.pages[self.compaction_page].first_item_offset;
+    self.compaction_state = COMPACTION_COPY;
+}
+
+static void CompleteCompaction(void)
+{
+    while (self.compaction_state != COMPACTION_IDLE)
+    {
+        CompactionStep();
+    }
+}
+
+/**
+ * Advance the compaction by one bounded step, the copy of a few items or the
+ * erase of the reclaimed page.
+ *
+ * The reclaimed page stays valid until all its live items are copied to the
+ * head page. Items stored meanwhile are added to the head page and make the
+ * copies of their older items unnecessary.
+ */
+static void CompactionStep(void)
+{
+    switch (self.compaction_state)
+    {
+        case COMPACTION_COPY:
+            CopyItems();
+            break;
+
+        case COMPACTION_ERASE:
+            ResetPage(self.compaction_page);
+            self.compaction_state = COMPACTION_IDLE;
+
+            Logging_Info(self.logger_p,
+                         "Compaction done: {page_address: 0x%x, erase_count: %u, active_address: 0x%x}",
+                         GetPageAddress(self.compaction_page),
+                         self.pages[self.compaction_page].erase_count,
+                         GetPageAddress(self.head) + self.pages[self.head].end_offset);
+            break;
+
+        case COMPACTION_IDLE:
+        default:
+            break;
+    }
+}
+
+/**
+ * Copy the latest used items among the next few items on the reclaimed page
+ * to the head page. Removed and replaced items are left behind.
+ */
+static void CopyItems(void)
+{
+    const struct nvs_page_t *page_p = &self.pages[self.compaction_page];
+    const uint32_t page_address = GetPageAddress(self.compaction_page);
+
+    for (size_t i = 0; i < COMPACTION_ITEMS_PER_STEP; ++i)
+    {
+        if (self.compaction_source >= page_p->end_offset)
+        {
+            self.compaction_state = COMPACTION_ERASE;
+            break;
+        }
+
+        struct nvs_item_t item;
+        const uint32_t item_address = page_address + self.compaction_source;
+        ReadFromFlash(item_address, &item, sizeof(item));
+
+        const uint32_t length = GetItemLength(&item);
+        struct nvs_index_entry_t *entry_p = GetIndexEntry(item.hash);
+        const uint32_t offset = (self.compaction_page * FLASH_PAGE_SIZE) + self.compaction_source;
+
+        if ((item.status == ITEM_USED) && (entry_p->offset == offset))
+        {
+            if (!HasSpace(length, true))
+            {
+                Logging_Critical(self.logger_p, "Compaction failed: {page_address: 0x%x}", page_address);
+                self.compaction_state = COMPACTION_IDLE;
+                break;
+            }
+
+            if ((length > GetHeadFreeSpace()) && !AllocatePage())
+            {
+                self.compaction_state = COMPACTION_IDLE;
+                break;
+            }
+
+            struct nvs_page_t *head_p = &self.pages[self.head];
+            const uint32_t destination = GetPageAddress(self.head) + head_p->end_offset;
+            Logging_Debug(self.logger_p,
+                          "Move: {hash: %u, size: %u, crc: %u, destination: 0x%x}",
+                          item.hash,
+                          item.size,
+                          item.crc,
+                          destination);
+
+            if (!CopyItem(item_address, destination, &item))
+            {
+                /* The reclaimed page is kept, nothing can be written over the failed copy. */
+                Logging_Critical(self.logger_p, "Compaction failed: {page_address: 0x%x}", page_address);
+                head_p->end_offset = FLASH_PAGE_SIZE;
+                self.compaction_state = COMPACTION_IDLE;
+                break;
+            }
+
+            SetIndexEntry(entry_p, (self.head * FLASH_PAGE_SIZE) + head_p->end_offset, length);
+            head_p->end_offset += length;
+        }
+
+        self.compaction_source += length;
     }
-    return  next_page_address;
 }
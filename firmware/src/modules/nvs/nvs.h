@@ -36,15 +36,36 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //DEFINES
 //////////////////////////////////////////////////////////////////////////
 
+/* Max size of a blob, what fits on an empty page. */
+#define NVS_MAX_BLOB_SIZE 974
+
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
 //////////////////////////////////////////////////////////////////////////
 
+struct nvs_statistics_t
+{
+    uint32_t number_of_pages;
+    uint32_t min_erase_count;
+    uint32_t max_erase_count;
+    uint32_t remaining_erase_cycles;
+    uint32_t live_space;
+    uint32_t free_space;
+    uint32_t max_store_time_us;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
 /**
  * Initialize the Non Volatile Storage(NVS) module.
  *
+ * Items are stored in a log over all pages, one page is kept unused so the
+ * oldest page can always be reclaimed.
+ *
  * @param start_page_address Address of the first flash page used for NVS.
- * @param number_of_pages Number of flash pages used for NVS.
+ * @param number_of_pages Number of flash pages used for NVS, 2 to 16.
  */
 void NVS_Init(uint32_t start_page_address, size_t number_of_pages);
 
@@ -57,6 +78,19 @@ void NVS_Init(uint32_t start_page_address, size_t number_of_pages);
  */
 bool NVS_Store(const char *key_p, uint32_t value);
 
+/**
+ * Store a blob in NVS.
+ *
+ * A CRC of the blob is stored with it and checked when it is retrieved.
+ * Scalar values and blobs share the same keys.
+ *
+ * @param  key_p Key of blob to store.
+ * @param  data_p Pointer to the blob.
+ * @param  size Size of the blob, at most NVS_MAX_BLOB_SIZE bytes.
+ * @return True if blob was stored successfully, otherwise false.
+ */
+bool NVS_StoreBlob(const char *key_p, const void *data_p, size_t size);
+
 /**
  * Retrieve a value from NVS.
  *
@@ -67,6 +101,20 @@ bool NVS_Store(const char *key_p, uint32_t value);
  */
 bool NVS_Retrieve(const char *key_p, uint32_t *value_p);
 
+/**
+ * Retrieve a blob from NVS.
+ *
+ * @param  key_p Key of blob to retrieve.
+ * @param  data_p Pointer to where the blob will be stored.
+ * @param  max_size Size of the buffer at 'data_p'.
+ * @param  size_p Pointer to the size of the stored blob, also set if the
+ *                buffer is too small.
+ *
+ * @return True if a blob for the supplied key existed, fit in the buffer and
+ *         passed the CRC check, otherwise false.
+ */
+bool NVS_RetrieveBlob(const char *key_p, void *data_p, size_t max_size, size_t *size_p);
+
 /**
  * Remove a value from NVS.
  *
@@ -83,4 +131,24 @@ bool NVS_Remove(const char *key_p);
  */
 bool NVS_Clear(void);
 
+/**
+ * Compact the oldest page in the background.
+ *
+ * Compaction starts when the free space is low and is advanced one bounded
+ * step per call, i.e. one page erase or a few item copies, so a later store
+ * does not have to do it. Called from the main loop.
+ */
+void NVS_Process(void);
+
+/**
+ * Get the wear and space statistics.
+ *
+ * The remaining erase cycles are counted for the most worn page. Pages not
+ * erased since erase counting was added are assumed to be as worn as the
+ * most worn page.
+ *
+ * @param statistics_p Pointer to where the statistics will be stored.
+ */
+void NVS_GetStatistics(struct nvs_statistics_t *statistics_p);
+
 #endif
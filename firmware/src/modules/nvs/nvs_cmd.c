@@ -27,6 +27,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <assert.h>
 #include <stdio.h>
+#include <inttypes.h>
 #include "utility.h"
 #include "console.h"
 #include "nvs.h"
@@ -82,6 +83,20 @@ bool NVSCmd_Remove(void)
     return status;
 }
 
+bool NVSCmd_PrintStatistics(void)
+{
+    struct nvs_statistics_t statistics;
+    NVS_GetStatistics(&statistics);
+
+    printf("pages: %" PRIu32 ", live: %" PRIu32 " bytes, free: %" PRIu32 " bytes\r\n",
+           statistics.number_of_pages, statistics.live_space, statistics.free_space);
+    printf("erases: min: %" PRIu32 ", max: %" PRIu32 ", remaining: %" PRIu32 "\r\n",
+           statistics.min_erase_count, statistics.max_erase_count, statistics.remaining_erase_cycles);
+    printf("max store time: %" PRIu32 " us\r\n", statistics.max_store_time_us);
+
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
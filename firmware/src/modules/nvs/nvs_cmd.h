@@ -46,4 +46,6 @@ bool NVSCmd_Store(void);
 
 bool NVSCmd_Remove(void);
 
+bool NVSCmd_PrintStatistics(void);
+
 #endif
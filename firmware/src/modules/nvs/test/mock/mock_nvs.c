@@ -71,11 +71,40 @@ __attribute__((weak)) bool NVS_Store(const char *key_p, uint32_t value)
 
     return mock_type(bool);
 }
+__attribute__((weak)) bool NVS_StoreBlob(const char *key_p, const void *data_p, size_t size)
+{
+    assert_non_null(key_p);
+    assert_non_null(data_p);
+
+    return mock_type(bool);
+}
+
+__attribute__((weak)) bool NVS_RetrieveBlob(const char *key_p, void *data_p, size_t max_size, size_t *size_p)
+{
+    assert_non_null(key_p);
+    assert_non_null(data_p);
+    assert_non_null(size_p);
+
+    *size_p = mock_type(size_t);
+    return mock_type(bool);
+}
+
 __attribute__((weak)) bool NVS_Clear(void)
 {
     return mock_type(bool);
 }
 
+__attribute__((weak)) void NVS_Process(void)
+{
+    function_called();
+}
+
+__attribute__((weak)) void NVS_GetStatistics(struct nvs_statistics_t *statistics_p)
+{
+    assert_non_null(statistics_p);
+    *statistics_p = *mock_ptr_type(struct nvs_statistics_t *);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -64,6 +64,11 @@ __attribute__((weak)) bool NVSCmd_Remove(void)
     return mock_type(bool);
 }
 
+__attribute__((weak)) bool NVSCmd_PrintStatistics(void)
+{
+    return mock_type(bool);
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
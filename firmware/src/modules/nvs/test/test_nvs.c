@@ -35,6 +35,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdbool.h>
 #include <libopencm3/stm32/flash.h>
 #include "utility.h"
+#include "crc.h"
 #include "nvs.h"
 #include "nvs_cmd.h"
 
@@ -49,6 +50,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
  */
 #define FLASH_START_ADDRESS 0
 #define NUMBER_OF_PAGES 2
+#define NUMBER_OF_RING_PAGES 4
 #define PAGE_SIZE 1024
 
 //////////////////////////////////////////////////////////////////////////
@@ -61,7 +63,12 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 
 static struct logging_logger_t *dummy_logger;
 static bool create_corrupt_crc = false;
-static uint32_t flash_data[NUMBER_OF_PAGES][PAGE_SIZE];
+static uint8_t flash_data[NUMBER_OF_RING_PAGES][PAGE_SIZE];
+static size_t number_of_page_erases;
+static uint32_t system_time_us;
+static uint32_t time_per_call_us;
+static int remaining_writes_before_power_loss;
+static jmp_buf power_loss;
 
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTIONS
@@ -70,12 +77,16 @@ static uint32_t flash_data[NUMBER_OF_PAGES][PAGE_SIZE];
 static int Setup(void **state)
 {
     create_corrupt_crc = false;
+    remaining_writes_before_power_loss = -1;
 
     flash_erase_all_pages();
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
     will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
 
     NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    number_of_page_erases = 0;
+    system_time_us = 0;
+    time_per_call_us = 0;
 
     return 0;
 }
@@ -94,6 +105,15 @@ void flash_program_word(uint32_t address, uint32_t data)
 
 void flash_program_half_word(uint32_t address, uint16_t data)
 {
+    if (remaining_writes_before_power_loss == 0)
+    {
+        longjmp(power_loss, 1);
+    }
+    else if (remaining_writes_before_power_loss > 0)
+    {
+        --remaining_writes_before_power_loss;
+    }
+
     uint8_t *destination_p = ((uint8_t *)flash_data) + address;
     __real_memcpy(destination_p, &data, sizeof(data));
 }
@@ -108,6 +128,7 @@ void flash_erase_page(uint32_t page_address)
 {
     uint32_t page_index = page_address / PAGE_SIZE;
     memset(flash_data[page_index], 0xFF, PAGE_SIZE);
+    ++number_of_page_erases;
 }
 
 void flash_erase_all_pages(void)
@@ -115,6 +136,53 @@ void flash_erase_all_pages(void)
     memset(flash_data, 0xFF, sizeof(flash_data));
 }
 
+uint32_t SysTime_GetSystemTimeUs(void)
+{
+    system_time_us += time_per_call_us;
+    return system_time_us;
+}
+
+/**
+ * Write a page in the format from before the erase records, items start
+ * directly after the page header.
+ */
+static void WriteLegacyPage(size_t page_index, uint32_t sequence_number, const char *keys[], const uint32_t values[], size_t number_of_items)
+{
+    uint32_t *page_p = (uint32_t *)flash_data[page_index];
+    memset(page_p, 0xFF, PAGE_SIZE);
+
+    page_p[0] = 0x0C00FFE0;
+    page_p[1] = sequence_number;
+    page_p[2] = CRC_Calculate(page_p, 2 * sizeof(uint32_t));
+
+    uint32_t *item_p = &page_p[3];
+    for (size_t i = 0; i < number_of_items; ++i)
+    {
+        uint32_t hash = 2166136261;
+        for (const char *c_p = keys[i]; *c_p != '\0'; ++c_p)
+        {
+            hash ^= (uint32_t)(*c_p);
+            hash *= 16777619;
+        }
+
+        item_p[0] = hash;
+        item_p[1] = 0xFFFF0000 | sizeof(uint32_t);
+        item_p[2] = CRC_Calculate(item_p, 6);
+        item_p[3] = values[i];
+        item_p += 4;
+    }
+}
+
+static void ProcessUntilCompactionDone(void)
+{
+    const size_t number_of_erases = number_of_page_erases;
+    for (size_t i = 0; i < 100; ++i)
+    {
+        NVS_Process();
+    }
+    assert_int_equal(number_of_page_erases, number_of_erases + 1);
+}
+
 //////////////////////////////////////////////////////////////////////////
 //TESTS
 //////////////////////////////////////////////////////////////////////////
@@ -123,6 +191,7 @@ static void test_NVS_Init_Invalid(void **state)
 {
     expect_assert_failure(NVS_Init(FLASH_START_ADDRESS, 0));
     expect_assert_failure(NVS_Init(FLASH_START_ADDRESS, 1));
+    expect_assert_failure(NVS_Init(FLASH_START_ADDRESS, 17));
 }
 
 static void test_NVS_Init_CrcError(void **state)
@@ -192,7 +261,7 @@ static void test_NVS_Remove(void **state)
 
 static void test_NVS_Remove_FailedFlashWrite(void **state)
 {
-    will_return_uint_count(flash_get_status_flags, FLASH_SR_EOP, 8);
+    will_return_uint_count(flash_get_status_flags, FLASH_SR_EOP, 9);
     assert_true(NVS_Store("Foo", 10));
 
     will_return_uint_maybe(flash_get_status_flags, FLASH_SR_PGERR);
@@ -307,6 +376,600 @@ static void test_NVS_PageWrapAround(void **state)
     assert_int_equal(value, 31);
 }
 
+static void test_NVS_KeyCollision(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    /* 'costarring' and 'liquid' have the same FNV-1a hash. */
+    uint32_t value;
+    assert_true(NVS_Store("costarring", 10));
+    assert_false(NVS_Store("liquid", 20));
+    assert_false(NVS_Retrieve("liquid", &value));
+    assert_false(NVS_Remove("liquid"));
+    assert_true(NVS_Retrieve("costarring", &value));
+    assert_int_equal(value, 10);
+
+    /* The key check is stored with the item, the collision is detected after init. */
+    NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    assert_false(NVS_Store("liquid", 20));
+    assert_false(NVS_Retrieve("liquid", &value));
+    assert_false(NVS_Remove("liquid"));
+    assert_true(NVS_Retrieve("costarring", &value));
+    assert_int_equal(value, 10);
+}
+
+static void test_NVS_ManyKeys(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    const size_t number_of_keys = 40;
+    char keys[40][8];
+    for (size_t i = 0; i < number_of_keys; ++i)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "Key%zu", i);
+        assert_true(NVS_Store(keys[i], i));
+    }
+
+    /* Remove every other key, later keys must still be found. */
+    for (size_t i = 0; i < number_of_keys; i += 2)
+    {
+        assert_true(NVS_Remove(keys[i]));
+    }
+
+    for (size_t n = 0; n < 2; ++n)
+    {
+        for (size_t i = 0; i < number_of_keys; ++i)
+        {
+            uint32_t value;
+            if (i % 2 == 0)
+            {
+                assert_false(NVS_Retrieve(keys[i], &value));
+            }
+            else
+            {
+                assert_true(NVS_Retrieve(keys[i], &value));
+                assert_int_equal(value, i);
+            }
+        }
+
+        /* Rebuild the index from flash and check again. */
+        NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    }
+
+    /* Fill the page so the remaining keys are moved. */
+    for (size_t i = 0; i < 60; ++i)
+    {
+        assert_true(NVS_Store(keys[1], 100 + i));
+    }
+
+    for (size_t i = 1; i < number_of_keys; i += 2)
+    {
+        uint32_t value;
+        assert_true(NVS_Retrieve(keys[i], &value));
+        assert_int_equal(value, i == 1 ? 159 : i);
+        assert_false(NVS_Retrieve(keys[i - 1], &value));
+    }
+}
+
+static void test_NVS_Store_MaxStoreTime(void **state)
+{
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    struct nvs_statistics_t statistics;
+    NVS_GetStatistics(&statistics);
+    assert_int_equal(statistics.max_store_time_us, 0);
+
+    /* The longest store is kept. */
+    const uint32_t store_times[] = {100, 300, 50};
+    for (size_t i = 0; i < ElementsIn(store_times); ++i)
+    {
+        time_per_call_us = store_times[i];
+        assert_true(NVS_Store("Foo", i));
+    }
+
+    NVS_GetStatistics(&statistics);
+    assert_int_equal(statistics.max_store_time_us, 300);
+}
+
+static void test_NVS_Process_Idle(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    /* Free space is still above the threshold. */
+    for (size_t i = 0; i < 40; ++i)
+    {
+        assert_true(NVS_Store("A", i));
+    }
+    NVS_Process();
+    assert_int_equal(number_of_page_erases, 0);
+
+    /* Below the threshold but all items are live, nothing to gain. */
+    NVS_Clear();
+    number_of_page_erases = 0;
+    char keys[50][8];
+    for (size_t i = 0; i < ElementsIn(keys); ++i)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "Key%zu", i);
+        assert_true(NVS_Store(keys[i], i));
+    }
+    NVS_Process();
+    assert_int_equal(number_of_page_erases, 0);
+}
+
+static void test_NVS_Process_Compaction(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    for (size_t i = 0; i < 25; ++i)
+    {
+        assert_true(NVS_Store("A", i));
+        assert_true(NVS_Store("B", i));
+    }
+    assert_int_equal(number_of_page_erases, 0);
+
+    /* The page is compacted in the background, later stores do not erase. */
+    ProcessUntilCompactionDone();
+    for (size_t i = 25; i < 70; ++i)
+    {
+        assert_true(NVS_Store("A", i));
+    }
+    assert_int_equal(number_of_page_erases, 1);
+
+    uint32_t value;
+    assert_true(NVS_Retrieve("A", &value));
+    assert_int_equal(value, 69);
+    assert_true(NVS_Retrieve("B", &value));
+    assert_int_equal(value, 24);
+
+    NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    assert_true(NVS_Retrieve("A", &value));
+    assert_int_equal(value, 69);
+    assert_true(NVS_Retrieve("B", &value));
+    assert_int_equal(value, 24);
+}
+
+static void test_NVS_Process_ChangesDuringCompaction(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    assert_true(NVS_Store("A", 1));
+    assert_true(NVS_Store("B", 2));
+    assert_true(NVS_Store("C", 3));
+    for (size_t i = 0; i < 47; ++i)
+    {
+        assert_true(NVS_Store("D", i));
+    }
+
+    /* Erase the new page and copy the first items. */
+    NVS_Process();
+    NVS_Process();
+
+    /* Replace an item that is already copied and remove another one. */
+    assert_true(NVS_Store("A", 10));
+    assert_true(NVS_Remove("B"));
+    assert_true(NVS_Store("E", 5));
+
+    /* New items are stored on the new page while the old page is reclaimed. */
+    for (size_t i = 0; i < 20; ++i)
+    {
+        assert_true(NVS_Store("D", 100 + i));
+    }
+    assert_int_equal(number_of_page_erases, 0);
+    ProcessUntilCompactionDone();
+
+    for (size_t n = 0; n < 2; ++n)
+    {
+        uint32_t value;
+        assert_true(NVS_Retrieve("A", &value));
+        assert_int_equal(value, 10);
+        assert_false(NVS_Retrieve("B", &value));
+        assert_true(NVS_Retrieve("C", &value));
+        assert_int_equal(value, 3);
+        assert_true(NVS_Retrieve("D", &value));
+        assert_int_equal(value, 119);
+        assert_true(NVS_Retrieve("E", &value));
+        assert_int_equal(value, 5);
+
+        NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    }
+}
+
+static void test_NVS_Process_InterruptedCompaction(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    char keys[10][8];
+    for (size_t i = 0; i < ElementsIn(keys); ++i)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "Key%zu", i);
+        assert_true(NVS_Store(keys[i], i));
+    }
+    for (size_t i = 0; i < 40; ++i)
+    {
+        assert_true(NVS_Store("A", i));
+    }
+
+    /* Reset after the first items are copied to the new page. */
+    NVS_Process();
+    assert_int_equal(number_of_page_erases, 0);
+
+    /* Both pages are used, the compaction is finished to get an unused page back. */
+    NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    assert_int_equal(number_of_page_erases, 1);
+
+    for (size_t n = 0; n < 2; ++n)
+    {
+        uint32_t value;
+        for (size_t i = 0; i < ElementsIn(keys); ++i)
+        {
+            assert_true(NVS_Retrieve(keys[i], &value));
+            assert_int_equal(value, i);
+        }
+        assert_true(NVS_Retrieve("A", &value));
+        assert_int_equal(value, 39);
+
+        NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    }
+}
+
+static void test_NVS_Process_PowerLossDuringCompaction(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    char keys[10][8];
+    for (size_t i = 0; i < ElementsIn(keys); ++i)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "Key%zu", i);
+        assert_true(NVS_Store(keys[i], i));
+    }
+    for (size_t i = 0; i < 40; ++i)
+    {
+        assert_true(NVS_Store("A", i));
+    }
+
+    static uint8_t flash_before_compaction[sizeof(flash_data)];
+    __real_memcpy(flash_before_compaction, flash_data, sizeof(flash_data));
+
+    /* Cut the power after every half word written by the compaction. */
+    bool is_compaction_done = false;
+    for (int n = 0; !is_compaction_done; ++n)
+    {
+        __real_memcpy(flash_data, flash_before_compaction, sizeof(flash_data));
+        NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+
+        remaining_writes_before_power_loss = n;
+        if (setjmp(power_loss) == 0)
+        {
+            for (size_t i = 0; i < 100; ++i)
+            {
+                NVS_Process();
+            }
+            is_compaction_done = true;
+        }
+        remaining_writes_before_power_loss = -1;
+
+        NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+
+        uint32_t value;
+        for (size_t i = 0; i < ElementsIn(keys); ++i)
+        {
+            assert_true(NVS_Retrieve(keys[i], &value));
+            assert_int_equal(value, i);
+        }
+        assert_true(NVS_Retrieve("A", &value));
+        assert_int_equal(value, 39);
+
+        /* Items torn by the power loss are not in the way of new items. */
+        assert_true(NVS_Store("A", 40));
+        NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+        assert_true(NVS_Retrieve("A", &value));
+        assert_int_equal(value, 40);
+    }
+}
+
+static void test_NVS_Blob_Invalid(void **state)
+{
+    uint8_t data[4];
+    size_t size;
+
+    expect_assert_failure(NVS_StoreBlob("Foo", NULL, sizeof(data)));
+    expect_assert_failure(NVS_StoreBlob("Foo", data, NVS_MAX_BLOB_SIZE + 1));
+    expect_assert_failure(NVS_RetrieveBlob("Foo", NULL, sizeof(data), &size));
+    expect_assert_failure(NVS_RetrieveBlob("Foo", data, sizeof(data), NULL));
+}
+
+static void test_NVS_StoreAndRetrieveBlob(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    const uint8_t blob[] = {1, 2, 3, 4, 5, 6, 7};
+    const uint8_t empty_blob[1] = {0};
+    assert_true(NVS_StoreBlob("Blob", blob, sizeof(blob)));
+    assert_true(NVS_StoreBlob("Empty", empty_blob, 0));
+    assert_true(NVS_Store("Value", 10));
+
+    for (size_t n = 0; n < 2; ++n)
+    {
+        uint8_t data[16] = {0};
+        size_t size;
+        assert_true(NVS_RetrieveBlob("Blob", data, sizeof(data), &size));
+        assert_int_equal(size, sizeof(blob));
+        assert_memory_equal(data, blob, sizeof(blob));
+
+        assert_true(NVS_RetrieveBlob("Empty", data, sizeof(data), &size));
+        assert_int_equal(size, 0);
+
+        /* A scalar value can be retrieved as a blob, but not the other way around. */
+        assert_true(NVS_RetrieveBlob("Value", data, sizeof(data), &size));
+        assert_int_equal(size, sizeof(uint32_t));
+        uint32_t value;
+        assert_false(NVS_Retrieve("Blob", &value));
+
+        /* The size is reported when the buffer is too small. */
+        assert_false(NVS_RetrieveBlob("Blob", data, sizeof(blob) - 1, &size));
+        assert_int_equal(size, sizeof(blob));
+
+        NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    }
+}
+
+static void test_NVS_Blob_CorruptPayload(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    const uint8_t blob[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    assert_true(NVS_StoreBlob("Blob", blob, sizeof(blob)));
+
+    /* Flip a bit in the last payload byte, after the page header, erase record, item header and CRC. */
+    uint8_t *flash_p = (uint8_t *)flash_data;
+    flash_p[12 + 20 + 12 + 4 + sizeof(blob) - 1] ^= 0x01;
+
+    uint8_t data[sizeof(blob)];
+    size_t size;
+    assert_false(NVS_RetrieveBlob("Blob", data, sizeof(data), &size));
+}
+
+static void test_NVS_Blob_Compaction(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    uint8_t blob[301];
+    for (size_t i = 0; i < sizeof(blob); ++i)
+    {
+        blob[i] = (uint8_t)i;
+    }
+    assert_true(NVS_StoreBlob("Blob", blob, sizeof(blob)));
+
+    /* Move the blob to a new page, in the background and when the page is full. */
+    for (size_t i = 0; i < 30; ++i)
+    {
+        assert_true(NVS_Store("A", i));
+    }
+    ProcessUntilCompactionDone();
+    for (size_t i = 0; i < 50; ++i)
+    {
+        assert_true(NVS_Store("A", i));
+    }
+    assert_int_equal(number_of_page_erases, 2);
+
+    for (size_t n = 0; n < 2; ++n)
+    {
+        uint8_t data[sizeof(blob)] = {0};
+        size_t size;
+        assert_true(NVS_RetrieveBlob("Blob", data, sizeof(data), &size));
+        assert_int_equal(size, sizeof(blob));
+        assert_memory_equal(data, blob, sizeof(blob));
+
+        uint32_t value;
+        assert_true(NVS_Retrieve("A", &value));
+        assert_int_equal(value, 49);
+
+        NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    }
+}
+
+static void test_NVS_Blob_StorageFull(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    static uint8_t blob[NVS_MAX_BLOB_SIZE];
+    memset(blob, 0xA5, sizeof(blob));
+    assert_true(NVS_StoreBlob("Blob", blob, sizeof(blob)));
+
+    /* The live blob fills a page, nothing else fits. */
+    assert_false(NVS_Store("Foo", 10));
+
+    uint8_t data[NVS_MAX_BLOB_SIZE];
+    size_t size;
+    assert_true(NVS_RetrieveBlob("Blob", data, sizeof(data), &size));
+    assert_int_equal(size, sizeof(blob));
+
+    /* Space is reclaimed when the blob is removed. */
+    assert_true(NVS_Remove("Blob"));
+    assert_true(NVS_Store("Foo", 10));
+    assert_false(NVS_RetrieveBlob("Blob", data, sizeof(data), &size));
+    uint32_t value;
+    assert_true(NVS_Retrieve("Foo", &value));
+    assert_int_equal(value, 10);
+}
+
+static void test_NVS_Ring_LiveDataOnSeveralPages(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    flash_erase_all_pages();
+    NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_RING_PAGES);
+
+    /* Two blobs fit on a page, the live data fills three pages. */
+    static uint8_t blobs[6][400];
+    const char *keys[] = {"Blob0", "Blob1", "Blob2", "Blob3", "Blob4", "Blob5"};
+    for (size_t i = 0; i < ElementsIn(blobs); ++i)
+    {
+        memset(blobs[i], (int)i, sizeof(blobs[i]));
+        assert_true(NVS_StoreBlob(keys[i], blobs[i], sizeof(blobs[i])));
+    }
+
+    /* The reserved page is kept, another blob does not fit. */
+    assert_false(NVS_StoreBlob("Blob6", blobs[0], sizeof(blobs[0])));
+
+    for (size_t n = 0; n < 2; ++n)
+    {
+        for (size_t i = 0; i < ElementsIn(blobs); ++i)
+        {
+            uint8_t data[400];
+            size_t size;
+            assert_true(NVS_RetrieveBlob(keys[i], data, sizeof(data), &size));
+            assert_int_equal(size, sizeof(blobs[i]));
+            assert_memory_equal(data, blobs[i], sizeof(blobs[i]));
+        }
+
+        struct nvs_statistics_t statistics;
+        NVS_GetStatistics(&statistics);
+        assert_int_equal(statistics.number_of_pages, NUMBER_OF_RING_PAGES);
+        assert_int_equal(statistics.live_space, ElementsIn(blobs) * (12 + 2 + 4 + 400));
+
+        NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_RING_PAGES);
+    }
+    assert_int_equal(number_of_page_erases, 0);
+
+    /* Space of a removed blob is reclaimed. */
+    assert_true(NVS_Remove(keys[0]));
+    assert_true(NVS_StoreBlob("Blob6", blobs[0], sizeof(blobs[0])));
+    uint8_t data[400];
+    size_t size;
+    assert_true(NVS_RetrieveBlob("Blob6", data, sizeof(data), &size));
+    assert_false(NVS_RetrieveBlob(keys[0], data, sizeof(data), &size));
+}
+
+static void test_NVS_Ring_WearLeveling(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    flash_erase_all_pages();
+    NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_RING_PAGES);
+
+    /* Static data is moved along as the oldest page is reclaimed. */
+    static uint8_t blob[500];
+    memset(blob, 0x5A, sizeof(blob));
+    assert_true(NVS_StoreBlob("Static", blob, sizeof(blob)));
+
+    for (size_t i = 0; i < 3000; ++i)
+    {
+        assert_true(NVS_Store("Counter", i));
+        NVS_Process();
+    }
+
+    struct nvs_statistics_t statistics;
+    NVS_GetStatistics(&statistics);
+    assert_true(number_of_page_erases > 40);
+    assert_true(statistics.max_erase_count - statistics.min_erase_count <= 1);
+    assert_true(statistics.min_erase_count >= number_of_page_erases / NUMBER_OF_RING_PAGES - 1);
+    assert_int_equal(statistics.remaining_erase_cycles, 10000 - statistics.max_erase_count);
+
+    /* The erase counts are kept in flash. */
+    NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_RING_PAGES);
+    struct nvs_statistics_t new_statistics;
+    NVS_GetStatistics(&new_statistics);
+    assert_memory_equal(&new_statistics, &statistics, sizeof(statistics));
+
+    uint8_t data[sizeof(blob)];
+    size_t size;
+    assert_true(NVS_RetrieveBlob("Static", data, sizeof(data), &size));
+    assert_memory_equal(data, blob, sizeof(blob));
+    uint32_t value;
+    assert_true(NVS_Retrieve("Counter", &value));
+    assert_int_equal(value, 2999);
+}
+
+static void test_NVS_Ring_LegacyPages(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    /**
+     * Only the newest page was live, 'Bar' was removed after the last
+     * compaction and is only left on the old page.
+     */
+    const char *old_keys[] = {"Foo", "Bar"};
+    const uint32_t old_values[] = {1, 2};
+    WriteLegacyPage(0, 1, old_keys, old_values, ElementsIn(old_keys));
+    const char *keys[] = {"Foo", "Baz"};
+    const uint32_t values[] = {3, 4};
+    WriteLegacyPage(1, 2, keys, values, ElementsIn(keys));
+
+    NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+
+    uint32_t value;
+    assert_true(NVS_Retrieve("Foo", &value));
+    assert_int_equal(value, 3);
+    assert_true(NVS_Retrieve("Baz", &value));
+    assert_int_equal(value, 4);
+    assert_false(NVS_Retrieve("Bar", &value));
+
+    /* The legacy page is reclaimed like any other page. */
+    for (size_t i = 0; i < 70; ++i)
+    {
+        assert_true(NVS_Store("Foo", 100 + i));
+    }
+    assert_int_equal(number_of_page_erases, 2);
+
+    NVS_Init(FLASH_START_ADDRESS, NUMBER_OF_PAGES);
+    assert_true(NVS_Retrieve("Foo", &value));
+    assert_int_equal(value, 169);
+    assert_true(NVS_Retrieve("Baz", &value));
+    assert_int_equal(value, 4);
+    assert_false(NVS_Retrieve("Bar", &value));
+
+    struct nvs_statistics_t statistics;
+    NVS_GetStatistics(&statistics);
+    assert_int_equal(statistics.min_erase_count, 1);
+    assert_int_equal(statistics.max_erase_count, 1);
+}
+
+static void test_NVS_GetStatistics(void **state)
+{
+    will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    expect_assert_failure(NVS_GetStatistics(NULL));
+
+    struct nvs_statistics_t statistics;
+    NVS_GetStatistics(&statistics);
+    assert_int_equal(statistics.number_of_pages, NUMBER_OF_PAGES);
+    assert_int_equal(statistics.min_erase_count, 0);
+    assert_int_equal(statistics.max_erase_count, 0);
+    assert_int_equal(statistics.remaining_erase_cycles, 10000);
+    assert_int_equal(statistics.live_space, 0);
+    assert_int_equal(statistics.free_space, PAGE_SIZE - 12 - 20);
+
+    assert_true(NVS_Store("Foo", 10));
+    assert_true(NVS_Store("Foo", 20));
+    NVS_GetStatistics(&statistics);
+    assert_int_equal(statistics.live_space, 18);
+    assert_int_equal(statistics.free_space, PAGE_SIZE - 12 - 20 - 36);
+
+    /* All pages are erased on clear. */
+    assert_true(NVS_Clear());
+    NVS_GetStatistics(&statistics);
+    assert_int_equal(statistics.min_erase_count, 1);
+    assert_int_equal(statistics.max_erase_count, 1);
+    assert_int_equal(statistics.remaining_erase_cycles, 9999);
+    assert_int_equal(statistics.live_space, 0);
+}
+
 static void test_NVS_Clear(void **state)
 {
     will_return_ptr_maybe(Logging_GetLogger, dummy_logger);
@@ -388,6 +1051,14 @@ static void test_NVSCmd_Remove(void **state)
     assert_false(NVS_Retrieve(name, &value));
 }
 
+static void test_NVSCmd_PrintStatistics(void **state)
+{
+    will_return_uint_maybe(flash_get_status_flags, FLASH_SR_EOP);
+
+    assert_true(NVS_Store("Foo", 10));
+    assert_true(NVSCmd_PrintStatistics());
+}
+
 /////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -405,6 +1076,23 @@ int main(int argc, char *argv[])
         cmocka_unit_test_setup(test_NVS_RetrieveExistingValues, Setup),
         cmocka_unit_test_setup(test_NVS_PageFull, Setup),
         cmocka_unit_test_setup(test_NVS_PageWrapAround, Setup),
+        cmocka_unit_test_setup(test_NVS_KeyCollision, Setup),
+        cmocka_unit_test_setup(test_NVS_ManyKeys, Setup),
+        cmocka_unit_test_setup(test_NVS_Store_MaxStoreTime, Setup),
+        cmocka_unit_test_setup(test_NVS_Process_Idle, Setup),
+        cmocka_unit_test_setup(test_NVS_Process_Compaction, Setup),
+        cmocka_unit_test_setup(test_NVS_Process_ChangesDuringCompaction, Setup),
+        cmocka_unit_test_setup(test_NVS_Process_InterruptedCompaction, Setup),
+        cmocka_unit_test_setup(test_NVS_Process_PowerLossDuringCompaction, Setup),
+        cmocka_unit_test(test_NVS_Blob_Invalid),
+        cmocka_unit_test_setup(test_NVS_StoreAndRetrieveBlob, Setup),
+        cmocka_unit_test_setup(test_NVS_Blob_CorruptPayload, Setup),
+        cmocka_unit_test_setup(test_NVS_Blob_Compaction, Setup),
+        cmocka_unit_test_setup(test_NVS_Blob_StorageFull, Setup),
+        cmocka_unit_test_setup(test_NVS_Ring_LiveDataOnSeveralPages, Setup),
+        cmocka_unit_test_setup(test_NVS_Ring_WearLeveling, Setup),
+        cmocka_unit_test_setup(test_NVS_Ring_LegacyPages, Setup),
+        cmocka_unit_test_setup(test_NVS_GetStatistics, Setup),
         cmocka_unit_test_setup(test_NVS_Clear, Setup),
         cmocka_unit_test_setup(test_NVS_ClearFailed, Setup)
     };
@@ -414,7 +1102,8 @@ int main(int argc, char *argv[])
         cmocka_unit_test(test_NVSCmd_Store_InvalidFormat),
         cmocka_unit_test_setup(test_NVSCmd_Store, Setup),
         cmocka_unit_test(test_NVSCmd_Remove_InvalidFormat),
-        cmocka_unit_test(test_NVSCmd_Remove)
+        cmocka_unit_test(test_NVSCmd_Remove),
+        cmocka_unit_test_setup(test_NVSCmd_PrintStatistics, Setup)
     };
 
     if (argc >= 2)
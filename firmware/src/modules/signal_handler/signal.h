@@ -59,6 +59,7 @@ struct signal_t
 {
     enum signal_id_t id;
     void *data_p;
+    uint32_t timestamp; /* Reception time of the CAN frame carrying the signal. */
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -32,6 +32,7 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #include "candb.h"
 #include "fifo.h"
 #include "system_monitor.h"
+#include "device_monitoring.h"
 #include "signal_handler.h"
 
 //////////////////////////////////////////////////////////////////////////
@@ -43,13 +44,18 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 #define SIGH_LOGGER_DEBUG_LEVEL LOGGING_INFO
 #endif
 
-#define FRAME_BUFFER_SIZE 5
+#define FRAME_BUFFER_SIZE 8
 #define MAX_NUMBER_OF_HANDLERS 6
 
+/* CAN interface ID of a generated message, flagged when the database defines it as 29-bit. */
+#define CANDB_ID(msg) ((uint32_t)(msg##_FRAME_ID) | ((msg##_IS_EXTENDED) ? CANINTERFACE_EXTENDED_ID_FLAG : 0))
+
 //////////////////////////////////////////////////////////////////////////
 //TYPE DEFINITIONS
 //////////////////////////////////////////////////////////////////////////
 
+FIFO_DEFINE(FrameFIFO, struct can_frame_t, FRAME_BUFFER_SIZE)
+
 struct handler_t
 {
     enum signal_id_t id;
@@ -59,8 +65,7 @@ struct handler_t
 struct module_t
 {
     logging_logger_t *logger;
-    struct can_frame_t frame_buffer[FRAME_BUFFER_SIZE];
-    struct fifo_t frame_fifo;
+    struct FrameFIFO_t frame_fifo;
     struct handler_t handlers[MAX_NUMBER_OF_HANDLERS];
     size_t number_of_handlers;
     uint32_t watchdog_handle;
@@ -86,7 +91,7 @@ static void DistributeSignal(struct signal_t *signal_p);
 void SignalHandler_Init(void)
 {
     module = (__typeof__(module)) {0};
-    module.frame_fifo = FIFO_New(module.frame_buffer);
+    FrameFIFO_Init(&module.frame_fifo);
     module.watchdog_handle = SystemMonitor_GetWatchdogHandle();
     module.logger = Logging_GetLogger(SIGH_LOGGER_NAME);
     Logging_SetLevel(module.logger, SIGH_LOGGER_DEBUG_LEVEL);
@@ -97,14 +102,14 @@ void SignalHandler_Init(void)
 void SignalHandler_Process(void)
 {
     struct can_frame_t frame;
-    bool status = FIFO_Pop(&module.frame_fifo, &frame);
+    bool status = FrameFIFO_Pop(&module.frame_fifo, &frame);
     if (status)
     {
         Logging_Debug(module.logger, "Process: {id: 0x%02x}", frame.id);
 
         switch (frame.id)
         {
-            case CANDB_CONTROLLER_MSG_MOTOR_CONTROL_FRAME_ID:
+            case CANDB_ID(CANDB_CONTROLLER_MSG_MOTOR_CONTROL):
                 HandleMotorControlFrame(&frame);
                 break;
 
@@ -133,9 +138,9 @@ void SignalHandler_Listener(const struct can_frame_t *frame_p, __attribute__((un
 {
     assert(frame_p != NULL);
 
-    if (frame_p->id == CANDB_CONTROLLER_MSG_MOTOR_CONTROL_FRAME_ID)
+    if (frame_p->id == CANDB_ID(CANDB_CONTROLLER_MSG_MOTOR_CONTROL))
     {
-        bool status = FIFO_Push(&module.frame_fifo, frame_p);
+        bool status = FrameFIFO_Push(&module.frame_fifo, frame_p);
         if (!status)
         {
             Logging_Warning(module.logger, "Buffer full, discard frame: {id: 0x%02x}", frame_p->id);
@@ -166,7 +171,7 @@ bool SignalHandler_SendMotorStatus(int16_t rpm1, int16_t current1, uint8_t msg_s
         const int32_t pack_status = candb_motor_msg_status_pack(data, &msg, sizeof(data));
         assert(pack_status != -EINVAL);
 
-        if (!CANInterface_Transmit(CANDB_MOTOR_MSG_STATUS_FRAME_ID, data, CANDB_MOTOR_MSG_STATUS_LENGTH))
+        if (!CANInterface_Transmit(CANDB_ID(CANDB_MOTOR_MSG_STATUS), data, CANDB_MOTOR_MSG_STATUS_LENGTH))
         {
             Logging_Warning(module.logger, "Failed to send msg: {id: 0x%02x}", CANDB_MOTOR_MSG_STATUS_FRAME_ID);
             status = false;
@@ -193,7 +198,10 @@ static void HandleMotorControlFrame(const struct can_frame_t *frame_p)
     const int32_t status = candb_controller_msg_motor_control_unpack(&msg, frame_p->data, frame_p->size);
     if (status != -EINVAL)
     {
+        DeviceMonitoring_RecordLatency(DEV_MON_LATENCY_SIGNAL, frame_p->timestamp);
+
         struct signal_t control_signal;
+        control_signal.timestamp = frame_p->timestamp;
 
         control_signal.id = SIGNAL_CONTROL_RPM1;
         control_signal.data_p = &msg.motor_control_sig_rpm1;
@@ -130,7 +130,7 @@ static void test_SignalHandler_Process(void **state)
 
     /* Try to fill the frame buffer with unsupported frames. */
     frame.id = 0x00;
-    const size_t max_number_of_frames = 5;
+    const size_t max_number_of_frames = 8;
     for (size_t i = 0; i < max_number_of_frames; ++i)
     {
         SignalHandler_Listener(&frame, NULL);
@@ -160,7 +160,7 @@ static void test_SignalHandler_Process_FullFIFO(void **state)
     candb_controller_msg_motor_control_pack(frame.data, &msg, sizeof(frame.data));
 
     /* Fill the frame buffer. */
-    const size_t max_number_of_frames = 5;
+    const size_t max_number_of_frames = 8;
     for (size_t i = 0; i < max_number_of_frames; ++i)
     {
         SignalHandler_Listener(&frame, NULL);
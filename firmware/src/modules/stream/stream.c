@@ -45,6 +45,9 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //LOCAL FUNCTION PROTOTYPES
 //////////////////////////////////////////////////////////////////////////
 
+static inline size_t Min(size_t a, size_t b);
+static inline size_t Advance(const struct stream_t *self_p, size_t offset, size_t length);
+
 //////////////////////////////////////////////////////////////////////////
 //FUNCTIONS
 //////////////////////////////////////////////////////////////////////////
@@ -68,12 +71,12 @@ size_t Stream_Write(struct stream_t *self_p, const void *source_p, size_t length
     const size_t available_space = Stream_GetAvailableSpace(self_p);
     const size_t number_of_bytes = available_space >= length ? length : available_space;
 
-    for (size_t i = 0; i < number_of_bytes; ++i)
-    {
-        self_p->data_p[self_p->head % self_p->size] = ((const uint8_t *)source_p)[i];
-        ++self_p->head;
-    }
+    /* Copied in at most two parts, up to the end of the buffer and from the start. */
+    const size_t first_length = Min(number_of_bytes, self_p->size - self_p->head);
+    memcpy(&self_p->data_p[self_p->head], source_p, first_length);
+    memcpy(self_p->data_p, (const uint8_t *)source_p + first_length, number_of_bytes - first_length);
 
+    self_p->head = Advance(self_p, self_p->head, number_of_bytes);
     self_p->number_of_bytes += number_of_bytes;
 
     return number_of_bytes;
@@ -86,12 +89,33 @@ size_t Stream_Read(struct stream_t *self_p, void *destination_p, size_t length)
 
     const size_t number_of_bytes = self_p->number_of_bytes >= length ? length : self_p->number_of_bytes;
 
-    for (size_t i = 0; i < number_of_bytes; ++i)
-    {
-        ((uint8_t *)destination_p)[i] = self_p->data_p[self_p->tail % self_p->size];
-        ++self_p->tail;
-    }
+    /* Copied out in at most two parts, up to the end of the buffer and from the start. */
+    const size_t first_length = Min(number_of_bytes, self_p->size - self_p->tail);
+    memcpy(destination_p, &self_p->data_p[self_p->tail], first_length);
+    memcpy((uint8_t *)destination_p + first_length, self_p->data_p, number_of_bytes - first_length);
+
+    self_p->tail = Advance(self_p, self_p->tail, number_of_bytes);
+    self_p->number_of_bytes -= number_of_bytes;
+
+    return number_of_bytes;
+}
+
+size_t Stream_PeekContiguous(const struct stream_t *self_p, const void **data_pp)
+{
+    assert(self_p != NULL);
+    assert(data_pp != NULL);
+
+    *data_pp = &self_p->data_p[self_p->tail];
+    return Min(self_p->number_of_bytes, self_p->size - self_p->tail);
+}
+
+size_t Stream_Skip(struct stream_t *self_p, size_t length)
+{
+    assert(self_p != NULL);
+
+    const size_t number_of_bytes = self_p->number_of_bytes >= length ? length : self_p->number_of_bytes;
 
+    self_p->tail = Advance(self_p, self_p->tail, number_of_bytes);
     self_p->number_of_bytes -= number_of_bytes;
 
     return number_of_bytes;
@@ -119,3 +143,28 @@ void Stream_Clear(struct stream_t *self_p)
     self_p->tail = 0;
     self_p->number_of_bytes = 0;
 }
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static inline size_t Min(size_t a, size_t b)
+{
+    return a < b ? a : b;
+}
+
+/**
+ * Head and tail are kept within the buffer, so they never overflow and
+ * no division is needed to wrap them. The length is at most the buffer
+ * size, a single subtraction is enough.
+ */
+static inline size_t Advance(const struct stream_t *self_p, size_t offset, size_t length)
+{
+    offset += length;
+    if (offset >= self_p->size)
+    {
+        offset -= self_p->size;
+    }
+
+    return offset;
+}
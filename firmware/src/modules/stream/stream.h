@@ -47,8 +47,8 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 struct stream_t
 {
     uint8_t *data_p;
-    size_t head;
-    size_t tail;
+    size_t head; /* Write offset, always less than 'size'. */
+    size_t tail; /* Read offset, always less than 'size'. */
     size_t size;
     size_t number_of_bytes;
 };
@@ -92,6 +92,30 @@ size_t Stream_Write(struct stream_t *self_p, const void *source_p, size_t length
  */
 size_t Stream_Read(struct stream_t *self_p, void *destination_p, size_t length);
 
+/**
+ * Get the longest contiguous region of unread data without consuming it.
+ *
+ * The region starts at the oldest unread byte and ends at the end of the
+ * stream buffer or the newest byte, whichever comes first. Data that has
+ * wrapped around is returned by the next call after 'Stream_Skip'.
+ *
+ * @param self_p Pointer to stream instance.
+ * @param data_pp Pointer to where a pointer to the region is stored.
+ *
+ * @return Number of bytes in the region, 0 means that no data was available.
+ */
+size_t Stream_PeekContiguous(const struct stream_t *self_p, const void **data_pp);
+
+/**
+ * Discard data from stream without copying it.
+ *
+ * @param self_p Pointer to stream instance.
+ * @param length Max number of bytes to discard.
+ *
+ * @return Number of bytes discarded.
+ */
+size_t Stream_Skip(struct stream_t *self_p, size_t length);
+
 /**
  * Get the available space in the stream.
  *
@@ -117,6 +117,103 @@ void test_Stream_Read(void **state)
     assert_memory_equal(data_read, data_write + sizeof(data_read), 6);
 }
 
+void test_Stream_WrapAround(void **state)
+{
+    /* A size that isn't a power of two, with chunks that don't divide it. */
+    struct stream_t odd_stream;
+    uint8_t odd_buffer[13];
+    Stream_Init(&odd_stream, odd_buffer, sizeof(odd_buffer));
+
+    uint8_t data_write[sizeof(odd_buffer)];
+    uint8_t data_read[sizeof(odd_buffer)];
+    uint8_t value = 0;
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        const size_t length = (i % sizeof(odd_buffer)) + 1;
+        for (size_t j = 0; j < length; ++j)
+        {
+            data_write[j] = value++;
+        }
+
+        assert_int_equal(Stream_Write(&odd_stream, data_write, length), length);
+        assert_int_equal(Stream_GetAvailableSpace(&odd_stream), sizeof(odd_buffer) - length);
+        assert_int_equal(Stream_Read(&odd_stream, data_read, sizeof(data_read)), length);
+        assert_memory_equal(data_read, data_write, length);
+        assert_true(odd_stream.head < sizeof(odd_buffer));
+        assert_true(odd_stream.tail < sizeof(odd_buffer));
+    }
+
+    /* Fill the whole buffer starting from the middle. */
+    Stream_Write(&odd_stream, data_write, 5);
+    Stream_Skip(&odd_stream, 5);
+    for (size_t j = 0; j < sizeof(data_write); ++j)
+    {
+        data_write[j] = (uint8_t)j;
+    }
+    assert_int_equal(Stream_Write(&odd_stream, data_write, sizeof(data_write)), sizeof(data_write));
+    assert_int_equal(Stream_GetAvailableSpace(&odd_stream), 0);
+    assert_int_equal(Stream_Read(&odd_stream, data_read, sizeof(data_read)), sizeof(data_read));
+    assert_memory_equal(data_read, data_write, sizeof(data_write));
+}
+
+void test_Stream_PeekContiguous_Invalid(void **state)
+{
+    const void *data_p;
+    expect_assert_failure(Stream_PeekContiguous(NULL, &data_p));
+    expect_assert_failure(Stream_PeekContiguous(&stream, NULL));
+}
+
+void test_Stream_PeekContiguous(void **state)
+{
+    const uint8_t data_write[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    const void *data_p;
+
+    assert_int_equal(Stream_PeekContiguous(&stream, &data_p), 0);
+
+    /* Peek does not consume any data. */
+    Stream_Write(&stream, data_write, 10);
+    assert_int_equal(Stream_PeekContiguous(&stream, &data_p), 10);
+    assert_ptr_equal(data_p, buffer);
+    assert_int_equal(Stream_PeekContiguous(&stream, &data_p), 10);
+    assert_memory_equal(data_p, data_write, 10);
+
+    /* The region ends at the end of the buffer when the data has wrapped around. */
+    Stream_Skip(&stream, 8);
+    Stream_Write(&stream, data_write, 12);
+    assert_int_equal(Stream_PeekContiguous(&stream, &data_p), sizeof(buffer) - 8);
+    assert_ptr_equal(data_p, buffer + 8);
+    const uint8_t expected_data[] = {8, 9, 0, 1, 2, 3, 4, 5};
+    assert_memory_equal(data_p, expected_data, sizeof(expected_data));
+
+    Stream_Skip(&stream, sizeof(buffer) - 8);
+    assert_int_equal(Stream_PeekContiguous(&stream, &data_p), 6);
+    assert_ptr_equal(data_p, buffer);
+    assert_memory_equal(data_p, data_write + 6, 6);
+}
+
+void test_Stream_Skip_Invalid(void **state)
+{
+    expect_assert_failure(Stream_Skip(NULL, 1));
+}
+
+void test_Stream_Skip(void **state)
+{
+    const uint8_t data_write[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    uint8_t data_read[10];
+
+    assert_int_equal(Stream_Skip(&stream, 1), 0);
+
+    Stream_Write(&stream, data_write, sizeof(data_write));
+    assert_int_equal(Stream_Skip(&stream, 4), 4);
+    assert_int_equal(Stream_GetAvailableSpace(&stream), sizeof(buffer) - 6);
+    assert_int_equal(Stream_Read(&stream, data_read, 2), 2);
+    assert_memory_equal(data_read, data_write + 4, 2);
+
+    assert_int_equal(Stream_Skip(&stream, sizeof(data_write)), 4);
+    assert_false(Stream_HasData(&stream));
+}
+
 void test_Stream_GetAvailableSpace_Invalid(void **state)
 {
     expect_assert_failure(Stream_GetAvailableSpace(NULL));
@@ -192,6 +289,11 @@ int main(int argc, char *argv[])
         cmocka_unit_test_setup(test_Stream_Write, Setup),
         cmocka_unit_test_setup(test_Stream_Read_Invalid, Setup),
         cmocka_unit_test_setup(test_Stream_Read, Setup),
+        cmocka_unit_test_setup(test_Stream_WrapAround, Setup),
+        cmocka_unit_test_setup(test_Stream_PeekContiguous_Invalid, Setup),
+        cmocka_unit_test_setup(test_Stream_PeekContiguous, Setup),
+        cmocka_unit_test_setup(test_Stream_Skip_Invalid, Setup),
+        cmocka_unit_test_setup(test_Stream_Skip, Setup),
         cmocka_unit_test_setup(test_Stream_GetAvailableSpace_Invalid, Setup),
         cmocka_unit_test_setup(test_Stream_GetAvailableSpace, Setup),
         cmocka_unit_test_setup(test_Stream_HasData_Invalid, Setup),
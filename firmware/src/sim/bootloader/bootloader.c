@@ -0,0 +1,201 @@
+/**
+ * @file   bootloader.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Bootloader stage of the simulator.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libopencm3/stm32/rcc.h>
+#include "board.h"
+#include "serial.h"
+#include "systime.h"
+#include "logging.h"
+#include "image.h"
+#include "can_interface.h"
+#include "flash.h"
+#include "isotp.h"
+#include "firmware_manager.h"
+#include "nvcom.h"
+#include "sim.h"
+#include "bootloader.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define BOOTLOADER_LOGGER_NAME "Boot"
+#ifndef BOOTLOADER_LOGGER_DEBUG_LEVEL
+#define BOOTLOADER_LOGGER_DEBUG_LEVEL LOGGING_INFO
+#endif
+
+#define MAX_IDLE_TIME_MS 1
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct module_t
+{
+    logging_logger_t *logger;
+    uint32_t status_led_last_update;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct module_t module;
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static void UpdateRestartInformation(void);
+static void UpdateFirmware(void);
+static bool IsUpdateRequested(void);
+static void ClearUpdateRequest(void);
+static inline bool IsWatchdogRestart(void);
+static void UpdateStatusLED(void);
+static void Reset(void);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void Bootloader_Init(void)
+{
+    Board_Init();
+    SysTime_Init();
+    Serial_Init(BAUD_RATE);
+    Logging_Init(SysTime_GetSystemTime);
+    NVCom_Init();
+    Image_Init();
+
+    module.logger = Logging_GetLogger(BOOTLOADER_LOGGER_NAME);
+    Logging_SetLevel(module.logger, BOOTLOADER_LOGGER_DEBUG_LEVEL);
+    Logging_Info(module.logger, "Bootloader ready");
+}
+
+/**
+ * The simulator binary is the application, so instead of jumping to the
+ * image in flash this returns to start it. A downloaded image is stored in
+ * the flash image file but never executed.
+ */
+void Bootloader_Start(void)
+{
+    UpdateRestartInformation();
+
+    if (IsUpdateRequested())
+    {
+        Logging_Info(module.logger, "Firmware update requested");
+        UpdateFirmware();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static void UpdateRestartInformation(void)
+{
+    struct nvcom_data_t *data_p = NVCom_GetData();
+
+    if (data_p->number_of_restarts < UINT16_MAX)
+    {
+        data_p->number_of_restarts += 1;
+    }
+    data_p->reset_flags = Board_GetResetFlags();
+
+    if (IsWatchdogRestart())
+    {
+        if (data_p->number_of_watchdog_restarts < UINT16_MAX)
+        {
+            data_p->number_of_watchdog_restarts += 1;
+        }
+    }
+    else
+    {
+        data_p->number_of_watchdog_restarts = 0;
+    }
+
+    NVCom_SetData(data_p);
+}
+
+static void UpdateFirmware(void)
+{
+    /* Zero (cold restart) selects the default bit rate. */
+    const struct nvcom_data_t *data_p = NVCom_GetData();
+    CANInterface_Init(data_p->can_bit_rate);
+    Flash_Init();
+    ISOTP_Init();
+    FirmwareManager_Init(Reset);
+
+    Logging_Info(module.logger, "Wait for new firmware...");
+    while (FirmwareManager_Active())
+    {
+        CANInterface_Process();
+        ISOTP_Proccess();
+        FirmwareManager_Process();
+        UpdateStatusLED();
+        Sim_Wait(MAX_IDLE_TIME_MS);
+    }
+}
+
+static bool IsUpdateRequested(void)
+{
+    const struct nvcom_data_t *data_p = NVCom_GetData();
+    return data_p->number_of_restarts > 0 && data_p->request_firmware_update;
+}
+
+static void ClearUpdateRequest(void)
+{
+    struct nvcom_data_t *data_p = NVCom_GetData();
+    data_p->request_firmware_update = false;
+    NVCom_SetData(data_p);
+}
+
+static inline bool IsWatchdogRestart(void)
+{
+    const uint32_t reset_flags = Board_GetResetFlags();
+
+    return (bool)(reset_flags & RCC_CSR_IWDGRSTF);
+}
+
+static void UpdateStatusLED(void)
+{
+    const uint32_t status_led_period_ms = FirmwareManager_DownloadActive() ? 50 : 1000;
+
+    if (SysTime_GetDifference(module.status_led_last_update) >= status_led_period_ms)
+    {
+        Board_ToggleStatusLED();
+        module.status_led_last_update = SysTime_GetSystemTime();
+    }
+}
+
+static void Reset(void)
+{
+    ClearUpdateRequest();
+    Board_Reset();
+}
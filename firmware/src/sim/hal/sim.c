@@ -0,0 +1,235 @@
+/**
+ * @file   sim.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Host environment for the simulator.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libopencm3/cm3/vector.h>
+#include <libopencm3/stm32/rcc.h>
+#include "utility.h"
+#include "sim.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define MAX_NUMBER_OF_POLL_DESCRIPTORS 4
+#define RESET_ENVIRONMENT_VARIABLE "CANDRIVE_SIM_RESET"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct module_t
+{
+    struct sim_config_t config;
+    char *const *argv;
+    uint32_t reset_flags;
+    struct pollfd poll_descriptors[MAX_NUMBER_OF_POLL_DESCRIPTORS];
+    size_t number_of_poll_descriptors;
+};
+
+/* Same layout as the build ID note provided by the target linker script. */
+struct note_section_t
+{
+    uint32_t namesz;
+    uint32_t descsz;
+    uint32_t type;
+    uint8_t data[4];
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+/* Referenced by the image header, there is no vector table on the host. */
+vector_table_t vector_table;
+
+/* An empty build ID, the host linker does not expose its own note. */
+const struct note_section_t note_build_id =
+{
+    .namesz = 4,
+    .descsz = 0,
+    .type = 3,
+    .data = "GNU"
+};
+
+static struct module_t module;
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static void MapImage(const char *path);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void Sim_Init(const struct sim_config_t *config_p, char *const argv[])
+{
+    assert(config_p != NULL);
+    assert(config_p->can_interface != NULL);
+    assert(config_p->image_path != NULL);
+
+    module = (__typeof__(module)) {0};
+    module.config = *config_p;
+    module.argv = argv;
+
+    if (getenv(RESET_ENVIRONMENT_VARIABLE) != NULL)
+    {
+        module.reset_flags = RCC_CSR_SFTRSTF;
+        unsetenv(RESET_ENVIRONMENT_VARIABLE);
+    }
+    else
+    {
+        module.reset_flags = RCC_CSR_PORRSTF | RCC_CSR_PINRSTF;
+    }
+
+    MapImage(module.config.image_path);
+}
+
+const char *Sim_GetCANInterface(void)
+{
+    return module.config.can_interface;
+}
+
+uintptr_t Sim_GetBackupMemoryAddress(void)
+{
+    return SIM_FLASH_START + SIM_FLASH_SIZE;
+}
+
+bool Sim_IsFlashAddress(uint32_t address, size_t length)
+{
+    return (address >= SIM_FLASH_START) &&
+           (length <= SIM_FLASH_SIZE) &&
+           (address - SIM_FLASH_START <= SIM_FLASH_SIZE - length);
+}
+
+void Sim_AddPollDescriptor(int fd)
+{
+    assert(module.number_of_poll_descriptors < ElementsIn(module.poll_descriptors));
+
+    module.poll_descriptors[module.number_of_poll_descriptors] = (struct pollfd) {.fd = fd, .events = POLLIN};
+    ++module.number_of_poll_descriptors;
+}
+
+void Sim_RemovePollDescriptor(int fd)
+{
+    for (size_t i = 0; i < module.number_of_poll_descriptors; ++i)
+    {
+        if (module.poll_descriptors[i].fd == fd)
+        {
+            --module.number_of_poll_descriptors;
+            module.poll_descriptors[i] = module.poll_descriptors[module.number_of_poll_descriptors];
+            break;
+        }
+    }
+}
+
+void Sim_Wait(uint32_t timeout_ms)
+{
+    if ((poll(module.poll_descriptors, module.number_of_poll_descriptors, (int)timeout_ms) < 0) && (errno != EINTR))
+    {
+        perror("poll");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void Sim_Reset(void)
+{
+    fflush(stdout);
+    setenv(RESET_ENVIRONMENT_VARIABLE, "1", 1);
+    execv("/proc/self/exe", module.argv);
+
+    perror("execv");
+    exit(EXIT_FAILURE);
+}
+
+uint32_t Sim_GetResetFlags(void)
+{
+    return module.reset_flags;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+/**
+ * The image is mapped at the flash address used on target so that modules
+ * reading flash through pointers, e.g. NVS and image, work unmodified.
+ */
+static void MapImage(const char *path)
+{
+    const size_t image_size = SIM_FLASH_SIZE + SIM_BACKUP_MEMORY_SIZE;
+
+    const int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat image_stat;
+    if (fstat(fd, &image_stat) != 0)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    const bool new_image = image_stat.st_size == 0;
+    if (ftruncate(fd, (off_t)image_size) != 0)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    void *image_p = mmap((void *)SIM_FLASH_START, image_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    if (image_p != (void *)SIM_FLASH_START)
+    {
+        fprintf(stderr, "Failed to map %s at 0x%lx\n", path, SIM_FLASH_START);
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    if (new_image)
+    {
+        memset(image_p, 0xFF, SIM_FLASH_SIZE);
+    }
+}
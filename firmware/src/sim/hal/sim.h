@@ -0,0 +1,190 @@
+/**
+ * @file   sim.h
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Host environment for the simulator.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef SIM_H_
+#define SIM_H_
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+/* The flash image is mapped at the same address as the flash on target. */
+#define SIM_FLASH_START 0x08000000UL
+#define SIM_FLASH_SIZE 0x20000UL
+#define SIM_FLASH_PAGE_SIZE 0x400UL
+
+/* The backup domain is stored after the flash so it survives a reset. */
+#define SIM_BACKUP_MEMORY_SIZE 0x1000UL
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct sim_config_t
+{
+    const char *can_interface;
+    const char *image_path;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+/**
+ * Initialize the host environment.
+ *
+ * The flash image is created if it does not exist, a new image is erased.
+ * Exits the process if the image can't be mapped.
+ *
+ * @param config_p Pointer to configuration.
+ * @param argv Arguments the process was started with, used on reset.
+ */
+void Sim_Init(const struct sim_config_t *config_p, char *const argv[]);
+
+/**
+ * Get the name of the SocketCAN interface to use.
+ *
+ * @return Interface name, e.g. "vcan0".
+ */
+const char *Sim_GetCANInterface(void);
+
+/**
+ * Get the address of the emulated backup domain.
+ *
+ * @return Address.
+ */
+uintptr_t Sim_GetBackupMemoryAddress(void);
+
+/**
+ * Check if an address range is inside the flash image.
+ *
+ * @param address Start address.
+ * @param length Length in bytes.
+ *
+ * @return True if inside, otherwise false.
+ */
+bool Sim_IsFlashAddress(uint32_t address, size_t length);
+
+/**
+ * Add a file descriptor that wakes up the main loop when readable.
+ *
+ * @param fd File descriptor.
+ */
+void Sim_AddPollDescriptor(int fd);
+
+/**
+ * Remove a file descriptor added with 'Sim_AddPollDescriptor'.
+ *
+ * @param fd File descriptor.
+ */
+void Sim_RemovePollDescriptor(int fd);
+
+/**
+ * Sleep until any poll descriptor is readable or the timeout expires.
+ *
+ * @param timeout_ms Timeout in milliseconds.
+ */
+void Sim_Wait(uint32_t timeout_ms);
+
+/**
+ * Reset the device by restarting the process with the same arguments.
+ */
+void Sim_Reset(void);
+
+/**
+ * Get the reset flags, formatted as the RCC_CSR register.
+ *
+ * @return Reset flags.
+ */
+uint32_t Sim_GetResetFlags(void);
+
+/**
+ * Get the output state of GPIO pins.
+ *
+ * @param port GPIO port.
+ * @param gpios GPIO pins.
+ *
+ * @return True if any of the pins are set.
+ */
+bool SimGPIO_Get(uint32_t port, uint16_t gpios);
+
+/**
+ * Get the PWM duty of a timer output compare channel.
+ *
+ * @param timer Timer peripheral.
+ * @param oc_id Output compare channel, see 'enum tim_oc_id'.
+ *
+ * @return Duty in per mille, zero if the output or counter is disabled.
+ */
+uint32_t SimTimer_GetDuty(uint32_t timer, uint32_t oc_id);
+
+/**
+ * Get the auto-reload value of a timer.
+ *
+ * @param timer Timer peripheral.
+ *
+ * @return Period.
+ */
+uint32_t SimTimer_GetPeriod(uint32_t timer);
+
+/**
+ * Get the encoder count of the motor connected to a timer.
+ *
+ * @param timer Encoder timer peripheral.
+ * @param count_p Pointer to where the count is stored.
+ *
+ * @return True if a motor is connected to the timer, otherwise false.
+ */
+bool SimMotor_GetEncoderCount(uint32_t timer, uint32_t *count_p);
+
+/**
+ * Reset the encoder count of the motor connected to a timer.
+ *
+ * @param timer Encoder timer peripheral.
+ * @param count New count.
+ */
+void SimMotor_SetEncoderCount(uint32_t timer, uint32_t count);
+
+/**
+ * Get the current sense voltage of the motor connected to an ADC channel.
+ *
+ * @param channel ADC channel.
+ * @param voltage_p Pointer to where the voltage in mV is stored.
+ *
+ * @return True if a motor is connected to the channel, otherwise false.
+ */
+bool SimMotor_GetSenseVoltage(uint8_t channel, uint32_t *voltage_p);
+
+#endif
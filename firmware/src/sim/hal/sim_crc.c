@@ -0,0 +1,96 @@
+/**
+ * @file   sim_crc.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Software implementation of the CRC calculation unit.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stddef.h>
+#include <libopencm3/stm32/crc.h>
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define CRC_POLYNOMIAL 0x04C11DB7
+#define CRC_INITIAL_VALUE 0xFFFFFFFF
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static uint32_t crc_register = CRC_INITIAL_VALUE;
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void crc_reset(void)
+{
+    crc_register = CRC_INITIAL_VALUE;
+}
+
+/**
+ * CRC-32 over a full word, MSB first and without reflection or final XOR,
+ * as the STM32F1 CRC unit.
+ */
+uint32_t crc_calculate(uint32_t data)
+{
+    crc_register ^= data;
+    for (size_t i = 0; i < 32; ++i)
+    {
+        if (crc_register & 0x80000000)
+        {
+            crc_register = (crc_register << 1) ^ CRC_POLYNOMIAL;
+        }
+        else
+        {
+            crc_register <<= 1;
+        }
+    }
+
+    return crc_register;
+}
+
+uint32_t crc_calculate_block(uint32_t *datap, int size)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        crc_calculate(datap[i]);
+    }
+
+    return crc_register;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
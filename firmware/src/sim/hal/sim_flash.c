@@ -0,0 +1,140 @@
+/**
+ * @file   sim_flash.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Flash controller backed by the simulator image.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <libopencm3/stm32/flash.h>
+#include "sim.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct module_t
+{
+    bool locked;
+    uint32_t status_flags;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct module_t module = {.locked = true};
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static void ProgramHalfWord(uint32_t address, uint16_t data);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void flash_lock(void)
+{
+    module.locked = true;
+}
+
+void flash_unlock(void)
+{
+    module.locked = false;
+}
+
+uint32_t flash_get_status_flags(void)
+{
+    return module.status_flags;
+}
+
+void flash_clear_status_flags(void)
+{
+    module.status_flags = 0;
+}
+
+void flash_program_word(uint32_t address, uint32_t data)
+{
+    ProgramHalfWord(address, (uint16_t)data);
+    if (module.status_flags == FLASH_SR_EOP)
+    {
+        ProgramHalfWord(address + sizeof(uint16_t), (uint16_t)(data >> 16));
+    }
+}
+
+void flash_program_half_word(uint32_t address, uint16_t data)
+{
+    ProgramHalfWord(address, data);
+}
+
+void flash_erase_page(uint32_t page_address)
+{
+    assert(Sim_IsFlashAddress(page_address, SIM_FLASH_PAGE_SIZE));
+
+    if (module.locked)
+    {
+        module.status_flags = FLASH_SR_WRPRTERR;
+    }
+    else
+    {
+        const uintptr_t page_start = page_address & ~(SIM_FLASH_PAGE_SIZE - 1);
+        memset((void *)page_start, 0xFF, SIM_FLASH_PAGE_SIZE);
+        module.status_flags = FLASH_SR_EOP;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+/**
+ * Same rules as the flash controller, only erased half-words can be
+ * programmed, except with zero.
+ */
+static void ProgramHalfWord(uint32_t address, uint16_t data)
+{
+    assert(Sim_IsFlashAddress(address, sizeof(data)));
+
+    uint16_t *destination_p = (uint16_t *)(uintptr_t)address;
+    if (module.locked)
+    {
+        module.status_flags = FLASH_SR_WRPRTERR;
+    }
+    else if ((*destination_p != 0xFFFF) && (data != 0))
+    {
+        module.status_flags = FLASH_SR_PGERR;
+    }
+    else
+    {
+        *destination_p = data;
+        module.status_flags = FLASH_SR_EOP;
+    }
+}
@@ -0,0 +1,108 @@
+/**
+ * @file   sim_gpio.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  GPIO ports kept in memory.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdint.h>
+#include <libopencm3/stm32/gpio.h>
+#include "utility.h"
+#include "sim.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define NUMBER_OF_PORTS 7
+#define PORT_OFFSET 0x400
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static uint16_t output_data[NUMBER_OF_PORTS];
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static inline uint16_t *GetPort(uint32_t port);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void gpio_set_mode(uint32_t gpioport __attribute__((unused)),
+                   uint8_t mode __attribute__((unused)),
+                   uint8_t cnf __attribute__((unused)),
+                   uint16_t gpios __attribute__((unused)))
+{
+}
+
+void gpio_primary_remap(uint32_t swjenable __attribute__((unused)), uint32_t maps __attribute__((unused)))
+{
+}
+
+void gpio_set(uint32_t gpioport, uint16_t gpios)
+{
+    *GetPort(gpioport) |= gpios;
+}
+
+void gpio_clear(uint32_t gpioport, uint16_t gpios)
+{
+    *GetPort(gpioport) &= (uint16_t)~gpios;
+}
+
+void gpio_toggle(uint32_t gpioport, uint16_t gpios)
+{
+    *GetPort(gpioport) ^= gpios;
+}
+
+/* Inputs read back the pull-up/down selected with 'gpio_set'/'gpio_clear'. */
+uint16_t gpio_get(uint32_t gpioport, uint16_t gpios)
+{
+    return *GetPort(gpioport) & gpios;
+}
+
+bool SimGPIO_Get(uint32_t port, uint16_t gpios)
+{
+    return gpio_get(port, gpios) != 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static inline uint16_t *GetPort(uint32_t port)
+{
+    const uint32_t index = (port - GPIO_PORT_A_BASE) / PORT_OFFSET;
+    assert(index < ElementsIn(output_data));
+
+    return &output_data[index];
+}
@@ -0,0 +1,105 @@
+/**
+ * @file   sim_memfault.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Device monitoring backend without the Memfault SDK.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "memfault/components.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+/**
+ * The Memfault SDK and its port depend on the Cortex-M fault handling, the
+ * simulator accepts the metrics and has no data to export.
+ */
+int memfault_platform_boot(void)
+{
+    return 0;
+}
+
+void memfault_reboot_tracking_mark_reset_imminent(eMemfaultRebootReason reboot_reason __attribute__((unused)),
+        const sMfltRebootTrackingRegInfo *reg __attribute__((unused)))
+{
+}
+
+int memfault_metrics_heartbeat_add(MemfaultMetricId key __attribute__((unused)), int32_t amount __attribute__((unused)))
+{
+    return 0;
+}
+
+int memfault_metrics_heartbeat_set_unsigned(MemfaultMetricId key __attribute__((unused)),
+        uint32_t unsigned_value __attribute__((unused)))
+{
+    return 0;
+}
+
+int memfault_metrics_heartbeat_timer_start(MemfaultMetricId key __attribute__((unused)))
+{
+    return 0;
+}
+
+int memfault_metrics_heartbeat_timer_stop(MemfaultMetricId key __attribute__((unused)))
+{
+    return 0;
+}
+
+void memfault_data_export_dump_chunks(void)
+{
+    printf("No Memfault data in the simulator\r\n");
+}
+
+bool memfault_packetizer_get_chunk(void *buf __attribute__((unused)), size_t *buf_len __attribute__((unused)))
+{
+    return false;
+}
+
+void memfault_packetizer_abort(void)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
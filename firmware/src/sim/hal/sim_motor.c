@@ -0,0 +1,196 @@
+/**
+ * @file   sim_motor.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Model of the motors connected to the board.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include "board.h"
+#include "config.h"
+#include "utility.h"
+#include "sim.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define MAX_NUMBER_OF_MOTORS 2
+#define TIME_CONSTANT_S 0.1
+#define BRAKE_TIME_CONSTANT_S 0.02
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct motor_model_t
+{
+    double rpm;
+    double target_rpm;
+    double position;
+    double last_update_time;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct motor_model_t motors[MAX_NUMBER_OF_MOTORS];
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static struct motor_model_t *GetMotorByEncoder(uint32_t timer, const struct board_motor_config_t **config_pp);
+static void UpdateModel(struct motor_model_t *motor_p, const struct board_motor_config_t *config_p);
+static double GetTime(void);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+bool SimMotor_GetEncoderCount(uint32_t timer, uint32_t *count_p)
+{
+    assert(count_p != NULL);
+
+    const struct board_motor_config_t *config_p;
+    struct motor_model_t *motor_p = GetMotorByEncoder(timer, &config_p);
+    if (motor_p != NULL)
+    {
+        UpdateModel(motor_p, config_p);
+
+        const double counts_per_revolution = (double)SimTimer_GetPeriod(timer) + 1.0;
+        const double count = fmod(motor_p->position * counts_per_revolution, counts_per_revolution);
+        *count_p = (uint32_t)((count < 0.0) ? count + counts_per_revolution : count);
+    }
+
+    return motor_p != NULL;
+}
+
+void SimMotor_SetEncoderCount(uint32_t timer, uint32_t count)
+{
+    const struct board_motor_config_t *config_p;
+    struct motor_model_t *motor_p = GetMotorByEncoder(timer, &config_p);
+    if (motor_p != NULL)
+    {
+        UpdateModel(motor_p, config_p);
+        motor_p->position = (double)count / ((double)SimTimer_GetPeriod(timer) + 1.0);
+    }
+}
+
+/**
+ * The current is modeled as the no-load current at the actual speed plus a
+ * part of the stall current proportional to the speed error.
+ */
+bool SimMotor_GetSenseVoltage(uint8_t channel, uint32_t *voltage_p)
+{
+    assert(voltage_p != NULL);
+
+    const size_t number_of_motors = Board_GetMaxNumberOfMotors();
+    for (size_t i = 0; (i < number_of_motors) && (i < ElementsIn(motors)); ++i)
+    {
+        const struct board_motor_config_t *config_p = Board_GetMotorConfig(i);
+        if (config_p->adc.channel == channel)
+        {
+            UpdateModel(&motors[i], config_p);
+
+            const double no_load_rpm = (double)Config_GetNoLoadRpm();
+            const double load = fabs(motors[i].target_rpm - motors[i].rpm) / no_load_rpm;
+            const double current = (double)Config_GetNoLoadCurrent() * fabs(motors[i].rpm) / no_load_rpm +
+                                   (double)Config_GetStallCurrent() * fmin(load, 1.0);
+
+            *voltage_p = (uint32_t)current;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static struct motor_model_t *GetMotorByEncoder(uint32_t timer, const struct board_motor_config_t **config_pp)
+{
+    const size_t number_of_motors = Board_GetMaxNumberOfMotors();
+    for (size_t i = 0; (i < number_of_motors) && (i < ElementsIn(motors)); ++i)
+    {
+        const struct board_motor_config_t *config_p = Board_GetMotorConfig(i);
+        if (config_p->encoder.timer == timer)
+        {
+            *config_pp = config_p;
+            return &motors[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * First order response towards the speed given by the PWM duty and the
+ * driver inputs. Both inputs low with full duty brakes the motor.
+ */
+static void UpdateModel(struct motor_model_t *motor_p, const struct board_motor_config_t *config_p)
+{
+    const double now = GetTime();
+    const double elapsed_time = (motor_p->last_update_time > 0.0) ? now - motor_p->last_update_time : 0.0;
+    motor_p->last_update_time = now;
+
+    const double duty = (double)SimTimer_GetDuty(config_p->pwm.timer_peripheral, config_p->pwm.oc_id) / 1000.0;
+    const bool ina = SimGPIO_Get(config_p->driver.port, config_p->driver.ina);
+    const bool inb = SimGPIO_Get(config_p->driver.port, config_p->driver.inb);
+
+    double time_constant = TIME_CONSTANT_S;
+    if (ina && !inb)
+    {
+        motor_p->target_rpm = duty * (double)Config_GetNoLoadRpm();
+    }
+    else if (!ina && inb)
+    {
+        motor_p->target_rpm = -duty * (double)Config_GetNoLoadRpm();
+    }
+    else
+    {
+        motor_p->target_rpm = 0.0;
+        if (duty > 0.0)
+        {
+            time_constant = BRAKE_TIME_CONSTANT_S;
+        }
+    }
+
+    const double step = fmin(elapsed_time / time_constant, 1.0);
+    motor_p->rpm += (motor_p->target_rpm - motor_p->rpm) * step;
+    motor_p->position += motor_p->rpm * elapsed_time / 60.0;
+}
+
+static double GetTime(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + ((double)time.tv_nsec / 1e9);
+}
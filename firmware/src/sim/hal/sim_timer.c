@@ -0,0 +1,244 @@
+/**
+ * @file   sim_timer.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Timers kept in memory, encoder counts come from the motor model.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <libopencm3/stm32/timer.h>
+#include "utility.h"
+#include "sim.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define NUMBER_OF_TIMERS 4
+#define NUMBER_OF_OUTPUT_COMPARE_CHANNELS 4
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct sim_timer_t
+{
+    uint32_t peripheral;
+    uint32_t period;
+    uint32_t counter;
+    bool counter_enabled;
+    uint32_t oc_values[NUMBER_OF_OUTPUT_COMPARE_CHANNELS];
+    bool oc_enabled[NUMBER_OF_OUTPUT_COMPARE_CHANNELS];
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct sim_timer_t timers[NUMBER_OF_TIMERS];
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static struct sim_timer_t *GetTimer(uint32_t timer_peripheral);
+static inline size_t GetChannelIndex(enum tim_oc_id oc_id);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void timer_set_mode(uint32_t timer_peripheral,
+                    uint32_t clock_div __attribute__((unused)),
+                    uint32_t alignment __attribute__((unused)),
+                    uint32_t direction __attribute__((unused)))
+{
+    GetTimer(timer_peripheral);
+}
+
+void timer_set_prescaler(uint32_t timer_peripheral __attribute__((unused)), uint32_t value __attribute__((unused)))
+{
+}
+
+void timer_set_repetition_counter(uint32_t timer_peripheral __attribute__((unused)), uint32_t value __attribute__((unused)))
+{
+}
+
+void timer_enable_preload(uint32_t timer_peripheral __attribute__((unused)))
+{
+}
+
+void timer_continuous_mode(uint32_t timer_peripheral __attribute__((unused)))
+{
+}
+
+void timer_set_period(uint32_t timer_peripheral, uint32_t period)
+{
+    GetTimer(timer_peripheral)->period = period;
+}
+
+void timer_enable_counter(uint32_t timer_peripheral)
+{
+    GetTimer(timer_peripheral)->counter_enabled = true;
+}
+
+void timer_disable_counter(uint32_t timer_peripheral)
+{
+    GetTimer(timer_peripheral)->counter_enabled = false;
+}
+
+void timer_set_oc_mode(uint32_t timer_peripheral __attribute__((unused)),
+                       enum tim_oc_id oc_id __attribute__((unused)),
+                       enum tim_oc_mode oc_mode __attribute__((unused)))
+{
+}
+
+void timer_set_oc_value(uint32_t timer_peripheral, enum tim_oc_id oc_id, uint32_t value)
+{
+    GetTimer(timer_peripheral)->oc_values[GetChannelIndex(oc_id)] = value;
+}
+
+void timer_enable_oc_output(uint32_t timer_peripheral, enum tim_oc_id oc_id)
+{
+    GetTimer(timer_peripheral)->oc_enabled[GetChannelIndex(oc_id)] = true;
+}
+
+void timer_disable_oc_output(uint32_t timer_peripheral, enum tim_oc_id oc_id)
+{
+    GetTimer(timer_peripheral)->oc_enabled[GetChannelIndex(oc_id)] = false;
+}
+
+void timer_slave_set_mode(uint32_t timer __attribute__((unused)), uint8_t mode __attribute__((unused)))
+{
+}
+
+void timer_ic_set_filter(uint32_t timer __attribute__((unused)),
+                         enum tim_ic_id ic __attribute__((unused)),
+                         enum tim_ic_filter flt __attribute__((unused)))
+{
+}
+
+void timer_ic_set_input(uint32_t timer __attribute__((unused)),
+                        enum tim_ic_id ic __attribute__((unused)),
+                        enum tim_ic_input in __attribute__((unused)))
+{
+}
+
+void timer_ic_enable(uint32_t timer __attribute__((unused)), enum tim_ic_id ic __attribute__((unused)))
+{
+}
+
+void timer_ic_disable(uint32_t timer __attribute__((unused)), enum tim_ic_id ic __attribute__((unused)))
+{
+}
+
+uint32_t timer_get_counter(uint32_t timer_peripheral)
+{
+    struct sim_timer_t *timer_p = GetTimer(timer_peripheral);
+    uint32_t count;
+
+    if (timer_p->counter_enabled && SimMotor_GetEncoderCount(timer_peripheral, &count))
+    {
+        timer_p->counter = count;
+    }
+
+    return timer_p->counter;
+}
+
+void timer_set_counter(uint32_t timer_peripheral, uint32_t count)
+{
+    GetTimer(timer_peripheral)->counter = count;
+    SimMotor_SetEncoderCount(timer_peripheral, count);
+}
+
+uint32_t SimTimer_GetDuty(uint32_t timer, uint32_t oc_id)
+{
+    const struct sim_timer_t *timer_p = GetTimer(timer);
+    const size_t index = GetChannelIndex((enum tim_oc_id)oc_id);
+
+    uint32_t duty = 0;
+    if (timer_p->counter_enabled && timer_p->oc_enabled[index] && (timer_p->period > 0))
+    {
+        duty = (timer_p->oc_values[index] * 1000) / timer_p->period;
+    }
+
+    return duty;
+}
+
+uint32_t SimTimer_GetPeriod(uint32_t timer)
+{
+    return GetTimer(timer)->period;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static struct sim_timer_t *GetTimer(uint32_t timer_peripheral)
+{
+    for (size_t i = 0; i < ElementsIn(timers); ++i)
+    {
+        if (timers[i].peripheral == timer_peripheral)
+        {
+            return &timers[i];
+        }
+
+        if (timers[i].peripheral == 0)
+        {
+            timers[i].peripheral = timer_peripheral;
+            return &timers[i];
+        }
+    }
+
+    assert(false && "Too many timers");
+    return NULL;
+}
+
+static inline size_t GetChannelIndex(enum tim_oc_id oc_id)
+{
+    size_t index;
+
+    switch (oc_id)
+    {
+        case TIM_OC1:
+            index = 0;
+            break;
+        case TIM_OC2:
+            index = 1;
+            break;
+        case TIM_OC3:
+            index = 2;
+            break;
+        case TIM_OC4:
+            index = 3;
+            break;
+        default:
+            assert(false && "Unsupported output compare channel");
+            index = 0;
+            break;
+    }
+
+    return index;
+}
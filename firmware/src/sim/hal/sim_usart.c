@@ -0,0 +1,152 @@
+/**
+ * @file   sim_usart.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  USART backed by stdin and stdout.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <libopencm3/stm32/usart.h>
+#include "sim.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct module_t
+{
+    bool enabled;
+    bool input_closed;
+    bool data_available;
+    uint8_t data;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct module_t module;
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static void ReadInput(void);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void usart_set_baudrate(uint32_t usart __attribute__((unused)), uint32_t baud __attribute__((unused)))
+{
+}
+
+void usart_set_databits(uint32_t usart __attribute__((unused)), uint32_t bits __attribute__((unused)))
+{
+}
+
+void usart_set_stopbits(uint32_t usart __attribute__((unused)), uint32_t stopbits __attribute__((unused)))
+{
+}
+
+void usart_set_parity(uint32_t usart __attribute__((unused)), uint32_t parity __attribute__((unused)))
+{
+}
+
+void usart_set_mode(uint32_t usart __attribute__((unused)), uint32_t mode __attribute__((unused)))
+{
+}
+
+void usart_set_flow_control(uint32_t usart __attribute__((unused)), uint32_t flowcontrol __attribute__((unused)))
+{
+}
+
+void usart_enable(uint32_t usart __attribute__((unused)))
+{
+    if (!module.enabled)
+    {
+        module.enabled = true;
+        fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+        Sim_AddPollDescriptor(STDIN_FILENO);
+    }
+}
+
+void usart_send_blocking(uint32_t usart __attribute__((unused)), uint16_t data)
+{
+    putchar((uint8_t)data);
+}
+
+bool usart_get_flag(uint32_t usart __attribute__((unused)), uint32_t flag)
+{
+    bool status = false;
+
+    if (flag == USART_SR_RXNE)
+    {
+        ReadInput();
+        status = module.data_available;
+    }
+    else if (flag == USART_SR_TXE)
+    {
+        status = true;
+    }
+
+    return status;
+}
+
+uint16_t usart_recv(uint32_t usart __attribute__((unused)))
+{
+    module.data_available = false;
+    return module.data;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static void ReadInput(void)
+{
+    if (!module.data_available && !module.input_closed)
+    {
+        uint8_t data;
+        const ssize_t result = read(STDIN_FILENO, &data, sizeof(data));
+        if (result == sizeof(data))
+        {
+            /* The console ends lines with carriage return, as sent by a terminal. */
+            module.data = (data == '\n') ? '\r' : data;
+            module.data_available = true;
+        }
+        else if (result == 0)
+        {
+            module.input_closed = true;
+            Sim_RemovePollDescriptor(STDIN_FILENO);
+        }
+    }
+}
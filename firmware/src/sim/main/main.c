@@ -0,0 +1,123 @@
+/**
+ * @file   main.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Simulator entry point.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sim.h"
+#include "board.h"
+#include "bootloader.h"
+#include "application.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define DEFAULT_CAN_INTERFACE "vcan0"
+#define DEFAULT_IMAGE_PATH "flash.bin"
+
+/* Longest sleep between application runs, CAN and console input wake up earlier. */
+#define MAX_IDLE_TIME_MS 1
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static void PrintUsage(const char *name);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+    struct sim_config_t config = {
+        .can_interface = DEFAULT_CAN_INTERFACE,
+        .image_path = DEFAULT_IMAGE_PATH
+    };
+
+    int option;
+    while ((option = getopt(argc, argv, "i:f:h")) != -1)
+    {
+        switch (option)
+        {
+            case 'i':
+                config.can_interface = optarg;
+                break;
+
+            case 'f':
+                config.image_path = optarg;
+                break;
+
+            case 'h':
+                PrintUsage(argv[0]);
+                return EXIT_SUCCESS;
+
+            default:
+                PrintUsage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    Sim_Init(&config, argv);
+
+    /* Returns unless a firmware update is requested, the update ends with a reset. */
+    Bootloader_Init();
+    Bootloader_Start();
+
+    Board_Init();
+    Application_Init();
+
+    while (1)
+    {
+        Application_Run();
+        Sim_Wait(MAX_IDLE_TIME_MS);
+    }
+
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static void PrintUsage(const char *name)
+{
+    printf("Usage: %s [-i interface] [-f image]\n", name);
+    printf("  -i interface  SocketCAN interface, default " DEFAULT_CAN_INTERFACE "\n");
+    printf("  -f image      Flash image file, created if missing, default " DEFAULT_IMAGE_PATH "\n");
+}
@@ -0,0 +1,117 @@
+/**
+ * @file   adc.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  ADC with samples from the simulator models.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include "utility.h"
+#include "logging.h"
+#include "sim.h"
+#include "adc.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define ADC_LOGGER_NAME "ADC"
+#ifndef ADC_LOGGER_DEBUG_LEVEL
+#define ADC_LOGGER_DEBUG_LEVEL LOGGING_INFO
+#endif
+
+#define MAX_NUMBER_OF_CHANNELS 3
+#define VSENSE_CHANNEL 14
+/* 12 V through the VSense voltage divider. */
+#define VSENSE_VOLTAGE 1286
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct module_t
+{
+    logging_logger_t *logger;
+    size_t number_of_channels;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct module_t module;
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void ADC_Init(void)
+{
+    module = (__typeof__(module)) {0};
+    module.logger = Logging_GetLogger(ADC_LOGGER_NAME);
+    Logging_SetLevel(module.logger, ADC_LOGGER_DEBUG_LEVEL);
+
+    Logging_Info(module.logger, "ADC initialized");
+}
+
+void ADC_InitChannel(adc_input_t *self_p, uint8_t channel)
+{
+    assert(self_p != NULL);
+    assert(module.number_of_channels < MAX_NUMBER_OF_CHANNELS);
+
+    *self_p = (__typeof__(*self_p)) {0};
+    self_p->channel = channel;
+    ++module.number_of_channels;
+
+    Logging_Info(module.logger, "Initialized ADC channel %u", channel);
+}
+
+void ADC_Start(void)
+{
+    Logging_Info(module.logger, "Scanning on %u channel(s).", module.number_of_channels);
+}
+
+uint32_t ADC_GetVoltage(const adc_input_t *self_p)
+{
+    assert(self_p != NULL);
+
+    uint32_t voltage = 0;
+    if (self_p->channel == VSENSE_CHANNEL)
+    {
+        voltage = VSENSE_VOLTAGE;
+    }
+    else if (!SimMotor_GetSenseVoltage(self_p->channel, &voltage))
+    {
+        Logging_Warning(module.logger, "No model for channel %u", self_p->channel);
+    }
+
+    return voltage;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,237 @@
+/**
+ * @file   board.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Board support for the simulator.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <stdint.h>
+#include <assert.h>
+#include "utility.h"
+#include "sim.h"
+#include "board.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define NUMBER_OF_MOTORS 2
+#define GPIO_STATUS_LED_PORT GPIOA
+#define GPIO_STATUS_LED GPIO5
+#define GPIO_EMERGENCY_PORT GPIOC
+#define GPIO_EMERGENCY GPIO13
+
+/* Same layout as the target linker script. */
+#define APPLICATION_ADDRESS (SIM_FLASH_START + 0x8000)
+#define NVS_ADDRESS (SIM_FLASH_START + 0x1E000)
+#define NVS_SIZE 0x2000
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct module_t
+{
+    const struct board_motor_config_t motor_configs[NUMBER_OF_MOTORS];
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct module_t module =
+{
+    .motor_configs = {
+        {
+            .pwm = {
+                .timer_peripheral = TIM3,
+                .remap = AFIO_MAPR_TIM3_REMAP_FULL_REMAP,
+                .gpio_port = GPIOC,
+                .gpio = GPIO8,
+                .oc_id = TIM_OC3,
+                .peripheral_clocks = {RCC_GPIOC, RCC_TIM3, RCC_AFIO}
+            },
+            .driver = {
+                .port = GPIOC,
+                .sel = GPIO0,
+                .cs = GPIO1,
+                .ina = GPIO2,
+                .inb = GPIO3,
+                .gpio_clock = RCC_GPIOC
+            },
+            .encoder = {
+                .port = GPIOB,
+                .a = GPIO6,
+                .b = GPIO7,
+                .gpio_clock = RCC_GPIOB,
+                .timer = TIM4,
+                .timer_clock = RCC_TIM4,
+                .timer_rst = RST_TIM4
+            },
+            .adc = {
+                .channel = 11
+            }
+        },
+        {
+            .pwm = {
+                .timer_peripheral = TIM3,
+                .remap = AFIO_MAPR_TIM3_REMAP_FULL_REMAP,
+                .gpio_port = GPIOC,
+                .gpio = GPIO6,
+                .oc_id = TIM_OC1,
+                .peripheral_clocks = {RCC_GPIOC, RCC_TIM3, RCC_AFIO}
+            },
+            .driver = {
+                .port = GPIOB,
+                .sel = GPIO13,
+                .cs = GPIO1,
+                .ina = GPIO14,
+                .inb = GPIO15,
+                .gpio_clock = RCC_GPIOB
+            },
+            .encoder = {
+                .port = GPIOA,
+                .a = GPIO0,
+                .b = GPIO1,
+                .gpio_clock = RCC_GPIOA,
+                .timer = TIM2,
+                .timer_clock = RCC_TIM2,
+                .timer_rst = RST_TIM2
+            },
+            .adc = {
+                .channel = 9
+            }
+        }
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void Board_Init(void)
+{
+    gpio_set(GPIO_STATUS_LED_PORT, GPIO_STATUS_LED);
+
+    /* The emergency input has a pull-up, released unless driven low. */
+    gpio_set(GPIO_EMERGENCY_PORT, GPIO_EMERGENCY);
+}
+
+uint32_t Board_GetHardwareRevision(void)
+{
+    return 0;
+}
+
+uint32_t Board_GetSoftwareRevision(void)
+{
+    return 0;
+}
+
+struct board_id_t Board_GetId(void)
+{
+    /* Derived from the CAN interface so nodes on different buses differ. */
+    uint32_t hash = 2166136261;
+    for (const char *c = Sim_GetCANInterface(); *c != '\0'; ++c)
+    {
+        hash = (hash ^ (uint8_t)*c) * 16777619;
+    }
+
+    return (struct board_id_t) {.offset_0 = 0x53494D00, .offset_4 = 0, .offset_8 = hash};
+}
+
+const struct board_motor_config_t *Board_GetMotorConfig(size_t index)
+{
+    assert(index < ElementsIn(module.motor_configs));
+
+    return &module.motor_configs[index];
+}
+
+size_t Board_GetMaxNumberOfMotors(void)
+{
+    return ElementsIn(module.motor_configs);
+}
+
+void Board_ToggleStatusLED(void)
+{
+    gpio_toggle(GPIO_STATUS_LED_PORT, GPIO_STATUS_LED);
+}
+
+uint32_t Board_GetResetFlags(void)
+{
+    return Sim_GetResetFlags();
+}
+
+void Board_Reset(void)
+{
+    Sim_Reset();
+}
+
+bool Board_GetEmergencyPinState(void)
+{
+    return !(bool)gpio_get(GPIO_EMERGENCY_PORT, GPIO_EMERGENCY);
+}
+
+uintptr_t Board_GetNVSAddress(void)
+{
+    return NVS_ADDRESS;
+}
+
+uintptr_t Board_GetApplicationAddress(void)
+{
+    return APPLICATION_ADDRESS;
+}
+
+uint32_t Board_GetNumberOfPagesInNVS(void)
+{
+    return NVS_SIZE / SIM_FLASH_PAGE_SIZE;
+}
+
+uint32_t Board_GetMaxCurrent(void)
+{
+    return 5000;
+}
+
+uintptr_t Board_GetBackupMemoryAddress(void)
+{
+    return Sim_GetBackupMemoryAddress();
+}
+
+uint32_t Board_VSenseToVoltage(uint32_t value)
+{
+    /* Vsense voltage divider values in Ohm. */
+    const uint32_t r1 = 10000;
+    const uint32_t r2 = 1200;
+
+    return ((value * (r1 + r2)) + (r2 / 2)) / r2;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,559 @@
+/**
+ * @file   can_interface.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  CAN interface on a Linux SocketCAN socket.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include "utility.h"
+#include "logging.h"
+#include "systime.h"
+#include "sim.h"
+#include "can_interface.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define CANIF_LOGGER_NAME "CANIf"
+#ifndef CANIF_LOGGER_DEBUG_LEVEL
+#define CANIF_LOGGER_DEBUG_LEVEL LOGGING_INFO
+#endif
+
+/* Same limits as the hardware implementation. */
+#define MAX_NUMBER_OF_FILTERS 56
+#define RX_BATCH_SIZE 32
+#define TX_QUEUE_SIZE 16
+#define PACED_QUEUE_SIZE 16
+
+#define NUMBER_OF_PRIORITIES 2
+#define FRAME_RATE_PERIOD_MS 1000
+#define SAMPLE_POINT 875
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct filter_t
+{
+    uint32_t id;
+    uint32_t mask;
+    bool extended;
+    enum caninterface_priority_t priority;
+    caninterface_listener_cb_t listener_cb;
+    void *arg_p;
+};
+
+struct frame_rate_t
+{
+    uint32_t period_start;
+    uint32_t last_number_of_frames;
+    uint32_t frames_per_second;
+    uint32_t max_frames_per_second;
+};
+
+struct rx_batch_t
+{
+    struct can_frame_t frames[RX_BATCH_SIZE];
+    const struct filter_t *filters[RX_BATCH_SIZE];
+    size_t number_of_frames;
+};
+
+struct paced_frame_t
+{
+    struct can_frame_t frame;
+    uint32_t separation_time;
+};
+
+/**
+ * The host has no pacing timer, paced frames are sent when due from
+ * 'CANInterface_TransmitPaced' and 'CANInterface_Process'. The separation is
+ * timed from when the previous frame was written to the socket.
+ */
+struct paced_queue_t
+{
+    struct paced_frame_t frames[PACED_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t sent_time;
+    uint32_t sent_id;
+    uint32_t separation_time;
+};
+
+struct module_t
+{
+    logging_logger_t *logger;
+    int socket;
+    uint32_t bit_rate;
+    struct filter_t filters[MAX_NUMBER_OF_FILTERS];
+    size_t number_of_filters;
+    struct rx_batch_t rx_batches[NUMBER_OF_PRIORITIES];
+    uint32_t number_of_rx_frames[NUMBER_OF_PRIORITIES];
+    uint32_t number_of_tx_frames;
+    uint32_t number_of_dropped_tx_frames;
+    struct paced_queue_t paced_queue;
+    struct frame_rate_t rx_rate;
+    struct frame_rate_t tx_rate;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct module_t module;
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static void OpenSocket(const char *interface_name);
+static void ReceiveFrames(void);
+static const struct filter_t *GetMatchingFilter(const struct can_frame_t *frame_p);
+static void DispatchFrames(struct rx_batch_t *batch_p);
+static bool WriteFrame(uint32_t id, const void *data_p, size_t size);
+static void SendPacedFrames(void);
+static void UpdateFrameRate(struct frame_rate_t *rate_p, uint32_t number_of_frames, uint32_t time);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void CANInterface_Init(uint32_t bit_rate)
+{
+    module = (__typeof__(module)) {0};
+    module.logger = Logging_GetLogger(CANIF_LOGGER_NAME);
+    Logging_SetLevel(module.logger, CANIF_LOGGER_DEBUG_LEVEL);
+
+    struct caninterface_bit_timing_t timing;
+    if ((bit_rate == 0) || !CANInterface_CalculateBitTiming(bit_rate, &timing))
+    {
+        if (bit_rate != 0)
+        {
+            Logging_Warning(module.logger, "Unsupported bit rate, using default: {bit_rate: %u}", bit_rate);
+        }
+
+        bit_rate = CANINTERFACE_DEFAULT_BIT_RATE;
+    }
+    module.bit_rate = bit_rate;
+
+    OpenSocket(Sim_GetCANInterface());
+
+    Logging_Info(module.logger, "CAN initialized: {interface: %s, bit_rate: %u}", Sim_GetCANInterface(), module.bit_rate);
+}
+
+uint32_t CANInterface_GetBitRate(void)
+{
+    return module.bit_rate;
+}
+
+/**
+ * The bit rate is set on the host interface, any rate the hardware could use
+ * is accepted and reported with a nominal timing.
+ */
+bool CANInterface_CalculateBitTiming(uint32_t bit_rate, struct caninterface_bit_timing_t *timing_p)
+{
+    assert(timing_p != NULL);
+
+    if ((bit_rate == 0) || (bit_rate > CANINTERFACE_MAX_BIT_RATE))
+    {
+        return false;
+    }
+
+    *timing_p = (__typeof__(*timing_p)) {
+        .prescaler = 1,
+        .time_segment1 = 13,
+        .time_segment2 = 2,
+        .sync_jump_width = 1,
+        .sample_point = SAMPLE_POINT
+    };
+
+    return true;
+}
+
+bool CANInterface_Transmit(uint32_t id, void *data_p, size_t size)
+{
+    assert(data_p != NULL || size == 0);
+    assert(size <= 8);
+
+    Logging_Debug(module.logger, "CANTX{id=0x%x}", id);
+
+    if (!WriteFrame(id, data_p, size))
+    {
+        /* A full socket queue corresponds to a full TX queue on target. */
+        Logging_Debug(module.logger, "TX queue full, frame dropped");
+        ++module.number_of_dropped_tx_frames;
+        return false;
+    }
+
+    ++module.number_of_tx_frames;
+    return true;
+}
+
+size_t CANInterface_GetTransmitQueueSpace(void)
+{
+    /* The socket send queue can't be inspected per frame, report an empty target queue. */
+    return TX_QUEUE_SIZE;
+}
+
+bool CANInterface_TransmitPaced(uint32_t id, void *data_p, size_t size, uint32_t separation_time_us)
+{
+    assert(data_p != NULL);
+    assert(size <= 8);
+
+    struct paced_queue_t *queue_p = &module.paced_queue;
+    if ((queue_p->head - queue_p->tail) >= PACED_QUEUE_SIZE)
+    {
+        Logging_Debug(module.logger, "Paced TX queue full, frame dropped");
+        ++module.number_of_dropped_tx_frames;
+        return false;
+    }
+
+    struct paced_frame_t *paced_frame_p = &queue_p->frames[queue_p->head % PACED_QUEUE_SIZE];
+    paced_frame_p->frame.id = id;
+    paced_frame_p->frame.size = (uint8_t)size;
+    memcpy(paced_frame_p->frame.data, data_p, size);
+    paced_frame_p->separation_time = separation_time_us;
+    ++queue_p->head;
+
+    SendPacedFrames();
+    return true;
+}
+
+size_t CANInterface_GetPacedTransmitQueueSpace(void)
+{
+    return PACED_QUEUE_SIZE - (module.paced_queue.head - module.paced_queue.tail);
+}
+
+bool CANInterface_IsPacedTransmitPending(uint32_t id)
+{
+    const struct paced_queue_t *queue_p = &module.paced_queue;
+
+    for (uint32_t i = queue_p->tail; i != queue_p->head; ++i)
+    {
+        if (queue_p->frames[i % PACED_QUEUE_SIZE].frame.id == id)
+        {
+            return true;
+        }
+    }
+
+    const uint32_t elapsed_time = SysTime_GetSystemTimeUs() - queue_p->sent_time;
+    return (queue_p->sent_id == id) && (elapsed_time < queue_p->separation_time);
+}
+
+void CANInterface_GetStatistics(struct caninterface_statistics_t *statistics_p)
+{
+    assert(statistics_p != NULL);
+
+    const uint32_t control_frames = module.number_of_rx_frames[CANINTERFACE_PRIORITY_CONTROL];
+    const uint32_t bulk_frames = module.number_of_rx_frames[CANINTERFACE_PRIORITY_BULK];
+
+    *statistics_p = (__typeof__(*statistics_p)) {
+        .rx_frames = control_frames + bulk_frames,
+        .rx_control_frames = control_frames,
+        .rx_bulk_frames = bulk_frames,
+        .rx_frames_per_second = module.rx_rate.frames_per_second,
+        .rx_max_frames_per_second = module.rx_rate.max_frames_per_second,
+        .tx_frames = module.number_of_tx_frames,
+        .tx_frames_per_second = module.tx_rate.frames_per_second,
+        .tx_max_frames_per_second = module.tx_rate.max_frames_per_second,
+        .tx_dropped_frames = module.number_of_dropped_tx_frames
+    };
+}
+
+void CANInterface_ClearPeakStatistics(void)
+{
+    module.rx_rate.max_frames_per_second = 0;
+    module.tx_rate.max_frames_per_second = 0;
+}
+
+void CANInterface_Process(void)
+{
+    ReceiveFrames();
+    SendPacedFrames();
+
+    /* Control frames are dispatched before bulk frames. */
+    DispatchFrames(&module.rx_batches[CANINTERFACE_PRIORITY_CONTROL]);
+    DispatchFrames(&module.rx_batches[CANINTERFACE_PRIORITY_BULK]);
+
+    const uint32_t time = SysTime_GetSystemTime();
+    UpdateFrameRate(&module.rx_rate,
+                    module.number_of_rx_frames[CANINTERFACE_PRIORITY_CONTROL] + module.number_of_rx_frames[CANINTERFACE_PRIORITY_BULK],
+                    time);
+    UpdateFrameRate(&module.tx_rate, module.number_of_tx_frames, time);
+}
+
+void CANInterface_RegisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
+{
+    assert(listener_cb != NULL);
+    assert((priority == CANINTERFACE_PRIORITY_CONTROL) || (priority == CANINTERFACE_PRIORITY_BULK));
+    assert(module.number_of_filters < ElementsIn(module.filters));
+
+    const bool extended = CANInterface_IsExtendedID(id);
+    const uint32_t filter_mask = mask & (extended ? CANINTERFACE_EXTENDED_ID_MASK : CANINTERFACE_STANDARD_ID_MASK);
+
+    module.filters[module.number_of_filters] = (struct filter_t) {
+        .id = id & filter_mask,
+        .mask = filter_mask,
+        .extended = extended,
+        .priority = priority,
+        .listener_cb = listener_cb,
+        .arg_p = arg_p
+    };
+    ++module.number_of_filters;
+
+    Logging_Info(module.logger, "New listener registered: {id=0x%x, mask=0x%x, priority=%u, cb: 0x%x, arg: 0x%x} (filters: %u)",
+                 id, mask, priority, (uintptr_t)listener_cb, (uintptr_t)arg_p, module.number_of_filters);
+}
+
+void CANInterface_UnregisterListener(uint32_t id, uint32_t mask, enum caninterface_priority_t priority, caninterface_listener_cb_t listener_cb, void *arg_p)
+{
+    assert(listener_cb != NULL);
+
+    const bool extended = CANInterface_IsExtendedID(id);
+    const uint32_t filter_mask = mask & (extended ? CANINTERFACE_EXTENDED_ID_MASK : CANINTERFACE_STANDARD_ID_MASK);
+
+    for (size_t i = 0; i < module.number_of_filters; ++i)
+    {
+        const struct filter_t *filter_p = &module.filters[i];
+        if ((filter_p->id == (id & filter_mask)) && (filter_p->mask == filter_mask) && (filter_p->extended == extended) &&
+                (filter_p->priority == priority) && (filter_p->listener_cb == listener_cb) && (filter_p->arg_p == arg_p))
+        {
+            /* Keep the order of the remaining filters, the first matching one is used. */
+            memmove(&module.filters[i], &module.filters[i + 1], (module.number_of_filters - i - 1) * sizeof(module.filters[0]));
+            --module.number_of_filters;
+
+            Logging_Info(module.logger, "Listener unregistered: {id=0x%x, mask=0x%x, priority=%u} (filters: %u)",
+                         id, mask, priority, module.number_of_filters);
+            return;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static void OpenSocket(const char *interface_name)
+{
+    module.socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (module.socket < 0)
+    {
+        Logging_Critical(module.logger, "Failed to open CAN socket: %s", strerror(errno));
+        assert(false);
+    }
+
+    struct ifreq request = {0};
+    strncpy(request.ifr_name, interface_name, sizeof(request.ifr_name) - 1);
+    if (ioctl(module.socket, SIOCGIFINDEX, &request) < 0)
+    {
+        Logging_Critical(module.logger, "No CAN interface %s: %s", interface_name, strerror(errno));
+        assert(false);
+    }
+
+    struct sockaddr_can address = {
+        .can_family = AF_CAN,
+        .can_ifindex = request.ifr_ifindex
+    };
+    if (bind(module.socket, (struct sockaddr *)&address, sizeof(address)) < 0)
+    {
+        Logging_Critical(module.logger, "Failed to bind CAN socket: %s", strerror(errno));
+        assert(false);
+    }
+
+    fcntl(module.socket, F_SETFL, fcntl(module.socket, F_GETFL) | O_NONBLOCK);
+    Sim_AddPollDescriptor(module.socket);
+}
+
+/**
+ * Read the pending frames from the socket into the batch of the matching
+ * priority, frames without a listener are discarded as by the filter banks.
+ */
+static void ReceiveFrames(void)
+{
+    struct can_frame frame;
+
+    while (true)
+    {
+        struct rx_batch_t *control_batch_p = &module.rx_batches[CANINTERFACE_PRIORITY_CONTROL];
+        struct rx_batch_t *bulk_batch_p = &module.rx_batches[CANINTERFACE_PRIORITY_BULK];
+        if ((control_batch_p->number_of_frames == RX_BATCH_SIZE) || (bulk_batch_p->number_of_frames == RX_BATCH_SIZE))
+        {
+            break;
+        }
+
+        if (read(module.socket, &frame, sizeof(frame)) != (ssize_t)sizeof(frame))
+        {
+            break;
+        }
+
+        if ((frame.can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) != 0)
+        {
+            continue;
+        }
+
+        struct can_frame_t received_frame = {
+            .size = frame.can_dlc,
+            .timestamp = SysTime_GetSystemTimeUs()
+        };
+        if ((frame.can_id & CAN_EFF_FLAG) != 0)
+        {
+            received_frame.id = CANInterface_ExtendedID(frame.can_id & CAN_EFF_MASK);
+        }
+        else
+        {
+            received_frame.id = frame.can_id & CAN_SFF_MASK;
+        }
+        memcpy(received_frame.data, frame.data, sizeof(received_frame.data));
+
+        const struct filter_t *filter_p = GetMatchingFilter(&received_frame);
+        if (filter_p == NULL)
+        {
+            continue;
+        }
+
+        struct rx_batch_t *batch_p = &module.rx_batches[filter_p->priority];
+        batch_p->frames[batch_p->number_of_frames] = received_frame;
+        batch_p->filters[batch_p->number_of_frames] = filter_p;
+        ++batch_p->number_of_frames;
+        ++module.number_of_rx_frames[filter_p->priority];
+    }
+}
+
+/**
+ * Control filters take precedence, as FIFO 0 does on target.
+ */
+static const struct filter_t *GetMatchingFilter(const struct can_frame_t *frame_p)
+{
+    const bool extended = CANInterface_IsExtendedID(frame_p->id);
+    const uint32_t id = frame_p->id & CANINTERFACE_EXTENDED_ID_MASK;
+    const struct filter_t *match_p = NULL;
+
+    for (size_t i = 0; i < module.number_of_filters; ++i)
+    {
+        const struct filter_t *filter_p = &module.filters[i];
+
+        if ((filter_p->extended == extended) && ((id & filter_p->mask) == filter_p->id))
+        {
+            if (filter_p->priority == CANINTERFACE_PRIORITY_CONTROL)
+            {
+                return filter_p;
+            }
+
+            if (match_p == NULL)
+            {
+                match_p = filter_p;
+            }
+        }
+    }
+
+    return match_p;
+}
+
+static void DispatchFrames(struct rx_batch_t *batch_p)
+{
+    for (size_t i = 0; i < batch_p->number_of_frames; ++i)
+    {
+        const struct filter_t *filter_p = batch_p->filters[i];
+
+        Logging_Debug(module.logger, "CANRX{id=0x%x}", batch_p->frames[i].id);
+        filter_p->listener_cb(&batch_p->frames[i], filter_p->arg_p);
+    }
+
+    batch_p->number_of_frames = 0;
+}
+
+static bool WriteFrame(uint32_t id, const void *data_p, size_t size)
+{
+    struct can_frame frame = {0};
+    if (CANInterface_IsExtendedID(id))
+    {
+        frame.can_id = (id & CANINTERFACE_EXTENDED_ID_MASK) | CAN_EFF_FLAG;
+    }
+    else
+    {
+        frame.can_id = id & CANINTERFACE_STANDARD_ID_MASK;
+    }
+    frame.can_dlc = (uint8_t)size;
+    if (size > 0)
+    {
+        memcpy(frame.data, data_p, size);
+    }
+
+    return write(module.socket, &frame, sizeof(frame)) == (ssize_t)sizeof(frame);
+}
+
+static void SendPacedFrames(void)
+{
+    struct paced_queue_t *queue_p = &module.paced_queue;
+
+    while (queue_p->head != queue_p->tail)
+    {
+        const uint32_t time = SysTime_GetSystemTimeUs();
+        if ((time - queue_p->sent_time) < queue_p->separation_time)
+        {
+            break;
+        }
+
+        /* The frame stays queued until the socket accepts it. */
+        const struct paced_frame_t *paced_frame_p = &queue_p->frames[queue_p->tail % PACED_QUEUE_SIZE];
+        if (!WriteFrame(paced_frame_p->frame.id, paced_frame_p->frame.data, paced_frame_p->frame.size))
+        {
+            break;
+        }
+
+        ++module.number_of_tx_frames;
+        queue_p->sent_time = time;
+        queue_p->sent_id = paced_frame_p->frame.id;
+        queue_p->separation_time = paced_frame_p->separation_time;
+        ++queue_p->tail;
+    }
+}
+
+static void UpdateFrameRate(struct frame_rate_t *rate_p, uint32_t number_of_frames, uint32_t time)
+{
+    const uint32_t elapsed_time = time - rate_p->period_start;
+    if (elapsed_time < FRAME_RATE_PERIOD_MS)
+    {
+        return;
+    }
+
+    /* Scale in case the main loop was late to close the period. */
+    rate_p->frames_per_second = ((number_of_frames - rate_p->last_number_of_frames) * FRAME_RATE_PERIOD_MS) / elapsed_time;
+    if (rate_p->frames_per_second > rate_p->max_frames_per_second)
+    {
+        rate_p->max_frames_per_second = rate_p->frames_per_second;
+    }
+
+    rate_p->last_number_of_frames = number_of_frames;
+    rate_p->period_start = time;
+}
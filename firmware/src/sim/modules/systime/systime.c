@@ -0,0 +1,98 @@
+/**
+ * @file   systime.c
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  System time from the host monotonic clock.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <time.h>
+#include "systime.h"
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct module_t
+{
+    uint64_t start_time_us;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+static struct module_t module;
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTION PROTOTYPES
+//////////////////////////////////////////////////////////////////////////
+
+static uint64_t GetMonotonicTimeUs(void);
+
+//////////////////////////////////////////////////////////////////////////
+//FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+void SysTime_Init(void)
+{
+    module = (__typeof__(module)) {0};
+    module.start_time_us = GetMonotonicTimeUs();
+}
+
+uint32_t SysTime_GetSystemTime(void)
+{
+    return (uint32_t)((GetMonotonicTimeUs() - module.start_time_us) / 1000);
+}
+
+uint32_t SysTime_GetSystemTimeUs(void)
+{
+    return (uint32_t)(GetMonotonicTimeUs() - module.start_time_us);
+}
+
+uint32_t SysTime_GetSystemTimestamp(void)
+{
+    return (uint32_t)((GetMonotonicTimeUs() - module.start_time_us) / 1000000);
+}
+
+uint32_t SysTime_GetDifference(uint32_t system_time)
+{
+    /* Unsigned arithmetic handles the wrap-around. */
+    return SysTime_GetSystemTime() - system_time;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//LOCAL FUNCTIONS
+//////////////////////////////////////////////////////////////////////////
+
+static uint64_t GetMonotonicTimeUs(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return ((uint64_t)time.tv_sec * 1000000) + ((uint64_t)time.tv_nsec / 1000);
+}
@@ -0,0 +1,99 @@
+/**
+ * @file   can.h
+ * @Author Andreas Dahlberg (andreas.dahlberg90@gmail.com)
+ * @brief  Mock bxCAN registers.
+ */
+
+/*
+This file is part of CANDrive firmware.
+
+CANDrive firmware is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CANDrive firmware is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOCK_CAN_H_
+#define MOCK_CAN_H_
+
+//////////////////////////////////////////////////////////////////////////
+//INCLUDES
+//////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include_next <libopencm3/stm32/can.h>
+
+//////////////////////////////////////////////////////////////////////////
+//DEFINES
+//////////////////////////////////////////////////////////////////////////
+
+#define MOCK_CAN_NUMBER_OF_FILTER_BANKS 14
+
+/**
+ * The registers accessed directly by the firmware are redirected to
+ * 'mock_can_registers'. The registers behave like plain memory, e.g. writing
+ * a flag to clear it leaves the written value in the register.
+ */
+#undef CAN_MSR
+#define CAN_MSR(can_base) (mock_can_registers.msr)
+#undef CAN_TSR
+#define CAN_TSR(can_base) (mock_can_registers.tsr)
+#undef CAN_RF0R
+#define CAN_RF0R(can_base) (mock_can_registers.rf0r)
+#undef CAN_RF1R
+#define CAN_RF1R(can_base) (mock_can_registers.rf1r)
+#undef CAN_ESR
+#define CAN_ESR(can_base) (mock_can_registers.esr)
+#undef CAN_FMR
+#define CAN_FMR(can_base) (mock_can_registers.fmr)
+#undef CAN_FM1R
+#define CAN_FM1R(can_base) (mock_can_registers.fm1r)
+#undef CAN_FS1R
+#define CAN_FS1R(can_base) (mock_can_registers.fs1r)
+#undef CAN_FFA1R
+#define CAN_FFA1R(can_base) (mock_can_registers.ffa1r)
+#undef CAN_FA1R
+#define CAN_FA1R(can_base) (mock_can_registers.fa1r)
+#undef CAN_FiR1
+#define CAN_FiR1(can_base, bank) (mock_can_registers.filter_banks[(bank)].fr1)
+#undef CAN_FiR2
+#define CAN_FiR2(can_base, bank) (mock_can_registers.filter_banks[(bank)].fr2)
+
+//////////////////////////////////////////////////////////////////////////
+//TYPE DEFINITIONS
+//////////////////////////////////////////////////////////////////////////
+
+struct mock_can_registers_t
+{
+    uint32_t msr;
+    uint32_t tsr;
+    uint32_t rf0r;
+    uint32_t rf1r;
+    uint32_t esr;
+    uint32_t fmr;
+    uint32_t fm1r;
+    uint32_t fs1r;
+    uint32_t ffa1r;
+    uint32_t fa1r;
+    struct
+    {
+        uint32_t fr1;
+        uint32_t fr2;
+    } filter_banks[MOCK_CAN_NUMBER_OF_FILTER_BANKS];
+};
+
+//////////////////////////////////////////////////////////////////////////
+//VARIABLES
+//////////////////////////////////////////////////////////////////////////
+
+extern struct mock_can_registers_t mock_can_registers;
+
+#endif
@@ -46,6 +46,8 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //VARIABLES
 //////////////////////////////////////////////////////////////////////////
 
+struct mock_can_registers_t mock_can_registers;
+
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTION PROTOTYPES
 //////////////////////////////////////////////////////////////////////////
@@ -62,7 +64,11 @@ __attribute__((weak)) void can_reset(uint32_t canport)
 __attribute__((weak)) int can_init(uint32_t canport, bool ttcm, bool abom, bool awum, bool nart, bool rflm, bool txfp, uint32_t sjw, uint32_t ts1, uint32_t ts2, uint32_t brp, bool loopback, bool silent)
 {
     check_expected_uint(canport);
-    mock_type(int);
+    check_expected_uint(sjw);
+    check_expected_uint(ts1);
+    check_expected_uint(ts2);
+    check_expected_uint(brp);
+    return mock_type(int);
 }
 
 __attribute__((weak)) void can_filter_init(uint32_t nr, bool scale_32bit, bool id_list_mode, uint32_t fr1, uint32_t fr2, uint32_t fifo, bool enable)
@@ -76,6 +82,7 @@ __attribute__((weak)) void can_filter_id_mask_16bit_init(uint32_t nr, uint16_t i
     check_expected_uint(mask1);
     check_expected_uint(id2);
     check_expected_uint(mask2);
+    check_expected_uint(fifo);
 }
 
 __attribute__((weak)) void can_filter_id_mask_32bit_init(uint32_t nr, uint32_t id, uint32_t mask, uint32_t fifo, bool enable)
@@ -104,6 +111,7 @@ __attribute__((weak)) int can_transmit(uint32_t canport, uint32_t id, bool ext,
 {
     check_expected_uint(canport);
     check_expected_uint(id);
+    check_expected_uint(ext);
     check_expected_uint(length);
     check_expected_ptr(data);
     mock_type(int);
@@ -114,10 +122,13 @@ __attribute__((weak)) void can_receive(uint32_t canport, uint8_t fifo, bool rele
     check_expected_uint(canport);
 
     *id = mock_type(uint32_t);
+    *ext = mock_type(bool);
     *length = mock_type(uint8_t);
 
     uint8_t *mock_data_p = mock_ptr_type(uint8_t *);
     memcpy(data, mock_data_p, *length);
+
+    *fmi = mock_type(uint8_t);
 }
 
 __attribute__((weak)) void can_fifo_release(uint32_t canport, uint8_t fifo)
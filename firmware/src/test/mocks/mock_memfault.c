@@ -70,6 +70,12 @@ __attribute__((weak)) int memfault_metrics_heartbeat_add(MemfaultMetricId key, i
     return mock_type(int);
 }
 
+__attribute__((weak)) int memfault_metrics_heartbeat_set_unsigned(MemfaultMetricId key, uint32_t unsigned_value)
+{
+    check_expected_uint(unsigned_value);
+    return mock_type(int);
+}
+
 __attribute__((weak)) int memfault_metrics_heartbeat_timer_start(MemfaultMetricId key)
 {
     return mock_type(int);
@@ -47,6 +47,8 @@ along with CANDrive firmware.  If not, see <http://www.gnu.org/licenses/>.
 //////////////////////////////////////////////////////////////////////////
 
 const struct rcc_clock_scale rcc_hse_configs[RCC_CLOCK_HSE_END];
+uint32_t rcc_apb1_frequency = 36000000;
+uint32_t rcc_apb2_frequency = 72000000;
 
 //////////////////////////////////////////////////////////////////////////
 //LOCAL FUNCTION PROTOTYPES
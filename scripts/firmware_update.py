@@ -13,6 +13,14 @@ import isotp
 import bincopy
 from can.interfaces.socketcan import SocketcanBus
 
+# Messages larger than 4095 bytes use the ISO 15765-2:2016 escape first frame.
+MAX_MESSAGE_SIZE = 0xFFFFFFFF
+
+# Bootloaders without escape first frame support only accept messages up to
+# 4095 bytes. The image is sent in chunks of this size unless --single-message
+# is given.
+FIRMWARE_CHUNK_SIZE = 1024
+
 crc_table = {}
 
 def generate_crc32_table():
@@ -74,7 +82,7 @@ class ISOTPLink():
     def __init__(self, interface, source, destination, error_handler, wftmax=5):
         self._can_bus = SocketcanBus(channel=interface)
         addr = isotp.Address(isotp.AddressingMode.Normal_11bits, rxid=source, txid=destination)
-        parameters = {'wftmax': wftmax}
+        parameters = {'wftmax': wftmax, 'max_frame_size': MAX_MESSAGE_SIZE}
         self._stack = isotp.CanStack(self._can_bus, address=addr, error_handler=error_handler, params=parameters)
 
     def send(self, data):
@@ -132,13 +140,15 @@ class Device():
         message = Message(MessageType.REQ_FW_HEADER, data_header)
         self.send(message.dump())
 
-    def _send_firmware_data(self, data):
-        number_of_pages = math.ceil(len(data) / 1024)
-        sent_pages = 0
+    def _send_firmware_data(self, data, chunk_size=FIRMWARE_CHUNK_SIZE):
+        if not chunk_size:
+            chunk_size = len(data)
+        number_of_chunks = math.ceil(len(data) / chunk_size)
+        sent_chunks = 0
 
         byte_stream = io.BytesIO(data)
         while True:
-            payload = byte_stream.read(1024)
+            payload = byte_stream.read(chunk_size)
             if not payload:
                 break
 
@@ -146,11 +156,11 @@ class Device():
             if not self.send(message.dump()):
                 print('Abort firmware upgrade')
                 return
-            sent_pages += 1
-            print('{}/{} pages sent'.format(sent_pages, number_of_pages))
+            sent_chunks += 1
+            print('{}/{} chunks sent'.format(sent_chunks, number_of_chunks))
         print('Firmware upgrade done')
 
-    def upgrade(self, upgrade_file, reqest_upgrade=True):
+    def upgrade(self, upgrade_file, reqest_upgrade=True, chunk_size=FIRMWARE_CHUNK_SIZE):
         if reqest_upgrade:
             message = Message(MessageType.REQ_UPDATE)
             self.send(message.dump())
@@ -161,7 +171,7 @@ class Device():
             binary_data = f.read()
 
         self._send_firmware_header(binary_data)
-        self._send_firmware_data(binary_data)
+        self._send_firmware_data(binary_data, chunk_size)
         self._populate_device_information()
         self.reset()
         #TODO: Verify correct version
@@ -236,7 +246,8 @@ def handle_reset(args):
 def handle_upgrade(args):
     """Execute the upgrade command."""
     device = Device(args.interface, args.src_id, args.dest_id, args.w)
-    device.upgrade(args.path, not args.s)
+    chunk_size = None if args.single_message else args.c
+    device.upgrade(args.path, not args.s, chunk_size)
 
 
 def main():
@@ -258,6 +269,8 @@ def main():
     parser_upgrade.add_argument('path', type=str, help='Path to firmware')
     parser_upgrade.add_argument('-w', type=int, default=5, help='Max number of wait indications')
     parser_upgrade.add_argument('-s', action='store_true', default=False, help='Skip upgrade mode request')
+    parser_upgrade.add_argument('-c', type=int, default=FIRMWARE_CHUNK_SIZE, help='Split the image in messages of this size, at most 4095 bytes for bootloaders without escape first frame support (default: %(default)s)')
+    parser_upgrade.add_argument('--single-message', action='store_true', default=False, help='Send the whole image as one message, requires a bootloader with escape first frame support')
     parser_upgrade.set_defaults(func=handle_upgrade)
 
     args = parser.parse_args()
@@ -6,6 +6,9 @@ import argparse
 import isotp
 from can.interfaces.socketcan import SocketcanBus
 
+# Messages larger than 4095 bytes use the ISO 15765-2:2016 escape first frame.
+MAX_MESSAGE_SIZE = 0xFFFFFFFF
+
 
 def error_handler(error):
     """ISO-TP error handler"""
@@ -35,7 +38,7 @@ def handle_recv(args):
     bus = SocketcanBus(channel=args.interface)
     addr = isotp.Address(isotp.AddressingMode.Normal_11bits, rxid=args.src_id, txid=args.dest_id)
 
-    parameters = {'stmin': args.m, 'rx_consecutive_frame_timeout': args.t, 'blocksize': args.b}
+    parameters = {'stmin': args.m, 'rx_consecutive_frame_timeout': args.t, 'blocksize': args.b, 'max_frame_size': MAX_MESSAGE_SIZE}
     stack = isotp.CanStack(bus, address=addr, error_handler=error_handler, params=parameters)
 
     while True:
@@ -57,7 +60,7 @@ def main():
     subparsers = parser.add_subparsers()
 
     parser_send = subparsers.add_parser('send', help='Send payload')
-    parser_send.add_argument('length', type=int, help='Length of the payload')
+    parser_send.add_argument('length', type=int, help='Length of the payload, larger than 4095 bytes is sent with an escape first frame')
     parser_send.add_argument('-w', type=int, default=5, help='Max number of wait indications')
     parser_send.set_defaults(func=handle_send)
 